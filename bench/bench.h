@@ -0,0 +1,55 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdio.h>
+
+/**
+ * Every bench_*() compares a structure of libalg with what it replaces
+ * and prints one line per variant with bench_report(). Sizes are fixed
+ * so that the numbers of two commits can be compared on one machine.
+ */
+
+/**
+ * @return      monotonic time in seconds.
+ */
+double bench_now(void);
+
+/**
+ * print @value of @variant, e.g. bench_report("lru", "zipf 0.99", 91.2, "% hits").
+ */
+void bench_report(const char *bench, const char *variant, double value, const char *unit);
+
+/**
+ * run @run(@ctx, id) on @threads threads with ids 0 .. @threads - 1,
+ * started together.
+ * @return      seconds from the start until the last thread is done.
+ */
+double bench_parallel(int threads, void (*run)(void *ctx, int id), void *ctx);
+
+/**
+ * xorshift64* on a caller owned @state, so threads do not share one.
+ */
+unsigned long bench_rand(unsigned long *state);
+
+int bench_bistree_u64(void);
+int bench_bistree_fc(void);
+int bench_bistree_rcu(void);
+int bench_avl_tree(void);
+int bench_bptree(void);
+int bench_bistree_setops(void);
+int bench_frozen(void);
+int bench_sorted_batch(void);
+int bench_bitree_sized(void);
+int bench_bitree_walk(void);
+int bench_bitree_reduce(void);
+int bench_bitree_pool(void);
+int bench_bitree_implicit(void);
+int bench_lfqueue(void);
+int bench_htable(void);
+int bench_hmap(void);
+int bench_mlist_sort(void);
+int bench_ulist(void);
+int bench_lru(void);
+int bench_skiplist(void);
+
+#endif
@@ -0,0 +1,133 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+extern "C" {
+#include "bench.h"
+#include "../src/tree/bistree.h"
+}
+#include "../src/tree/avl_tree.hpp"
+
+#define KEYS (1 << 18)
+#define LOOKUPS (1 << 22)
+
+namespace {
+
+int compare(const void *key1, const void *key2)
+{
+    uint64_t a = *(const uint64_t *)key1, b = *(const uint64_t *)key2;
+
+    return a < b ? -1 : a > b;
+}
+
+/**
+ * time @insert over all @keys, then @find on random ones, the same
+ * sequence for every tree.
+ * @return      -1 if a key was not found.
+ */
+template <class K, class Insert, class Find>
+int run(const char *variant, const std::vector<K> &keys, Insert insert, Find find)
+{
+    unsigned long seed = 33;
+    char name[64];
+    double start = bench_now(), inserted;
+    long i, found = 0;
+
+    for (i = 0; i < (long)keys.size(); i++)
+        insert(keys[i]);
+    inserted = bench_now() - start;
+
+    start = bench_now();
+    for (i = 0; i < LOOKUPS; i++)
+        found += find(keys[bench_rand(&seed) % keys.size()]);
+    if (found != LOOKUPS)
+        return -1;
+
+    snprintf(name, sizeof(name), "%s insert", variant);
+    bench_report("avl_tree", name, keys.size() / inserted / 1e6, "Minserts/s");
+    snprintf(name, sizeof(name), "%s lookup", variant);
+    bench_report("avl_tree", name, LOOKUPS / (bench_now() - start) / 1e6, "Mlookups/s");
+
+    return 0;
+}
+
+int integers()
+{
+    std::vector<uint64_t> keys(KEYS);
+    unsigned long seed = 1;
+    long i;
+
+    // Distinct random keys
+    {
+        alg::avl_tree<uint64_t, long> seen;
+        for (i = 0; i < KEYS; i++) {
+            do {
+                keys[i] = bench_rand(&seed);
+            } while (!seen.insert(keys[i], i).second);
+        }
+    }
+
+    alg::avl_tree<uint64_t, uint64_t> avl;
+    if (run("avl_tree u64", keys,
+            [&](uint64_t k) { avl.insert(k, k); },
+            [&](uint64_t k) { return avl.find(k) != nullptr; }) != 0)
+        return -1;
+
+    std::map<uint64_t, uint64_t> map;
+    if (run("std::map u64", keys,
+            [&](uint64_t k) { map.emplace(k, k); },
+            [&](uint64_t k) { return map.find(k) != map.end(); }) != 0)
+        return -1;
+
+    // The C tree stores pointers to the keys and compares through one
+    BisTree bistree;
+    bistree_init(&bistree, compare, NULL);
+    int ret = run("bistree u64", keys,
+                  [&](const uint64_t &k) { bistree_insert(&bistree, &k); },
+                  [&](const uint64_t &k) {
+                      void *data = (void *)&k;
+                      return bistree_lookup(&bistree, &data) == 0;
+                  });
+    bistree_destroy(&bistree);
+
+    return ret;
+}
+
+int strings()
+{
+    std::vector<std::string> keys(KEYS);
+    std::vector<std::string_view> views(KEYS);
+    long i;
+
+    // Long enough to live on the heap, distinct by the random suffix
+    for (i = 0; i < KEYS; i++)
+        keys[i] = "/usr/share/doc/packages/" + std::to_string(i * 2654435761UL % 1000000007);
+    for (i = 0; i < KEYS; i++)
+        views[i] = keys[i];
+
+    alg::avl_tree<std::string, long, std::less<> > avl;
+    if (run("avl_tree string", views,
+            [&](std::string_view k) { avl.emplace(std::string(k), 0); },
+            [&](std::string_view k) { return avl.find(k) != nullptr; }) != 0)
+        return -1;
+
+    std::map<std::string, long, std::less<> > map;
+    if (run("std::map string", views,
+            [&](std::string_view k) { map.emplace(std::string(k), 0); },
+            [&](std::string_view k) { return map.find(k) != map.end(); }) != 0)
+        return -1;
+
+    return 0;
+}
+
+} // namespace
+
+extern "C" int bench_avl_tree(void)
+{
+    if (integers() != 0 || strings() != 0)
+        return -1;
+
+    return 0;
+}
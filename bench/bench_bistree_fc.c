@@ -0,0 +1,116 @@
+#include <pthread.h>
+#include <stdio.h>
+#include "bench.h"
+#include "../src/tree/bistree_fc.h"
+
+#define KEYS (1 << 16)
+#define OPS (1 << 20)           // per run, split between the threads
+
+static long keys[KEYS];
+
+static int compare(const void *key1, const void *key2)
+{
+    long a = *(const long *)key1, b = *(const long *)key2;
+
+    return a < b ? -1 : a > b;
+}
+
+struct shared {
+    BisTreeFc fc;
+    BisTree tree;
+    pthread_mutex_t lock;
+    int threads;
+};
+
+// a quarter inserts, a quarter removes, half lookups
+static void fc_run(void *ctx, int id)
+{
+    struct shared *shared = (struct shared *)ctx;
+    struct bistree_fc_slot slot;
+    unsigned long seed = id + 1, r;
+    void *data;
+    long i;
+
+    if (bistree_fc_register(&shared->fc, &slot) != 0)
+        return;
+
+    for (i = 0; i < OPS / shared->threads; i++) {
+        r = bench_rand(&seed);
+        data = &keys[r % KEYS];
+        switch ((r >> 20) % 4) {
+        case 0:
+            bistree_fc_insert(&shared->fc, &slot, data);
+            break;
+        case 1:
+            bistree_fc_remove(&shared->fc, &slot, data);
+            break;
+        default:
+            bistree_fc_lookup(&shared->fc, &slot, &data);
+        }
+    }
+
+    bistree_fc_unregister(&shared->fc, &slot);
+}
+
+static void mutex_run(void *ctx, int id)
+{
+    struct shared *shared = (struct shared *)ctx;
+    unsigned long seed = id + 1, r;
+    void *data;
+    long i;
+
+    for (i = 0; i < OPS / shared->threads; i++) {
+        r = bench_rand(&seed);
+        data = &keys[r % KEYS];
+        pthread_mutex_lock(&shared->lock);
+        switch ((r >> 20) % 4) {
+        case 0:
+            bistree_insert(&shared->tree, data);
+            break;
+        case 1:
+            bistree_remove(&shared->tree, data);
+            break;
+        default:
+            bistree_lookup(&shared->tree, &data);
+        }
+        pthread_mutex_unlock(&shared->lock);
+    }
+}
+
+int bench_bistree_fc(void)
+{
+    struct shared shared;
+    char variant[32];
+    double seconds;
+    long i;
+
+    for (i = 0; i < KEYS; i++)
+        keys[i] = i;
+
+    // Both trees start half full
+    for (shared.threads = 1; shared.threads <= 64; shared.threads *= 2) {
+        bistree_fc_init(&shared.fc, compare, NULL);
+        for (i = 0; i < KEYS; i += 2)
+            bistree_insert(&shared.fc.tree, &keys[i]);
+        seconds = bench_parallel(shared.threads, fc_run, &shared);
+        bistree_fc_destroy(&shared.fc);
+        if (seconds < 0)
+            return -1;
+        snprintf(variant, sizeof(variant), "flat combining %d threads", shared.threads);
+        bench_report("bistree_fc", variant, OPS / seconds / 1e6, "Mops/s");
+
+        bistree_init(&shared.tree, compare, NULL);
+        pthread_mutex_init(&shared.lock, NULL);
+        for (i = 0; i < KEYS; i += 2)
+            bistree_insert(&shared.tree, &keys[i]);
+        seconds = bench_parallel(shared.threads, mutex_run, &shared);
+        bistree_destroy(&shared.tree);
+        pthread_mutex_destroy(&shared.lock);
+        if (seconds < 0)
+            return -1;
+        snprintf(variant, sizeof(variant), "mutex %d threads", shared.threads);
+        bench_report("bistree_fc", variant, OPS / seconds / 1e6, "Mops/s");
+    }
+
+    return 0;
+}
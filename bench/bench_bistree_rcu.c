@@ -0,0 +1,134 @@
+#include <pthread.h>
+#include <stdio.h>
+#include "bench.h"
+#include "../src/tree/bistree.h"
+
+#define KEYS (1 << 16)
+#define READS (1 << 20)         // per run, split between the readers
+
+static long keys[KEYS];
+
+static int compare(const void *key1, const void *key2)
+{
+    long a = *(const long *)key1, b = *(const long *)key2;
+
+    return a < b ? -1 : a > b;
+}
+
+struct shared {
+    BisTreeRcu rcu;
+    BisTree tree;
+    pthread_rwlock_t lock;
+    int readers;
+    int running;                // readers not done yet
+    long writes;
+};
+
+/**
+ * thread 0 is the writer, it inserts and removes odd keys until the
+ * last reader is done. The even keys are always there.
+ */
+static void rcu_run(void *ctx, int id)
+{
+    struct shared *shared = (struct shared *)ctx;
+    struct epoch_record record;
+    unsigned long seed = id + 1, r;
+    void *data;
+    long i;
+
+    if (id == 0) {
+        for (i = 0; __atomic_load_n(&shared->running, __ATOMIC_ACQUIRE) > 0; i++) {
+            r = bench_rand(&seed);
+            if (r & 1)
+                bistree_rcu_insert(&shared->rcu, &keys[r % KEYS | 1]);
+            else
+                bistree_rcu_remove(&shared->rcu, &keys[r % KEYS | 1]);
+        }
+        shared->writes = i;
+        return;
+    }
+
+    bistree_rcu_register(&shared->rcu, &record);
+    for (i = 0; i < READS / shared->readers; i++) {
+        data = &keys[bench_rand(&seed) % KEYS];
+        bistree_rcu_lookup(&shared->rcu, &record, &data);
+    }
+    bistree_rcu_unregister(&shared->rcu, &record);
+    __atomic_sub_fetch(&shared->running, 1, __ATOMIC_RELEASE);
+}
+
+static void rwlock_run(void *ctx, int id)
+{
+    struct shared *shared = (struct shared *)ctx;
+    unsigned long seed = id + 1, r;
+    void *data;
+    long i;
+
+    if (id == 0) {
+        for (i = 0; __atomic_load_n(&shared->running, __ATOMIC_ACQUIRE) > 0; i++) {
+            r = bench_rand(&seed);
+            pthread_rwlock_wrlock(&shared->lock);
+            if (r & 1)
+                bistree_insert(&shared->tree, &keys[r % KEYS | 1]);
+            else
+                bistree_remove(&shared->tree, &keys[r % KEYS | 1]);
+            pthread_rwlock_unlock(&shared->lock);
+        }
+        shared->writes = i;
+        return;
+    }
+
+    for (i = 0; i < READS / shared->readers; i++) {
+        data = &keys[bench_rand(&seed) % KEYS];
+        pthread_rwlock_rdlock(&shared->lock);
+        bistree_lookup(&shared->tree, &data);
+        pthread_rwlock_unlock(&shared->lock);
+    }
+    __atomic_sub_fetch(&shared->running, 1, __ATOMIC_RELEASE);
+}
+
+static void report(const char *name, struct shared *shared, double seconds)
+{
+    char variant[40];
+
+    snprintf(variant, sizeof(variant), "%s %d readers", name, shared->readers);
+    bench_report("bistree_rcu", variant, READS / seconds / 1e6, "Mreads/s");
+    snprintf(variant, sizeof(variant), "%s %d readers writer", name, shared->readers);
+    bench_report("bistree_rcu", variant, shared->writes / seconds / 1e6, "Mwrites/s");
+}
+
+int bench_bistree_rcu(void)
+{
+    struct shared shared;
+    double seconds;
+    long i;
+
+    for (i = 0; i < KEYS; i++)
+        keys[i] = i;
+
+    for (shared.readers = 1; shared.readers <= 8; shared.readers *= 2) {
+        bistree_rcu_init(&shared.rcu, compare, NULL);
+        for (i = 0; i < KEYS; i += 2)
+            bistree_rcu_insert(&shared.rcu, &keys[i]);
+        shared.running = shared.readers;
+        seconds = bench_parallel(shared.readers + 1, rcu_run, &shared);
+        bistree_rcu_destroy(&shared.rcu);
+        if (seconds < 0)
+            return -1;
+        report("rcu", &shared, seconds);
+
+        bistree_init(&shared.tree, compare, NULL);
+        pthread_rwlock_init(&shared.lock, NULL);
+        for (i = 0; i < KEYS; i += 2)
+            bistree_insert(&shared.tree, &keys[i]);
+        shared.running = shared.readers;
+        seconds = bench_parallel(shared.readers + 1, rwlock_run, &shared);
+        bistree_destroy(&shared.tree);
+        pthread_rwlock_destroy(&shared.lock);
+        if (seconds < 0)
+            return -1;
+        report("rwlock", &shared, seconds);
+    }
+
+    return 0;
+}
@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+#include "../src/tree/bistree.h"
+#include "../src/thread/wspool.h"
+
+#define KEYS (1 << 21)          // both inputs draw from these
+
+static long keys[KEYS];
+static void *evens[KEYS / 2];
+static void *thirds[KEYS / 3 + 1];
+
+static int compare(const void *key1, const void *key2)
+{
+    long a = *(const long *)key1, b = *(const long *)key2;
+
+    return a < b ? -1 : a > b;
+}
+
+enum {
+    BUILD,
+    UNION,
+    INTERSECTION,
+    DIFFERENCE,
+    OPS,
+};
+
+static const char *names[OPS] = { "build", "union", "intersection", "difference" };
+
+/**
+ * time one operation, sequential without @pool.
+ * @return      seconds, -1 on failure.
+ */
+static double run(int op, struct wspool *pool)
+{
+    BisTree t1, t2, tree;
+    double start;
+    int ret;
+
+    bistree_init(&t1, compare, NULL);
+    bistree_init(&t2, compare, NULL);
+    if (op == BUILD) {
+        start = bench_now();
+        ret = pool != NULL ? bistree_parallel_build_sorted(&t1, evens, KEYS / 2, pool)
+                           : bistree_build_sorted(&t1, evens, KEYS / 2);
+        start = bench_now() - start;
+        bistree_destroy(&t1);
+        bistree_destroy(&t2);
+        return ret == 0 ? start : -1;
+    }
+
+    // Every second key against every third one
+    if (bistree_build_sorted(&t1, evens, KEYS / 2) != 0
+        || bistree_build_sorted(&t2, thirds, (KEYS + 2) / 3) != 0) {
+        bistree_destroy(&t1);
+        bistree_destroy(&t2);
+        return -1;
+    }
+
+    start = bench_now();
+    switch (op) {
+    case UNION:
+        ret = pool != NULL ? bistree_parallel_union(&tree, &t1, &t2, pool)
+                           : bistree_union(&tree, &t1, &t2);
+        break;
+    case INTERSECTION:
+        ret = pool != NULL ? bistree_parallel_intersection(&tree, &t1, &t2, pool)
+                           : bistree_intersection(&tree, &t1, &t2);
+        break;
+    default:
+        ret = pool != NULL ? bistree_parallel_difference(&tree, &t1, &t2, pool)
+                           : bistree_difference(&tree, &t1, &t2);
+    }
+    start = bench_now() - start;
+
+    if (ret == 0)
+        bistree_destroy(&tree);
+    bistree_destroy(&t1);
+    bistree_destroy(&t2);
+
+    return ret == 0 ? start : -1;
+}
+
+int bench_bistree_setops(void)
+{
+    struct wspool *pool;
+    char variant[40];
+    double seconds;
+    int op, threads;
+    long i;
+
+    for (i = 0; i < KEYS; i++)
+        keys[i] = i;
+    for (i = 0; i < KEYS; i += 2)
+        evens[i / 2] = &keys[i];
+    for (i = 0; i < KEYS; i += 3)
+        thirds[i / 3] = &keys[i];
+
+    for (op = 0; op < OPS; op++) {
+        if ((seconds = run(op, NULL)) < 0)
+            return -1;
+        snprintf(variant, sizeof(variant), "%s sequential", names[op]);
+        bench_report("bistree_setops", variant, seconds * 1e3, "ms");
+
+        for (threads = 1; threads <= 8; threads *= 2) {
+            if ((pool = wspool_create(threads)) == NULL)
+                return -1;
+            seconds = run(op, pool);
+            wspool_destroy(pool);
+            if (seconds < 0)
+                return -1;
+            snprintf(variant, sizeof(variant), "%s %d threads", names[op], threads);
+            bench_report("bistree_setops", variant, seconds * 1e3, "ms");
+        }
+    }
+
+    return 0;
+}
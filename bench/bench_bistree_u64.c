@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "bench.h"
+#include "../src/tree/bistree.h"
+#include "../src/tree/bistree_u64.h"
+
+#define LOOKUPS (1 << 22)
+
+static int compare(const void *key1, const void *key2)
+{
+    uint64_t a = *(const uint64_t *)key1, b = *(const uint64_t *)key2;
+
+    return a < b ? -1 : a > b;
+}
+
+// random hits, the same sequence for both trees
+static double lookup_u64(BisTreeU64 *tree, const uint64_t *keys, long size)
+{
+    unsigned long seed = 33;
+    void *data;
+    double start = bench_now();
+    long i, found = 0;
+
+    for (i = 0; i < LOOKUPS; i++)
+        found += bistree_u64_lookup(tree, keys[bench_rand(&seed) % size], &data) == 0;
+
+    return found == LOOKUPS ? bench_now() - start : -1;
+}
+
+static double lookup_generic(BisTree *tree, uint64_t *keys, long size)
+{
+    unsigned long seed = 33;
+    void *data;
+    double start = bench_now();
+    long i, found = 0;
+
+    for (i = 0; i < LOOKUPS; i++) {
+        data = &keys[bench_rand(&seed) % size];
+        found += bistree_lookup(tree, &data) == 0;
+    }
+
+    return found == LOOKUPS ? bench_now() - start : -1;
+}
+
+int bench_bistree_u64(void)
+{
+    BisTreeU64 u64;
+    BisTree generic;
+    uint64_t *keys;
+    unsigned long seed = 1;
+    double t64, tgen;
+    char variant[32];
+    long size, i;
+
+    // Cache resident, then bigger than the caches
+    for (size = 1 << 12; size <= 1 << 20; size <<= 4) {
+        if ((keys = (uint64_t *)malloc(size * sizeof(uint64_t))) == NULL)
+            return -1;
+
+        bistree_u64_init(&u64, NULL);
+        bistree_init(&generic, compare, NULL);
+        for (i = 0; i < size; i++) {
+            // Random keys, duplicates only cost a retry
+            do {
+                keys[i] = bench_rand(&seed);
+            } while (bistree_u64_insert(&u64, keys[i], &keys[i]) == 1);
+            bistree_insert(&generic, &keys[i]);
+        }
+
+        t64 = lookup_u64(&u64, keys, size);
+        tgen = lookup_generic(&generic, keys, size);
+        bistree_u64_destroy(&u64);
+        bistree_destroy(&generic);
+        free(keys);
+        if (t64 < 0 || tgen < 0)
+            return -1;
+
+        snprintf(variant, sizeof(variant), "bistree_u64 %ld keys", size);
+        bench_report("bistree_u64", variant, LOOKUPS / t64 / 1e6, "Mlookups/s");
+        snprintf(variant, sizeof(variant), "bistree %ld keys", size);
+        bench_report("bistree_u64", variant, LOOKUPS / tgen / 1e6, "Mlookups/s");
+        snprintf(variant, sizeof(variant), "speedup %ld keys", size);
+        bench_report("bistree_u64", variant, tgen / t64, "x");
+    }
+
+    return 0;
+}
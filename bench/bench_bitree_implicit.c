@@ -0,0 +1,88 @@
+#include <malloc.h>
+#include <stdio.h>
+#include "bench.h"
+#include "../src/tree/bitree_implicit.h"
+
+#define NODES (1 << 23)
+
+static long values[NODES];
+
+static int visit(void *data, void *ctx)
+{
+    *(long *)ctx += *(long *)data;
+    return 0;
+}
+
+// heap memory in use, mapped chunks included
+static size_t in_use(void)
+{
+    struct mallinfo2 info = mallinfo2();
+
+    return info.uordblks + info.hblkhd;
+}
+
+static const char *orders[] = { "preorder", "inorder", "postorder" };
+
+int bench_bitree_implicit(void)
+{
+    struct bitree_implicit implicit, source;
+    struct bitree_tree tree;
+    double seconds;
+    char variant[40];
+    size_t base, bytes;
+    long i, sum;
+    int order, ret = -1;
+
+    for (i = 0; i < NODES; i++)
+        values[i] = i;
+
+    bitree_implicit_init(&implicit, NULL);
+    bitree_implicit_init(&source, NULL);
+    bitree_init(&tree, NULL);
+
+    base = in_use();
+    for (i = 0; i < NODES; i++)
+        if (bitree_implicit_push(&implicit, &values[i]) != 0)
+            goto out;
+    bytes = in_use() - base;
+    bench_report("bitree_implicit", "implicit memory", (double)bytes / NODES, "bytes/node");
+
+    // The same complete tree with pointers
+    base = in_use();
+    for (i = 0; i < NODES; i++)
+        if (bitree_implicit_push(&source, &values[i]) != 0)
+            goto out;
+    if (bitree_implicit_to_bitree(&source, &tree) != 0)
+        goto out;
+    bitree_implicit_destroy(&source);
+    bytes = in_use() - base;
+    bench_report("bitree_implicit", "pointer memory", (double)bytes / NODES, "bytes/node");
+
+    for (order = BITREE_PREORDER; order <= BITREE_POSTORDER; order++) {
+        sum = 0;
+        seconds = bench_now();
+        bitree_implicit_walk(&implicit, 0, order, visit, &sum);
+        seconds = bench_now() - seconds;
+        if (sum != (long)NODES * (NODES - 1) / 2)
+            goto out;
+        snprintf(variant, sizeof(variant), "implicit %s", orders[order]);
+        bench_report("bitree_implicit", variant, NODES / seconds / 1e6, "Mnodes/s");
+
+        sum = 0;
+        seconds = bench_now();
+        bitree_walk(bitree_root(&tree), order, visit, &sum);
+        seconds = bench_now() - seconds;
+        if (sum != (long)NODES * (NODES - 1) / 2)
+            goto out;
+        snprintf(variant, sizeof(variant), "pointer %s", orders[order]);
+        bench_report("bitree_implicit", variant, NODES / seconds / 1e6, "Mnodes/s");
+    }
+    ret = 0;
+
+out:
+    bitree_implicit_destroy(&implicit);
+    bitree_implicit_destroy(&source);
+    bitree_destroy(&tree);
+
+    return ret;
+}
@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+#include "../src/tree/bitree.h"
+
+#define NODES 10000000
+
+static struct bitree_node **heap;
+static long destroyed;
+
+static void destroy(void *data)
+{
+    (void)data;
+    destroyed++;
+}
+
+// heap order: the children of heap[k] are heap[2k] and heap[2k + 1]
+static int grow(struct bitree_tree *tree)
+{
+    int k;
+
+    if (bitree_ins_left_data(tree, NULL, NULL) != 0)
+        return -1;
+    heap[1] = bitree_root(tree);
+
+    for (k = 2; k <= NODES; k++) {
+        if (k % 2 == 0) {
+            if (bitree_ins_left_data(tree, heap[k / 2], NULL) != 0)
+                return -1;
+            heap[k] = bitree_left(heap[k / 2]);
+        } else {
+            if (bitree_ins_right_data(tree, heap[k / 2], NULL) != 0)
+                return -1;
+            heap[k] = bitree_right(heap[k / 2]);
+        }
+    }
+
+    return 0;
+}
+
+enum {
+    MALLOC,
+    POOL,
+    POOL_DESTROY,
+    POOL_HUGEPAGE,
+    KINDS,
+};
+
+static const char *names[KINDS] = { "malloc", "pool", "pool destroy", "pool hugepage" };
+
+static int run(int kind)
+{
+    struct bitree_tree tree;
+    char variant[40];
+    double start, build;
+    long allocations = NODES, per_slab;
+
+    bitree_init(&tree, kind == POOL_DESTROY ? destroy : NULL);
+    if (kind != MALLOC
+        && bitree_use_pool(&tree, kind == POOL_HUGEPAGE ? BITREE_POOL_HUGEPAGE : 0) != 0)
+        return -1;
+
+    start = bench_now();
+    if (grow(&tree) != 0) {
+        bitree_destroy(&tree);
+        return -1;
+    }
+    build = bench_now() - start;
+
+    // The pool itself and its slabs
+    if (tree.pool != NULL) {
+        per_slab = (tree.pool->slab_size - 16) / tree.pool->object;
+        allocations = 1 + (NODES + per_slab - 1) / per_slab;
+    }
+
+    destroyed = 0;
+    start = bench_now();
+    bitree_destroy(&tree);
+    start = bench_now() - start;
+    if (kind == POOL_DESTROY && destroyed != NODES)
+        return -1;
+
+    snprintf(variant, sizeof(variant), "%s build", names[kind]);
+    bench_report("bitree_pool", variant, NODES / build / 1e6, "Mnodes/s");
+    bench_report("bitree_pool", names[kind], allocations, "allocations");
+    snprintf(variant, sizeof(variant), "%s teardown", names[kind]);
+    bench_report("bitree_pool", variant, start * 1e3, "ms");
+
+    return 0;
+}
+
+int bench_bitree_pool(void)
+{
+    int kind;
+
+    if ((heap = (struct bitree_node **)malloc((NODES + 1) * sizeof(*heap))) == NULL)
+        return -1;
+    for (kind = 0; kind < KINDS && run(kind) == 0; kind++)
+        ;
+    free(heap);
+
+    return kind == KINDS ? 0 : -1;
+}
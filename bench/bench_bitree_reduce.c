@@ -0,0 +1,136 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+#include "../src/tree/bitree.h"
+#include "../src/thread/wspool.h"
+
+#define NODES (1 << 22)
+#define CHAIN (1 << 20)
+#define ROUNDS 4
+
+static long *values;
+static struct bitree_node **heap;
+
+static void map(void *acc, void *data, void *ctx)
+{
+    (void)ctx;
+    *(long *)acc += *(long *)data;
+}
+
+static void combine(void *acc, const void *other, void *ctx)
+{
+    (void)ctx;
+    *(long *)acc += *(const long *)other;
+}
+
+/**
+ * fill the empty @tree with @count nodes, in heap order or, with @chain,
+ * each the right child of the one before.
+ */
+static int grow(struct bitree_tree *tree, int count, int chain)
+{
+    struct bitree_node *parent;
+    int k;
+
+    if (bitree_ins_left_data(tree, NULL, &values[0]) != 0)
+        return -1;
+    heap[1] = bitree_root(tree);
+
+    for (k = 2; k <= count; k++) {
+        parent = heap[chain ? k - 1 : k / 2];
+        if (!chain && k % 2 == 0) {
+            if (bitree_ins_left_data(tree, parent, &values[k - 1]) != 0)
+                return -1;
+            heap[k] = bitree_left(parent);
+        } else {
+            if (bitree_ins_right_data(tree, parent, &values[k - 1]) != 0)
+                return -1;
+            heap[k] = bitree_right(parent);
+        }
+    }
+
+    return 0;
+}
+
+static double reduce(struct bitree_tree *tree, long count, struct wspool *pool)
+{
+    static const long identity = 0;
+    double start = bench_now();
+    long sum;
+    int i;
+
+    for (i = 0; i < ROUNDS; i++) {
+        if (bitree_parallel_reduce(tree, map, combine, &identity, sizeof(sum), &sum,
+                                   NULL, pool) != 0
+            || sum != count * (count - 1) / 2)
+            return -1;
+    }
+
+    return bench_now() - start;
+}
+
+static int run(const char *shape, struct bitree_tree *tree, long count)
+{
+    struct wspool *pool;
+    char variant[40];
+    double seconds;
+    int threads;
+
+    if ((seconds = reduce(tree, count, NULL)) < 0)
+        return -1;
+    snprintf(variant, sizeof(variant), "%s sequential", shape);
+    bench_report("bitree_reduce", variant, ROUNDS * count / seconds / 1e6, "Mnodes/s");
+
+    for (threads = 1; threads <= 8; threads *= 2) {
+        if ((pool = wspool_create(threads)) == NULL)
+            return -1;
+        seconds = reduce(tree, count, pool);
+        wspool_destroy(pool);
+        if (seconds < 0)
+            return -1;
+        snprintf(variant, sizeof(variant), "%s %d threads", shape, threads);
+        bench_report("bitree_reduce", variant, ROUNDS * count / seconds / 1e6, "Mnodes/s");
+    }
+
+    return 0;
+}
+
+int bench_bitree_reduce(void)
+{
+    struct bitree_tree tree;
+    int ret = -1, sized;
+    long i;
+
+    values = (long *)malloc(NODES * sizeof(long));
+    heap = (struct bitree_node **)malloc((NODES + 1) * sizeof(*heap));
+    if (values == NULL || heap == NULL)
+        goto out;
+    for (i = 0; i < NODES; i++)
+        values[i] = i;
+
+    // Plain trees fork down to a fixed depth, sized ones by subtree size
+    for (sized = 0; sized < 2; sized++) {
+        if (sized)
+            bitree_init_sized(&tree, NULL);
+        else
+            bitree_init(&tree, NULL);
+        ret = grow(&tree, NODES, 0) == 0
+            ? run(sized ? "balanced sized" : "balanced", &tree, NODES) : -1;
+        bitree_destroy(&tree);
+        if (ret != 0)
+            goto out;
+    }
+
+    bitree_init(&tree, NULL);
+    ret = grow(&tree, CHAIN, 1) == 0 ? run("right chain", &tree, CHAIN) : -1;
+    // bitree_destroy() recurses per level, so take the chain apart from below
+    while (bitree_size(&tree) > 1)
+        bitree_rm_right(&tree, heap[bitree_size(&tree) - 1]);
+    bitree_destroy(&tree);
+
+out:
+    free(values);
+    free(heap);
+
+    return ret;
+}
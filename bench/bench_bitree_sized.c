@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+#include "../src/tree/bitree.h"
+
+#define NODES 10000000
+#define ROUNDS 8
+
+/**
+ * fill the empty @tree with NODES nodes in heap order, @heap[1] is the
+ * root and the children of heap[k] are heap[2k] and heap[2k + 1].
+ */
+static int grow(struct bitree_tree *tree, struct bitree_node **heap)
+{
+    int k;
+
+    if (bitree_ins_left_data(tree, NULL, NULL) != 0)
+        return -1;
+    heap[1] = bitree_root(tree);
+
+    for (k = 2; k <= NODES; k++) {
+        if (k % 2 == 0) {
+            if (bitree_ins_left_data(tree, heap[k / 2], NULL) != 0)
+                return -1;
+            heap[k] = bitree_left(heap[k / 2]);
+        } else {
+            if (bitree_ins_right_data(tree, heap[k / 2], NULL) != 0)
+                return -1;
+            heap[k] = bitree_right(heap[k / 2]);
+        }
+    }
+
+    return 0;
+}
+
+// split at the root and merge the halves back under a new root
+static double split_merge(struct bitree_tree *tree)
+{
+    struct bitree_tree left, right;
+    struct bitree_node *root;
+    double start = bench_now();
+    int i;
+
+    for (i = 0; i < ROUNDS; i++) {
+        if (bitree_split(tree, &left, &right) != 0)
+            return -1;
+        root = bitree_root(tree);
+        root->left = root->right = NULL;
+        bitree_destroy(tree);
+        if (bitree_merge(tree, &left, &right, NULL) != 0)
+            return -1;
+    }
+
+    return bitree_size(tree) == NODES ? bench_now() - start : -1;
+}
+
+int bench_bitree_sized(void)
+{
+    struct bitree_node **heap;
+    struct bitree_tree tree;
+    double seconds;
+    int sized;
+
+    if ((heap = (struct bitree_node **)malloc((NODES + 1) * sizeof(*heap))) == NULL)
+        return -1;
+
+    for (sized = 0; sized < 2; sized++) {
+        if (sized)
+            bitree_init_sized(&tree, NULL);
+        else
+            bitree_init(&tree, NULL);
+        seconds = grow(&tree, heap) == 0 ? split_merge(&tree) : -1;
+        bitree_destroy(&tree);
+        if (seconds < 0)
+            break;
+        bench_report("bitree_sized", sized ? "sized split+merge" : "plain split+merge",
+                     seconds / ROUNDS * 1e6, "us");
+    }
+    free(heap);
+
+    return sized == 2 ? 0 : -1;
+}
@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+#include "../src/tree/bitree.h"
+
+#define NODES 10000000
+
+static struct bitree_node **heap;
+
+/**
+ * fill the empty @tree with NODES nodes, in heap order or, with @chain,
+ * each the left child of the one before.
+ */
+static int grow(struct bitree_tree *tree, int chain)
+{
+    struct bitree_node *parent;
+    int k;
+
+    if (bitree_ins_left_data(tree, NULL, NULL) != 0)
+        return -1;
+    heap[1] = bitree_root(tree);
+
+    for (k = 2; k <= NODES; k++) {
+        parent = heap[chain ? k - 1 : k / 2];
+        if (chain || k % 2 == 0) {
+            if (bitree_ins_left_data(tree, parent, NULL) != 0)
+                return -1;
+            heap[k] = bitree_left(parent);
+        } else {
+            if (bitree_ins_right_data(tree, parent, NULL) != 0)
+                return -1;
+            heap[k] = bitree_right(parent);
+        }
+    }
+
+    return 0;
+}
+
+static int visit(void *data, void *ctx)
+{
+    (void)data;
+    (*(long *)ctx)++;
+    return 0;
+}
+
+// what show_tree_inorder() used to do, one call per node
+static void recurse(struct bitree_node *node, long *count)
+{
+    if (node == NULL)
+        return;
+    recurse(bitree_left(node), count);
+    (*count)++;
+    recurse(bitree_right(node), count);
+}
+
+enum {
+    WALK_PREORDER,
+    WALK_INORDER,
+    MORRIS_INORDER,
+    ITER_INORDER,
+    RECURSIVE,
+    WAYS,
+};
+
+static const char *names[WAYS] = {
+    "walk preorder", "walk inorder", "morris inorder", "iter inorder", "recursive inorder",
+};
+
+static double traverse(struct bitree_tree *tree, int way)
+{
+    struct bitree_iter iter;
+    double start = bench_now();
+    long count = 0;
+
+    switch (way) {
+    case WALK_PREORDER:
+    case WALK_INORDER:
+        if (bitree_walk(bitree_root(tree), way == WALK_PREORDER ? BITREE_PREORDER
+                        : BITREE_INORDER, visit, &count) != 0)
+            return -1;
+        break;
+    case MORRIS_INORDER:
+        if (bitree_walk_morris(bitree_root(tree), BITREE_INORDER, visit, &count) != 0)
+            return -1;
+        break;
+    case ITER_INORDER:
+        if (bitree_iter_init(&iter, bitree_root(tree), BITREE_INORDER) != 0)
+            return -1;
+        while (bitree_iter_next(&iter) != NULL)
+            count++;
+        bitree_iter_destroy(&iter);
+        break;
+    default:
+        recurse(bitree_root(tree), &count);
+    }
+
+    return count == NODES ? bench_now() - start : -1;
+}
+
+int bench_bitree_walk(void)
+{
+    struct bitree_tree tree;
+    char variant[40];
+    double seconds;
+    int chain, way;
+
+    if ((heap = (struct bitree_node **)malloc((NODES + 1) * sizeof(*heap))) == NULL)
+        return -1;
+
+    for (chain = 0; chain < 2; chain++) {
+        bitree_init(&tree, NULL);
+        seconds = grow(&tree, chain) == 0 ? 0 : -1;
+        // A chain this long would overflow the stack of the recursion
+        for (way = 0; seconds >= 0 && way < (chain ? RECURSIVE : WAYS); way++) {
+            if ((seconds = traverse(&tree, way)) < 0)
+                break;
+            snprintf(variant, sizeof(variant), "%s %s", names[way], chain ? "chain" : "balanced");
+            bench_report("bitree_walk", variant, NODES / seconds / 1e6, "Mnodes/s");
+        }
+        // bitree_destroy() recurses per level, so take the chain apart from below
+        while (chain && bitree_size(&tree) > 1)
+            bitree_rm_left(&tree, heap[bitree_size(&tree) - 1]);
+        bitree_destroy(&tree);
+        if (seconds < 0)
+            break;
+    }
+    free(heap);
+
+    return chain == 2 ? 0 : -1;
+}
@@ -0,0 +1,136 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "bench.h"
+#include "../src/tree/bistree.h"
+#include "../src/tree/bptree.h"
+
+#define LOOKUPS (1 << 22)
+#define SCANS 8
+
+static int compare(const void *key1, const void *key2)
+{
+    uint64_t a = *(const uint64_t *)key1, b = *(const uint64_t *)key2;
+
+    return a < b ? -1 : a > b;
+}
+
+static int count(void *data, void *ctx)
+{
+    (void)data;
+    (*(long *)ctx)++;
+    return 0;
+}
+
+// the in-order walk of a BisTree sees AvlNodes, removed ones included
+static int count_live(void *data, void *ctx)
+{
+    if (!((AvlNode *)data)->hidden)
+        (*(long *)ctx)++;
+    return 0;
+}
+
+struct times {
+    double insert;
+    double lookup;
+    double scan;
+};
+
+static int run_bptree(uint64_t *keys, long size, struct times *times)
+{
+    BpTree tree;
+    unsigned long seed = 33;
+    double start;
+    void *data;
+    long i, found = 0;
+
+    bptree_init(&tree, compare, NULL);
+    start = bench_now();
+    for (i = 0; i < size; i++)
+        bptree_insert(&tree, &keys[i]);
+    times->insert = bench_now() - start;
+
+    start = bench_now();
+    for (i = 0; i < LOOKUPS; i++) {
+        data = &keys[bench_rand(&seed) % size];
+        found += bptree_lookup(&tree, &data) == 0;
+    }
+    times->lookup = bench_now() - start;
+
+    start = bench_now();
+    for (i = 0; i < SCANS; i++)
+        bptree_scan(&tree, NULL, NULL, count, &found);
+    times->scan = bench_now() - start;
+    bptree_destroy(&tree);
+
+    return found == LOOKUPS + SCANS * size ? 0 : -1;
+}
+
+static int run_bistree(uint64_t *keys, long size, struct times *times)
+{
+    BisTree tree;
+    unsigned long seed = 33;
+    double start;
+    void *data;
+    long i, found = 0;
+
+    bistree_init(&tree, compare, NULL);
+    start = bench_now();
+    for (i = 0; i < size; i++)
+        bistree_insert(&tree, &keys[i]);
+    times->insert = bench_now() - start;
+
+    start = bench_now();
+    for (i = 0; i < LOOKUPS; i++) {
+        data = &keys[bench_rand(&seed) % size];
+        found += bistree_lookup(&tree, &data) == 0;
+    }
+    times->lookup = bench_now() - start;
+
+    start = bench_now();
+    for (i = 0; i < SCANS; i++)
+        bitree_walk(bitree_root(&tree), BITREE_INORDER, count_live, &found);
+    times->scan = bench_now() - start;
+    bistree_destroy(&tree);
+
+    return found == LOOKUPS + SCANS * size ? 0 : -1;
+}
+
+static void report(const char *tree, long size, const struct times *times)
+{
+    char variant[40];
+
+    snprintf(variant, sizeof(variant), "%s insert %ld keys", tree, size);
+    bench_report("bptree", variant, size / times->insert / 1e6, "Minserts/s");
+    snprintf(variant, sizeof(variant), "%s lookup %ld keys", tree, size);
+    bench_report("bptree", variant, LOOKUPS / times->lookup / 1e6, "Mlookups/s");
+    snprintf(variant, sizeof(variant), "%s scan %ld keys", tree, size);
+    bench_report("bptree", variant, SCANS * size / times->scan / 1e6, "Mkeys/s");
+}
+
+int bench_bptree(void)
+{
+    struct times bp, avl;
+    uint64_t *keys;
+    long size, i;
+
+    // Cache resident, then bigger than the caches
+    for (size = 1 << 12; size <= 1 << 20; size <<= 4) {
+        if ((keys = (uint64_t *)malloc(size * sizeof(uint64_t))) == NULL)
+            return -1;
+        // Distinct keys in a scattered order
+        for (i = 0; i < size; i++)
+            keys[i] = (i + 1) * 0x9e3779b97f4a7c15UL;
+
+        if (run_bptree(keys, size, &bp) != 0 || run_bistree(keys, size, &avl) != 0) {
+            free(keys);
+            return -1;
+        }
+        free(keys);
+
+        report("bptree", size, &bp);
+        report("bistree", size, &avl);
+    }
+
+    return 0;
+}
@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "bench.h"
+#include "../src/tree/bistree.h"
+#include "../src/tree/bistree_frozen.h"
+
+#define LOOKUPS (1 << 20)
+
+static int compare(const void *key1, const void *key2)
+{
+    uint64_t a = *(const uint64_t *)key1, b = *(const uint64_t *)key2;
+
+    return a < b ? -1 : a > b;
+}
+
+static uint64_t key_of(const void *data)
+{
+    return *(const uint64_t *)data;
+}
+
+enum {
+    POINTER,
+    FROZEN,
+    FROZEN_U64,
+};
+
+// random hits, the same sequence for every layout
+static double lookup(BisTree *tree, BisFrozen *frozen, int kind, uint64_t *keys, long size)
+{
+    unsigned long seed = 33;
+    void *data;
+    double start = bench_now();
+    long i, found = 0;
+
+    for (i = 0; i < LOOKUPS; i++) {
+        data = &keys[bench_rand(&seed) % size];
+        switch (kind) {
+        case POINTER:
+            found += bistree_lookup(tree, &data) == 0;
+            break;
+        case FROZEN:
+            found += bistree_frozen_lookup(frozen, &data) == 0;
+            break;
+        default:
+            found += bistree_frozen_lookup_u64(frozen, *(uint64_t *)data, &data) == 0;
+        }
+    }
+
+    return found == LOOKUPS ? bench_now() - start : -1;
+}
+
+int bench_frozen(void)
+{
+    static const long sizes[] = { 1 << 12, 1 << 16, 1 << 22 };
+    static const char *names[] = { "bistree", "frozen", "frozen u64" };
+    BisTree tree;
+    BisFrozen frozen;
+    uint64_t *keys;
+    double seconds[3];
+    char variant[40];
+    long size, i;
+    int s, kind;
+
+    // Cache resident up to a tree far bigger than the caches
+    for (s = 0; s < (int)(sizeof(sizes) / sizeof(sizes[0])); s++) {
+        size = sizes[s];
+        if ((keys = (uint64_t *)malloc(size * sizeof(uint64_t))) == NULL)
+            return -1;
+        // Distinct keys in a scattered order
+        bistree_init(&tree, compare, NULL);
+        for (i = 0; i < size; i++) {
+            keys[i] = (i + 1) * 0x9e3779b97f4a7c15UL;
+            bistree_insert(&tree, &keys[i]);
+        }
+
+        if (bistree_freeze_u64(&tree, &frozen, key_of) != 0) {
+            bistree_destroy(&tree);
+            free(keys);
+            return -1;
+        }
+        for (kind = POINTER; kind <= FROZEN_U64; kind++)
+            seconds[kind] = lookup(&tree, &frozen, kind, keys, size);
+        bistree_frozen_destroy(&frozen);
+        bistree_destroy(&tree);
+        free(keys);
+
+        for (kind = POINTER; kind <= FROZEN_U64; kind++) {
+            if (seconds[kind] < 0)
+                return -1;
+            snprintf(variant, sizeof(variant), "%s %ld keys", names[kind], size);
+            bench_report("frozen", variant, LOOKUPS / seconds[kind] / 1e6, "Mlookups/s");
+        }
+    }
+
+    return 0;
+}
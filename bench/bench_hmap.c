@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "bench.h"
+#include "../src/data_structure/hmap.h"
+
+#define SLOTS (1 << 20)
+#define OPS (1 << 21)
+
+// distinct keys for distinct @i, in a scattered order
+static uint64_t key_of(uint64_t i)
+{
+    return (i + 1) * 0x9e3779b97f4a7c15ULL;
+}
+
+static void report(const char *op, double load, long ops, double seconds)
+{
+    char variant[40];
+
+    snprintf(variant, sizeof(variant), "%s load %.3f", op, load);
+    bench_report("hmap", variant, ops / seconds / 1e6, "Mops/s");
+}
+
+/**
+ * fill a map of SLOTS slots to @count keys and time the operations on it.
+ */
+static int run(size_t count, uint64_t *present)
+{
+    unsigned long seed = 46;
+    uint64_t key, next = count, value = 0;
+    double start, load;
+    long i, found = 0;
+    size_t j;
+    HMap map;
+
+    hmap_init(&map, sizeof(uint64_t), sizeof(uint64_t), NULL, NULL);
+    if (hmap_reserve(&map, SLOTS * 7 / 8) != 0)
+        return -1;
+
+    start = bench_now();
+    for (j = 0; j < count; j++) {
+        present[j] = key_of(j);
+        if (hmap_insert(&map, &present[j], &value) != 0)
+            break;
+    }
+    start = bench_now() - start;
+    load = (double)hmap_size(&map) / map.capacity;
+    if (j < count || map.capacity != SLOTS) {
+        hmap_destroy(&map);
+        return -1;
+    }
+    report("insert", load, count, start);
+
+    start = bench_now();
+    for (i = 0; i < OPS; i++)
+        found += hmap_lookup(&map, &present[bench_rand(&seed) % count], NULL) == 0;
+    report("hit lookup", load, OPS, bench_now() - start);
+
+    start = bench_now();
+    for (i = 0; i < OPS; i++) {
+        key = key_of((1UL << 40) + bench_rand(&seed));
+        found += hmap_lookup(&map, &key, NULL) == 0;
+    }
+    report("miss lookup", load, OPS, bench_now() - start);
+
+    // Every step removes a random key and inserts a new one
+    start = bench_now();
+    for (i = 0; i < OPS; i++) {
+        j = bench_rand(&seed) % count;
+        found += hmap_remove(&map, &present[j]) == 0;
+        present[j] = key_of(next++);
+        found += hmap_insert(&map, &present[j], &value) == 0;
+    }
+    report("churn", load, OPS, bench_now() - start);
+
+    hmap_destroy(&map);
+
+    return found == 3L * OPS ? 0 : -1;
+}
+
+int bench_hmap(void)
+{
+    static const size_t counts[] = { SLOTS / 2, SLOTS * 5 / 8, SLOTS * 3 / 4, SLOTS * 7 / 8 };
+    uint64_t *present;
+    int i, ret = 0;
+
+    if ((present = (uint64_t *)malloc(SLOTS * sizeof(uint64_t))) == NULL)
+        return -1;
+    for (i = 0; i < (int)(sizeof(counts) / sizeof(counts[0])) && ret == 0; i++)
+        ret = run(counts[i], present);
+    free(present);
+
+    return ret;
+}
@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "../src/data_structure/htable.h"
+#include "../src/tree/bistree.h"
+
+#define LOOKUPS (1 << 20)
+
+struct entry {
+    struct hlist_node node;
+    char key[24];
+};
+
+static uint64_t hash(const struct hlist_node *node)
+{
+    const char *key = list_entry(node, struct entry, node)->key;
+
+    return htable_hash_bytes(key, strlen(key));
+}
+
+static int match(const struct hlist_node *node, const void *key)
+{
+    return strcmp(list_entry(node, struct entry, node)->key, (const char *)key) == 0;
+}
+
+static int compare(const void *key1, const void *key2)
+{
+    int diff = strcmp(((const struct entry *)key1)->key, ((const struct entry *)key2)->key);
+
+    return diff < 0 ? -1 : diff > 0;
+}
+
+enum {
+    HTABLE,
+    BISTREE,
+    KINDS,
+};
+
+static const char *names[KINDS] = { "htable", "bistree" };
+
+/**
+ * random hits by key string, the same sequence for every structure.
+ * @return      seconds, -1 if a key was missed.
+ */
+static double lookup(int kind, void *container, struct entry *entries, long size)
+{
+    unsigned long seed = 45;
+    struct entry *entry;
+    void *data;
+    double start = bench_now();
+    long i, found = 0;
+
+    for (i = 0; i < LOOKUPS; i++) {
+        entry = &entries[bench_rand(&seed) % size];
+        switch (kind) {
+        case HTABLE:
+            found += htable_lookup((struct htable *)container,
+                                   htable_hash_bytes(entry->key, strlen(entry->key)),
+                                   match, entry->key) == &entry->node;
+            break;
+        default:
+            data = entry;
+            found += bistree_lookup((BisTree *)container, &data) == 0 && data == entry;
+        }
+    }
+
+    return found == LOOKUPS ? bench_now() - start : -1;
+}
+
+static int run(struct entry *entries, long size)
+{
+    struct htable table;
+    BisTree tree;
+    double seconds[KINDS];
+    char variant[40];
+    long i;
+    int kind;
+
+    if (htable_init(&table, hash) != 0)
+        return -1;
+    bistree_init(&tree, compare, NULL);
+    for (i = 0; i < size; i++) {
+        htable_insert(&table, &entries[i].node);
+        bistree_insert(&tree, &entries[i]);
+    }
+
+    seconds[HTABLE] = lookup(HTABLE, &table, entries, size);
+    seconds[BISTREE] = lookup(BISTREE, &tree, entries, size);
+    htable_destroy(&table, NULL);
+    bistree_destroy(&tree);
+
+    for (kind = 0; kind < KINDS; kind++) {
+        if (seconds[kind] < 0)
+            return -1;
+        snprintf(variant, sizeof(variant), "%s %ld keys", names[kind], size);
+        bench_report("htable", variant, LOOKUPS / seconds[kind] / 1e6, "Mlookups/s");
+    }
+
+    return 0;
+}
+
+int bench_htable(void)
+{
+    struct entry *entries;
+    long size, i;
+    int ret = 0;
+
+    // Cache resident, then bigger than the caches
+    for (size = 1 << 12; size <= 1 << 20 && ret == 0; size <<= 4) {
+        if ((entries = (struct entry *)malloc(size * sizeof(struct entry))) == NULL)
+            return -1;
+        // Distinct keys in a scattered order
+        for (i = 0; i < size; i++)
+            snprintf(entries[i].key, sizeof(entries[i].key), "key%lu",
+                     (i + 1) * 0x9e3779b97f4a7c15UL >> 20);
+        ret = run(entries, size);
+        free(entries);
+    }
+
+    return ret;
+}
@@ -0,0 +1,154 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+#include "../src/data_structure/list.h"
+#include "../src/data_structure/lfqueue.h"
+
+#define ITEMS (1 << 20)         // per run, split between the producers
+#define RING 1024
+
+struct item {
+    struct list_node list;
+    struct mpsc_node node;
+    double stamp;               // when it was enqueued
+};
+
+enum {
+    MUTEX,
+    MPSC,
+    MPMC,
+    KINDS,
+};
+
+static const char *names[KINDS] = { "mutex list", "mpsc", "mpmc ring" };
+
+struct shared {
+    int kind;
+    int producers;
+    struct item *items;
+    pthread_mutex_t lock;
+    struct list_node head;
+    struct mpsc_queue queue;
+    struct mpmc_ring ring;
+    long consumed;
+    long latency;               // nanoseconds, summed over all items
+};
+
+static void produce(struct shared *shared, int id)
+{
+    long i, per = ITEMS / shared->producers;
+    struct item *item;
+
+    for (i = id * per; i < (id + 1) * per; i++) {
+        item = &shared->items[i];
+        item->stamp = bench_now();
+        switch (shared->kind) {
+        case MUTEX:
+            pthread_mutex_lock(&shared->lock);
+            mlist_enqueue(&shared->head, &item->list);
+            pthread_mutex_unlock(&shared->lock);
+            break;
+        case MPSC:
+            mpsc_enqueue(&shared->queue, &item->node);
+            break;
+        default:
+            while (mpmc_ring_enqueue(&shared->ring, item) != 0)
+                sched_yield();
+        }
+    }
+}
+
+static struct item *take(struct shared *shared)
+{
+    struct mpsc_node *node;
+    void *data = NULL;
+
+    switch (shared->kind) {
+    case MUTEX:
+        pthread_mutex_lock(&shared->lock);
+        if (!mlist_is_empty(&shared->head)) {
+            data = list_entry(shared->head.next, struct item, list);
+            mlist_dequeue(&shared->head);
+        }
+        pthread_mutex_unlock(&shared->lock);
+        return (struct item *)data;
+    case MPSC:
+        node = mpsc_dequeue(&shared->queue);
+        return node != NULL ? mpsc_entry(node, struct item, node) : NULL;
+    default:
+        return mpmc_ring_dequeue(&shared->ring, &data) == 0 ? (struct item *)data : NULL;
+    }
+}
+
+static void consume(struct shared *shared)
+{
+    struct item *item;
+    long latency = 0;
+
+    while (__atomic_load_n(&shared->consumed, __ATOMIC_RELAXED) < ITEMS) {
+        if ((item = take(shared)) == NULL) {
+            sched_yield();
+            continue;
+        }
+        latency += (long)((bench_now() - item->stamp) * 1e9);
+        __atomic_add_fetch(&shared->consumed, 1, __ATOMIC_RELAXED);
+    }
+    __atomic_add_fetch(&shared->latency, latency, __ATOMIC_RELAXED);
+}
+
+// the first threads produce, the others consume
+static void run(void *ctx, int id)
+{
+    struct shared *shared = (struct shared *)ctx;
+
+    if (id < shared->producers)
+        produce(shared, id);
+    else
+        consume(shared);
+}
+
+int bench_lfqueue(void)
+{
+    struct shared shared;
+    char variant[40];
+    double seconds;
+    int pairs, consumers;
+
+    if ((shared.items = (struct item *)malloc(ITEMS * sizeof(struct item))) == NULL)
+        return -1;
+    if (mpmc_ring_init(&shared.ring, RING) != 0) {
+        free(shared.items);
+        return -1;
+    }
+    pthread_mutex_init(&shared.lock, NULL);
+
+    for (pairs = 1; pairs <= 4; pairs *= 2) {
+        for (shared.kind = 0; shared.kind < KINDS; shared.kind++) {
+            // The mpsc queue has one consumer only
+            consumers = shared.kind == MPSC ? 1 : pairs;
+            shared.producers = pairs;
+            shared.consumed = shared.latency = 0;
+            M_INIT_LIST_HEAD(&shared.head);
+            mpsc_init(&shared.queue);
+
+            if ((seconds = bench_parallel(pairs + consumers, run, &shared)) < 0)
+                break;
+            snprintf(variant, sizeof(variant), "%s %dp %dc", names[shared.kind],
+                     pairs, consumers);
+            bench_report("lfqueue", variant, ITEMS / seconds / 1e6, "Mitems/s");
+            snprintf(variant, sizeof(variant), "%s %dp %dc latency", names[shared.kind],
+                     pairs, consumers);
+            bench_report("lfqueue", variant, (double)shared.latency / ITEMS / 1e3, "us");
+        }
+        if (shared.kind < KINDS)
+            break;
+    }
+
+    pthread_mutex_destroy(&shared.lock);
+    mpmc_ring_destroy(&shared.ring);
+    free(shared.items);
+
+    return pairs > 4 ? 0 : -1;
+}
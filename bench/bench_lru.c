@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "bench.h"
+#include "../src/data_structure/lru.h"
+
+#define KEYS (1 << 20)
+#define OPS (1 << 20)           // per run, split between the threads
+#define CAPACITY (KEYS / 16)    // entries of charge 1
+
+enum {
+    LRU,
+    CLOCK,
+    KINDS,
+};
+
+static const char *names[KINDS] = { "lru", "clock" };
+
+struct shared {
+    struct lru_cache *cache;
+    const uint64_t *trace;
+    int threads;
+    long hits;
+};
+
+/**
+ * OPS keys drawn from a Zipf distribution with exponent 1 over KEYS
+ * keys, rank 0 the most popular.
+ */
+static uint64_t *zipf_trace(void)
+{
+    unsigned long seed = 49;
+    uint64_t *trace;
+    double *cdf, sum = 0, u;
+    long i, lo, hi, mid;
+
+    cdf = (double *)malloc(KEYS * sizeof(double));
+    trace = (uint64_t *)malloc(OPS * sizeof(uint64_t));
+    if (cdf == NULL || trace == NULL) {
+        free(cdf);
+        free(trace);
+        return NULL;
+    }
+
+    for (i = 0; i < KEYS; i++)
+        cdf[i] = sum += 1.0 / (i + 1);
+    for (i = 0; i < OPS; i++) {
+        u = (double)bench_rand(&seed) / (1UL << 48) * sum;
+        for (lo = 0, hi = KEYS - 1; lo < hi; ) {
+            mid = (lo + hi) / 2;
+            if (cdf[mid] < u)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        trace[i] = lo;
+    }
+    free(cdf);
+
+    return trace;
+}
+
+// read through: a miss puts the key
+static void run(void *ctx, int id)
+{
+    struct shared *shared = (struct shared *)ctx;
+    struct lru_handle *handle;
+    long i, per = OPS / shared->threads, hits = 0;
+    const uint64_t *key;
+
+    for (i = id * per; i < (id + 1) * per; i++) {
+        key = &shared->trace[i];
+        if ((handle = lru_get(shared->cache, key, sizeof(*key))) != NULL) {
+            hits++;
+            lru_release(shared->cache, handle);
+        } else {
+            lru_put(shared->cache, key, sizeof(*key), NULL, 1, NULL);
+        }
+    }
+    __atomic_add_fetch(&shared->hits, hits, __ATOMIC_RELAXED);
+}
+
+int bench_lru(void)
+{
+    struct shared shared;
+    char variant[40];
+    double seconds;
+    int kind;
+
+    if ((shared.trace = zipf_trace()) == NULL)
+        return -1;
+
+    for (shared.threads = 1; shared.threads <= 8; shared.threads *= 2) {
+        for (kind = 0; kind < KINDS; kind++) {
+            shared.cache = lru_create(CAPACITY, 0, kind == CLOCK ? LRU_CLOCK : 0, NULL);
+            if (shared.cache == NULL)
+                break;
+            shared.hits = 0;
+            seconds = bench_parallel(shared.threads, run, &shared);
+            lru_destroy(shared.cache);
+            if (seconds < 0)
+                break;
+
+            snprintf(variant, sizeof(variant), "%s %d threads", names[kind], shared.threads);
+            bench_report("lru", variant, OPS / seconds / 1e6, "Mops/s");
+            snprintf(variant, sizeof(variant), "%s %d threads hit rate", names[kind],
+                     shared.threads);
+            bench_report("lru", variant, 100.0 * shared.hits / OPS, "%");
+        }
+        if (kind < KINDS)
+            break;
+    }
+    free((void *)shared.trace);
+
+    return shared.threads > 8 ? 0 : -1;
+}
@@ -0,0 +1,48 @@
+#include <string.h>
+#include "bench.h"
+
+static const struct {
+    const char *name;
+    int (*run)(void);
+} benches[] = {
+    { "bistree_u64", bench_bistree_u64 },
+    { "bistree_fc", bench_bistree_fc },
+    { "bistree_rcu", bench_bistree_rcu },
+    { "avl_tree", bench_avl_tree },
+    { "bptree", bench_bptree },
+    { "bistree_setops", bench_bistree_setops },
+    { "frozen", bench_frozen },
+    { "sorted_batch", bench_sorted_batch },
+    { "bitree_sized", bench_bitree_sized },
+    { "bitree_walk", bench_bitree_walk },
+    { "bitree_reduce", bench_bitree_reduce },
+    { "bitree_pool", bench_bitree_pool },
+    { "bitree_implicit", bench_bitree_implicit },
+    { "lfqueue", bench_lfqueue },
+    { "htable", bench_htable },
+    { "hmap", bench_hmap },
+    { "mlist_sort", bench_mlist_sort },
+    { "ulist", bench_ulist },
+    { "lru", bench_lru },
+    { "skiplist", bench_skiplist },
+};
+
+int main(int argc, const char *argv[])
+{
+    int i, j, failures = 0;
+
+    for (i = 0; i < (int)(sizeof(benches) / sizeof(benches[0])); i++) {
+        // Only the benchmarks named on the command line, all by default
+        for (j = 1; j < argc && strcmp(argv[j], benches[i].name) != 0; j++)
+            ;
+        if (argc > 1 && j == argc)
+            continue;
+
+        if (benches[i].run() != 0) {
+            printf("%-16s FAILED\n", benches[i].name);
+            failures++;
+        }
+    }
+
+    return failures == 0 ? 0 : 1;
+}
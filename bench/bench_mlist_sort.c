@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+#include "../src/data_structure/list.h"
+
+#define MAX_NODES (1 << 20)
+
+struct item {
+    struct list_node node;
+    unsigned long key;
+};
+
+static int cmp_nodes(void *ctx, const struct list_node *a, const struct list_node *b)
+{
+    unsigned long x = list_entry(a, struct item, node)->key;
+    unsigned long y = list_entry(b, struct item, node)->key;
+
+    (void)ctx;
+    return x > y ? 1 : 0;
+}
+
+static int cmp_ptrs(const void *a, const void *b)
+{
+    unsigned long x = (*(struct item *const *)a)->key;
+    unsigned long y = (*(struct item *const *)b)->key;
+
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * link @count items in a random order, so neighbours in the list are
+ * not neighbours in memory.
+ */
+static void shuffle(struct list_node *head, struct item *items, long *order, long count)
+{
+    unsigned long seed = 47;
+    long i, j, swap;
+
+    for (i = 0; i < count; i++)
+        order[i] = i;
+    for (i = count - 1; i > 0; i--) {
+        j = bench_rand(&seed) % (i + 1);
+        swap = order[i];
+        order[i] = order[j];
+        order[j] = swap;
+    }
+
+    M_INIT_LIST_HEAD(head);
+    for (i = 0; i < count; i++)
+        mlist_enqueue(head, &items[order[i]].node);
+}
+
+// what callers did before mlist_sort(): copy, qsort and relink
+static int copy_sort(struct list_node *head, long count)
+{
+    struct item **array;
+    struct list_node *node;
+    long i = 0;
+
+    if ((array = (struct item **)malloc(count * sizeof(struct item *))) == NULL)
+        return -1;
+    for (node = head->next; node != head; node = node->next)
+        array[i++] = list_entry(node, struct item, node);
+    qsort(array, count, sizeof(struct item *), cmp_ptrs);
+
+    M_INIT_LIST_HEAD(head);
+    for (i = 0; i < count; i++)
+        mlist_enqueue(head, &array[i]->node);
+    free(array);
+
+    return 0;
+}
+
+static int sorted(struct list_node *head, long count)
+{
+    struct list_node *node;
+    unsigned long last = 0;
+    long seen = 0;
+
+    for (node = head->next; node != head; node = node->next, seen++) {
+        if (list_entry(node, struct item, node)->key < last)
+            return 0;
+        last = list_entry(node, struct item, node)->key;
+    }
+
+    return seen == count;
+}
+
+int bench_mlist_sort(void)
+{
+    struct list_node head;
+    struct item *items;
+    long *order, count, i;
+    unsigned long seed = 1;
+    double start, merge, copy;
+    char variant[40];
+    int ret = -1;
+
+    items = (struct item *)malloc(MAX_NODES * sizeof(struct item));
+    order = (long *)malloc(MAX_NODES * sizeof(long));
+    if (items == NULL || order == NULL)
+        goto out;
+    for (i = 0; i < MAX_NODES; i++)
+        items[i].key = bench_rand(&seed);
+
+    for (count = 1 << 10; count <= MAX_NODES; count <<= 2) {
+        shuffle(&head, items, order, count);
+        start = bench_now();
+        mlist_sort(&head, cmp_nodes, NULL);
+        merge = bench_now() - start;
+        if (!sorted(&head, count))
+            goto out;
+
+        shuffle(&head, items, order, count);
+        start = bench_now();
+        if (copy_sort(&head, count) != 0)
+            goto out;
+        copy = bench_now() - start;
+        if (!sorted(&head, count))
+            goto out;
+
+        snprintf(variant, sizeof(variant), "mlist_sort %ld nodes", count);
+        bench_report("mlist_sort", variant, count / merge / 1e6, "Mnodes/s");
+        snprintf(variant, sizeof(variant), "copy qsort relink %ld nodes", count);
+        bench_report("mlist_sort", variant, count / copy / 1e6, "Mnodes/s");
+    }
+    ret = 0;
+
+out:
+    free(items);
+    free(order);
+
+    return ret;
+}
@@ -0,0 +1,123 @@
+#include <pthread.h>
+#include <stdio.h>
+#include "bench.h"
+#include "../src/data_structure/skiplist.h"
+#include "../src/tree/bistree.h"
+
+#define KEYS (1 << 16)
+#define OPS (1 << 19)           // per run, split between the threads
+
+static long keys[KEYS];
+
+static int compare(const void *key1, const void *key2)
+{
+    long a = *(const long *)key1, b = *(const long *)key2;
+
+    return a < b ? -1 : a > b;
+}
+
+struct shared {
+    SkipList list;
+    BisTree tree;
+    pthread_mutex_t lock;
+    int threads;
+    int writes;                 // percent of the operations, half inserts
+};
+
+static void skiplist_run(void *ctx, int id)
+{
+    struct shared *shared = (struct shared *)ctx;
+    struct epoch_record record;
+    unsigned long seed = id + 1, r;
+    void *data;
+    long i;
+    int op;
+
+    skiplist_register(&shared->list, &record);
+
+    for (i = 0; i < OPS / shared->threads; i++) {
+        r = bench_rand(&seed);
+        data = &keys[r % KEYS];
+        op = (r >> 20) % 100;
+        if (op < shared->writes / 2)
+            skiplist_insert(&shared->list, &record, data);
+        else if (op < shared->writes)
+            skiplist_remove(&shared->list, &record, data);
+        else
+            skiplist_lookup(&shared->list, &record, &data);
+    }
+
+    skiplist_unregister(&shared->list, &record);
+}
+
+static void mutex_run(void *ctx, int id)
+{
+    struct shared *shared = (struct shared *)ctx;
+    unsigned long seed = id + 1, r;
+    void *data;
+    long i;
+    int op;
+
+    for (i = 0; i < OPS / shared->threads; i++) {
+        r = bench_rand(&seed);
+        data = &keys[r % KEYS];
+        op = (r >> 20) % 100;
+        pthread_mutex_lock(&shared->lock);
+        if (op < shared->writes / 2)
+            bistree_insert(&shared->tree, data);
+        else if (op < shared->writes)
+            bistree_remove(&shared->tree, data);
+        else
+            bistree_lookup(&shared->tree, &data);
+        pthread_mutex_unlock(&shared->lock);
+    }
+}
+
+int bench_skiplist(void)
+{
+    static const int writes[] = { 10, 50 };
+    struct epoch_record record;
+    struct shared shared;
+    char variant[40];
+    double seconds;
+    long i;
+    int w;
+
+    for (i = 0; i < KEYS; i++)
+        keys[i] = i;
+
+    // Both maps start half full
+    for (w = 0; w < (int)(sizeof(writes) / sizeof(writes[0])); w++) {
+        shared.writes = writes[w];
+        for (shared.threads = 1; shared.threads <= 64; shared.threads *= 2) {
+            if (skiplist_init(&shared.list, compare, NULL) != 0)
+                return -1;
+            skiplist_register(&shared.list, &record);
+            for (i = 0; i < KEYS; i += 2)
+                skiplist_insert(&shared.list, &record, &keys[i]);
+            skiplist_unregister(&shared.list, &record);
+            seconds = bench_parallel(shared.threads, skiplist_run, &shared);
+            skiplist_destroy(&shared.list);
+            if (seconds < 0)
+                return -1;
+            snprintf(variant, sizeof(variant), "skiplist %d%% writes %d threads",
+                     shared.writes, shared.threads);
+            bench_report("skiplist", variant, OPS / seconds / 1e6, "Mops/s");
+
+            bistree_init(&shared.tree, compare, NULL);
+            pthread_mutex_init(&shared.lock, NULL);
+            for (i = 0; i < KEYS; i += 2)
+                bistree_insert(&shared.tree, &keys[i]);
+            seconds = bench_parallel(shared.threads, mutex_run, &shared);
+            bistree_destroy(&shared.tree);
+            pthread_mutex_destroy(&shared.lock);
+            if (seconds < 0)
+                return -1;
+            snprintf(variant, sizeof(variant), "mutex bistree %d%% writes %d threads",
+                     shared.writes, shared.threads);
+            bench_report("skiplist", variant, OPS / seconds / 1e6, "Mops/s");
+        }
+    }
+
+    return 0;
+}
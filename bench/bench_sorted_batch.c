@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+#include "../src/tree/bistree.h"
+
+#define KEYS (1 << 20)
+#define LOOKUPS (1 << 19)       // per variant, in batches
+
+static long keys[KEYS];
+
+static int compare(const void *key1, const void *key2)
+{
+    long a = *(const long *)key1, b = *(const long *)key2;
+
+    return a < b ? -1 : a > b;
+}
+
+static int cmp_long(const void *a, const void *b)
+{
+    long x = *(const long *)a, y = *(const long *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+int bench_sorted_batch(void)
+{
+    BisTree tree;
+    unsigned long seed = 36;
+    long *draws, i, j, n, found;
+    void **probes, **out, *data;
+    double start, batch, single;
+    char variant[40];
+
+    draws = (long *)malloc(LOOKUPS * sizeof(long));
+    probes = (void **)malloc(LOOKUPS * sizeof(void *));
+    out = (void **)malloc(LOOKUPS * sizeof(void *));
+    if (draws == NULL || probes == NULL || out == NULL) {
+        free(draws);
+        free(probes);
+        free(out);
+        return -1;
+    }
+
+    bistree_init(&tree, compare, NULL);
+    for (i = 0; i < KEYS; i++) {
+        keys[i] = i;
+        bistree_insert(&tree, &keys[i]);
+    }
+
+    // Denser batches share more of their search paths
+    for (n = 16; n <= 1 << 16; n <<= 4) {
+        for (i = 0; i < LOOKUPS; i++)
+            draws[i] = bench_rand(&seed) % KEYS;
+        for (i = 0; i < LOOKUPS; i += n)
+            qsort(&draws[i], n, sizeof(long), cmp_long);
+        for (i = 0; i < LOOKUPS; i++)
+            probes[i] = &keys[draws[i]];
+
+        found = 0;
+        start = bench_now();
+        for (i = 0; i < LOOKUPS; i += n)
+            found += bistree_lookup_sorted_batch(&tree, &probes[i], n, &out[i]);
+        batch = bench_now() - start;
+
+        start = bench_now();
+        for (i = 0; i < LOOKUPS; i += n) {
+            for (j = i; j < i + n; j++) {
+                data = probes[j];
+                found += bistree_lookup(&tree, &data) == 0;
+            }
+        }
+        single = bench_now() - start;
+        if (found != 2L * LOOKUPS)
+            break;
+
+        snprintf(variant, sizeof(variant), "sorted batch of %ld", n);
+        bench_report("sorted_batch", variant, LOOKUPS / batch / 1e6, "Mlookups/s");
+        snprintf(variant, sizeof(variant), "single lookups of %ld", n);
+        bench_report("sorted_batch", variant, LOOKUPS / single / 1e6, "Mlookups/s");
+    }
+
+    bistree_destroy(&tree);
+    free(draws);
+    free(probes);
+    free(out);
+
+    return n > 1 << 16 ? 0 : -1;
+}
@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+#include "../src/data_structure/list.h"
+#include "../src/data_structure/ulist.h"
+
+#define NODES (1 << 20)
+#define EVERY 8                 // insert before every EVERY-th element
+#define ROUNDS 8
+
+struct item {
+    struct list_node node;
+    long value;
+};
+
+static struct item items[NODES];
+static struct item extras[NODES / EVERY];
+static long order[NODES];
+
+struct times {
+    double push;
+    double iterate;
+    double insert;
+    double pop;
+};
+
+static long run_list(struct times *times)
+{
+    struct list_node head, *node;
+    double start;
+    long i, k = 0, sum = 0;
+
+    M_INIT_LIST_HEAD(&head);
+    start = bench_now();
+    for (i = 0; i < NODES; i++)
+        mlist_enqueue(&head, &items[order[i]].node);
+    times->push = bench_now() - start;
+
+    start = bench_now();
+    for (i = 0; i < ROUNDS; i++)
+        for (node = head.next; node != &head; node = node->next)
+            sum += list_entry(node, struct item, node)->value;
+    times->iterate = bench_now() - start;
+
+    start = bench_now();
+    for (node = head.next, i = 0; node != &head; node = node->next, i++)
+        if (i % EVERY == 0)
+            mlist_add_ahead(&extras[k++].node, node);
+    times->insert = bench_now() - start;
+
+    start = bench_now();
+    while (!mlist_is_empty(&head)) {
+        sum += list_entry(head.next, struct item, node)->value;
+        mlist_dequeue(&head);
+    }
+    times->pop = bench_now() - start;
+
+    return sum;
+}
+
+static long run_ulist(struct times *times)
+{
+    struct ulist_iter iter;
+    UList list;
+    double start;
+    void *data;
+    long i, k = 0, sum = 0;
+
+    ulist_init(&list, NULL);
+    start = bench_now();
+    for (i = 0; i < NODES; i++)
+        if (ulist_push_back(&list, &items[order[i]]) != 0)
+            sum = -1;
+    times->push = bench_now() - start;
+
+    start = bench_now();
+    for (i = 0; i < ROUNDS; i++) {
+        if (ulist_first(&list, &iter) != 0)
+            continue;
+        do {
+            sum += ((struct item *)ulist_get(&iter))->value;
+        } while (ulist_next(&list, &iter) == 0);
+    }
+    times->iterate = bench_now() - start;
+
+    // The iterator stays on the new element, step over it
+    start = bench_now();
+    for (ulist_first(&list, &iter), i = 0; iter.chunk != NULL; ulist_next(&list, &iter), i++) {
+        if (i % EVERY == 0) {
+            if (ulist_insert(&list, &iter, &extras[k++]) != 0)
+                sum = -1;
+            ulist_next(&list, &iter);
+        }
+    }
+    times->insert = bench_now() - start;
+
+    start = bench_now();
+    while (ulist_pop_front(&list, &data) == 0)
+        sum += ((struct item *)data)->value;
+    times->pop = bench_now() - start;
+    ulist_destroy(&list);
+
+    return sum;
+}
+
+static void report(const char *name, const char *layout, const struct times *times)
+{
+    char variant[40];
+
+    snprintf(variant, sizeof(variant), "%s push %s", name, layout);
+    bench_report("ulist", variant, NODES / times->push / 1e6, "Mitems/s");
+    snprintf(variant, sizeof(variant), "%s iterate %s", name, layout);
+    bench_report("ulist", variant, ROUNDS * NODES / times->iterate / 1e6, "Mitems/s");
+    snprintf(variant, sizeof(variant), "%s insert %s", name, layout);
+    bench_report("ulist", variant, NODES / EVERY / times->insert / 1e6, "Minserts/s");
+    snprintf(variant, sizeof(variant), "%s pop %s", name, layout);
+    bench_report("ulist", variant, (NODES + NODES / EVERY) / times->pop / 1e6, "Mitems/s");
+}
+
+int bench_ulist(void)
+{
+    struct times list, unrolled;
+    unsigned long seed = 48;
+    long i, j, swap;
+    int shuffled;
+
+    for (i = 0; i < NODES; i++)
+        items[i].value = i;
+
+    // Elements in memory order, then in a random order
+    for (shuffled = 0; shuffled < 2; shuffled++) {
+        for (i = 0; i < NODES; i++)
+            order[i] = i;
+        for (i = NODES - 1; shuffled && i > 0; i--) {
+            j = bench_rand(&seed) % (i + 1);
+            swap = order[i];
+            order[i] = order[j];
+            order[j] = swap;
+        }
+
+        if (run_list(&list) != run_ulist(&unrolled))
+            return -1;
+        report("list", shuffled ? "shuffled" : "in order", &list);
+        report("ulist", shuffled ? "shuffled" : "in order", &unrolled);
+    }
+
+    return 0;
+}
@@ -0,0 +1,99 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+#include "bench.h"
+
+struct starter {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int waiting;                // threads not at the start line yet
+    double start;
+};
+
+struct thread_arg {
+    struct starter *starter;
+    void (*run)(void *ctx, int id);
+    void *ctx;
+    int id;
+};
+
+double bench_now(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+void bench_report(const char *bench, const char *variant, double value, const char *unit)
+{
+    printf("%-16s %-32s %12.2f %s\n", bench, variant, value, unit);
+    fflush(stdout);
+}
+
+static void *thread_run(void *arg)
+{
+    struct thread_arg *thread = (struct thread_arg *)arg;
+    struct starter *starter = thread->starter;
+
+    // The last thread to arrive starts the clock
+    pthread_mutex_lock(&starter->lock);
+    if (--starter->waiting == 0) {
+        starter->start = bench_now();
+        pthread_cond_broadcast(&starter->cond);
+    }
+    while (starter->waiting > 0)
+        pthread_cond_wait(&starter->cond, &starter->lock);
+    pthread_mutex_unlock(&starter->lock);
+
+    thread->run(thread->ctx, thread->id);
+
+    return NULL;
+}
+
+double bench_parallel(int threads, void (*run)(void *ctx, int id), void *ctx)
+{
+    struct starter starter;
+    struct thread_arg *args;
+    pthread_t *ids;
+    int i;
+
+    args = (struct thread_arg *)malloc(threads * sizeof(struct thread_arg));
+    ids = (pthread_t *)malloc(threads * sizeof(pthread_t));
+    if (args == NULL || ids == NULL) {
+        free(args);
+        free(ids);
+        return -1;
+    }
+
+    pthread_mutex_init(&starter.lock, NULL);
+    pthread_cond_init(&starter.cond, NULL);
+    starter.waiting = threads;
+    for (i = 0; i < threads; i++) {
+        args[i].starter = &starter;
+        args[i].run = run;
+        args[i].ctx = ctx;
+        args[i].id = i;
+        pthread_create(&ids[i], NULL, thread_run, &args[i]);
+    }
+    for (i = 0; i < threads; i++)
+        pthread_join(ids[i], NULL);
+
+    pthread_cond_destroy(&starter.cond);
+    pthread_mutex_destroy(&starter.lock);
+    free(args);
+    free(ids);
+
+    return bench_now() - starter.start;
+}
+
+unsigned long bench_rand(unsigned long *state)
+{
+    unsigned long x = *state != 0 ? *state : 1;
+
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return (x * 2685821657736338717UL) >> 16;
+}
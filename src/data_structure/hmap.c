@@ -0,0 +1,409 @@
+/* hmap.c --- open addressing hash map
+ *
+ * Filename: hmap.c
+ * Description: Swiss table style hash map with SIMD group probing
+ * Author: Werther Zhang
+ * Maintainer: Werther Zhang (peng.zhang.dev@gmail.com)
+ * Version: 0
+ * Keywords: hash map, open addressing, SSE2
+ *
+ */
+
+/* Change Log:
+ *
+ *
+ */
+
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth
+ * Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* Code: */
+
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "hmap.h"
+
+/*
+ * Control bytes: a full slot stores the low 7 bits of its hash (H2), the
+ * other two states have the sign bit set.
+ */
+#define CTRL_EMPTY   ((int8_t)-128)
+#define CTRL_DELETED ((int8_t)-2)
+
+#define H1(hash) ((size_t)((hash) >> 7))
+#define H2(hash) ((int8_t)((hash) & 0x7f))
+
+/*
+ * One bit per slot of the group starting at @ctrl, bit i for ctrl[i].
+ */
+#ifdef __SSE2__
+static inline uint32_t group_match(const int8_t *ctrl, int8_t h2)
+{
+    __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), group));
+}
+
+static inline uint32_t group_match_empty_or_deleted(const int8_t *ctrl)
+{
+    // Only empty and deleted have the sign bit
+    return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)ctrl));
+}
+#else
+static inline uint32_t group_match(const int8_t *ctrl, int8_t h2)
+{
+    uint32_t mask = 0;
+    int i;
+
+    for (i = 0; i < HMAP_GROUP; i++)
+        mask |= (uint32_t)(ctrl[i] == h2) << i;
+
+    return mask;
+}
+
+static inline uint32_t group_match_empty_or_deleted(const int8_t *ctrl)
+{
+    uint32_t mask = 0;
+    int i;
+
+    for (i = 0; i < HMAP_GROUP; i++)
+        mask |= (uint32_t)(ctrl[i] < 0) << i;
+
+    return mask;
+}
+#endif
+
+static inline uint32_t group_match_empty(const int8_t *ctrl)
+{
+    return group_match(ctrl, CTRL_EMPTY);
+}
+
+static inline int lowest_bit(uint32_t mask)
+{
+    return __builtin_ctz(mask);
+}
+
+static inline char *slot_at(HMap *map, size_t index)
+{
+    return map->slots + index * map->slot_size;
+}
+
+static void set_ctrl(HMap *map, size_t index, int8_t ctrl)
+{
+    map->ctrl[index] = ctrl;
+    // Keep the mirror so that a group load never wraps around
+    if (index < HMAP_GROUP)
+        map->ctrl[map->capacity + index] = ctrl;
+}
+
+static size_t max_load(size_t capacity)
+{
+    return capacity - capacity / 8;
+}
+
+static int default_equal(const void *key1, const void *key2, size_t size)
+{
+    return memcmp(key1, key2, size) == 0;
+}
+
+static inline uint64_t mix(uint64_t x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+uint64_t hmap_hash_bytes(const void *key, size_t size)
+{
+    const unsigned char *p = (const unsigned char *)key;
+    uint64_t hash = 0x9e3779b97f4a7c15ULL ^ size;
+    uint64_t word;
+
+    while (size >= 8) {
+        memcpy(&word, p, 8);
+        hash = (hash ^ mix(word)) * 0x9fb21c651e98df25ULL;
+        p += 8;
+        size -= 8;
+    }
+
+    if (size > 0) {
+        word = 0;
+        memcpy(&word, p, size);
+        hash = (hash ^ mix(word)) * 0x9fb21c651e98df25ULL;
+    }
+
+    return mix(hash);
+}
+
+void hmap_init(HMap *map, size_t key_size, size_t value_size,
+               uint64_t (*hash)(const void *key, size_t size),
+               int (*equal)(const void *key1, const void *key2, size_t size))
+{
+    map->size = 0;
+    map->capacity = 0;
+    map->growth_left = 0;
+    map->key_size = key_size;
+    map->value_size = value_size;
+    // Values are 8-byte aligned so callers may cast them
+    map->value_offset = (key_size + 7) & ~(size_t)7;
+    map->slot_size = (map->value_offset + value_size + 7) & ~(size_t)7;
+    map->ctrl = NULL;
+    map->slots = NULL;
+    map->hash = hash != NULL ? hash : hmap_hash_bytes;
+    map->equal = equal != NULL ? equal : default_equal;
+
+    return;
+}
+
+void hmap_destroy(HMap *map)
+{
+    // Slots live in the same block as the control bytes
+    free(map->ctrl);
+    map->ctrl = NULL;
+    map->slots = NULL;
+    map->size = 0;
+    map->capacity = 0;
+    map->growth_left = 0;
+
+    return;
+}
+
+/**
+ * first empty or deleted slot on the probe sequence of @hash.
+ * The triangular probe visits every group once as the number of groups
+ * is a power of two; at 7/8 load there is always a free slot.
+ */
+static size_t find_free(HMap *map, uint64_t hash)
+{
+    size_t mask = map->capacity - 1;
+    size_t pos = H1(hash) & mask;
+    size_t stride = 0;
+    uint32_t match;
+
+    for (;;) {
+        if ((match = group_match_empty_or_deleted(map->ctrl + pos)) != 0)
+            return (pos + lowest_bit(match)) & mask;
+
+        stride += HMAP_GROUP;
+        pos = (pos + stride) & mask;
+    }
+}
+
+/**
+ * @return      index of @key or -1.
+ */
+static long find(HMap *map, const void *key, uint64_t hash)
+{
+    size_t mask = map->capacity - 1;
+    size_t pos = H1(hash) & mask;
+    size_t stride = 0, index;
+    int8_t h2 = H2(hash);
+    uint32_t match;
+
+    if (map->capacity == 0)
+        return -1;
+
+    for (;;) {
+        match = group_match(map->ctrl + pos, h2);
+        while (match != 0) {
+            index = (pos + lowest_bit(match)) & mask;
+            if (map->equal(slot_at(map, index), key, map->key_size))
+                return (long)index;
+            match &= match - 1;
+        }
+
+        // An empty slot ends the probe, the key would have been put there
+        if (group_match_empty(map->ctrl + pos) != 0)
+            return -1;
+
+        stride += HMAP_GROUP;
+        pos = (pos + stride) & mask;
+        if (stride > map->capacity)
+            return -1;
+    }
+}
+
+static int resize(HMap *map, size_t capacity)
+{
+    size_t ctrl_size = (capacity + HMAP_GROUP + 7) & ~(size_t)7;
+    size_t old_capacity = map->capacity, i, index;
+    int8_t *old_ctrl = map->ctrl;
+    char *old_slots = map->slots;
+    char *slot;
+    uint64_t hash;
+
+    if ((map->ctrl = (int8_t *)malloc(ctrl_size + capacity * map->slot_size)) == NULL) {
+        map->ctrl = old_ctrl;
+        return -1;
+    }
+
+    memset(map->ctrl, CTRL_EMPTY, capacity + HMAP_GROUP);
+    map->slots = (char *)map->ctrl + ctrl_size;
+    map->capacity = capacity;
+
+    // Fresh arrays, so tombstones are gone and every probe ends early
+    for (i = 0; i < old_capacity; i++) {
+        if (old_ctrl[i] < 0)
+            continue;
+
+        slot = old_slots + i * map->slot_size;
+        hash = map->hash(slot, map->key_size);
+        index = find_free(map, hash);
+        set_ctrl(map, index, H2(hash));
+        memcpy(slot_at(map, index), slot, map->slot_size);
+    }
+
+    map->growth_left = max_load(capacity) - map->size;
+    free(old_ctrl);
+
+    return 0;
+}
+
+static size_t capacity_for(size_t count)
+{
+    size_t capacity = HMAP_GROUP;
+
+    while (max_load(capacity) < count)
+        capacity *= 2;
+
+    return capacity;
+}
+
+int hmap_reserve(HMap *map, size_t count)
+{
+    if (count <= map->size + map->growth_left)
+        return 0;
+
+    return resize(map, capacity_for(count));
+}
+
+int hmap_insert(HMap *map, const void *key, const void *value)
+{
+    uint64_t hash = map->hash(key, map->key_size);
+    size_t index, capacity;
+    char *slot;
+
+    if (find(map, key, hash) >= 0)
+        return 1;
+
+    if (map->capacity == 0) {
+        if (resize(map, HMAP_GROUP) != 0)
+            return -1;
+    }
+
+    index = find_free(map, hash);
+    // Reusing a tombstone does not raise the load
+    if (map->growth_left == 0 && map->ctrl[index] != CTRL_DELETED) {
+        // Mostly tombstones: rehash in place size, otherwise double
+        capacity = map->capacity;
+        if (map->size + 1 > max_load(capacity) / 2)
+            capacity *= 2;
+        if (resize(map, capacity) != 0)
+            return -1;
+        index = find_free(map, hash);
+    }
+
+    if (map->ctrl[index] == CTRL_EMPTY)
+        map->growth_left--;
+
+    set_ctrl(map, index, H2(hash));
+    slot = slot_at(map, index);
+    memcpy(slot, key, map->key_size);
+    if (value != NULL)
+        memcpy(slot + map->value_offset, value, map->value_size);
+    else
+        memset(slot + map->value_offset, 0, map->value_size);
+    map->size++;
+
+    return 0;
+}
+
+int hmap_lookup(HMap *map, const void *key, void **value)
+{
+    long index = find(map, key, map->hash(key, map->key_size));
+
+    if (index < 0)
+        return -1;
+
+    if (value != NULL)
+        *value = slot_at(map, index) + map->value_offset;
+
+    return 0;
+}
+
+static void erase(HMap *map, size_t index)
+{
+    size_t mask = map->capacity - 1;
+    uint32_t before, after;
+    int full_before, full_after;
+
+    before = group_match_empty(map->ctrl + ((index - HMAP_GROUP) & mask));
+    after = group_match_empty(map->ctrl + index);
+
+    // Full slots right before and right from @index. If no group window
+    // around it was ever completely full, no probe went past it.
+    full_before = before != 0 ? __builtin_clz(before << 16) : HMAP_GROUP;
+    full_after = after != 0 ? lowest_bit(after) : HMAP_GROUP;
+
+    if (full_before + full_after < HMAP_GROUP) {
+        set_ctrl(map, index, CTRL_EMPTY);
+        map->growth_left++;
+    } else {
+        set_ctrl(map, index, CTRL_DELETED);
+    }
+
+    map->size--;
+}
+
+int hmap_remove(HMap *map, const void *key)
+{
+    long index = find(map, key, map->hash(key, map->key_size));
+
+    if (index < 0)
+        return -1;
+
+    erase(map, (size_t)index);
+
+    return 0;
+}
+
+size_t hmap_foreach(HMap *map, int (*visit)(const void *key, void *value, void *ctx),
+                    void *ctx)
+{
+    size_t i, visited = 0;
+    char *slot;
+
+    for (i = 0; i < map->capacity; i++) {
+        if (map->ctrl[i] < 0)
+            continue;
+
+        slot = slot_at(map, i);
+        visited++;
+        if (visit(slot, slot + map->value_offset, ctx) != 0)
+            break;
+    }
+
+    return visited;
+}
+
+/* hmap.c ends here */
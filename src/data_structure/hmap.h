@@ -0,0 +1,103 @@
+#ifndef HMAP_H
+#define HMAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Flat open addressing hash map in the style of Swiss tables. Keys and
+ * values of fixed size are copied into one slot array; a parallel array
+ * of control bytes holds 7 bits of the hash of every full slot, so a probe
+ * compares a group of 16 slots at once (one SSE2 compare where available)
+ * and only touches the slots whose bits match.
+ *
+ * The map grows at 7/8 load. A removed slot goes back to empty unless a
+ * probe could have walked past it, in which case it becomes a tombstone
+ * that the next insert or rehash reclaims.
+ */
+
+#define HMAP_GROUP 16
+
+typedef struct hmap_ {
+    size_t size;
+    size_t capacity;            // slots, 0 or a power of two >= HMAP_GROUP
+    size_t growth_left;         // inserts into empty slots before growing
+    size_t key_size;
+    size_t value_size;
+    size_t value_offset;
+    size_t slot_size;
+    int8_t *ctrl;               // capacity + HMAP_GROUP bytes, the tail mirrors the head
+    char *slots;
+    uint64_t (*hash)(const void *key, size_t size);
+    int (*equal)(const void *key1, const void *key2, size_t size);
+} HMap;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * init hash map, no memory is allocated before the first insert.
+ * @key_size    size of a key in bytes.
+ * @value_size  size of a value in bytes, 0 for a set.
+ * @hash        hash of a key, NULL for hmap_hash_bytes().
+ * @equal       return non-zero if key1 equals key2, NULL for memcmp().
+ */
+void hmap_init(HMap *map, size_t key_size, size_t value_size,
+               uint64_t (*hash)(const void *key, size_t size),
+               int (*equal)(const void *key1, const void *key2, size_t size));
+
+/**
+ * free all slots, keys and values are not referenced any more.
+ */
+void hmap_destroy(HMap *map);
+
+/**
+ * make room for @count entries without a rehash.
+ * @return      return 0 on success otherwise return -1
+ */
+int hmap_reserve(HMap *map, size_t count);
+
+/**
+ * copy @key and @value (NULL for zeroes) into @map.
+ * @return      return 0 on success, 1 if @key is already in the map
+ *              (its value is kept), -1 on error.
+ */
+int hmap_insert(HMap *map, const void *key, const void *value);
+
+/**
+ * lookup @key. On success *@value, if @value is not NULL, points to the
+ * value inside the map, valid until the next insert.
+ * @return      return 0 on success otherwise return -1
+ */
+int hmap_lookup(HMap *map, const void *key, void **value);
+
+/**
+ * remove @key from @map.
+ * @return      return 0 on success otherwise return -1
+ */
+int hmap_remove(HMap *map, const void *key);
+
+/**
+ * visit all entries in no particular order.
+ * @visit       return non-zero to stop; it may remove the visited key.
+ * @return      number of visited entries.
+ */
+size_t hmap_foreach(HMap *map, int (*visit)(const void *key, void *value, void *ctx),
+                    void *ctx);
+
+/**
+ * default hash, for keys without padding bytes.
+ */
+uint64_t hmap_hash_bytes(const void *key, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+static inline size_t hmap_size(HMap *map)
+{
+    return map->size;
+}
+
+#endif
@@ -0,0 +1,217 @@
+/* htable.c --- intrusive hash table
+ *
+ * Filename: htable.c
+ * Description: resizable intrusive hash table with incremental rehash
+ * Author: Werther Zhang
+ * Maintainer: Werther Zhang (peng.zhang.dev@gmail.com)
+ * Version: 0
+ * Keywords: hash table, intrusive
+ *
+ */
+
+/* Change Log:
+ *
+ *
+ */
+
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth
+ * Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* Code: */
+
+#include <stdlib.h>
+#include "htable.h"
+
+#define HTABLE_MIN_BUCKETS 16
+#define HTABLE_REHASH_STEP 4    // old buckets moved per insert
+
+static struct hlist_head *alloc_buckets(size_t count)
+{
+    // calloc gives NULL heads
+    return (struct hlist_head *)calloc(count, sizeof(struct hlist_head));
+}
+
+/**
+ * move up to @steps old buckets into the new array.
+ */
+static void rehash_step(struct htable *table, size_t steps)
+{
+    struct hlist_node *node, *next;
+    struct hlist_head *head;
+
+    while (table->old != NULL && steps-- > 0) {
+        head = &table->old[table->rehash_pos];
+        hlist_for_each_safely(node, next, head) {
+            hlist_delete(node);
+            hlist_add_head(node, &table->buckets[table->hash(node) & table->mask]);
+        }
+
+        if (table->rehash_pos++ == table->old_mask) {
+            free(table->old);
+            table->old = NULL;
+        }
+    }
+}
+
+/**
+ * start doubling, the old array is drained by later inserts.
+ * Only called once the previous rehash is done (table->old == NULL).
+ */
+static void grow(struct htable *table)
+{
+    struct hlist_head *buckets;
+
+    if ((buckets = alloc_buckets(2 * (table->mask + 1))) == NULL)
+        return;                 // keep going with a higher load
+
+    table->old = table->buckets;
+    table->old_mask = table->mask;
+    table->rehash_pos = 0;
+    table->buckets = buckets;
+    table->mask = 2 * table->mask + 1;
+}
+
+int htable_init(struct htable *table, uint64_t (*hash)(const struct hlist_node *node))
+{
+    if ((table->buckets = alloc_buckets(HTABLE_MIN_BUCKETS)) == NULL)
+        return -1;
+
+    table->old = NULL;
+    table->mask = HTABLE_MIN_BUCKETS - 1;
+    table->old_mask = 0;
+    table->rehash_pos = 0;
+    table->size = 0;
+    table->hash = hash;
+
+    return 0;
+}
+
+struct release_ctx {
+    void (*release)(struct hlist_node *node);
+};
+
+static int release_visit(struct hlist_node *node, void *ctx)
+{
+    ((struct release_ctx *)ctx)->release(node);
+
+    return 0;
+}
+
+void htable_destroy(struct htable *table, void (*release)(struct hlist_node *node))
+{
+    struct release_ctx ctx;
+
+    if (release != NULL) {
+        ctx.release = release;
+        htable_foreach(table, release_visit, &ctx);
+    }
+
+    free(table->buckets);
+    free(table->old);
+    table->buckets = NULL;
+    table->old = NULL;
+    table->size = 0;
+
+    return;
+}
+
+int htable_insert(struct htable *table, struct hlist_node *node)
+{
+    if (table->size > table->mask && table->old == NULL)
+        grow(table);
+    else
+        rehash_step(table, HTABLE_REHASH_STEP);
+
+    hlist_add_head(node, &table->buckets[table->hash(node) & table->mask]);
+    table->size++;
+
+    return 0;
+}
+
+void htable_remove(struct htable *table, struct hlist_node *node)
+{
+    // No rehash step here, htable_foreach() callers may remove entries
+    hlist_delete(node);
+    table->size--;
+
+    return;
+}
+
+static struct hlist_node *search(struct hlist_head *head,
+                                 int (*match)(const struct hlist_node *node, const void *key),
+                                 const void *key)
+{
+    struct hlist_node *node;
+
+    for (node = head->first; node != NULL; node = node->next) {
+        if (match(node, key))
+            return node;
+    }
+
+    return NULL;
+}
+
+struct hlist_node *htable_lookup(const struct htable *table, uint64_t hash,
+                                 int (*match)(const struct hlist_node *node, const void *key),
+                                 const void *key)
+{
+    struct hlist_node *node;
+
+    // Read only, the rehash is driven by htable_insert()
+    if ((node = search(&table->buckets[hash & table->mask], match, key)) != NULL)
+        return node;
+
+    // Not moved yet
+    if (table->old != NULL && (hash & table->old_mask) >= table->rehash_pos)
+        return search(&table->old[hash & table->old_mask], match, key);
+
+    return NULL;
+}
+
+static size_t foreach_buckets(struct hlist_head *buckets, size_t count,
+                              int (*visit)(struct hlist_node *node, void *ctx),
+                              void *ctx, int *stop)
+{
+    struct hlist_node *node, *next;
+    size_t i, visited = 0;
+
+    for (i = 0; i < count && !*stop; i++) {
+        hlist_for_each_safely(node, next, &buckets[i]) {
+            visited++;
+            if (visit(node, ctx) != 0) {
+                *stop = 1;
+                break;
+            }
+        }
+    }
+
+    return visited;
+}
+
+size_t htable_foreach(struct htable *table,
+                      int (*visit)(struct hlist_node *node, void *ctx), void *ctx)
+{
+    size_t visited;
+    int stop = 0;
+
+    visited = foreach_buckets(table->buckets, table->mask + 1, visit, ctx, &stop);
+    if (table->old != NULL)
+        visited += foreach_buckets(table->old, table->old_mask + 1, visit, ctx, &stop);
+
+    return visited;
+}
+
+/* htable.c ends here */
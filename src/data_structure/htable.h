@@ -0,0 +1,107 @@
+#ifndef HTABLE_H
+#define HTABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "list.h"
+
+/**
+ * Intrusive hash table. Entries embed a struct hlist_node and are found
+ * back with list_entry(); buckets are single pointer hlist heads.
+ *
+ * The table doubles when it holds more entries than buckets. The entries
+ * of the old bucket array are moved a few buckets at a time by every
+ * following insert, so no single insert pays for a full rehash. Lookups
+ * search both arrays meanwhile and never change the table, so several
+ * readers may share it as long as no one writes.
+ */
+
+struct htable {
+    struct hlist_head *buckets;     // new entries go here
+    struct hlist_head *old;         // being drained, NULL when not rehashing
+    size_t mask;
+    size_t old_mask;
+    size_t rehash_pos;              // next old bucket to move
+    size_t size;
+    uint64_t (*hash)(const struct hlist_node *node);
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * init hash table
+ * @hash        hash of the key of an entry, used when rehashing.
+ * @return      return 0 on success otherwise return -1
+ */
+int htable_init(struct htable *table, uint64_t (*hash)(const struct hlist_node *node));
+
+/**
+ * free the buckets. @release, if not NULL, is called on every entry.
+ */
+void htable_destroy(struct htable *table, void (*release)(struct hlist_node *node));
+
+/**
+ * add @node, whose key must not be in @table yet.
+ * @return      return 0 on success otherwise return -1
+ */
+int htable_insert(struct htable *table, struct hlist_node *node);
+
+/**
+ * unlink @node from @table.
+ */
+void htable_remove(struct htable *table, struct hlist_node *node);
+
+/**
+ * find the entry for @key.
+ * @hash        hash of @key, the same as table->hash of its entry.
+ * @match       return non-zero if @node holds @key.
+ * @return      the node or NULL.
+ */
+struct hlist_node *htable_lookup(const struct htable *table, uint64_t hash,
+                                 int (*match)(const struct hlist_node *node, const void *key),
+                                 const void *key);
+
+/**
+ * visit all entries in no particular order.
+ * @visit       return non-zero to stop; it may remove the visited node.
+ * @return      number of visited entries.
+ */
+size_t htable_foreach(struct htable *table,
+                      int (*visit)(struct hlist_node *node, void *ctx), void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+/**
+ * hash helpers for keys.
+ */
+static inline uint64_t htable_hash_u64(uint64_t key)
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return key;
+}
+
+static inline uint64_t htable_hash_bytes(const void *key, size_t len)
+{
+    const unsigned char *p = (const unsigned char *)key;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    while (len-- > 0)
+        hash = (hash ^ *p++) * 0x100000001b3ULL;
+
+    return htable_hash_u64(hash);
+}
+
+static inline size_t htable_size(const struct htable *table)
+{
+    return table->size;
+}
+
+#endif
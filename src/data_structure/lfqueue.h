@@ -0,0 +1,209 @@
+/**
+ * Lock-free queues to pair with the single threaded mlist_enqueue and
+ * mlist_dequeue of list.h.
+ *
+ * mpsc_queue: unbounded intrusive queue for many producers and one
+ * consumer (Dmitry Vyukov's design). Elements embed a struct mpsc_node and
+ * are recovered with mpsc_entry(), like list_entry() for list_node.
+ *
+ * mpmc_ring: bounded queue of pointers for many producers and many
+ * consumers, one sequence number per cell.
+ */
+
+#ifndef COMMON_LFQUEUE_H
+#define COMMON_LFQUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "list.h"
+
+struct mpsc_node
+{
+    struct mpsc_node *next;
+};
+
+struct mpsc_queue
+{
+    struct mpsc_node *head __attribute__((aligned(64)));  // producers
+    struct mpsc_node *tail __attribute__((aligned(64)));  // consumer
+    struct mpsc_node stub;
+};
+
+#define mpsc_entry(ptr, type, member)           \
+    list_entry(ptr, type, member)
+
+/**
+ * init the empty queue @queue.
+ */
+static inline void mpsc_init(struct mpsc_queue *queue)
+{
+    queue->stub.next = NULL;
+    queue->head = &queue->stub;
+    queue->tail = &queue->stub;
+}
+
+/**
+ * add @node to the tail of @queue, from any thread. Wait-free.
+ */
+static inline void mpsc_enqueue(struct mpsc_queue *queue, struct mpsc_node *node)
+{
+    struct mpsc_node *prev;
+
+    __atomic_store_n(&node->next, NULL, __ATOMIC_RELAXED);
+    prev = __atomic_exchange_n(&queue->head, node, __ATOMIC_ACQ_REL);
+    // Until this store the queue is cut behind prev
+    __atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+}
+
+/**
+ * take the node at the head of @queue, only from the consumer thread.
+ * @return      the node, NULL if the queue is empty or a producer is
+ *              half way through mpsc_enqueue(); retry later then.
+ */
+static inline struct mpsc_node *mpsc_dequeue(struct mpsc_queue *queue)
+{
+    struct mpsc_node *tail = queue->tail;
+    struct mpsc_node *next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+
+    // Skip the stub
+    if (tail == &queue->stub) {
+        if (next == NULL)
+            return NULL;
+        queue->tail = next;
+        tail = next;
+        next = __atomic_load_n(&next->next, __ATOMIC_ACQUIRE);
+    }
+
+    if (next != NULL) {
+        queue->tail = next;
+        return tail;
+    }
+
+    if (tail != __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE))
+        return NULL;
+
+    // tail is the last node: put the stub behind it to be able to take it
+    mpsc_enqueue(queue, &queue->stub);
+    next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+    if (next != NULL) {
+        queue->tail = next;
+        return tail;
+    }
+
+    return NULL;
+}
+
+/**
+ * Check whether @queue is empty, only from the consumer thread.
+ */
+static inline int mpsc_is_empty(struct mpsc_queue *queue)
+{
+    return queue->tail == &queue->stub
+        && __atomic_load_n(&queue->stub.next, __ATOMIC_ACQUIRE) == NULL;
+}
+
+struct mpmc_cell
+{
+    size_t seq;
+    void *data;
+};
+
+struct mpmc_ring
+{
+    struct mpmc_cell *cells;
+    size_t mask;
+    size_t enqueue_pos __attribute__((aligned(64)));
+    size_t dequeue_pos __attribute__((aligned(64)));
+};
+
+/**
+ * init @ring for @capacity pointers, a power of two >= 2.
+ * @return      return 0 on success otherwise return -1
+ */
+static inline int mpmc_ring_init(struct mpmc_ring *ring, size_t capacity)
+{
+    size_t i;
+
+    if (capacity < 2 || (capacity & (capacity - 1)) != 0)
+        return -1;
+
+    if (posix_memalign((void **)&ring->cells, 64, capacity * sizeof(struct mpmc_cell)) != 0)
+        return -1;
+
+    for (i = 0; i < capacity; i++)
+        ring->cells[i].seq = i;
+    ring->mask = capacity - 1;
+    ring->enqueue_pos = 0;
+    ring->dequeue_pos = 0;
+
+    return 0;
+}
+
+static inline void mpmc_ring_destroy(struct mpmc_ring *ring)
+{
+    free(ring->cells);
+    ring->cells = NULL;
+}
+
+/**
+ * add @data to @ring, from any thread.
+ * @return      return 0 on success, -1 if the ring is full.
+ */
+static inline int mpmc_ring_enqueue(struct mpmc_ring *ring, void *data)
+{
+    size_t pos = __atomic_load_n(&ring->enqueue_pos, __ATOMIC_RELAXED);
+    struct mpmc_cell *cell;
+    intptr_t diff;
+
+    for (;;) {
+        cell = &ring->cells[pos & ring->mask];
+        diff = (intptr_t)__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) - (intptr_t)pos;
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&ring->enqueue_pos, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        } else if (diff < 0) {
+            return -1;
+        } else {
+            pos = __atomic_load_n(&ring->enqueue_pos, __ATOMIC_RELAXED);
+        }
+    }
+
+    cell->data = data;
+    __atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+/**
+ * take the oldest pointer from @ring into *@data, from any thread.
+ * @return      return 0 on success, -1 if the ring is empty.
+ */
+static inline int mpmc_ring_dequeue(struct mpmc_ring *ring, void **data)
+{
+    size_t pos = __atomic_load_n(&ring->dequeue_pos, __ATOMIC_RELAXED);
+    struct mpmc_cell *cell;
+    intptr_t diff;
+
+    for (;;) {
+        cell = &ring->cells[pos & ring->mask];
+        diff = (intptr_t)__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) - (intptr_t)(pos + 1);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&ring->dequeue_pos, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        } else if (diff < 0) {
+            return -1;
+        } else {
+            pos = __atomic_load_n(&ring->dequeue_pos, __ATOMIC_RELAXED);
+        }
+    }
+
+    *data = cell->data;
+    __atomic_store_n(&cell->seq, pos + ring->mask + 1, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+#endif
@@ -6,6 +6,7 @@
 #ifndef COMMON_MLIST_H
 #define COMMON_MLIST_H
 
+#include <stddef.h>
 
 struct list_node  // double linkded list node
 {
@@ -120,6 +121,196 @@ static inline int mlist_is_tail(struct list_node * head,
     return (head->prev == node);
 }
 
+/**
+ * Merge two NULL terminated lists linked by ->next, @a before @b for
+ * equal nodes. ->prev is not maintained.
+ */
+static inline struct list_node *__mlist_merge(struct list_node *a,
+                                              struct list_node *b,
+                                              int (*cmp)(void *ctx,
+                                                         const struct list_node *a,
+                                                         const struct list_node *b),
+                                              void *ctx)
+{
+    struct list_node *head, **tail = &head;
+
+    for (;;) {
+        if (cmp(ctx, a, b) <= 0) {
+            *tail = a;
+            tail = &a->next;
+            if ((a = a->next) == NULL) {
+                *tail = b;
+                break;
+            }
+        } else {
+            *tail = b;
+            tail = &b->next;
+            if ((b = b->next) == NULL) {
+                *tail = a;
+                break;
+            }
+        }
+    }
+
+    return head;
+}
+
+/**
+ * Last merge, which also restores ->prev and the circular links to @head.
+ */
+static inline void __mlist_merge_final(struct list_node *head,
+                                       struct list_node *a,
+                                       struct list_node *b,
+                                       int (*cmp)(void *ctx,
+                                                  const struct list_node *a,
+                                                  const struct list_node *b),
+                                       void *ctx)
+{
+    struct list_node *tail = head;
+
+    for (;;) {
+        if (cmp(ctx, a, b) <= 0) {
+            tail->next = a;
+            a->prev = tail;
+            tail = a;
+            if ((a = a->next) == NULL)
+                break;
+        } else {
+            tail->next = b;
+            b->prev = tail;
+            tail = b;
+            if ((b = b->next) == NULL) {
+                b = a;
+                break;
+            }
+        }
+    }
+
+    // Link the rest of the other list
+    do {
+        tail->next = b;
+        b->prev = tail;
+        tail = b;
+        b = b->next;
+    } while (b != NULL);
+
+    tail->next = head;
+    head->prev = tail;
+}
+
+/**
+ * Stable sort of the list @head without allocating, as list_sort() of the
+ * Linux kernel: nodes are pushed one by one on a stack of sorted runs,
+ * chained through ->prev, and two runs of 2^k nodes are merged as soon as
+ * a third one of that size is complete. Runs are at most 2:1 unbalanced
+ * and stay small enough to be in cache while they are merged.
+ * @head,  the head of the list
+ * @cmp,   return > 0 if @a goes after @b, <= 0 otherwise
+ * @ctx,   passed to @cmp
+ */
+static inline void mlist_sort(struct list_node *head,
+                              int (*cmp)(void *ctx,
+                                         const struct list_node *a,
+                                         const struct list_node *b),
+                              void *ctx)
+{
+    struct list_node *list = head->next, *pending = NULL;
+    struct list_node **tail, *a, *b;
+    unsigned long count = 0, bits;
+
+    // Zero or one node
+    if (list == head->prev)
+        return;
+
+    head->prev->next = NULL;
+
+    do {
+        // The next node is needed after the merges below
+        __builtin_prefetch(list->next);
+
+        // The lowest clear bit of @count tells which two runs to merge
+        tail = &pending;
+        for (bits = count; bits & 1; bits >>= 1)
+            tail = &(*tail)->prev;
+
+        if (bits) {
+            a = *tail;
+            b = a->prev;
+            a = __mlist_merge(b, a, cmp, ctx);
+            a->prev = b->prev;
+            *tail = a;
+        }
+
+        // Push @list as a run of one
+        list->prev = pending;
+        pending = list;
+        list = list->next;
+        pending->next = NULL;
+        count++;
+    } while (list != NULL);
+
+    // Merge all pending runs, newest first
+    list = pending;
+    pending = pending->prev;
+    while (pending->prev != NULL) {
+        b = pending->prev;
+        list = __mlist_merge(pending, list, cmp, ctx);
+        pending = b;
+    }
+
+    __mlist_merge_final(head, pending, list, cmp, ctx);
+}
+
+/**
+ * Singly linked list with a one pointer head, for hash buckets. A node
+ * keeps the address of the pointer to it, so it can be deleted without
+ * knowing its head or walking the list.
+ */
+struct hlist_node
+{
+    struct hlist_node *next, **pprev;
+};
+
+struct hlist_head
+{
+    struct hlist_node *first;
+};
+
+#define M_INIT_HLIST_HEAD(ptr) ((ptr)->first = NULL)
+
+/**
+ * Insert @add at the front of @head
+ */
+static inline void hlist_add_head(struct hlist_node *add,
+                                  struct hlist_head *head)
+{
+    struct hlist_node *first = head->first;
+
+    add->next = first;
+    if (first != NULL)
+        first->pprev = &add->next;
+    head->first = add;
+    add->pprev = &head->first;
+}
+
+/**
+ * Delete node @del from whatever list it is on
+ */
+static inline void hlist_delete(struct hlist_node *del)
+{
+    *del->pprev = del->next;
+    if (del->next != NULL)
+        del->next->pprev = del->pprev;
+}
+
+static inline int hlist_is_empty(struct hlist_head *head)
+{
+    return (head->first == NULL);
+}
+
+#define hlist_for_each_safely(pos, pnext, head)                         \
+    for (pos = (head)->first; pos != NULL && ((pnext = pos->next), 1); pos = pnext)
+
 #define list_entry(ptr, type, member)                                   \
     ( (type *)( (char *)(ptr) - (unsigned long)( &((type*)(0))->member ) ) )
 
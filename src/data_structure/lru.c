@@ -0,0 +1,358 @@
+/* lru.c --- sharded LRU cache
+ *
+ * Filename: lru.c
+ * Description: lock striped LRU / CLOCK cache with byte capacity
+ * Author: Werther Zhang
+ * Maintainer: Werther Zhang (peng.zhang.dev@gmail.com)
+ * Version: 0
+ * Keywords: cache, LRU, CLOCK
+ *
+ */
+
+/* Change Log:
+ *
+ *
+ */
+
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth
+ * Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* Code: */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "htable.h"
+#include "list.h"
+#include "lru.h"
+
+#define LRU_DEFAULT_SHARDS 16
+
+struct lru_handle {
+    struct hlist_node hash_node;
+    struct list_node node;      // recency list, or free list once out
+    uint64_t hash;
+    void *value;
+    size_t charge;
+    int refs;                   // handles, plus one while in the cache
+    int in_cache;
+    int referenced;             // CLOCK bit
+    size_t key_len;
+    char key[];
+};
+
+struct lru_shard {
+    pthread_mutex_t lock;
+    struct htable index;
+    struct list_node list;      // least recent (or clock hand) first
+    size_t usage;
+    size_t capacity;
+} __attribute__((aligned(64)));
+
+struct lru_cache {
+    int flags;
+    int shard_bits;
+    struct lru_shard *shards;
+    void (*evict)(const void *key, size_t key_len, void *value);
+};
+
+struct lru_key {
+    const void *key;
+    size_t len;
+};
+
+static uint64_t entry_hash(const struct hlist_node *node)
+{
+    return list_entry(node, struct lru_handle, hash_node)->hash;
+}
+
+static int entry_match(const struct hlist_node *node, const void *key)
+{
+    const struct lru_handle *entry = list_entry(node, struct lru_handle, hash_node);
+    const struct lru_key *k = (const struct lru_key *)key;
+
+    return entry->key_len == k->len && memcmp(entry->key, k->key, k->len) == 0;
+}
+
+static struct lru_shard *shard_of(struct lru_cache *cache, uint64_t hash)
+{
+    // htable uses the low bits
+    if (cache->shard_bits == 0)
+        return cache->shards;
+    return &cache->shards[hash >> (64 - cache->shard_bits)];
+}
+
+struct lru_cache *lru_create(size_t capacity, int shards, int flags,
+                             void (*evict)(const void *key, size_t key_len, void *value))
+{
+    struct lru_cache *cache;
+    int i, n;
+
+    if (shards <= 0)
+        shards = LRU_DEFAULT_SHARDS;
+
+    if ((cache = (struct lru_cache *)malloc(sizeof(struct lru_cache))) == NULL)
+        return NULL;
+
+    cache->flags = flags;
+    cache->evict = evict;
+    for (cache->shard_bits = 0; (1 << cache->shard_bits) < shards; cache->shard_bits++)
+        ;
+    n = 1 << cache->shard_bits;
+
+    if (posix_memalign((void **)&cache->shards, 64, n * sizeof(struct lru_shard)) != 0) {
+        free(cache);
+        return NULL;
+    }
+
+    for (i = 0; i < n; i++) {
+        struct lru_shard *shard = &cache->shards[i];
+
+        if (htable_init(&shard->index, entry_hash) != 0) {
+            while (--i >= 0) {
+                htable_destroy(&cache->shards[i].index, NULL);
+                pthread_mutex_destroy(&cache->shards[i].lock);
+            }
+            free(cache->shards);
+            free(cache);
+            return NULL;
+        }
+        pthread_mutex_init(&shard->lock, NULL);
+        M_INIT_LIST_HEAD(&shard->list);
+        shard->usage = 0;
+        shard->capacity = (capacity + n - 1) / n;
+    }
+
+    return cache;
+}
+
+static void entry_free(struct lru_cache *cache, struct lru_handle *entry)
+{
+    if (cache->evict != NULL)
+        cache->evict(entry->key, entry->key_len, entry->value);
+    free(entry);
+}
+
+/**
+ * free the entries collected under the shard lock, after dropping it.
+ */
+static void free_list(struct lru_cache *cache, struct list_node *freed)
+{
+    struct list_node *pos, *pnext;
+
+    list_for_each_safely(pos, pnext, freed)
+        entry_free(cache, list_entry(pos, struct lru_handle, node));
+}
+
+static void unref(struct lru_handle *entry, struct list_node *freed)
+{
+    if (--entry->refs == 0)
+        mlist_enqueue(freed, &entry->node);
+}
+
+/**
+ * take @entry out of index and list, drop the reference of the cache.
+ */
+static void detach(struct lru_shard *shard, struct lru_handle *entry,
+                   struct list_node *freed)
+{
+    htable_remove(&shard->index, &entry->hash_node);
+    mlist_delete(&entry->node);
+    entry->in_cache = 0;
+    shard->usage -= entry->charge;
+    unref(entry, freed);
+}
+
+/**
+ * evict from the cold end until @shard fits. Pinned entries, and with
+ * CLOCK referenced ones, go back to the other end; each entry is looked
+ * at most twice so a shard full of pinned entries stays over capacity.
+ */
+static void evict(struct lru_shard *shard, struct list_node *freed)
+{
+    struct lru_handle *entry;
+    size_t budget = 2 * htable_size(&shard->index);
+
+    while (shard->usage > shard->capacity && !mlist_is_empty(&shard->list) && budget-- > 0) {
+        entry = list_head(&shard->list, struct lru_handle, node);
+        if (entry->refs > 1 || entry->referenced) {
+            entry->referenced = 0;
+            mlist_delete(&entry->node);
+            mlist_enqueue(&shard->list, &entry->node);
+            continue;
+        }
+
+        detach(shard, entry, freed);
+    }
+}
+
+void lru_destroy(struct lru_cache *cache)
+{
+    struct list_node freed;
+    int i;
+
+    for (i = 0; i < (1 << cache->shard_bits); i++) {
+        struct lru_shard *shard = &cache->shards[i];
+
+        M_INIT_LIST_HEAD(&freed);
+        while (!mlist_is_empty(&shard->list))
+            detach(shard, list_head(&shard->list, struct lru_handle, node), &freed);
+        free_list(cache, &freed);
+
+        htable_destroy(&shard->index, NULL);
+        pthread_mutex_destroy(&shard->lock);
+    }
+
+    free(cache->shards);
+    free(cache);
+
+    return;
+}
+
+int lru_put(struct lru_cache *cache, const void *key, size_t key_len, void *value,
+            size_t charge, struct lru_handle **handle)
+{
+    struct lru_handle *entry, *old;
+    struct lru_shard *shard;
+    struct hlist_node *node;
+    struct list_node freed;
+    struct lru_key k;
+
+    if ((entry = (struct lru_handle *)malloc(sizeof(struct lru_handle) + key_len)) == NULL)
+        return -1;
+
+    entry->hash = htable_hash_bytes(key, key_len);
+    entry->value = value;
+    entry->charge = charge;
+    entry->refs = handle != NULL ? 2 : 1;
+    entry->in_cache = 1;
+    entry->referenced = 0;
+    entry->key_len = key_len;
+    memcpy(entry->key, key, key_len);
+
+    k.key = key;
+    k.len = key_len;
+    shard = shard_of(cache, entry->hash);
+    M_INIT_LIST_HEAD(&freed);
+
+    pthread_mutex_lock(&shard->lock);
+    if ((node = htable_lookup(&shard->index, entry->hash, entry_match, &k)) != NULL) {
+        old = list_entry(node, struct lru_handle, hash_node);
+        detach(shard, old, &freed);
+    }
+
+    htable_insert(&shard->index, &entry->hash_node);
+    mlist_enqueue(&shard->list, &entry->node);
+    shard->usage += charge;
+    evict(shard, &freed);
+    pthread_mutex_unlock(&shard->lock);
+
+    free_list(cache, &freed);
+    if (handle != NULL)
+        *handle = entry;
+
+    return 0;
+}
+
+struct lru_handle *lru_get(struct lru_cache *cache, const void *key, size_t key_len)
+{
+    uint64_t hash = htable_hash_bytes(key, key_len);
+    struct lru_shard *shard = shard_of(cache, hash);
+    struct lru_handle *entry = NULL;
+    struct hlist_node *node;
+    struct lru_key k;
+
+    k.key = key;
+    k.len = key_len;
+
+    pthread_mutex_lock(&shard->lock);
+    if ((node = htable_lookup(&shard->index, hash, entry_match, &k)) != NULL) {
+        entry = list_entry(node, struct lru_handle, hash_node);
+        entry->refs++;
+        if (cache->flags & LRU_CLOCK) {
+            entry->referenced = 1;
+        } else {
+            mlist_delete(&entry->node);
+            mlist_enqueue(&shard->list, &entry->node);
+        }
+    }
+    pthread_mutex_unlock(&shard->lock);
+
+    return entry;
+}
+
+void lru_release(struct lru_cache *cache, struct lru_handle *handle)
+{
+    struct lru_shard *shard = shard_of(cache, handle->hash);
+    struct list_node freed;
+
+    M_INIT_LIST_HEAD(&freed);
+
+    pthread_mutex_lock(&shard->lock);
+    unref(handle, &freed);
+    // Pinning may have kept the shard over capacity
+    if (handle->in_cache)
+        evict(shard, &freed);
+    pthread_mutex_unlock(&shard->lock);
+
+    free_list(cache, &freed);
+
+    return;
+}
+
+void *lru_value(struct lru_handle *handle)
+{
+    return handle->value;
+}
+
+int lru_erase(struct lru_cache *cache, const void *key, size_t key_len)
+{
+    uint64_t hash = htable_hash_bytes(key, key_len);
+    struct lru_shard *shard = shard_of(cache, hash);
+    struct hlist_node *node;
+    struct list_node freed;
+    struct lru_key k;
+
+    k.key = key;
+    k.len = key_len;
+    M_INIT_LIST_HEAD(&freed);
+
+    pthread_mutex_lock(&shard->lock);
+    if ((node = htable_lookup(&shard->index, hash, entry_match, &k)) != NULL)
+        detach(shard, list_entry(node, struct lru_handle, hash_node), &freed);
+    pthread_mutex_unlock(&shard->lock);
+
+    free_list(cache, &freed);
+
+    return node != NULL ? 0 : -1;
+}
+
+size_t lru_usage(struct lru_cache *cache)
+{
+    size_t usage = 0;
+    int i;
+
+    for (i = 0; i < (1 << cache->shard_bits); i++) {
+        pthread_mutex_lock(&cache->shards[i].lock);
+        usage += cache->shards[i].usage;
+        pthread_mutex_unlock(&cache->shards[i].lock);
+    }
+
+    return usage;
+}
+
+/* lru.c ends here */
@@ -0,0 +1,86 @@
+#ifndef LRU_H
+#define LRU_H
+
+#include <stddef.h>
+
+/**
+ * Sharded cache with a byte capacity. Every shard has its own lock, an
+ * htable index and a recency list of list_node; the shard is picked by
+ * the high bits of the key hash.
+ *
+ * lru_get() and lru_put() return a handle which pins the entry until
+ * lru_release(): a pinned entry is never evicted, and one that is erased
+ * or replaced meanwhile is only freed at its last release.
+ *
+ * With LRU_CLOCK a hit only sets a reference bit instead of moving the
+ * entry to the recent end of the list; eviction gives referenced entries
+ * a second chance.
+ */
+
+#define LRU_CLOCK 0x1
+
+struct lru_cache;
+struct lru_handle;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * create cache.
+ * @capacity    total charge kept in the cache, split evenly over shards.
+ * @shards      number of shards, rounded up to a power of two, 0 for 16.
+ * @flags       0 or LRU_CLOCK.
+ * @evict       called when an entry is freed, after it left the cache
+ *              and its last handle is released; may be NULL.
+ * @return      the cache or NULL on failure.
+ */
+struct lru_cache *lru_create(size_t capacity, int shards, int flags,
+                             void (*evict)(const void *key, size_t key_len, void *value));
+
+/**
+ * free all entries. No handle may be outstanding.
+ */
+void lru_destroy(struct lru_cache *cache);
+
+/**
+ * insert @key, replacing an older entry with the same key.
+ * @charge      bytes accounted against the capacity.
+ * @handle      if not NULL, a handle of the new entry on success.
+ * @return      return 0 on success otherwise return -1
+ */
+int lru_put(struct lru_cache *cache, const void *key, size_t key_len, void *value,
+            size_t charge, struct lru_handle **handle);
+
+/**
+ * lookup @key.
+ * @return      a handle, to be released, or NULL on a miss.
+ */
+struct lru_handle *lru_get(struct lru_cache *cache, const void *key, size_t key_len);
+
+/**
+ * drop a handle returned by lru_get() or lru_put().
+ */
+void lru_release(struct lru_cache *cache, struct lru_handle *handle);
+
+/**
+ * value of the entry behind @handle.
+ */
+void *lru_value(struct lru_handle *handle);
+
+/**
+ * remove @key from the cache.
+ * @return      return 0 on success otherwise return -1
+ */
+int lru_erase(struct lru_cache *cache, const void *key, size_t key_len);
+
+/**
+ * total charge of the entries in the cache, pinned ones included.
+ */
+size_t lru_usage(struct lru_cache *cache);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,363 @@
+/* skiplist.c --- lock-free skip list
+ *
+ * Filename: skiplist.c
+ * Description: lock-free ordered map with epoch based reclamation
+ * Author: Werther Zhang
+ * Maintainer: Werther Zhang (peng.zhang.dev@gmail.com)
+ * Version: 0
+ * Keywords: skip list, lock-free
+ *
+ */
+
+/* Change Log:
+ *
+ *
+ */
+
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth
+ * Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* Code: */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "skiplist.h"
+
+#define is_marked(ptr) (((uintptr_t)(ptr)) & 1)
+#define marked(ptr)    ((struct skiplist_node *)(((uintptr_t)(ptr)) | 1))
+#define unmarked(ptr)  ((struct skiplist_node *)(((uintptr_t)(ptr)) & ~(uintptr_t)1))
+
+static __thread uint64_t level_seed;
+
+static inline struct skiplist_node *load_next(struct skiplist_node *node, int level)
+{
+    return __atomic_load_n(&node->next[level], __ATOMIC_ACQUIRE);
+}
+
+static inline int cas_next(struct skiplist_node *node, int level,
+                           struct skiplist_node *expected, struct skiplist_node *desired)
+{
+    return __atomic_compare_exchange_n(&node->next[level], &expected, desired, 0,
+                                       __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * geometric level with p = 1/2.
+ */
+static int random_level(void)
+{
+    uint64_t x = level_seed;
+
+    if (x == 0)
+        x = (uintptr_t)&level_seed | 1;
+
+    // xorshift64
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    level_seed = x;
+
+    return 1 + __builtin_ctzll(x | (1ULL << (SKIPLIST_MAX_LEVEL - 1)));
+}
+
+static struct skiplist_node *node_alloc(void *data, int level)
+{
+    struct skiplist_node *node;
+    int i;
+
+    node = (struct skiplist_node *)malloc(sizeof(struct skiplist_node)
+                                          + level * sizeof(struct skiplist_node *));
+    if (node == NULL)
+        return NULL;
+
+    node->data = data;
+    node->level = level;
+    for (i = 0; i < level; i++)
+        node->next[i] = NULL;
+
+    return node;
+}
+
+/**
+ * fill @preds and @succs with the last node before @key and the first
+ * node not before it on every level, unlinking marked nodes on the way.
+ * @return      1 if succs[0] holds @key, otherwise 0.
+ */
+static int find(SkipList *list, const void *key,
+                struct skiplist_node **preds, struct skiplist_node **succs)
+{
+    struct skiplist_node *pred, *curr, *succ;
+    int level;
+
+retry:
+    pred = list->head;
+    for (level = SKIPLIST_MAX_LEVEL - 1; level >= 0; level--) {
+        curr = unmarked(load_next(pred, level));
+        while (curr != NULL) {
+            succ = load_next(curr, level);
+            while (is_marked(succ)) {
+                if (!cas_next(pred, level, curr, unmarked(succ)))
+                    goto retry;
+                curr = unmarked(succ);
+                if (curr == NULL)
+                    break;
+                succ = load_next(curr, level);
+            }
+
+            if (curr == NULL || list->compare(curr->data, key) >= 0)
+                break;
+            pred = curr;
+            curr = unmarked(succ);
+        }
+
+        preds[level] = pred;
+        succs[level] = curr;
+    }
+
+    return succs[0] != NULL && list->compare(succs[0]->data, key) == 0;
+}
+
+/**
+ * first unmarked node not before @key, NULL for the first one, without
+ * writing anything.
+ */
+static struct skiplist_node *search(SkipList *list, const void *key)
+{
+    struct skiplist_node *pred = list->head, *curr = NULL, *succ;
+    int level;
+
+    for (level = SKIPLIST_MAX_LEVEL - 1; level >= 0; level--) {
+        curr = unmarked(load_next(pred, level));
+        while (curr != NULL) {
+            succ = load_next(curr, level);
+            while (is_marked(succ)) {
+                if ((curr = unmarked(succ)) == NULL)
+                    break;
+                succ = load_next(curr, level);
+            }
+
+            if (curr == NULL || key == NULL || list->compare(curr->data, key) >= 0)
+                break;
+            pred = curr;
+            curr = unmarked(succ);
+        }
+    }
+
+    return curr;
+}
+
+int skiplist_init(SkipList *list, int (*compare)(const void *key1, const void *key2),
+                  void (*destroy)(void *data))
+{
+    if ((list->head = node_alloc(NULL, SKIPLIST_MAX_LEVEL)) == NULL)
+        return -1;
+
+    list->size = 0;
+    list->compare = compare;
+    list->destroy = destroy;
+    epoch_init(&list->epoch);
+
+    return 0;
+}
+
+void skiplist_destroy(SkipList *list)
+{
+    struct skiplist_node *node, *next;
+
+    // Removed nodes are unlinked already, they are only in the epoch bags
+    epoch_destroy(&list->epoch);
+
+    for (node = list->head->next[0]; node != NULL; node = next) {
+        next = unmarked(node->next[0]);
+        if (list->destroy != NULL)
+            list->destroy(node->data);
+        free(node);
+    }
+
+    free(list->head);
+    list->head = NULL;
+    list->size = 0;
+
+    return;
+}
+
+void skiplist_register(SkipList *list, struct epoch_record *record)
+{
+    epoch_register(&list->epoch, record);
+}
+
+void skiplist_unregister(SkipList *list, struct epoch_record *record)
+{
+    (void)list;
+    epoch_unregister(record);
+}
+
+int skiplist_insert(SkipList *list, struct epoch_record *record, const void *data)
+{
+    struct skiplist_node *preds[SKIPLIST_MAX_LEVEL], *succs[SKIPLIST_MAX_LEVEL];
+    struct skiplist_node *node, *next;
+    int level, i;
+
+    if ((node = node_alloc((void *)data, random_level())) == NULL)
+        return -1;
+
+    epoch_enter(record);
+    for (;;) {
+        if (find(list, data, preds, succs)) {
+            epoch_exit(record);
+            free(node);
+            return 1;
+        }
+
+        for (i = 0; i < node->level; i++)
+            node->next[i] = succs[i];
+
+        // Linking level 0 makes @data visible
+        if (cas_next(preds[0], 0, succs[0], node))
+            break;
+    }
+    __atomic_add_fetch(&list->size, 1, __ATOMIC_RELAXED);
+
+    for (level = 1; level < node->level; level++) {
+        for (;;) {
+            // A concurrent remove marked the levels above, stop linking
+            next = load_next(node, level);
+            if (is_marked(next))
+                goto out;
+            if (next != succs[level] && !cas_next(node, level, next, succs[level]))
+                goto out;
+
+            if (cas_next(preds[level], level, succs[level], node))
+                break;
+
+            if (!find(list, data, preds, succs) || succs[0] != node)
+                goto out;
+        }
+    }
+
+out:
+    // The remover's last find may have run before one of our links: unlink
+    // the node again before leaving the read section, so it is not
+    // reachable once its grace period ends.
+    if (is_marked(load_next(node, 0)))
+        find(list, data, preds, succs);
+    epoch_exit(record);
+
+    return 0;
+}
+
+static void free_node(void *ptr)
+{
+    free(ptr);
+}
+
+static void retire(SkipList *list, struct epoch_record *record,
+                   void *ptr, void (*free_fn)(void *ptr))
+{
+    if (epoch_retire(record, ptr, free_fn) != 0) {
+        epoch_synchronize(&list->epoch);
+        free_fn(ptr);
+    }
+}
+
+int skiplist_remove(SkipList *list, struct epoch_record *record, const void *data)
+{
+    struct skiplist_node *preds[SKIPLIST_MAX_LEVEL], *succs[SKIPLIST_MAX_LEVEL];
+    struct skiplist_node *node, *next;
+    int level;
+
+    epoch_enter(record);
+    if (!find(list, data, preds, succs)) {
+        epoch_exit(record);
+        return -1;
+    }
+
+    node = succs[0];
+    for (level = node->level - 1; level > 0; level--) {
+        next = load_next(node, level);
+        while (!is_marked(next)) {
+            cas_next(node, level, next, marked(next));
+            next = load_next(node, level);
+        }
+    }
+
+    // Whoever marks level 0 removes the node
+    next = load_next(node, 0);
+    for (;;) {
+        if (is_marked(next)) {
+            epoch_exit(record);
+            return -1;
+        }
+        if (cas_next(node, 0, next, marked(next)))
+            break;
+        next = load_next(node, 0);
+    }
+
+    // Unlink it from every level before it is retired
+    find(list, data, preds, succs);
+    epoch_exit(record);
+
+    __atomic_sub_fetch(&list->size, 1, __ATOMIC_RELAXED);
+    if (list->destroy != NULL)
+        retire(list, record, node->data, list->destroy);
+    retire(list, record, node, free_node);
+
+    return 0;
+}
+
+int skiplist_lookup(SkipList *list, struct epoch_record *record, void **data)
+{
+    struct skiplist_node *node;
+    int retval = -1;
+
+    epoch_enter(record);
+    node = search(list, *data);
+    if (node != NULL && list->compare(node->data, *data) == 0) {
+        *data = node->data;
+        retval = 0;
+    }
+    epoch_exit(record);
+
+    return retval;
+}
+
+int skiplist_scan(SkipList *list, struct epoch_record *record,
+                  const void *lo, const void *hi,
+                  int (*visit)(void *data, void *ctx), void *ctx)
+{
+    struct skiplist_node *node, *next;
+    int count = 0;
+
+    epoch_enter(record);
+    node = search(list, lo);
+    while (node != NULL) {
+        if (hi != NULL && list->compare(node->data, hi) >= 0)
+            break;
+
+        next = load_next(node, 0);
+        if (!is_marked(next)) {
+            count++;
+            if (visit(node->data, ctx) != 0)
+                break;
+        }
+        node = unmarked(next);
+    }
+    epoch_exit(record);
+
+    return count;
+}
+
+/* skiplist.c ends here */
@@ -0,0 +1,97 @@
+#ifndef SKIPLIST_H
+#define SKIPLIST_H
+
+#include <stddef.h>
+#include "../thread/epoch.h"
+
+/**
+ * Lock-free skip list ordered map (Herlihy & Shavit). A node is removed
+ * by marking the low bit of its next pointers, top level first; the mark
+ * of level 0 is the actual removal. Searches unlink marked nodes on
+ * their way, and removed nodes and their data are freed through @epoch
+ * once no thread can still see them.
+ *
+ * Every thread registers its own epoch_record, as with BisTreeRcu, and
+ * passes it to all calls.
+ */
+
+#define SKIPLIST_MAX_LEVEL 24
+
+struct skiplist_node {
+    void *data;
+    int level;
+    struct skiplist_node *next[];
+};
+
+typedef struct skiplist_ {
+    size_t size;
+    struct skiplist_node *head;
+    int (*compare)(const void *key1, const void *key2);
+    void (*destroy)(void *data);
+    struct epoch_domain epoch;
+} SkipList;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * init skip list, arguments as in bistree_init().
+ * @return      return 0 on success otherwise return -1
+ */
+int skiplist_init(SkipList *list, int (*compare)(const void *key1, const void *key2),
+                  void (*destroy)(void *data));
+
+/**
+ * destroy the list, include all data. No thread may use @list anymore.
+ */
+void skiplist_destroy(SkipList *list);
+
+/**
+ * every thread registers its own @record before its first call.
+ */
+void skiplist_register(SkipList *list, struct epoch_record *record);
+void skiplist_unregister(SkipList *list, struct epoch_record *record);
+
+/**
+ * insert @data to @list
+ * @return      return 0 on success, 1 if an equal key is already in
+ *              the list, -1 on error.
+ */
+int skiplist_insert(SkipList *list, struct epoch_record *record, const void *data);
+
+/**
+ * remove the data equal to @data from @list. Its data is passed to
+ * list->destroy once no reader can reach it anymore.
+ * @return      return 0 on success otherwise return -1
+ */
+int skiplist_remove(SkipList *list, struct epoch_record *record, const void *data);
+
+/**
+ * lookup data. On success *@data is replaced by the data in the list,
+ * which may be destroyed after a concurrent skiplist_remove().
+ * @return      return 0 on success otherwise return -1
+ */
+int skiplist_lookup(SkipList *list, struct epoch_record *record, void **data);
+
+/**
+ * visit the data in [@lo, @hi) in key order. NULL bounds are open.
+ * Concurrent updates may or may not be seen.
+ * @visit       return non-zero to stop; @data is only valid during
+ *              the call.
+ * @return      number of visited data.
+ */
+int skiplist_scan(SkipList *list, struct epoch_record *record,
+                  const void *lo, const void *hi,
+                  int (*visit)(void *data, void *ctx), void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+static inline size_t skiplist_size(SkipList *list)
+{
+    return __atomic_load_n(&list->size, __ATOMIC_RELAXED);
+}
+
+#endif
@@ -0,0 +1,336 @@
+/* ulist.c --- unrolled linked list
+ *
+ * Filename: ulist.c
+ * Description: linked list of cache line aligned chunks of pointers
+ * Author: Werther Zhang
+ * Maintainer: Werther Zhang (peng.zhang.dev@gmail.com)
+ * Version: 0
+ * Keywords: list, unrolled list
+ *
+ */
+
+/* Change Log:
+ *
+ *
+ */
+
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth
+ * Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* Code: */
+
+#include <stdlib.h>
+#include <string.h>
+#include "ulist.h"
+
+#define ITEMS ((int)ULIST_CHUNK_ITEMS)
+
+static struct ulist_chunk *chunk_alloc(int begin)
+{
+    struct ulist_chunk *chunk;
+
+    if (posix_memalign((void **)&chunk, 64, sizeof(struct ulist_chunk)) != 0)
+        return NULL;
+
+    chunk->begin = begin;
+    chunk->end = begin;
+
+    return chunk;
+}
+
+static void chunk_free(struct ulist_chunk *chunk)
+{
+    mlist_delete(&chunk->node);
+    free(chunk);
+}
+
+static inline int chunk_count(struct ulist_chunk *chunk)
+{
+    return chunk->end - chunk->begin;
+}
+
+static inline struct ulist_chunk *first_chunk(UList *list)
+{
+    return list_entry(list->chunks.next, struct ulist_chunk, node);
+}
+
+static inline struct ulist_chunk *last_chunk(UList *list)
+{
+    return list_entry(list->chunks.prev, struct ulist_chunk, node);
+}
+
+/**
+ * move the items of @chunk to the start of its array.
+ * @return      how far they moved.
+ */
+static int compact(struct ulist_chunk *chunk)
+{
+    int shift = chunk->begin;
+
+    if (shift > 0) {
+        memmove(chunk->items, chunk->items + shift, chunk_count(chunk) * sizeof(void *));
+        chunk->begin = 0;
+        chunk->end -= shift;
+    }
+
+    return shift;
+}
+
+void ulist_init(UList *list, void (*destroy)(void *data))
+{
+    list->size = 0;
+    M_INIT_LIST_HEAD(&list->chunks);
+    list->destroy = destroy;
+
+    return;
+}
+
+void ulist_destroy(UList *list)
+{
+    struct list_node *pos, *pnext;
+    struct ulist_chunk *chunk;
+    int i;
+
+    list_for_each_safely(pos, pnext, &list->chunks) {
+        chunk = list_entry(pos, struct ulist_chunk, node);
+        if (list->destroy != NULL) {
+            for (i = chunk->begin; i < chunk->end; i++)
+                list->destroy(chunk->items[i]);
+        }
+        free(chunk);
+    }
+
+    M_INIT_LIST_HEAD(&list->chunks);
+    list->size = 0;
+
+    return;
+}
+
+int ulist_push_front(UList *list, void *data)
+{
+    struct ulist_chunk *chunk;
+
+    if (mlist_is_empty(&list->chunks) || (chunk = first_chunk(list))->begin == 0) {
+        // Fill the new chunk from its end, further pushes stay in place
+        if ((chunk = chunk_alloc(ITEMS)) == NULL)
+            return -1;
+        mlist_add_tail(&chunk->node, &list->chunks);
+    }
+
+    chunk->items[--chunk->begin] = data;
+    list->size++;
+
+    return 0;
+}
+
+int ulist_push_back(UList *list, void *data)
+{
+    struct ulist_chunk *chunk;
+
+    if (mlist_is_empty(&list->chunks) || (chunk = last_chunk(list))->end == ITEMS) {
+        if ((chunk = chunk_alloc(0)) == NULL)
+            return -1;
+        mlist_enqueue(&list->chunks, &chunk->node);
+    }
+
+    chunk->items[chunk->end++] = data;
+    list->size++;
+
+    return 0;
+}
+
+int ulist_pop_front(UList *list, void **data)
+{
+    struct ulist_chunk *chunk;
+
+    if (mlist_is_empty(&list->chunks))
+        return -1;
+
+    chunk = first_chunk(list);
+    *data = chunk->items[chunk->begin++];
+    if (chunk->begin == chunk->end)
+        chunk_free(chunk);
+    list->size--;
+
+    return 0;
+}
+
+int ulist_pop_back(UList *list, void **data)
+{
+    struct ulist_chunk *chunk;
+
+    if (mlist_is_empty(&list->chunks))
+        return -1;
+
+    chunk = last_chunk(list);
+    *data = chunk->items[--chunk->end];
+    if (chunk->begin == chunk->end)
+        chunk_free(chunk);
+    list->size--;
+
+    return 0;
+}
+
+/**
+ * move the upper half of the full @chunk to a new chunk after it and
+ * follow @iter, which may point to @chunk->end.
+ */
+static int split(struct ulist_chunk *chunk, struct ulist_iter *iter)
+{
+    struct ulist_chunk *next;
+    int mid = chunk->begin + chunk_count(chunk) / 2;
+
+    if ((next = chunk_alloc(0)) == NULL)
+        return -1;
+
+    next->end = chunk->end - mid;
+    memcpy(next->items, chunk->items + mid, next->end * sizeof(void *));
+    chunk->end = mid;
+    mlist_add_tail(&next->node, &chunk->node);
+
+    // Inserting at mid goes to the end of the left half, it has room now
+    if (iter->index > mid) {
+        iter->chunk = next;
+        iter->index -= mid;
+    }
+
+    return 0;
+}
+
+int ulist_insert(UList *list, struct ulist_iter *iter, void *data)
+{
+    struct ulist_chunk *chunk;
+    int i;
+
+    if (iter->chunk == NULL) {
+        if (ulist_push_back(list, data) != 0)
+            return -1;
+        iter->chunk = last_chunk(list);
+        iter->index = iter->chunk->end - 1;
+        return 0;
+    }
+
+    if (chunk_count(iter->chunk) == ITEMS && split(iter->chunk, iter) != 0)
+        return -1;
+
+    chunk = iter->chunk;
+    i = iter->index;
+    // Shift the shorter side that has room
+    if (chunk->end < ITEMS && (chunk->begin == 0 || chunk->end - i <= i - chunk->begin)) {
+        memmove(chunk->items + i + 1, chunk->items + i, (chunk->end - i) * sizeof(void *));
+        chunk->end++;
+    } else {
+        memmove(chunk->items + chunk->begin - 1, chunk->items + chunk->begin,
+                (i - chunk->begin) * sizeof(void *));
+        chunk->begin--;
+        i--;
+    }
+
+    chunk->items[i] = data;
+    iter->index = i;
+    list->size++;
+
+    return 0;
+}
+
+/**
+ * merge the successor of the sparse @chunk into it if both fit, and
+ * follow @iter.
+ */
+static void rebalance(UList *list, struct ulist_chunk *chunk, struct ulist_iter *iter)
+{
+    struct ulist_chunk *next;
+    int shift;
+
+    if (chunk_count(chunk) >= ITEMS / 4 || chunk->node.next == &list->chunks)
+        return;
+
+    next = list_entry(chunk->node.next, struct ulist_chunk, node);
+    if (chunk_count(chunk) + chunk_count(next) > ITEMS * 3 / 4)
+        return;
+
+    shift = compact(chunk);
+    if (iter->chunk == chunk) {
+        iter->index -= shift;
+    } else if (iter->chunk == next) {
+        iter->chunk = chunk;
+        iter->index = chunk->end + iter->index - next->begin;
+    }
+
+    memcpy(chunk->items + chunk->end, next->items + next->begin,
+           chunk_count(next) * sizeof(void *));
+    chunk->end += chunk_count(next);
+    chunk_free(next);
+}
+
+void ulist_remove(UList *list, struct ulist_iter *iter, void **data)
+{
+    struct ulist_chunk *chunk = iter->chunk;
+    int i = iter->index;
+
+    if (data != NULL)
+        *data = chunk->items[i];
+    list->size--;
+
+    // Close the gap from the shorter side
+    if (chunk->end - i - 1 <= i - chunk->begin) {
+        memmove(chunk->items + i, chunk->items + i + 1, (chunk->end - i - 1) * sizeof(void *));
+        chunk->end--;
+    } else {
+        memmove(chunk->items + chunk->begin + 1, chunk->items + chunk->begin,
+                (i - chunk->begin) * sizeof(void *));
+        chunk->begin++;
+        i++;
+    }
+
+    // Point @iter to the next data
+    if (i < chunk->end) {
+        iter->index = i;
+    } else if (chunk->node.next != &list->chunks) {
+        iter->chunk = list_entry(chunk->node.next, struct ulist_chunk, node);
+        iter->index = iter->chunk->begin;
+    } else {
+        iter->chunk = NULL;
+    }
+
+    if (chunk->begin == chunk->end)
+        chunk_free(chunk);
+    else
+        rebalance(list, chunk, iter);
+
+    return;
+}
+
+size_t ulist_foreach(UList *list, int (*visit)(void *data, void *ctx), void *ctx)
+{
+    struct list_node *pos;
+    struct ulist_chunk *chunk;
+    size_t visited = 0;
+    int i;
+
+    for (pos = list->chunks.next; pos != &list->chunks; pos = pos->next) {
+        chunk = list_entry(pos, struct ulist_chunk, node);
+        for (i = chunk->begin; i < chunk->end; i++) {
+            visited++;
+            if (visit(chunk->items[i], ctx) != 0)
+                return visited;
+        }
+    }
+
+    return visited;
+}
+
+/* ulist.c ends here */
@@ -0,0 +1,144 @@
+#ifndef ULIST_H
+#define ULIST_H
+
+#include <stddef.h>
+#include "list.h"
+
+/**
+ * Unrolled list: data pointers are kept in cache line aligned chunks of
+ * ULIST_CHUNK_ITEMS slots, and only the chunks are linked with list_node.
+ * A walk touches one chunk header per ULIST_CHUNK_ITEMS data instead of
+ * one node per data.
+ *
+ * Items of a chunk are in [begin, end), so both ends of the list grow in
+ * place. A full chunk is split in two on insertion and a chunk that drops
+ * under a quarter is merged with its successor when both fit in one.
+ */
+
+#ifndef ULIST_CHUNK_SIZE
+#define ULIST_CHUNK_SIZE 256    // bytes, a multiple of 64
+#endif
+
+#define ULIST_CHUNK_ITEMS                                               \
+    ((ULIST_CHUNK_SIZE - sizeof(struct list_node) - 2 * sizeof(int)) / sizeof(void *))
+
+struct ulist_chunk {
+    struct list_node node;
+    int begin;
+    int end;
+    void *items[ULIST_CHUNK_ITEMS];
+} __attribute__((aligned(64)));
+
+/**
+ * Position of one data. chunk is NULL past the last data.
+ */
+struct ulist_iter {
+    struct ulist_chunk *chunk;
+    int index;
+};
+
+typedef struct ulist_ {
+    size_t size;
+    struct list_node chunks;    // never holds an empty chunk
+    void (*destroy)(void *data);
+} UList;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * init unrolled list.
+ * @destroy     destroy private data in UList, may be NULL.
+ */
+void ulist_init(UList *list, void (*destroy)(void *data));
+
+/**
+ * destroy unrolled list, include all data.
+ */
+void ulist_destroy(UList *list);
+
+/**
+ * add @data at the front or at the back of @list.
+ * @return      return 0 on success otherwise return -1
+ */
+int ulist_push_front(UList *list, void *data);
+int ulist_push_back(UList *list, void *data);
+
+/**
+ * remove the first or the last data of @list into *@data.
+ * @return      return 0 on success, -1 if @list is empty.
+ */
+int ulist_pop_front(UList *list, void **data);
+int ulist_pop_back(UList *list, void **data);
+
+/**
+ * insert @data before @iter, at the end if @iter is past the last data.
+ * Other iterators are invalid afterwards, @iter points to @data.
+ * @return      return 0 on success otherwise return -1
+ */
+int ulist_insert(UList *list, struct ulist_iter *iter, void *data);
+
+/**
+ * remove the data at @iter into *@data, if @data is not NULL.
+ * Other iterators are invalid afterwards, @iter points to the next data.
+ */
+void ulist_remove(UList *list, struct ulist_iter *iter, void **data);
+
+/**
+ * visit all data in order.
+ * @visit       return non-zero to stop.
+ * @return      number of visited data.
+ */
+size_t ulist_foreach(UList *list, int (*visit)(void *data, void *ctx), void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+static inline size_t ulist_size(UList *list)
+{
+    return list->size;
+}
+
+/**
+ * move @iter to the first data.
+ * @return      return 0 on success, -1 if @list is empty.
+ */
+static inline int ulist_first(UList *list, struct ulist_iter *iter)
+{
+    if (mlist_is_empty(&list->chunks)) {
+        iter->chunk = NULL;
+        return -1;
+    }
+
+    iter->chunk = list_entry(list->chunks.next, struct ulist_chunk, node);
+    iter->index = iter->chunk->begin;
+    return 0;
+}
+
+/**
+ * move @iter to the next data.
+ * @return      return 0 on success, -1 past the last data.
+ */
+static inline int ulist_next(UList *list, struct ulist_iter *iter)
+{
+    if (++iter->index < iter->chunk->end)
+        return 0;
+
+    if (iter->chunk->node.next == &list->chunks) {
+        iter->chunk = NULL;
+        return -1;
+    }
+
+    iter->chunk = list_entry(iter->chunk->node.next, struct ulist_chunk, node);
+    iter->index = iter->chunk->begin;
+    return 0;
+}
+
+static inline void *ulist_get(struct ulist_iter *iter)
+{
+    return iter->chunk->items[iter->index];
+}
+
+#endif
@@ -0,0 +1,213 @@
+/* epoch.c --- epoch based memory reclamation
+ *
+ * Filename: epoch.c
+ * Description: deferred free of memory shared with lock-free readers
+ * Author: Werther Zhang
+ * Maintainer: Werther Zhang (peng.zhang.dev@gmail.com)
+ * Version: 0
+ * Keywords: epoch, rcu, memory reclamation
+ *
+ */
+
+/* Change Log:
+ *
+ *
+ */
+
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth
+ * Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* Code: */
+
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "epoch.h"
+
+#define EPOCH_RECLAIM_BATCH 128
+
+static void bag_flush(struct epoch_bag *bag)
+{
+    size_t i;
+
+    for (i = 0; i < bag->size; i++)
+        bag->frees[i](bag->ptrs[i]);
+    bag->size = 0;
+}
+
+static int bag_add(struct epoch_bag *bag, void *ptr, void (*free_fn)(void *ptr))
+{
+    void **ptrs;
+    void (**frees)(void *ptr);
+    size_t capacity;
+
+    if (bag->size == bag->capacity) {
+        capacity = bag->capacity ? bag->capacity * 2 : 64;
+        if ((ptrs = (void **)realloc(bag->ptrs, capacity * sizeof(void *))) == NULL)
+            return -1;
+        bag->ptrs = ptrs;
+        frees = (void (**)(void *))realloc(bag->frees, capacity * sizeof(*frees));
+        if (frees == NULL)
+            return -1;
+        bag->frees = frees;
+        bag->capacity = capacity;
+    }
+
+    bag->ptrs[bag->size] = ptr;
+    bag->frees[bag->size] = free_fn;
+    bag->size++;
+
+    return 0;
+}
+
+/**
+ * move the global epoch on if every active reader has seen it.
+ * @return      the global epoch.
+ */
+static unsigned long try_advance(struct epoch_domain *domain)
+{
+    struct epoch_record *record;
+    unsigned long epoch, state;
+
+    pthread_mutex_lock(&domain->lock);
+    epoch = __atomic_load_n(&domain->epoch, __ATOMIC_ACQUIRE);
+
+    for (record = domain->records; record != NULL; record = record->next) {
+        state = __atomic_load_n(&record->state, __ATOMIC_SEQ_CST);
+        if ((state & 1) && (state >> 1) != epoch)
+            break;
+    }
+
+    if (record == NULL) {
+        epoch++;
+        __atomic_store_n(&domain->epoch, epoch, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&domain->lock);
+
+    return epoch;
+}
+
+void epoch_init(struct epoch_domain *domain)
+{
+    domain->epoch = 3;          // bags start at epoch 0, which is safe
+    domain->records = NULL;
+    pthread_mutex_init(&domain->lock, NULL);
+
+    return;
+}
+
+void epoch_destroy(struct epoch_domain *domain)
+{
+    struct epoch_record *record;
+    int i;
+
+    for (record = domain->records; record != NULL; record = record->next) {
+        for (i = 0; i < 3; i++) {
+            bag_flush(&record->bags[i]);
+            free(record->bags[i].ptrs);
+            free(record->bags[i].frees);
+            memset(&record->bags[i], 0, sizeof(struct epoch_bag));
+        }
+    }
+
+    pthread_mutex_destroy(&domain->lock);
+    return;
+}
+
+void epoch_register(struct epoch_domain *domain, struct epoch_record *record)
+{
+    memset(record, 0, sizeof(struct epoch_record));
+    record->domain = domain;
+
+    pthread_mutex_lock(&domain->lock);
+    record->next = domain->records;
+    domain->records = record;
+    pthread_mutex_unlock(&domain->lock);
+
+    return;
+}
+
+void epoch_unregister(struct epoch_record *record)
+{
+    struct epoch_domain *domain = record->domain;
+    struct epoch_record **position;
+    int i;
+
+    epoch_exit(record);
+    epoch_synchronize(domain);
+
+    pthread_mutex_lock(&domain->lock);
+    for (position = &domain->records; *position != NULL; position = &(*position)->next) {
+        if (*position == record) {
+            *position = record->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&domain->lock);
+
+    for (i = 0; i < 3; i++) {
+        bag_flush(&record->bags[i]);
+        free(record->bags[i].ptrs);
+        free(record->bags[i].frees);
+    }
+
+    return;
+}
+
+int epoch_retire(struct epoch_record *record, void *ptr,
+                 void (*free_fn)(void *ptr))
+{
+    unsigned long epoch = __atomic_load_n(&record->domain->epoch, __ATOMIC_ACQUIRE);
+    struct epoch_bag *bag = &record->bags[epoch % 3];
+
+    // A bag of the same slot is at least three epochs old
+    if (bag->epoch != epoch) {
+        bag_flush(bag);
+        bag->epoch = epoch;
+    }
+
+    if (bag_add(bag, ptr, free_fn) != 0)
+        return -1;
+
+    if (++record->retired >= EPOCH_RECLAIM_BATCH) {
+        record->retired = 0;
+        epoch_reclaim(record);
+    }
+
+    return 0;
+}
+
+void epoch_reclaim(struct epoch_record *record)
+{
+    unsigned long epoch = try_advance(record->domain);
+    int i;
+
+    for (i = 0; i < 3; i++) {
+        if (record->bags[i].size > 0 && record->bags[i].epoch + 2 <= epoch)
+            bag_flush(&record->bags[i]);
+    }
+}
+
+void epoch_synchronize(struct epoch_domain *domain)
+{
+    unsigned long target = __atomic_load_n(&domain->epoch, __ATOMIC_ACQUIRE) + 2;
+
+    while (try_advance(domain) < target)
+        sched_yield();
+}
+
+/* epoch.c ends here */
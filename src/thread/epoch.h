@@ -0,0 +1,98 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+/**
+ * Epoch based memory reclamation.
+ *
+ * Every thread touching shared memory owns a registered epoch_record.
+ * Readers bracket their accesses with epoch_enter()/epoch_exit();
+ * writers hand unlinked memory to epoch_retire(), which frees it once
+ * every thread inside a read section has moved two epochs ahead.
+ */
+
+struct epoch_bag {
+    unsigned long epoch;        // epoch the entries were retired in
+    size_t size;
+    size_t capacity;
+    void **ptrs;
+    void (**frees)(void *ptr);
+};
+
+struct epoch_record {
+    unsigned long state;        // (epoch << 1) | active
+    unsigned long retired;      // retire calls since the last reclaim
+    struct epoch_domain *domain;
+    struct epoch_record *next;
+    struct epoch_bag bags[3];
+};
+
+struct epoch_domain {
+    unsigned long epoch;
+    pthread_mutex_t lock;       // guards @records
+    struct epoch_record *records;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    void epoch_init(struct epoch_domain *domain);
+
+    /**
+     * free everything still retired. No thread may use @domain anymore.
+     */
+    void epoch_destroy(struct epoch_domain *domain);
+
+    /**
+     * attach @record to @domain, one record per thread.
+     */
+    void epoch_register(struct epoch_domain *domain, struct epoch_record *record);
+
+    /**
+     * detach @record, waiting until its retired memory can be freed.
+     */
+    void epoch_unregister(struct epoch_record *record);
+
+    /**
+     * start a read section. Sections do not nest.
+     */
+    static inline void epoch_enter(struct epoch_record *record)
+    {
+        unsigned long epoch = __atomic_load_n(&record->domain->epoch, __ATOMIC_ACQUIRE);
+
+        __atomic_store_n(&record->state, (epoch << 1) | 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    }
+
+    static inline void epoch_exit(struct epoch_record *record)
+    {
+        __atomic_store_n(&record->state, 0, __ATOMIC_RELEASE);
+    }
+
+    /**
+     * free @ptr with @free_fn once no reader can reach it anymore.
+     * @return      0 on success, -1 when out of memory; @ptr is then
+     *              still owned by the caller.
+     */
+    int epoch_retire(struct epoch_record *record, void *ptr,
+                     void (*free_fn)(void *ptr));
+
+    /**
+     * try to advance the epoch and free what became safe.
+     */
+    void epoch_reclaim(struct epoch_record *record);
+
+    /**
+     * wait until every read section running now has finished.
+     * Must not be called inside a read section.
+     */
+    void epoch_synchronize(struct epoch_domain *domain);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
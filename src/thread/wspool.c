@@ -0,0 +1,355 @@
+/* wspool.c --- work stealing thread pool
+ *
+ * Filename: wspool.c
+ * Description: fork-join thread pool with per-worker deques
+ * Author: Werther Zhang
+ * Maintainer: Werther Zhang (peng.zhang.dev@gmail.com)
+ * Version: 0
+ * Keywords: thread pool, work stealing
+ *
+ */
+
+/* Change Log:
+ *
+ *
+ */
+
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth
+ * Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* Code: */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "wspool.h"
+
+#define WSPOOL_DEQUE_SIZE 1024  // power of two
+#define WSPOOL_SPINS 64         // failed steal rounds before sleeping
+
+/*
+ * The deques are short ring buffers guarded by a spinlock: owner and
+ * thieves only hold it for a couple of loads and stores.
+ */
+struct wspool_worker {
+    pthread_spinlock_t lock;
+    unsigned long top;          // thieves take from here
+    unsigned long bottom;       // owner pushes and pops here
+    struct wspool_task *tasks[WSPOOL_DEQUE_SIZE];
+    struct wspool *pool;
+    pthread_t thread;
+    unsigned int seed;
+} __attribute__((aligned(64)));
+
+struct wspool {
+    int nthreads;
+    int shutdown;
+    int pending;                // queued tasks, to let workers sleep
+    int sleepers;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;        // work or shutdown for sleeping workers
+    pthread_cond_t finish;      // wspool_run() completion
+    struct wspool_worker *workers;
+};
+
+static __thread struct wspool_worker *self;
+
+static int deque_push(struct wspool_worker *worker, struct wspool_task *task)
+{
+    int retval = -1;
+
+    pthread_spin_lock(&worker->lock);
+    if (worker->bottom - worker->top < WSPOOL_DEQUE_SIZE) {
+        worker->tasks[worker->bottom & (WSPOOL_DEQUE_SIZE - 1)] = task;
+        __atomic_store_n(&worker->bottom, worker->bottom + 1, __ATOMIC_RELAXED);
+        retval = 0;
+    }
+    pthread_spin_unlock(&worker->lock);
+
+    return retval;
+}
+
+static struct wspool_task *deque_pop(struct wspool_worker *worker)
+{
+    struct wspool_task *task = NULL;
+
+    pthread_spin_lock(&worker->lock);
+    if (worker->bottom != worker->top) {
+        __atomic_store_n(&worker->bottom, worker->bottom - 1, __ATOMIC_RELAXED);
+        task = worker->tasks[worker->bottom & (WSPOOL_DEQUE_SIZE - 1)];
+    }
+    pthread_spin_unlock(&worker->lock);
+
+    return task;
+}
+
+static struct wspool_task *deque_steal(struct wspool_worker *worker)
+{
+    struct wspool_task *task = NULL;
+
+    // Peek without the lock first, most victims are empty
+    if (__atomic_load_n(&worker->bottom, __ATOMIC_RELAXED)
+        == __atomic_load_n(&worker->top, __ATOMIC_RELAXED))
+        return NULL;
+
+    pthread_spin_lock(&worker->lock);
+    if (worker->bottom != worker->top) {
+        task = worker->tasks[worker->top & (WSPOOL_DEQUE_SIZE - 1)];
+        __atomic_store_n(&worker->top, worker->top + 1, __ATOMIC_RELAXED);
+    }
+    pthread_spin_unlock(&worker->lock);
+
+    return task;
+}
+
+/*
+ * @pending is raised before a task becomes visible and @sleepers before a
+ * worker checks @pending, so a push never misses a worker going to sleep.
+ */
+static int push(struct wspool *pool, struct wspool_worker *worker,
+                struct wspool_task *task)
+{
+    __atomic_add_fetch(&pool->pending, 1, __ATOMIC_SEQ_CST);
+    if (deque_push(worker, task) != 0) {
+        __atomic_sub_fetch(&pool->pending, 1, __ATOMIC_SEQ_CST);
+        return -1;
+    }
+
+    if (__atomic_load_n(&pool->sleepers, __ATOMIC_SEQ_CST) > 0) {
+        pthread_mutex_lock(&pool->mutex);
+        pthread_cond_signal(&pool->cond);
+        pthread_mutex_unlock(&pool->mutex);
+    }
+
+    return 0;
+}
+
+static void execute(struct wspool *pool, struct wspool_task *task)
+{
+    __atomic_sub_fetch(&pool->pending, 1, __ATOMIC_SEQ_CST);
+    task->fn(task->arg);
+    __atomic_store_n(&task->done, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * find one task, own deque first, then a random victim.
+ */
+static struct wspool_task *find_task(struct wspool_worker *worker)
+{
+    struct wspool *pool = worker->pool;
+    struct wspool_task *task;
+    int i, victim;
+
+    if ((task = deque_pop(worker)) != NULL)
+        return task;
+
+    victim = rand_r(&worker->seed) % pool->nthreads;
+    for (i = 0; i < pool->nthreads; i++) {
+        if ((task = deque_steal(&pool->workers[victim])) != NULL)
+            return task;
+        if (++victim == pool->nthreads)
+            victim = 0;
+    }
+
+    return NULL;
+}
+
+static void *worker_main(void *arg)
+{
+    struct wspool_worker *worker = (struct wspool_worker *)arg;
+    struct wspool *pool = worker->pool;
+    struct wspool_task *task;
+    int idle = 0;
+
+    self = worker;
+
+    for (;;) {
+        if ((task = find_task(worker)) != NULL) {
+            execute(pool, task);
+            idle = 0;
+            continue;
+        }
+
+        if (++idle < WSPOOL_SPINS) {
+            sched_yield();
+            continue;
+        }
+
+        pthread_mutex_lock(&pool->mutex);
+        __atomic_add_fetch(&pool->sleepers, 1, __ATOMIC_SEQ_CST);
+        while (!pool->shutdown && __atomic_load_n(&pool->pending, __ATOMIC_SEQ_CST) == 0)
+            pthread_cond_wait(&pool->cond, &pool->mutex);
+        __atomic_sub_fetch(&pool->sleepers, 1, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&pool->mutex);
+
+        if (pool->shutdown)
+            break;
+        idle = 0;
+    }
+
+    return NULL;
+}
+
+struct wspool *wspool_create(int nthreads)
+{
+    struct wspool *pool;
+    int i;
+
+    if (nthreads <= 0)
+        nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (nthreads <= 0)
+        nthreads = 1;
+
+    if ((pool = (struct wspool *)malloc(sizeof(struct wspool))) == NULL)
+        return NULL;
+
+    memset(pool, 0, sizeof(struct wspool));
+    if (posix_memalign((void **)&pool->workers, 64,
+                       nthreads * sizeof(struct wspool_worker)) != 0) {
+        free(pool);
+        return NULL;
+    }
+
+    pool->nthreads = nthreads;
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+    pthread_cond_init(&pool->finish, NULL);
+
+    for (i = 0; i < nthreads; i++) {
+        struct wspool_worker *worker = &pool->workers[i];
+
+        pthread_spin_init(&worker->lock, PTHREAD_PROCESS_PRIVATE);
+        worker->top = 0;
+        worker->bottom = 0;
+        worker->pool = pool;
+        worker->seed = i + 1;
+    }
+
+    for (i = 0; i < nthreads; i++) {
+        if (pthread_create(&pool->workers[i].thread, NULL, worker_main,
+                           &pool->workers[i]) != 0) {
+            pool->nthreads = i;
+            wspool_destroy(pool);
+            return NULL;
+        }
+    }
+
+    return pool;
+}
+
+void wspool_destroy(struct wspool *pool)
+{
+    int i;
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (i = 0; i < pool->nthreads; i++) {
+        pthread_join(pool->workers[i].thread, NULL);
+        pthread_spin_destroy(&pool->workers[i].lock);
+    }
+
+    pthread_cond_destroy(&pool->finish);
+    pthread_cond_destroy(&pool->cond);
+    pthread_mutex_destroy(&pool->mutex);
+    free(pool->workers);
+    free(pool);
+
+    return;
+}
+
+int wspool_size(struct wspool *pool)
+{
+    return pool->nthreads;
+}
+
+void wspool_spawn(struct wspool *pool, struct wspool_task *task)
+{
+    if (self == NULL || self->pool != pool || push(pool, self, task) != 0) {
+        task->fn(task->arg);
+        __atomic_store_n(&task->done, 1, __ATOMIC_RELEASE);
+    }
+}
+
+void wspool_sync(struct wspool *pool, struct wspool_task *task)
+{
+    struct wspool_task *other;
+
+    while (!__atomic_load_n(&task->done, __ATOMIC_ACQUIRE)) {
+        if (self != NULL && self->pool == pool
+            && (other = find_task(self)) != NULL) {
+            execute(pool, other);
+        } else {
+            sched_yield();
+        }
+    }
+}
+
+struct wspool_root {
+    struct wspool *pool;
+    void (*fn)(void *arg);
+    void *arg;
+    int finished;
+};
+
+static void run_root(void *arg)
+{
+    struct wspool_root *root = (struct wspool_root *)arg;
+
+    root->fn(root->arg);
+
+    pthread_mutex_lock(&root->pool->mutex);
+    root->finished = 1;
+    pthread_cond_broadcast(&root->pool->finish);
+    pthread_mutex_unlock(&root->pool->mutex);
+}
+
+void wspool_run(struct wspool *pool, void (*fn)(void *arg), void *arg)
+{
+    struct wspool_root root;
+    struct wspool_task task;
+
+    if (self != NULL && self->pool == pool) {
+        fn(arg);
+        return;
+    }
+
+    root.pool = pool;
+    root.fn = fn;
+    root.arg = arg;
+    root.finished = 0;
+    wspool_task_init(&task, run_root, &root);
+
+    // Any deque accepts pushes from outside, the lock makes it safe
+    while (push(pool, &pool->workers[0], &task) != 0)
+        sched_yield();
+
+    pthread_mutex_lock(&pool->mutex);
+    while (!root.finished)
+        pthread_cond_wait(&pool->finish, &pool->mutex);
+    pthread_mutex_unlock(&pool->mutex);
+
+    // The worker may still be storing task.done
+    while (!__atomic_load_n(&task.done, __ATOMIC_ACQUIRE))
+        sched_yield();
+}
+
+/* wspool.c ends here */
@@ -0,0 +1,75 @@
+#ifndef WSPOOL_H
+#define WSPOOL_H
+
+/**
+ * Small fork-join pool with one deque per worker. A worker pops its own
+ * tasks LIFO and steals FIFO from the others when it runs dry.
+ *
+ * Typical use inside a task:
+ *
+ *     struct wspool_task task;
+ *     wspool_task_init(&task, left_half, &args);
+ *     wspool_spawn(pool, &task);
+ *     right_half(&other_args);
+ *     wspool_sync(pool, &task);
+ */
+
+struct wspool;
+
+struct wspool_task {
+    void (*fn)(void *arg);
+    void *arg;
+    int done;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /**
+     * create a pool of @nthreads workers, 0 for one per online cpu.
+     * @return      the pool or NULL on failure.
+     */
+    struct wspool *wspool_create(int nthreads);
+
+    /**
+     * stop all workers and free the pool. No task may be running.
+     */
+    void wspool_destroy(struct wspool *pool);
+
+    /**
+     * number of workers in @pool.
+     */
+    int wspool_size(struct wspool *pool);
+
+    static inline void wspool_task_init(struct wspool_task *task,
+                                        void (*fn)(void *arg), void *arg)
+    {
+        task->fn = fn;
+        task->arg = arg;
+        task->done = 0;
+    }
+
+    /**
+     * make @task available to other workers. Called outside of a worker of
+     * @pool, or when the local deque is full, @task runs right away.
+     */
+    void wspool_spawn(struct wspool *pool, struct wspool_task *task);
+
+    /**
+     * wait for @task, running other tasks in the meantime.
+     */
+    void wspool_sync(struct wspool *pool, struct wspool_task *task);
+
+    /**
+     * run @fn(@arg) on a worker of @pool and wait for it, including every
+     * task it spawns and syncs. This is the entry point for threads which
+     * do not belong to the pool.
+     */
+    void wspool_run(struct wspool *pool, void (*fn)(void *arg), void *arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
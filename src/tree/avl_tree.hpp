@@ -0,0 +1,578 @@
+/* avl_tree.hpp --- header-only AVL tree template
+ *
+ * Filename: avl_tree.hpp
+ * Description: AVL tree with inline keys/values and a compile-time comparator
+ * Author: Werther Zhang
+ * Maintainer: Werther Zhang (peng.zhang.dev@gmail.com)
+ * Version: 0
+ * Keywords: AVL tree, template
+ *
+ */
+
+/* Change Log:
+ *
+ *
+ */
+
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth
+ * Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* Code: */
+
+#ifndef AVL_TREE_HPP
+#define AVL_TREE_HPP
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace alg {
+
+/**
+ * avl_tree is the C++ counterpart of BisTree (bistree.h).
+ *
+ * It uses the same balance factors (AVL_LET_HEAVY/AVL_BALANCED/AVL_RGT_HEAVY)
+ * and the same LL/LR, RR/RL rotations as bistree.c, but keys and values live
+ * inside the node and @Compare is a type, so comparisons are inlined instead
+ * of going through tree->compare.
+ *
+ * @Key         key type, stored inline.
+ * @Value       mapped type, stored inline; may be move-only.
+ * @Compare     strict weak ordering on Key. If Compare::is_transparent is
+ *              defined, find/contains/erase accept any type comparable
+ *              with Key (heterogeneous lookup).
+ * @Allocator   allocator of std::pair<const Key, Value>, rebound to nodes.
+ */
+template <class Key, class Value,
+          class Compare = std::less<Key>,
+          class Allocator = std::allocator<std::pair<const Key, Value> > >
+class avl_tree {
+public:
+    typedef Key key_type;
+    typedef Value mapped_type;
+    typedef std::pair<const Key, Value> value_type;
+    typedef Compare key_compare;
+    typedef Allocator allocator_type;
+    typedef std::size_t size_type;
+
+private:
+    enum {
+        RGT_HEAVY = -1,
+        BALANCED = 0,
+        LET_HEAVY = 1,
+    };
+
+    struct node {
+        node *left;
+        node *right;
+        int factor;
+        value_type kv;
+
+        template <class K, class... Args>
+        node(K &&key, Args &&... args)
+            : left(nullptr), right(nullptr), factor(BALANCED),
+              kv(std::piecewise_construct,
+                 std::forward_as_tuple(std::forward<K>(key)),
+                 std::forward_as_tuple(std::forward<Args>(args)...)) {}
+    };
+
+    /* Without Compare::is_transparent, lookups convert the argument to Key once. */
+    template <class C, class = void>
+    struct transparent : std::false_type {};
+
+    template <class C>
+    struct transparent<C, typename std::conditional<true, void, typename C::is_transparent>::type>
+        : std::true_type {};
+
+    template <class K>
+    struct lookup_key {
+        typedef typename std::conditional<transparent<Compare>::value, K, Key>::type type;
+    };
+
+    typedef typename std::allocator_traits<Allocator>::template rebind_alloc<node> node_allocator;
+    typedef std::allocator_traits<node_allocator> node_traits;
+
+    /* Empty comparator/allocator cost nothing thanks to EBO on this pair. */
+    struct impl : Compare, node_allocator {
+        node *root;
+        size_type size;
+
+        impl(const Compare &c, const node_allocator &a)
+            : Compare(c), node_allocator(a), root(nullptr), size(0) {}
+    } m_;
+
+public:
+    explicit avl_tree(const Compare &comp = Compare(),
+                      const Allocator &alloc = Allocator())
+        : m_(comp, node_allocator(alloc)) {}
+
+    avl_tree(const avl_tree &) = delete;
+    avl_tree &operator=(const avl_tree &) = delete;
+
+    avl_tree(avl_tree &&other) noexcept
+        : m_(other.cmp(), other.alloc())
+    {
+        m_.root = other.m_.root;
+        m_.size = other.m_.size;
+        other.m_.root = nullptr;
+        other.m_.size = 0;
+    }
+
+    ~avl_tree() { clear(); }
+
+    size_type size() const { return m_.size; }
+    bool empty() const { return m_.size == 0; }
+
+    void clear()
+    {
+        destroy(m_.root);
+        m_.root = nullptr;
+        m_.size = 0;
+    }
+
+    /**
+     * insert (@key, @value).
+     * @return      pointer to the mapped value in the tree and true if it was
+     *              inserted, false if @key was already present (the tree is
+     *              left unchanged, same as bistree_insert returning 1).
+     */
+    std::pair<Value *, bool> insert(const Key &key, Value value)
+    {
+        return emplace(key, std::move(value));
+    }
+
+    std::pair<Value *, bool> insert(Key &&key, Value value)
+    {
+        return emplace(std::move(key), std::move(value));
+    }
+
+    /**
+     * construct the mapped value in place from @args.
+     * Nothing is constructed when @key is already present.
+     */
+    template <class K, class... Args>
+    std::pair<Value *, bool> emplace(K &&key, Args &&... args)
+    {
+        bool balanced = false;
+        node *where = nullptr;
+        bool inserted = insert(m_.root, key, where, balanced,
+                               std::forward<K>(key), std::forward<Args>(args)...);
+        if (inserted)
+            m_.size++;
+        return std::pair<Value *, bool>(&where->kv.second, inserted);
+    }
+
+    template <class K>
+    Value *find(const K &key)
+    {
+        const typename lookup_key<K>::type &k = key;
+        node *n = lookup(k);
+        return n ? &n->kv.second : nullptr;
+    }
+
+    template <class K>
+    const Value *find(const K &key) const
+    {
+        const typename lookup_key<K>::type &k = key;
+        const node *n = lookup(k);
+        return n ? &n->kv.second : nullptr;
+    }
+
+    template <class K>
+    bool contains(const K &key) const
+    {
+        const typename lookup_key<K>::type &k = key;
+        return lookup(k) != nullptr;
+    }
+
+    /**
+     * remove @key and destroy its node.
+     * @return      true if @key was present.
+     */
+    template <class K>
+    bool erase(const K &key)
+    {
+        const typename lookup_key<K>::type &k = key;
+        bool shorter = false;
+        if (!erase(m_.root, k, shorter))
+            return false;
+        m_.size--;
+        return true;
+    }
+
+    /**
+     * call @fn(const Key &, Value &) for every element in key order.
+     */
+    template <class F>
+    void for_each(F &&fn)
+    {
+        walk(m_.root, fn);
+    }
+
+    template <class F>
+    void for_each(F &&fn) const
+    {
+        walk(static_cast<const node *>(m_.root), fn);
+    }
+
+    /**
+     * for_each() which stops once @fn returns true.
+     * @return      number of visited elements, the last one included.
+     */
+    template <class F>
+    size_type for_each_until(F &&fn)
+    {
+        size_type count = 0;
+        walk_until(m_.root, fn, count);
+        return count;
+    }
+
+private:
+    const Compare &cmp() const { return m_; }
+    node_allocator &alloc() { return m_; }
+
+    template <class A, class B>
+    bool less(const A &a, const B &b) const { return cmp()(a, b); }
+
+    template <class K>
+    node *lookup(const K &key) const
+    {
+        node *n = m_.root;
+        while (n != nullptr) {
+            if (less(key, n->kv.first))
+                n = n->left;
+            else if (less(n->kv.first, key))
+                n = n->right;
+            else
+                return n;
+        }
+        return nullptr;
+    }
+
+    template <class... Args>
+    node *make_node(Args &&... args)
+    {
+        node *n = node_traits::allocate(alloc(), 1);
+        try {
+            node_traits::construct(alloc(), n, std::forward<Args>(args)...);
+        } catch (...) {
+            node_traits::deallocate(alloc(), n, 1);
+            throw;
+        }
+        return n;
+    }
+
+    void drop_node(node *n)
+    {
+        node_traits::destroy(alloc(), n);
+        node_traits::deallocate(alloc(), n, 1);
+    }
+
+    void destroy(node *n)
+    {
+        while (n != nullptr) {
+            destroy(n->right);
+            node *left = n->left;
+            drop_node(n);
+            n = left;
+        }
+    }
+
+    template <class N, class F>
+    static void walk(N *n, F &fn)
+    {
+        while (n != nullptr) {
+            walk(n->left, fn);
+            fn(n->kv.first, n->kv.second);
+            n = n->right;
+        }
+    }
+
+    template <class N, class F>
+    static bool walk_until(N *n, F &fn, size_type &count)
+    {
+        while (n != nullptr) {
+            if (walk_until(n->left, fn, count))
+                return true;
+            count++;
+            if (fn(n->kv.first, n->kv.second))
+                return true;
+            n = n->right;
+        }
+        return false;
+    }
+
+    /* rotate_left: the left subtree of @n is two levels taller (LL/LR). */
+    static void rotate_left(node *&n)
+    {
+        node *left = n->left;
+
+        if (left->factor == LET_HEAVY) {
+            n->left = left->right;
+            left->right = n;
+            n->factor = BALANCED;
+            left->factor = BALANCED;
+            n = left;
+        } else {
+            node *grandchild = left->right;
+            left->right = grandchild->left;
+            grandchild->left = left;
+            n->left = grandchild->right;
+            grandchild->right = n;
+
+            switch (grandchild->factor) {
+            case LET_HEAVY:
+                n->factor = RGT_HEAVY;
+                left->factor = BALANCED;
+                break;
+            case BALANCED:
+                n->factor = BALANCED;
+                left->factor = BALANCED;
+                break;
+            case RGT_HEAVY:
+                n->factor = BALANCED;
+                left->factor = LET_HEAVY;
+                break;
+            }
+
+            grandchild->factor = BALANCED;
+            n = grandchild;
+        }
+    }
+
+    /* rotate_right: the right subtree of @n is two levels taller (RR/RL). */
+    static void rotate_right(node *&n)
+    {
+        node *right = n->right;
+
+        if (right->factor == RGT_HEAVY) {
+            n->right = right->left;
+            right->left = n;
+            n->factor = BALANCED;
+            right->factor = BALANCED;
+            n = right;
+        } else {
+            node *grandchild = right->left;
+            right->left = grandchild->right;
+            grandchild->right = right;
+            n->right = grandchild->left;
+            grandchild->left = n;
+
+            switch (grandchild->factor) {
+            case LET_HEAVY:
+                n->factor = BALANCED;
+                right->factor = RGT_HEAVY;
+                break;
+            case BALANCED:
+                n->factor = BALANCED;
+                right->factor = BALANCED;
+                break;
+            case RGT_HEAVY:
+                n->factor = LET_HEAVY;
+                right->factor = BALANCED;
+                break;
+            }
+
+            grandchild->factor = BALANCED;
+            n = grandchild;
+        }
+    }
+
+    /*
+     * Same recursion as insert() in bistree.c; @balanced turns true once the
+     * height of the subtree stops changing on the way back up.
+     */
+    template <class K, class KeyArg, class... Args>
+    bool insert(node *&n, const K &key, node *&where, bool &balanced,
+                KeyArg &&key_arg, Args &&... args)
+    {
+        if (n == nullptr) {
+            n = make_node(std::forward<KeyArg>(key_arg), std::forward<Args>(args)...);
+            where = n;
+            return true;
+        }
+
+        if (less(key, n->kv.first)) {
+            if (!insert(n->left, key, where, balanced,
+                        std::forward<KeyArg>(key_arg), std::forward<Args>(args)...))
+                return false;
+
+            if (!balanced) {
+                switch (n->factor) {
+                case LET_HEAVY:
+                    rotate_left(n);
+                    balanced = true;
+                    break;
+                case BALANCED:
+                    n->factor = LET_HEAVY;
+                    break;
+                case RGT_HEAVY:
+                    n->factor = BALANCED;
+                    balanced = true;
+                    break;
+                }
+            }
+        } else if (less(n->kv.first, key)) {
+            if (!insert(n->right, key, where, balanced,
+                        std::forward<KeyArg>(key_arg), std::forward<Args>(args)...))
+                return false;
+
+            if (!balanced) {
+                switch (n->factor) {
+                case LET_HEAVY:
+                    n->factor = BALANCED;
+                    balanced = true;
+                    break;
+                case BALANCED:
+                    n->factor = RGT_HEAVY;
+                    break;
+                case RGT_HEAVY:
+                    rotate_right(n);
+                    balanced = true;
+                    break;
+                }
+            }
+        } else {
+            where = n;
+            balanced = true;
+            return false;
+        }
+
+        return true;
+    }
+
+    /*
+     * The left subtree of @n became one level shorter.
+     * @shorter stays true while the height of @n keeps shrinking.
+     */
+    static void left_shrunk(node *&n, bool &shorter)
+    {
+        switch (n->factor) {
+        case LET_HEAVY:
+            n->factor = BALANCED;
+            break;
+        case BALANCED:
+            n->factor = RGT_HEAVY;
+            shorter = false;
+            break;
+        case RGT_HEAVY:
+            if (n->right->factor == BALANCED) {
+                // RR rotation which does not change the height.
+                node *right = n->right;
+                n->right = right->left;
+                right->left = n;
+                n->factor = RGT_HEAVY;
+                right->factor = LET_HEAVY;
+                n = right;
+                shorter = false;
+            } else {
+                rotate_right(n);
+            }
+            break;
+        }
+    }
+
+    static void right_shrunk(node *&n, bool &shorter)
+    {
+        switch (n->factor) {
+        case RGT_HEAVY:
+            n->factor = BALANCED;
+            break;
+        case BALANCED:
+            n->factor = LET_HEAVY;
+            shorter = false;
+            break;
+        case LET_HEAVY:
+            if (n->left->factor == BALANCED) {
+                // LL rotation which does not change the height.
+                node *left = n->left;
+                n->left = left->right;
+                left->right = n;
+                n->factor = LET_HEAVY;
+                left->factor = RGT_HEAVY;
+                n = left;
+                shorter = false;
+            } else {
+                rotate_left(n);
+            }
+            break;
+        }
+    }
+
+    /* unlink the smallest node of @n and return it. */
+    static node *detach_min(node *&n, bool &shorter)
+    {
+        if (n->left == nullptr) {
+            node *min = n;
+            n = n->right;
+            shorter = true;
+            return min;
+        }
+
+        node *min = detach_min(n->left, shorter);
+        if (shorter)
+            left_shrunk(n, shorter);
+        return min;
+    }
+
+    template <class K>
+    bool erase(node *&n, const K &key, bool &shorter)
+    {
+        if (n == nullptr)
+            return false;
+
+        if (less(key, n->kv.first)) {
+            if (!erase(n->left, key, shorter))
+                return false;
+            if (shorter)
+                left_shrunk(n, shorter);
+        } else if (less(n->kv.first, key)) {
+            if (!erase(n->right, key, shorter))
+                return false;
+            if (shorter)
+                right_shrunk(n, shorter);
+        } else {
+            node *old = n;
+
+            if (n->left == nullptr || n->right == nullptr) {
+                n = n->left != nullptr ? n->left : n->right;
+                shorter = true;
+            } else {
+                // Relink the successor in place of @old so values never move.
+                node *succ = detach_min(old->right, shorter);
+                succ->left = old->left;
+                succ->right = old->right;
+                succ->factor = old->factor;
+                n = succ;
+                if (shorter)
+                    right_shrunk(n, shorter);
+            }
+
+            drop_node(old);
+        }
+
+        return true;
+    }
+};
+
+} // namespace alg
+
+#endif
+
+/* avl_tree.hpp ends here */
@@ -42,13 +42,60 @@
 #include <string.h>
 #include <stdlib.h>
 #include "bistree.h"
+#include "../thread/wspool.h"
+
+/*
+ * Nodes of an interval tree carry the largest high endpoint of their
+ * subtree, hidden nodes excluded.
+ */
+typedef struct IntervalNode_ {
+    AvlNode avl;
+    int64_t max;
+} IntervalNode;
+
+#define interval_node(node) ((IntervalNode *)bitree_data(node))
 
 static void destroy_right(BisTree *tree, BiTreeNode *node);
 
+static void update_max(BisTreeInterval *itree, BiTreeNode *node)
+{
+    IntervalNode *inode = interval_node(node);
+    int64_t max = inode->avl.hidden ? INT64_MIN : itree->high(inode->avl.data);
+
+    if (bitree_left(node) != NULL && interval_node(bitree_left(node))->max > max)
+        max = interval_node(bitree_left(node))->max;
+    if (bitree_right(node) != NULL && interval_node(bitree_right(node))->max > max)
+        max = interval_node(bitree_right(node))->max;
+
+    inode->max = max;
+}
+
+static AvlNode *avl_alloc(BisTreeInterval *itree, const void *data)
+{
+    AvlNode *avl_data;
+
+    if (itree != NULL) {
+        IntervalNode *inode = (IntervalNode *)malloc(sizeof(IntervalNode));
+
+        if (inode == NULL)
+            return NULL;
+        inode->max = itree->high(data);
+        avl_data = &inode->avl;
+    } else if ((avl_data = (AvlNode *)malloc(sizeof(AvlNode))) == NULL) {
+        return NULL;
+    }
+
+    avl_data->factor = AVL_BALANCED;
+    avl_data->hidden = 0;
+    avl_data->data = (void *)data;
+
+    return avl_data;
+}
+
 /**
  * rotate_left : LL/LR
  */
-static void rotate_left(BiTreeNode **node)
+static void rotate_left(BisTreeInterval *itree, BiTreeNode **node)
 {
     BiTreeNode *left, *grandchild;
     left = bitree_left(*node);
@@ -59,6 +106,10 @@ static void rotate_left(BiTreeNode **node)
         bitree_right(left) = *node;
         ((AvlNode *)bitree_data(*node))->factor = AVL_BALANCED;
         ((AvlNode *)bitree_data(left))->factor = AVL_BALANCED;
+        if (itree != NULL) {
+            update_max(itree, *node);
+            update_max(itree, left);
+        }
         *node = left;
     } else {
         // Perform an LR rotation;
@@ -74,24 +125,29 @@ static void rotate_left(BiTreeNode **node)
             ((AvlNode *)bitree_data(left))->factor = AVL_BALANCED;
             break;
         case AVL_BALANCED:
-            ((AvlNode *)bitree_node(*node))->factor = (int)AVL_BALANCED;
-            ((AvlNode *)bitree_node(left))->factor = (int)AVL_BALANCED;
+            ((AvlNode *)bitree_data(*node))->factor = (int)AVL_BALANCED;
+            ((AvlNode *)bitree_data(left))->factor = (int)AVL_BALANCED;
             break;
 
         case AVL_RGT_HEAVY:
-            ((AvlNode *)bitree_node(*node))->factor = AVL_BALANCED;
-            ((AvlNode *)bitree_node(left))->factor = AVL_LET_HEAVY;
+            ((AvlNode *)bitree_data(*node))->factor = AVL_BALANCED;
+            ((AvlNode *)bitree_data(left))->factor = AVL_LET_HEAVY;
             break;
         }
 
-        ((AvlNode *)bitree_node(grandchild))->factor = AVL_BALANCED;
+        ((AvlNode *)bitree_data(grandchild))->factor = AVL_BALANCED;
+        if (itree != NULL) {
+            update_max(itree, *node);
+            update_max(itree, left);
+            update_max(itree, grandchild);
+        }
         *node = grandchild;
     }
 
     return ;
 }
 
-static void rotate_right(BiTreeNode **node)
+static void rotate_right(BisTreeInterval *itree, BiTreeNode **node)
 {
     BiTreeNode *right, *grandchild;
     right = bitree_right(*node);
@@ -102,6 +158,10 @@ static void rotate_right(BiTreeNode **node)
         bitree_left(right) = *node;
         ((AvlNode *)bitree_data(*node))->factor = AVL_BALANCED;
         ((AvlNode *)bitree_data(right))->factor = AVL_BALANCED;
+        if (itree != NULL) {
+            update_max(itree, *node);
+            update_max(itree, right);
+        }
         *node = right;
     } else {
         // perform an RL rotation
@@ -114,21 +174,26 @@ static void rotate_right(BiTreeNode **node)
         switch(((AvlNode *)bitree_data(grandchild))->factor) {
         case AVL_LET_HEAVY:
             ((AvlNode *)bitree_data(*node))->factor = AVL_BALANCED;
-            ((AvlNode *)bitree_node(right))->factor = AVL_RGT_HEAVY;
+            ((AvlNode *)bitree_data(right))->factor = AVL_RGT_HEAVY;
             break;
 
         case AVL_BALANCED:
             ((AvlNode *)bitree_data(*node))->factor = AVL_BALANCED;
-            ((AvlNode *)bitree_node(right))->factor = AVL_BALANCED;
+            ((AvlNode *)bitree_data(right))->factor = AVL_BALANCED;
             break;
 
         case AVL_RGT_HEAVY:
-            ((AvlNode *)bitree_data(*node))->factor = AVL_BALANCED;
-            ((AvlNode *)bitree_node(right))->factor = AVL_LET_HEAVY;
+            ((AvlNode *)bitree_data(*node))->factor = AVL_LET_HEAVY;
+            ((AvlNode *)bitree_data(right))->factor = AVL_BALANCED;
             break;
         }
 
         ((AvlNode *)bitree_data(grandchild))->factor = AVL_BALANCED;
+        if (itree != NULL) {
+            update_max(itree, *node);
+            update_max(itree, right);
+            update_max(itree, grandchild);
+        }
         *node = grandchild;
     }
 
@@ -199,31 +264,24 @@ static void destroy_right(BisTree *tree, BiTreeNode *node)
     return;
 }
 
-static int insert(BisTree *tree, BiTreeNode **node,
+static int insert(BisTree *tree, BisTreeInterval *itree, BiTreeNode **node,
                   const void *data, int *balanced)
 {
     AvlNode *avl_data;
     int cmpval, retval;
 
     if (bitree_is_eob(*node)) {
-        if ((avl_data = (AvlNode *)malloc(sizeof(AvlNode))) == NULL)
+        if ((avl_data = avl_alloc(itree, data)) == NULL)
             return -1;
 
-        avl_data->factor = AVL_BALANCED;
-        avl_data->hidden = 0;
-        avl_data->data = (void *)data;
-
         return bitree_ins_left_data(tree, *node, avl_data);
     } else {
         cmpval = tree->compare(data, ((AvlNode *)bitree_data(*node))->data);
         if (cmpval < 0) {
             // Move to the left
             if (bitree_is_eob(bitree_left(*node))) {
-                if ((avl_data = (AvlNode *)malloc(sizeof(AvlNode))) == NULL)
+                if ((avl_data = avl_alloc(itree, data)) == NULL)
                     return -1;
-                avl_data->factor = AVL_BALANCED;
-                avl_data->hidden = 0;
-                avl_data->data = (void *)data;
 
                 if (bitree_ins_left_data(tree, *node, avl_data) != 0) {
                     return -1;
@@ -231,7 +289,7 @@ static int insert(BisTree *tree, BiTreeNode **node,
 
                 *balanced = 0;
             } else {
-                if ((retval = insert(tree, &bitree_left(*node), data, balanced)) != 0) {
+                if ((retval = insert(tree, itree, &bitree_left(*node), data, balanced)) != 0) {
                     return retval;
                 }
             }
@@ -240,7 +298,7 @@ static int insert(BisTree *tree, BiTreeNode **node,
             if (!(*balanced)) {
                 switch (((AvlNode *)bitree_data(*node))->factor) {
                 case AVL_LET_HEAVY:
-                    rotate_left(node);
+                    rotate_left(itree, node);
                     *balanced = 1;
                     break;
 
@@ -258,28 +316,23 @@ static int insert(BisTree *tree, BiTreeNode **node,
             // Move to the right
 
             if (bitree_is_eob(bitree_right(*node))) {
-                if ((avl_data = (AvlNode *)malloc(sizeof(AvlNode))) == NULL) {
+                if ((avl_data = avl_alloc(itree, data)) == NULL) {
                     return -1;
                 }
 
-
-                avl_data->factor = AVL_BALANCED;
-                avl_data->hidden = 0;
-                avl_data->data = (void *)data;
-
                 if (bitree_ins_right_data(tree, *node, avl_data) != 0)
                     return -1;
 
                 *balanced = 0;
             }
             else {
-                if ((retval = insert(tree, &bitree_right(*node), data, balanced)) != 0)
+                if ((retval = insert(tree, itree, &bitree_right(*node), data, balanced)) != 0)
                     return retval;
             }
 
             // Ensure that the tree remains balanced
             if (!(*balanced)) {
-                switch(((AvlNode *)bitree_data(*node))->factor = AVL_BALANCED) {
+                switch(((AvlNode *)bitree_data(*node))->factor) {
                 case AVL_LET_HEAVY:
                     ((AvlNode *)bitree_data(*node))->factor = AVL_BALANCED;
                     *balanced = 1;
@@ -290,7 +343,7 @@ static int insert(BisTree *tree, BiTreeNode **node,
                     break;
 
                 case AVL_RGT_HEAVY:
-                    rotate_right(node);
+                    rotate_right(itree, node);
                     *balanced = 1;
                 }
             }
@@ -315,10 +368,15 @@ static int insert(BisTree *tree, BiTreeNode **node,
         }
     }
 
+    // The subtree gained an endpoint, maybe also a new root
+    if (itree != NULL)
+        update_max(itree, *node);
+
     return 0;
 }
 
-static int hide(BisTree *tree, BiTreeNode *node, const void *data)
+static int hide(BisTree *tree, BisTreeInterval *itree, BiTreeNode *node,
+                const void *data)
 {
     int cmpval, retval;
 
@@ -327,13 +385,13 @@ static int hide(BisTree *tree, BiTreeNode *node, const void *data)
     }
 
     cmpval = tree->compare(data, ((AvlNode *)bitree_data(node))->data);
-    if (cmpval > 0) {
+    if (cmpval < 0) {
         // Move to the left
-        retval = hide(tree, bitree_left(node), data);
+        retval = hide(tree, itree, bitree_left(node), data);
     }
     else if (cmpval > 0) {
         // Move to the right
-        retval = hide(tree, bitree_right(node), data);
+        retval = hide(tree, itree, bitree_right(node), data);
     }
     else {
         // Mark the node as hidden
@@ -341,6 +399,9 @@ static int hide(BisTree *tree, BiTreeNode *node, const void *data)
         retval = 0;
     }
 
+    if (retval == 0 && itree != NULL)
+        update_max(itree, node);
+
     return retval;
 }
 
@@ -376,6 +437,721 @@ static int lookup(BisTree *tree, BiTreeNode *node, void **data)
     return retval;
 }
 
+/**
+ * visit the live intervals of @node overlapping [@lo, @hi) in key order.
+ * @return      non-zero once @visit asked to stop.
+ */
+static int overlap(BisTreeInterval *itree, BiTreeNode *node, int64_t lo, int64_t hi,
+                   int (*visit)(void *data, void *ctx), void *ctx, int *count)
+{
+    AvlNode *avl_data;
+
+    // Nothing below ends after @lo
+    if (bitree_is_eob(node) || interval_node(node)->max <= lo)
+        return 0;
+
+    if (overlap(itree, bitree_left(node), lo, hi, visit, ctx, count) != 0)
+        return 1;
+
+    // Keys are ordered by low, the right subtree starts even later
+    avl_data = (AvlNode *)bitree_data(node);
+    if (itree->low(avl_data->data) >= hi)
+        return 0;
+
+    if (!avl_data->hidden && itree->high(avl_data->data) > lo) {
+        (*count)++;
+        if (visit(avl_data->data, ctx) != 0)
+            return 1;
+    }
+
+    return overlap(itree, bitree_right(node), lo, hi, visit, ctx, count);
+}
+
+/*
+ * Join based set operations.
+ *
+ * join/split need subtree heights; they are not stored, but a height is
+ * known at the root and each child height follows from the balance factor,
+ * so every helper takes the height of the subtree it is handed.
+ */
+
+#define avl_node(node) ((AvlNode *)bitree_data(node))
+
+/*
+ * Parallel versions fork while both inputs of a recursive step are at
+ * least this high, i.e. hold a few thousand nodes.
+ */
+#define BISTREE_PAR_HEIGHT 12
+#define BISTREE_PAR_GRAIN 4096
+
+struct setop {
+    BisTree *t1;
+    BisTree *t2;
+    struct wspool *pool;        // NULL for the sequential versions
+    int dropped;                // nodes released while combining
+};
+
+typedef BiTreeNode *(*setop_fn)(struct setop *op, BiTreeNode *n1, int h1,
+                                BiTreeNode *n2, int h2, int *height);
+
+static int tree_height(BiTreeNode *node)
+{
+    int height = 0;
+
+    while (node != NULL) {
+        height++;
+        node = avl_node(node)->factor == AVL_RGT_HEAVY ?
+            bitree_right(node) : bitree_left(node);
+    }
+
+    return height;
+}
+
+static void child_heights(BiTreeNode *node, int height, int *hl, int *hr)
+{
+    *hl = *hr = height - 1;
+    if (avl_node(node)->factor == AVL_LET_HEAVY)
+        (*hr)--;
+    else if (avl_node(node)->factor == AVL_RGT_HEAVY)
+        (*hl)--;
+}
+
+static BiTreeNode *new_node(const void *data)
+{
+    BiTreeNode *node;
+    AvlNode *avl_data;
+
+    if ((avl_data = (AvlNode *)malloc(sizeof(AvlNode))) == NULL)
+        return NULL;
+
+    if (bitree_node_init(&node, avl_data) != 0) {
+        free(avl_data);
+        return NULL;
+    }
+
+    avl_data->factor = AVL_BALANCED;
+    avl_data->hidden = 0;
+    avl_data->data = (void *)data;
+
+    return node;
+}
+
+static void drop_node(BisTree *tree, BiTreeNode *node, struct setop *op)
+{
+    if (tree->destroy != NULL)
+        tree->destroy(avl_node(node)->data);
+
+    free(bitree_data(node));
+    free(node);
+    op->dropped++;
+}
+
+static void drop_tree(BisTree *tree, BiTreeNode *node, struct setop *op)
+{
+    BiTreeNode *left;
+
+    while (node != NULL) {
+        drop_tree(tree, bitree_right(node), op);
+        left = bitree_left(node);
+        drop_node(tree, node, op);
+        node = left;
+    }
+}
+
+/**
+ * make @node the parent of @left and @right, whose heights differ by at
+ * most one.
+ */
+static BiTreeNode *link(BiTreeNode *left, int hl, BiTreeNode *node,
+                        BiTreeNode *right, int hr, int *height)
+{
+    bitree_left(node) = left;
+    bitree_right(node) = right;
+    avl_node(node)->factor = hl - hr;
+    *height = (hl > hr ? hl : hr) + 1;
+
+    return node;
+}
+
+/**
+ * like link(), but the heights of @left and @right may differ by two.
+ */
+static BiTreeNode *balance(BiTreeNode *left, int hl, BiTreeNode *node,
+                           BiTreeNode *right, int hr, int *height)
+{
+    BiTreeNode *grandchild;
+    int h1, h2, h3, h4;
+
+    if (hr > hl + 1) {
+        child_heights(right, hr, &h1, &h2);
+        if (h2 >= h1) {
+            // RR rotation
+            node = link(left, hl, node, bitree_left(right), h1, &h3);
+            return link(node, h3, right, bitree_right(right), h2, height);
+        }
+
+        // RL rotation
+        grandchild = bitree_left(right);
+        child_heights(grandchild, h1, &h3, &h4);
+        node = link(left, hl, node, bitree_left(grandchild), h3, &h3);
+        right = link(bitree_right(grandchild), h4, right, bitree_right(right), h2, &h4);
+        return link(node, h3, grandchild, right, h4, height);
+    }
+
+    if (hl > hr + 1) {
+        child_heights(left, hl, &h1, &h2);
+        if (h1 >= h2) {
+            // LL rotation
+            node = link(bitree_right(left), h2, node, right, hr, &h3);
+            return link(bitree_left(left), h1, left, node, h3, height);
+        }
+
+        // LR rotation
+        grandchild = bitree_right(left);
+        child_heights(grandchild, h2, &h3, &h4);
+        left = link(bitree_left(left), h1, left, bitree_left(grandchild), h3, &h3);
+        node = link(bitree_right(grandchild), h4, node, right, hr, &h4);
+        return link(left, h3, grandchild, node, h4, height);
+    }
+
+    return link(left, hl, node, right, hr, height);
+}
+
+static BiTreeNode *join_right(BiTreeNode *left, int hl, BiTreeNode *node,
+                              BiTreeNode *right, int hr, int *height)
+{
+    BiTreeNode *tree;
+    int h1, h2, h3;
+
+    child_heights(left, hl, &h1, &h2);
+    if (h2 <= hr + 1)
+        tree = link(bitree_right(left), h2, node, right, hr, &h3);
+    else
+        tree = join_right(bitree_right(left), h2, node, right, hr, &h3);
+
+    return balance(bitree_left(left), h1, left, tree, h3, height);
+}
+
+static BiTreeNode *join_left(BiTreeNode *left, int hl, BiTreeNode *node,
+                             BiTreeNode *right, int hr, int *height)
+{
+    BiTreeNode *tree;
+    int h1, h2, h3;
+
+    child_heights(right, hr, &h1, &h2);
+    if (h1 <= hl + 1)
+        tree = link(left, hl, node, bitree_left(right), h1, &h3);
+    else
+        tree = join_left(left, hl, node, bitree_left(right), h1, &h3);
+
+    return balance(tree, h3, right, bitree_right(right), h2, height);
+}
+
+/**
+ * join @left, @node and @right, all keys in @left are smaller than @node
+ * and all keys in @right are bigger. O(|hl - hr|).
+ */
+static BiTreeNode *join(BiTreeNode *left, int hl, BiTreeNode *node,
+                        BiTreeNode *right, int hr, int *height)
+{
+    if (hl > hr + 1)
+        return join_right(left, hl, node, right, hr, height);
+    if (hr > hl + 1)
+        return join_left(left, hl, node, right, hr, height);
+
+    return link(left, hl, node, right, hr, height);
+}
+
+/**
+ * detach the biggest node of @node, the rest is returned through @rest.
+ */
+static BiTreeNode *split_last(BiTreeNode *node, int height,
+                              BiTreeNode **rest, int *hrest)
+{
+    BiTreeNode *last, *right;
+    int hl, hr;
+
+    child_heights(node, height, &hl, &hr);
+    if (bitree_is_eob(bitree_right(node))) {
+        *rest = bitree_left(node);
+        *hrest = hl;
+        return node;
+    }
+
+    last = split_last(bitree_right(node), hr, &right, &hr);
+    *rest = join(bitree_left(node), hl, node, right, hr, hrest);
+
+    return last;
+}
+
+/**
+ * join two trees without a middle node.
+ */
+static BiTreeNode *join2(BiTreeNode *left, int hl, BiTreeNode *right, int hr,
+                         int *height)
+{
+    BiTreeNode *last;
+
+    if (bitree_is_eob(left)) {
+        *height = hr;
+        return right;
+    }
+
+    last = split_last(left, hl, &left, &hl);
+    return join(left, hl, last, right, hr, height);
+}
+
+/**
+ * split @node into the keys smaller and bigger than @data.
+ * @return      the node equal to @data (hidden or not), or NULL.
+ */
+static BiTreeNode *split(BisTree *tree, BiTreeNode *node, int height,
+                         const void *data, BiTreeNode **left, int *hl,
+                         BiTreeNode **right, int *hr)
+{
+    BiTreeNode *found, *child;
+    int h1, h2, cmpval;
+
+    if (bitree_is_eob(node)) {
+        *left = *right = NULL;
+        *hl = *hr = 0;
+        return NULL;
+    }
+
+    child_heights(node, height, &h1, &h2);
+    cmpval = tree->compare(data, avl_node(node)->data);
+    if (cmpval == 0) {
+        *left = bitree_left(node);
+        *hl = h1;
+        *right = bitree_right(node);
+        *hr = h2;
+        return node;
+    }
+
+    if (cmpval < 0) {
+        child = bitree_right(node);
+        found = split(tree, bitree_left(node), h1, data, left, hl, right, hr);
+        *right = join(*right, *hr, node, child, h2, hr);
+    } else {
+        child = bitree_left(node);
+        found = split(tree, bitree_right(node), h2, data, left, hl, right, hr);
+        *left = join(child, h1, node, *left, *hl, hl);
+    }
+
+    return found;
+}
+
+struct setop_half {
+    struct setop op;
+    setop_fn fn;
+    BiTreeNode *n1;
+    BiTreeNode *n2;
+    int h1;
+    int h2;
+    BiTreeNode *root;
+    int height;
+};
+
+static void setop_half_run(void *arg)
+{
+    struct setop_half *half = (struct setop_half *)arg;
+
+    half->root = half->fn(&half->op, half->n1, half->h1, half->n2, half->h2,
+                          &half->height);
+}
+
+/**
+ * combine the left halves and the right halves of a recursive step,
+ * forking the left one onto the pool when both inputs are big enough.
+ */
+static void recurse(struct setop *op, setop_fn fn,
+                    BiTreeNode *l1, int hl1, BiTreeNode *l2, int hl2,
+                    BiTreeNode **left, int *hl,
+                    BiTreeNode *r1, int hr1, BiTreeNode *r2, int hr2,
+                    BiTreeNode **right, int *hr)
+{
+    struct setop_half half;
+    struct wspool_task task;
+
+    if (op->pool == NULL || hl1 < BISTREE_PAR_HEIGHT || hl2 < BISTREE_PAR_HEIGHT) {
+        *left = fn(op, l1, hl1, l2, hl2, hl);
+        *right = fn(op, r1, hr1, r2, hr2, hr);
+        return;
+    }
+
+    half.op = *op;
+    half.op.dropped = 0;
+    half.fn = fn;
+    half.n1 = l1;
+    half.h1 = hl1;
+    half.n2 = l2;
+    half.h2 = hl2;
+    wspool_task_init(&task, setop_half_run, &half);
+    wspool_spawn(op->pool, &task);
+
+    *right = fn(op, r1, hr1, r2, hr2, hr);
+
+    wspool_sync(op->pool, &task);
+    *left = half.root;
+    *hl = half.height;
+    op->dropped += half.op.dropped;
+}
+
+static BiTreeNode *set_union(struct setop *op, BiTreeNode *n1, int h1,
+                             BiTreeNode *n2, int h2, int *height)
+{
+    BiTreeNode *l1, *r1, *l2, *r2, *found, *left, *right;
+    int hl1, hr1, hl2, hr2, hl, hr;
+
+    if (bitree_is_eob(n1)) {
+        *height = h2;
+        return n2;
+    }
+    if (bitree_is_eob(n2)) {
+        *height = h1;
+        return n1;
+    }
+
+    child_heights(n2, h2, &hl2, &hr2);
+    l2 = bitree_left(n2);
+    r2 = bitree_right(n2);
+    found = split(op->t1, n1, h1, avl_node(n2)->data, &l1, &hl1, &r1, &hr1);
+
+    recurse(op, set_union, l1, hl1, l2, hl2, &left, &hl, r1, hr1, r2, hr2, &right, &hr);
+
+    // Data of @t1 wins when the key is live in both trees
+    if (found != NULL && !avl_node(found)->hidden) {
+        drop_node(op->t2, n2, op);
+        return join(left, hl, found, right, hr, height);
+    }
+
+    if (found != NULL)
+        drop_node(op->t1, found, op);
+
+    if (!avl_node(n2)->hidden)
+        return join(left, hl, n2, right, hr, height);
+
+    drop_node(op->t2, n2, op);
+    return join2(left, hl, right, hr, height);
+}
+
+static BiTreeNode *set_intersection(struct setop *op, BiTreeNode *n1, int h1,
+                                    BiTreeNode *n2, int h2, int *height)
+{
+    BiTreeNode *l1, *r1, *l2, *r2, *found, *left, *right;
+    int hl1, hr1, hl2, hr2, hl, hr;
+
+    if (bitree_is_eob(n1) || bitree_is_eob(n2)) {
+        drop_tree(op->t1, n1, op);
+        drop_tree(op->t2, n2, op);
+        *height = 0;
+        return NULL;
+    }
+
+    child_heights(n2, h2, &hl2, &hr2);
+    l2 = bitree_left(n2);
+    r2 = bitree_right(n2);
+    found = split(op->t1, n1, h1, avl_node(n2)->data, &l1, &hl1, &r1, &hr1);
+
+    recurse(op, set_intersection, l1, hl1, l2, hl2, &left, &hl, r1, hr1, r2, hr2, &right, &hr);
+
+    if (found != NULL && !avl_node(found)->hidden && !avl_node(n2)->hidden) {
+        drop_node(op->t2, n2, op);
+        return join(left, hl, found, right, hr, height);
+    }
+
+    if (found != NULL)
+        drop_node(op->t1, found, op);
+    drop_node(op->t2, n2, op);
+
+    return join2(left, hl, right, hr, height);
+}
+
+static BiTreeNode *set_difference(struct setop *op, BiTreeNode *n1, int h1,
+                                  BiTreeNode *n2, int h2, int *height)
+{
+    BiTreeNode *l1, *r1, *l2, *r2, *found, *left, *right;
+    int hl1, hr1, hl2, hr2, hl, hr, hidden;
+
+    if (bitree_is_eob(n1) || bitree_is_eob(n2)) {
+        drop_tree(op->t2, n2, op);
+        *height = h1;
+        return n1;
+    }
+
+    child_heights(n2, h2, &hl2, &hr2);
+    l2 = bitree_left(n2);
+    r2 = bitree_right(n2);
+    found = split(op->t1, n1, h1, avl_node(n2)->data, &l1, &hl1, &r1, &hr1);
+
+    recurse(op, set_difference, l1, hl1, l2, hl2, &left, &hl, r1, hr1, r2, hr2, &right, &hr);
+
+    // A hidden node of @t2 does not remove anything
+    hidden = avl_node(n2)->hidden;
+    drop_node(op->t2, n2, op);
+
+    if (found != NULL && hidden)
+        return join(left, hl, found, right, hr, height);
+
+    if (found != NULL)
+        drop_node(op->t1, found, op);
+
+    return join2(left, hl, right, hr, height);
+}
+
+struct build {
+    struct wspool *pool;        // NULL for the sequential version
+    void **data;
+    size_t size;
+    BiTreeNode *root;
+    int height;
+};
+
+static BiTreeNode *build_sorted(struct wspool *pool, void **data, size_t size,
+                                int *height);
+
+static void build_run(void *arg)
+{
+    struct build *build = (struct build *)arg;
+
+    build->root = build_sorted(build->pool, build->data, build->size,
+                               &build->height);
+}
+
+static BiTreeNode *build_sorted(struct wspool *pool, void **data, size_t size,
+                                int *height)
+{
+    BiTreeNode *left, *right, *node;
+    size_t mid = size / 2;
+    int hl, hr;
+
+    if (size == 0) {
+        *height = 0;
+        return NULL;
+    }
+
+    if (pool != NULL && size > BISTREE_PAR_GRAIN) {
+        struct build half = { pool, data, mid, NULL, 0 };
+        struct wspool_task task;
+
+        wspool_task_init(&task, build_run, &half);
+        wspool_spawn(pool, &task);
+        right = build_sorted(pool, data + mid + 1, size - mid - 1, &hr);
+        wspool_sync(pool, &task);
+        left = half.root;
+        hl = half.height;
+    } else {
+        left = build_sorted(NULL, data, mid, &hl);
+        right = build_sorted(NULL, data + mid + 1, size - mid - 1, &hr);
+    }
+
+    if ((mid > 0 && left == NULL) || (size - mid - 1 > 0 && right == NULL)
+        || (node = new_node(data[mid])) == NULL) {
+        struct setop op = { NULL, NULL, NULL, 0 };
+        BisTree none;
+
+        // Release what was built, the data still belongs to the caller
+        bitree_init(&none, NULL);
+        drop_tree(&none, left, &op);
+        drop_tree(&none, right, &op);
+        return NULL;
+    }
+
+    return link(left, hl, node, right, hr, height);
+}
+
+static int build_tree(BisTree *tree, void **data, size_t size,
+                      struct wspool *pool)
+{
+    struct build build = { pool, data, size, NULL, 0 };
+
+    if (bitree_size(tree) > 0)
+        return -1;
+
+    if (pool != NULL)
+        wspool_run(pool, build_run, &build);
+    else
+        build_run(&build);
+
+    if (build.root == NULL && size > 0)
+        return -1;
+
+    tree->root = build.root;
+    tree->size = size;
+
+    return 0;
+}
+
+struct combine {
+    struct setop op;
+    setop_fn fn;
+    BiTreeNode *root;
+};
+
+static void combine_run(void *arg)
+{
+    struct combine *c = (struct combine *)arg;
+    BiTreeNode *n1 = bitree_root(c->op.t1), *n2 = bitree_root(c->op.t2);
+    int height;
+
+    c->root = c->fn(&c->op, n1, tree_height(n1), n2, tree_height(n2), &height);
+}
+
+static int combine(BisTree *tree, BisTree *t1, BisTree *t2, setop_fn fn,
+                   struct wspool *pool)
+{
+    struct combine c;
+    BisTree tree1 = *t1, tree2 = *t2;
+    int size = bitree_size(t1) + bitree_size(t2);
+
+    c.op.t1 = &tree1;
+    c.op.t2 = &tree2;
+    c.op.pool = pool;
+    c.op.dropped = 0;
+    c.fn = fn;
+
+    if (pool != NULL)
+        wspool_run(pool, combine_run, &c);
+    else
+        combine_run(&c);
+
+    // Both inputs are consumed, as in bitree_merge()
+    t1->root = NULL;
+    t1->size = 0;
+    t2->root = NULL;
+    t2->size = 0;
+
+    bistree_init(tree, tree1.compare, tree1.destroy);
+    tree->root = c.root;
+    tree->size = size - c.op.dropped;
+
+    return 0;
+}
+
+/*
+ * Concurrent mode.
+ *
+ * Published nodes are never written again: the writer copies the search
+ * path, runs the usual insert() on the copies (its rotations only touch
+ * nodes of that path) and publishes the new root with a single atomic
+ * store. Replaced nodes are retired through the epoch domain of the tree.
+ */
+
+static void free_node(void *node)
+{
+    free(bitree_data((BiTreeNode *)node));
+    free(node);
+}
+
+static BiTreeNode *copy_node(BiTreeNode *node)
+{
+    BiTreeNode *copy;
+    AvlNode *avl_data;
+
+    if ((avl_data = (AvlNode *)malloc(sizeof(AvlNode))) == NULL)
+        return NULL;
+
+    if (bitree_node_init(&copy, avl_data) != 0) {
+        free(avl_data);
+        return NULL;
+    }
+
+    *avl_data = *avl_node(node);
+    bitree_left(copy) = bitree_left(node);
+    bitree_right(copy) = bitree_right(node);
+
+    return copy;
+}
+
+/**
+ * replace the search path of @data below *@root with copies.
+ * @path        receives the replaced nodes, @copies their copies.
+ * @return      the copy of the node equal to @data, NULL if there is none.
+ */
+static BiTreeNode *copy_path(BisTree *tree, BiTreeNode **root, const void *data,
+                             BiTreeNode **path, BiTreeNode **copies, int *depth)
+{
+    BiTreeNode **position = root, *node = *root;
+    int cmpval;
+
+    *depth = 0;
+    while (node != NULL) {
+        if (*depth == BISTREE_MAX_HEIGHT
+            || (copies[*depth] = copy_node(node)) == NULL) {
+            while (*depth > 0)
+                free_node(copies[--(*depth)]);
+            *depth = -1;
+            return NULL;
+        }
+
+        path[*depth] = node;
+        *position = copies[(*depth)++];
+
+        cmpval = tree->compare(data, avl_node(node)->data);
+        if (cmpval == 0)
+            return *position;
+
+        position = cmpval < 0 ? &bitree_left(*position) : &bitree_right(*position);
+        node = *position;
+    }
+
+    return NULL;
+}
+
+/**
+ * make @work the current version and retire the nodes it replaced.
+ */
+static void publish(BisTreeRcu *rcu, BisTree *work, BiTreeNode **path, int depth)
+{
+    int i;
+
+    __atomic_store_n(&rcu->tree.size, work->size, __ATOMIC_RELAXED);
+    __atomic_store_n(&rcu->tree.root, work->root, __ATOMIC_RELEASE);
+
+    for (i = 0; i < depth; i++) {
+        if (epoch_retire(&rcu->writer, path[i], free_node) != 0) {
+            epoch_synchronize(&rcu->epoch);
+            free_node(path[i]);
+        }
+    }
+}
+
+static int scan(BisTree *tree, BiTreeNode *node, const void *lo, const void *hi,
+                int (*visit)(void *data, void *ctx), void *ctx)
+{
+    BiTreeNode *stack[BISTREE_MAX_HEIGHT];
+    AvlNode *avl_data;
+    int top = 0, count = 0;
+
+    // Stack the path to the first node >= @lo
+    while (node != NULL) {
+        if (lo != NULL && tree->compare(avl_node(node)->data, lo) < 0) {
+            node = bitree_right(node);
+        } else {
+            stack[top++] = node;
+            node = bitree_left(node);
+        }
+    }
+
+    while (top > 0) {
+        node = stack[--top];
+        avl_data = avl_node(node);
+        if (hi != NULL && tree->compare(avl_data->data, hi) >= 0)
+            break;
+
+        if (!avl_data->hidden) {
+            count++;
+            if (visit(avl_data->data, ctx) != 0)
+                break;
+        }
+
+        for (node = bitree_right(node); node != NULL; node = bitree_left(node))
+            stack[top++] = node;
+    }
+
+    return count;
+}
+
 void bistree_init(BisTree *tree, int (*compare)(const void *key1, const void *key2),
                   void (*destroy)(void *data))
 {
@@ -399,12 +1175,12 @@ void bistree_destroy(BisTree *tree)
 int bistree_insert(BisTree *tree, const void *data)
 {
     int balanced = 0;
-    return insert(tree, &bitree_root(tree), data, &balanced);
+    return insert(tree, NULL, &bitree_root(tree), data, &balanced);
 }
 
 int bistree_remove(BisTree *tree, const void *data)
 {
-    return hide(tree, bitree_root(tree), data);
+    return hide(tree, NULL, bitree_root(tree), data);
 }
 
 int bistree_lookup(BisTree *tree, void **data)
@@ -412,5 +1188,274 @@ int bistree_lookup(BisTree *tree, void **data)
     return lookup(tree, bitree_root(tree), data);
 }
 
+int bistree_lookup_sorted_batch(BisTree *tree, void **keys, size_t n, void **out)
+{
+    BiTreeNode *path[BISTREE_MAX_HEIGHT];
+    int turn[BISTREE_MAX_HEIGHT];       // depths where the path went left
+    BiTreeNode *node;
+    AvlNode *avl_data;
+    int depth = 0, turns = 0, found = 0, cmpval;
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        out[i] = NULL;
+
+        // Out of order keys restart from the root
+        if (i > 0 && tree->compare(keys[i], keys[i - 1]) < 0)
+            depth = turns = 0;
+
+        // Only a left turn bounds the keys below it. Climb over the turns
+        // the key has passed, the last one is the lowest node covering it
+        while (turns > 0) {
+            avl_data = (AvlNode *)bitree_data(path[turn[turns - 1]]);
+            if (tree->compare(keys[i], avl_data->data) < 0)
+                break;
+            depth = turn[--turns] + 1;
+        }
+
+        node = depth > 0 ? path[--depth] : bitree_root(tree);
+
+        while (!bitree_is_eob(node)) {
+            avl_data = (AvlNode *)bitree_data(node);
+            path[depth++] = node;
+
+            if ((cmpval = tree->compare(keys[i], avl_data->data)) == 0) {
+                if (!avl_data->hidden) {
+                    out[i] = avl_data->data;
+                    found++;
+                }
+                break;
+            }
+
+            if (cmpval < 0) {
+                turn[turns++] = depth - 1;
+                node = bitree_left(node);
+            } else {
+                node = bitree_right(node);
+            }
+        }
+    }
+
+    return found;
+}
+
+
+void bistree_interval_init(BisTreeInterval *itree,
+                           int (*compare)(const void *key1, const void *key2),
+                           void (*destroy)(void *data),
+                           int64_t (*low)(const void *data),
+                           int64_t (*high)(const void *data))
+{
+    bistree_init(&itree->tree, compare, destroy);
+    itree->low = low;
+    itree->high = high;
+
+    return;
+}
+
+void bistree_interval_destroy(BisTreeInterval *itree)
+{
+    bistree_destroy(&itree->tree);
+
+    return;
+}
+
+int bistree_interval_insert(BisTreeInterval *itree, const void *data)
+{
+    int balanced = 0;
+    return insert(&itree->tree, itree, &bitree_root(&itree->tree), data, &balanced);
+}
+
+int bistree_interval_remove(BisTreeInterval *itree, const void *data)
+{
+    return hide(&itree->tree, itree, bitree_root(&itree->tree), data);
+}
+
+int bistree_overlap(BisTreeInterval *itree, int64_t lo, int64_t hi,
+                    int (*visit)(void *data, void *ctx), void *ctx)
+{
+    int count = 0;
+
+    overlap(itree, bitree_root(&itree->tree), lo, hi, visit, ctx, &count);
+
+    return count;
+}
+
+
+int bistree_union(BisTree *tree, BisTree *t1, BisTree *t2)
+{
+    return combine(tree, t1, t2, set_union, NULL);
+}
+
+int bistree_intersection(BisTree *tree, BisTree *t1, BisTree *t2)
+{
+    return combine(tree, t1, t2, set_intersection, NULL);
+}
+
+int bistree_difference(BisTree *tree, BisTree *t1, BisTree *t2)
+{
+    return combine(tree, t1, t2, set_difference, NULL);
+}
+
+int bistree_build_sorted(BisTree *tree, void **data, size_t size)
+{
+    return build_tree(tree, data, size, NULL);
+}
+
+int bistree_parallel_union(BisTree *tree, BisTree *t1, BisTree *t2,
+                           struct wspool *pool)
+{
+    return combine(tree, t1, t2, set_union, pool);
+}
+
+int bistree_parallel_intersection(BisTree *tree, BisTree *t1, BisTree *t2,
+                                  struct wspool *pool)
+{
+    return combine(tree, t1, t2, set_intersection, pool);
+}
+
+int bistree_parallel_difference(BisTree *tree, BisTree *t1, BisTree *t2,
+                                struct wspool *pool)
+{
+    return combine(tree, t1, t2, set_difference, pool);
+}
+
+int bistree_parallel_build_sorted(BisTree *tree, void **data, size_t size,
+                                  struct wspool *pool)
+{
+    return build_tree(tree, data, size, pool);
+}
+
+void bistree_rcu_init(BisTreeRcu *rcu,
+                      int (*compare)(const void *key1, const void *key2),
+                      void (*destroy)(void *data))
+{
+    bistree_init(&rcu->tree, compare, destroy);
+    pthread_mutex_init(&rcu->lock, NULL);
+    epoch_init(&rcu->epoch);
+    epoch_register(&rcu->epoch, &rcu->writer);
+
+    return;
+}
+
+void bistree_rcu_destroy(BisTreeRcu *rcu)
+{
+    epoch_destroy(&rcu->epoch);
+    pthread_mutex_destroy(&rcu->lock);
+    bistree_destroy(&rcu->tree);
+
+    return;
+}
+
+void bistree_rcu_register(BisTreeRcu *rcu, struct epoch_record *reader)
+{
+    epoch_register(&rcu->epoch, reader);
+}
+
+void bistree_rcu_unregister(BisTreeRcu *rcu, struct epoch_record *reader)
+{
+    (void)rcu;
+    epoch_unregister(reader);
+}
+
+int bistree_rcu_insert(BisTreeRcu *rcu, const void *data)
+{
+    BiTreeNode *path[BISTREE_MAX_HEIGHT], *copies[BISTREE_MAX_HEIGHT], *found;
+    BisTree work;
+    void *old = (void *)data;
+    int depth, balanced = 0, retval;
+
+    pthread_mutex_lock(&rcu->lock);
+    work = rcu->tree;
+
+    // Nothing is copied when the data is already live
+    if (lookup(&work, bitree_root(&work), &old) == 0) {
+        pthread_mutex_unlock(&rcu->lock);
+        return 1;
+    }
+
+    found = copy_path(&work, &bitree_root(&work), data, path, copies, &depth);
+    if (depth < 0) {
+        pthread_mutex_unlock(&rcu->lock);
+        return -1;
+    }
+
+    if (found != NULL) {
+        // Revive a hidden node, readers may still compare with the old data
+        old = avl_node(found)->data;
+        avl_node(found)->data = (void *)data;
+        avl_node(found)->hidden = 0;
+        if (work.destroy != NULL && epoch_retire(&rcu->writer, old, work.destroy) != 0) {
+            epoch_synchronize(&rcu->epoch);
+            work.destroy(old);
+        }
+        retval = 0;
+    } else if ((retval = insert(&work, NULL, &bitree_root(&work), data, &balanced)) != 0) {
+        // insert() fails before touching the copies
+        while (depth > 0)
+            free_node(copies[--depth]);
+        pthread_mutex_unlock(&rcu->lock);
+        return retval;
+    }
+
+    publish(rcu, &work, path, depth);
+    pthread_mutex_unlock(&rcu->lock);
+
+    return retval;
+}
+
+int bistree_rcu_remove(BisTreeRcu *rcu, const void *data)
+{
+    BiTreeNode *path[BISTREE_MAX_HEIGHT], *copies[BISTREE_MAX_HEIGHT], *found;
+    BisTree work;
+    void *old = (void *)data;
+    int depth;
+
+    pthread_mutex_lock(&rcu->lock);
+    work = rcu->tree;
+
+    if (lookup(&work, bitree_root(&work), &old) != 0) {
+        pthread_mutex_unlock(&rcu->lock);
+        return -1;
+    }
+
+    found = copy_path(&work, &bitree_root(&work), data, path, copies, &depth);
+    if (found == NULL) {
+        pthread_mutex_unlock(&rcu->lock);
+        return -1;
+    }
+
+    // Mark the copy as hidden, the same lazy removal as bistree_remove()
+    avl_node(found)->hidden = 1;
+    publish(rcu, &work, path, depth);
+    pthread_mutex_unlock(&rcu->lock);
+
+    return 0;
+}
+
+int bistree_rcu_lookup(BisTreeRcu *rcu, struct epoch_record *reader, void **data)
+{
+    int retval;
+
+    epoch_enter(reader);
+    retval = lookup(&rcu->tree, __atomic_load_n(&rcu->tree.root, __ATOMIC_ACQUIRE), data);
+    epoch_exit(reader);
+
+    return retval;
+}
+
+int bistree_rcu_scan(BisTreeRcu *rcu, struct epoch_record *reader,
+                     const void *lo, const void *hi,
+                     int (*visit)(void *data, void *ctx), void *ctx)
+{
+    int count;
+
+    epoch_enter(reader);
+    count = scan(&rcu->tree, __atomic_load_n(&rcu->tree.root, __ATOMIC_ACQUIRE),
+                 lo, hi, visit, ctx);
+    epoch_exit(reader);
+
+    return count;
+}
 
 /* bistree.c ends here */
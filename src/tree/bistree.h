@@ -2,7 +2,12 @@
 #define BISTREE_H
 
 #include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
 #include "bitree.h"
+#include "../thread/epoch.h"
+
+struct wspool;
 
 typedef struct bitree_tree BisTree;
 typedef struct bitree_node BiTreeNode;
@@ -13,12 +18,42 @@ typedef struct AvlNode_ {
     int factor;
 } AvlNode;
 
+/**
+ * BisTree with lock-free readers. Writers are serialised by @lock, copy
+ * the nodes on the search path and publish a new root atomically, so
+ * readers always walk a consistent version. Replaced nodes are freed
+ * through @epoch once no reader can see them anymore.
+ */
+typedef struct bistree_rcu_ {
+    BisTree tree;
+    pthread_mutex_t lock;
+    struct epoch_domain epoch;
+    struct epoch_record writer;
+} BisTreeRcu;
+
+/**
+ * BisTree of half-open intervals [low, high). The tree is ordered by
+ * @compare, which must order by low first. Every node also records the
+ * largest high of its subtree, so overlap queries skip whole subtrees.
+ */
+typedef struct bistree_interval_ {
+    BisTree tree;
+    int64_t (*low)(const void *data);
+    int64_t (*high)(const void *data);
+} BisTreeInterval;
+
 enum avl_balance_state_{
     AVL_RGT_HEAVY = -1,
     AVL_BALANCED = 0,
     AVL_LET_HEAVY = 1,
 };
 
+/**
+ * Bound for the explicit stacks of tree walks. An AVL tree of height 128
+ * would need more nodes than fit in memory.
+ */
+#define BISTREE_MAX_HEIGHT 128
+
 /**
  * init binary search tree
  * @tree        global BisTree struct
@@ -56,6 +91,146 @@ int bistree_remove(BisTree *tree, const void *data);
  */
 int bistree_lookup(BisTree *tree, void **data);
 
+/**
+ * lookup @n keys at once, *@out[i] is the data equal to @keys[i] or NULL.
+ * Keys in increasing order resume from the lowest node of the previous
+ * search path whose subtree covers them instead of the root, found by
+ * climbing only the nodes where that path went left. A key smaller than
+ * its predecessor starts over.
+ * @return      number of keys found.
+ */
+int bistree_lookup_sorted_batch(BisTree *tree, void **keys, size_t n, void **out);
+
+/**
+ * The set operations below are built on AVL join/split and take
+ * O(m log(n/m + 1)) for trees of m <= n nodes. Both @t1 and @t2 are
+ * consumed like in bitree_merge(): their nodes move to @tree and they are
+ * left empty. @tree is initialized with the compare/destroy of @t1 and may
+ * be @t1 itself. Nodes dropped from an input are released with the
+ * destroy of that input. Where a key is in both inputs a hidden (removed)
+ * node counts as absent: it neither keeps the key in the result nor
+ * removes a live node of the other input. Nodes that meet no equal key
+ * move over as they are, so hidden ones of a consumed subtree stay hidden
+ * in @tree and count in its size like after bistree_remove(); dropping
+ * them would walk the whole subtree.
+ */
+
+/**
+ * @tree = @t1 | @t2, data of @t1 is kept for keys in both trees.
+ */
+int bistree_union(BisTree *tree, BisTree *t1, BisTree *t2);
+
+/**
+ * @tree = @t1 & @t2, data of @t1 is kept.
+ */
+int bistree_intersection(BisTree *tree, BisTree *t1, BisTree *t2);
+
+/**
+ * @tree = @t1 - @t2
+ */
+int bistree_difference(BisTree *tree, BisTree *t1, BisTree *t2);
+
+/**
+ * build an empty @tree from @size data sorted in strictly increasing
+ * order by tree->compare, in O(@size).
+ * @return      return 0 on success otherwise return -1
+ */
+int bistree_build_sorted(BisTree *tree, void **data, size_t size);
+
+/**
+ * Fork-join versions of the set operations and of bistree_build_sorted()
+ * running on @pool (see wspool.h). Same results and ownership rules; the
+ * destroy functions of @t1 and @t2 may be called from several workers
+ * at once.
+ */
+int bistree_parallel_union(BisTree *tree, BisTree *t1, BisTree *t2,
+                           struct wspool *pool);
+int bistree_parallel_intersection(BisTree *tree, BisTree *t1, BisTree *t2,
+                                  struct wspool *pool);
+int bistree_parallel_difference(BisTree *tree, BisTree *t1, BisTree *t2,
+                                struct wspool *pool);
+int bistree_parallel_build_sorted(BisTree *tree, void **data, size_t size,
+                                  struct wspool *pool);
+
+/**
+ * init the concurrent mode, arguments as in bistree_init().
+ */
+void bistree_rcu_init(BisTreeRcu *rcu,
+                      int (*compare)(const void *key1, const void *key2),
+                      void (*destroy)(void *data));
+
+/**
+ * destroy the tree and everything still waiting for readers.
+ * No thread may use @rcu anymore.
+ */
+void bistree_rcu_destroy(BisTreeRcu *rcu);
+
+/**
+ * every reader thread registers its own @reader record before its first
+ * bistree_rcu_lookup()/bistree_rcu_scan().
+ */
+void bistree_rcu_register(BisTreeRcu *rcu, struct epoch_record *reader);
+void bistree_rcu_unregister(BisTreeRcu *rcu, struct epoch_record *reader);
+
+/**
+ * same results as bistree_insert()/bistree_remove(), may be called from
+ * any thread.
+ */
+int bistree_rcu_insert(BisTreeRcu *rcu, const void *data);
+int bistree_rcu_remove(BisTreeRcu *rcu, const void *data);
+
+/**
+ * bistree_lookup() without taking the writer lock.
+ * The read section ends when the call returns, so the data passed back
+ * in *@data is not protected anymore: a concurrent insert reviving the
+ * hidden key replaces it and hands it to tree->destroy after a grace
+ * period. Use it afterwards only when @destroy is NULL or no writer can
+ * run; otherwise copy it out with bistree_rcu_scan(), whose @visit runs
+ * inside the read section.
+ */
+int bistree_rcu_lookup(BisTreeRcu *rcu, struct epoch_record *reader, void **data);
+
+/**
+ * visit the live data in [@lo, @hi) of one version of the tree in key
+ * order without taking the writer lock. NULL bounds are open.
+ * @visit       return non-zero to stop; @data is only valid during
+ *              the call.
+ * @return      number of visited data.
+ */
+int bistree_rcu_scan(BisTreeRcu *rcu, struct epoch_record *reader,
+                     const void *lo, const void *hi,
+                     int (*visit)(void *data, void *ctx), void *ctx);
+
+/**
+ * init the interval mode, @compare and @destroy as in bistree_init().
+ * @low         start of the interval of data, included.
+ * @high        end of the interval of data, excluded.
+ */
+void bistree_interval_init(BisTreeInterval *itree,
+                           int (*compare)(const void *key1, const void *key2),
+                           void (*destroy)(void *data),
+                           int64_t (*low)(const void *data),
+                           int64_t (*high)(const void *data));
+
+void bistree_interval_destroy(BisTreeInterval *itree);
+
+/**
+ * bistree_insert()/bistree_remove() keeping the subtree maxima. Use
+ * bistree_lookup(&itree->tree, ...) for exact lookups. The set operations
+ * and the concurrent mode do not support interval trees.
+ */
+int bistree_interval_insert(BisTreeInterval *itree, const void *data);
+int bistree_interval_remove(BisTreeInterval *itree, const void *data);
+
+/**
+ * visit every interval overlapping [@lo, @hi) in key order, in
+ * O(log n + k) for k reported intervals.
+ * @visit       return non-zero to stop.
+ * @return      number of visited data.
+ */
+int bistree_overlap(BisTreeInterval *itree, int64_t lo, int64_t hi,
+                    int (*visit)(void *data, void *ctx), void *ctx);
+
 static inline size_t bistree_size(BisTree *tree)
 {
     return tree->size;
@@ -0,0 +1,316 @@
+/* bistree_fc.c --- flat combining binary search tree
+ *
+ * Filename: bistree_fc.c
+ * Description: batched writer front-end for a shared BisTree
+ * Author: Werther Zhang
+ * Maintainer: Werther Zhang (peng.zhang.dev@gmail.com)
+ * Version: 0
+ * Keywords: binary search tree, flat combining
+ *
+ */
+
+/* Change Log:
+ *
+ *
+ */
+
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth
+ * Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* Code: */
+
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bistree_fc.h"
+
+#define BISTREE_FC_SPINS 128
+
+/**
+ * insertion sort by key, batches hold at most one operation per thread.
+ */
+static void sort_batch(BisTree *tree, struct bistree_fc_slot **batch, int size)
+{
+    struct bistree_fc_slot *slot;
+    int i, j;
+
+    for (i = 1; i < size; i++) {
+        slot = batch[i];
+        for (j = i; j > 0 && tree->compare(batch[j - 1]->data, slot->data) > 0; j--)
+            batch[j] = batch[j - 1];
+        batch[j] = slot;
+    }
+}
+
+/**
+ * apply the sorted @writes as one change of the tree: a finger search
+ * finds the current data of their keys, the operations of each key are
+ * replayed on that, and only the net change reaches the tree through one
+ * difference and one union. Data inserted and removed again within the
+ * batch never enters the tree and is destroyed right away, like data
+ * replaced by the union or dropped by the difference.
+ * @return      return 0 on success, -1 if out of memory before anything
+ *              changed.
+ */
+static int apply_writes(BisTreeFc *fc, struct bistree_fc_slot **writes, int size)
+{
+    BisTree *tree = &fc->tree;
+    struct bistree_fc_slot *slot;
+    BisTree removed, inserted;
+    void **keys = fc->keys, **found = fc->keys + fc->batch_size;
+    void **dropped = fc->keys + 2 * fc->batch_size;
+    void *old, *live;
+    int count = 0, removes = 0, inserts = 0, drops = 0, i, k;
+
+    for (i = 0; i < size; i++) {
+        if (count == 0 || tree->compare(writes[i]->data, keys[count - 1]) != 0)
+            keys[count++] = writes[i]->data;
+    }
+    bistree_lookup_sorted_batch(tree, keys, count, found);
+
+    // The arrays are compacted in place: key k is read before slot k is
+    // reused for the data to remove (keys) or to insert (found)
+    for (i = k = 0; k < count; k++) {
+        old = live = found[k];
+        for (; i < size && tree->compare(writes[i]->data, keys[k]) == 0; i++) {
+            slot = writes[i];
+            if (slot->op == BISTREE_FC_INSERT) {
+                slot->result = live != NULL;
+                if (live == NULL)
+                    live = slot->data;
+            } else if (live == NULL) {
+                slot->result = -1;
+            } else {
+                slot->result = 0;
+                if (live != old)
+                    dropped[drops++] = live;
+                live = NULL;
+            }
+        }
+
+        if (live == old)
+            continue;
+        if (old != NULL)
+            keys[removes++] = old;
+        if (live != NULL)
+            found[inserts++] = live;
+    }
+
+    // The batch trees only borrow the data until they are consumed
+    bistree_init(&removed, tree->compare, NULL);
+    bistree_init(&inserted, tree->compare, NULL);
+    if (bistree_build_sorted(&removed, keys, removes) != 0)
+        return -1;
+    if (bistree_build_sorted(&inserted, found, inserts) != 0) {
+        bistree_destroy(&removed);
+        return -1;
+    }
+
+    if (removes > 0)
+        bistree_difference(tree, tree, &removed);
+    if (inserts > 0)
+        bistree_union(tree, tree, &inserted);
+
+    for (i = 0; i < drops && tree->destroy != NULL; i++)
+        tree->destroy(dropped[i]);
+
+    return 0;
+}
+
+/**
+ * serve every posted operation, called with the combiner lock held.
+ */
+static void combine(BisTreeFc *fc)
+{
+    struct bistree_fc_slot **posted = fc->batch + fc->batch_size;
+    struct bistree_fc_slot *slot;
+    void **found;
+    int size = 0, writes = 0, lookups = 0, i;
+
+    for (slot = __atomic_load_n(&fc->slots, __ATOMIC_ACQUIRE);
+         slot != NULL; slot = slot->next) {
+        if (__atomic_load_n(&slot->op, __ATOMIC_ACQUIRE) != BISTREE_FC_NONE
+            && size < fc->batch_size)
+            posted[size++] = slot;
+    }
+
+    sort_batch(&fc->tree, posted, size);
+
+    // Writes move to the front half, lookups stay sorted in the back one
+    for (i = 0; i < size; i++) {
+        if (posted[i]->op == BISTREE_FC_LOOKUP)
+            posted[lookups++] = posted[i];
+        else
+            fc->batch[writes++] = posted[i];
+    }
+
+    // All posted operations overlap, so they may take effect in any
+    // order: writes first, then every lookup in one sorted batch
+    if (writes > 0 && apply_writes(fc, fc->batch, writes) != 0) {
+        // No memory for the batch trees, one descent per operation then
+        for (i = 0; i < writes; i++) {
+            slot = fc->batch[i];
+            if (slot->op == BISTREE_FC_INSERT)
+                slot->result = bistree_insert(&fc->tree, slot->data);
+            else
+                slot->result = bistree_remove(&fc->tree, slot->data);
+        }
+    }
+
+    // A served slot may be reused at once
+    for (i = 0; i < writes; i++)
+        __atomic_store_n(&fc->batch[i]->op, BISTREE_FC_NONE, __ATOMIC_RELEASE);
+
+    if (lookups == 0)
+        return;
+
+    found = fc->keys + fc->batch_size;
+    for (i = 0; i < lookups; i++)
+        fc->keys[i] = posted[i]->data;
+    bistree_lookup_sorted_batch(&fc->tree, fc->keys, lookups, found);
+
+    for (i = 0; i < lookups; i++) {
+        slot = posted[i];
+        if (found[i] != NULL) {
+            slot->data = found[i];
+            slot->result = 0;
+        } else {
+            slot->result = -1;
+        }
+        __atomic_store_n(&slot->op, BISTREE_FC_NONE, __ATOMIC_RELEASE);
+    }
+}
+
+static int post(BisTreeFc *fc, struct bistree_fc_slot *slot, int op, void *data)
+{
+    int spins = 0;
+
+    slot->data = data;
+    __atomic_store_n(&slot->op, op, __ATOMIC_RELEASE);
+
+    while (__atomic_load_n(&slot->op, __ATOMIC_ACQUIRE) != BISTREE_FC_NONE) {
+        if (pthread_mutex_trylock(&fc->lock) == 0) {
+            combine(fc);
+            pthread_mutex_unlock(&fc->lock);
+            continue;
+        }
+
+        if (++spins == BISTREE_FC_SPINS) {
+            spins = 0;
+            sched_yield();
+        }
+    }
+
+    return slot->result;
+}
+
+int bistree_fc_init(BisTreeFc *fc, int (*compare)(const void *key1, const void *key2),
+                    void (*destroy)(void *data))
+{
+    bistree_init(&fc->tree, compare, destroy);
+    fc->slots = NULL;
+    fc->batch = NULL;
+    fc->keys = NULL;
+    fc->batch_size = 0;
+    pthread_mutex_init(&fc->lock, NULL);
+
+    return 0;
+}
+
+void bistree_fc_destroy(BisTreeFc *fc)
+{
+    bistree_destroy(&fc->tree);
+    pthread_mutex_destroy(&fc->lock);
+    free(fc->batch);
+    free(fc->keys);
+    fc->batch = NULL;
+    fc->keys = NULL;
+    fc->slots = NULL;
+
+    return;
+}
+
+int bistree_fc_register(BisTreeFc *fc, struct bistree_fc_slot *slot)
+{
+    struct bistree_fc_slot **batch;
+    void **keys;
+
+    slot->op = BISTREE_FC_NONE;
+    slot->result = 0;
+    slot->data = NULL;
+
+    pthread_mutex_lock(&fc->lock);
+    batch = (struct bistree_fc_slot **)realloc(fc->batch, 2 * (fc->batch_size + 1)
+                                               * sizeof(struct bistree_fc_slot *));
+    if (batch == NULL) {
+        pthread_mutex_unlock(&fc->lock);
+        return -1;
+    }
+    fc->batch = batch;
+
+    keys = (void **)realloc(fc->keys, 3 * (fc->batch_size + 1) * sizeof(void *));
+    if (keys == NULL) {
+        pthread_mutex_unlock(&fc->lock);
+        return -1;
+    }
+    fc->keys = keys;
+    fc->batch_size++;
+
+    slot->next = fc->slots;
+    __atomic_store_n(&fc->slots, slot, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&fc->lock);
+
+    return 0;
+}
+
+void bistree_fc_unregister(BisTreeFc *fc, struct bistree_fc_slot *slot)
+{
+    struct bistree_fc_slot **position;
+
+    pthread_mutex_lock(&fc->lock);
+    for (position = &fc->slots; *position != NULL; position = &(*position)->next) {
+        if (*position == slot) {
+            *position = slot->next;
+            fc->batch_size--;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&fc->lock);
+
+    return;
+}
+
+int bistree_fc_insert(BisTreeFc *fc, struct bistree_fc_slot *slot, const void *data)
+{
+    return post(fc, slot, BISTREE_FC_INSERT, (void *)data);
+}
+
+int bistree_fc_remove(BisTreeFc *fc, struct bistree_fc_slot *slot, const void *data)
+{
+    return post(fc, slot, BISTREE_FC_REMOVE, (void *)data);
+}
+
+int bistree_fc_lookup(BisTreeFc *fc, struct bistree_fc_slot *slot, void **data)
+{
+    int retval = post(fc, slot, BISTREE_FC_LOOKUP, *data);
+
+    if (retval == 0)
+        *data = slot->data;
+
+    return retval;
+}
+
+/* bistree_fc.c ends here */
@@ -0,0 +1,80 @@
+#ifndef BISTREE_FC_H
+#define BISTREE_FC_H
+
+#include <pthread.h>
+#include "bistree.h"
+
+/**
+ * Flat combining front-end for a shared BisTree.
+ *
+ * Each thread owns one slot and posts its operation there. Whoever gets
+ * the combiner lock collects all posted operations, sorts them by key and
+ * applies them to the tree, then hands every thread its result. The tree
+ * lock is taken once per batch instead of once per call.
+ *
+ * The lookups of a batch share one finger search down the tree
+ * (bistree_lookup_sorted_batch()). So do the inserts and removes, whose
+ * net change is then applied with one bistree_difference() and one
+ * bistree_union() of small trees built from the sorted batch. Removed
+ * data is therefore destroyed when its batch is applied, not kept hidden
+ * in the tree. Without memory for those trees the batch falls back to
+ * one descent per operation.
+ */
+
+enum bistree_fc_op_ {
+    BISTREE_FC_NONE = 0,
+    BISTREE_FC_INSERT,
+    BISTREE_FC_REMOVE,
+    BISTREE_FC_LOOKUP,
+};
+
+struct bistree_fc_slot {
+    int op;                     // posted operation, NONE once served
+    int result;
+    void *data;
+    struct bistree_fc_slot *next;
+} __attribute__((aligned(64)));
+
+typedef struct bistree_fc_ {
+    BisTree tree;
+    pthread_mutex_t lock;       // held by the combiner
+    struct bistree_fc_slot *slots;
+    struct bistree_fc_slot **batch;     // writes, then posted operations, 2 * batch_size
+    void **keys;                // keys, results and dropped data, 3 * batch_size
+    int batch_size;
+} BisTreeFc;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * arguments as in bistree_init().
+ */
+int bistree_fc_init(BisTreeFc *fc, int (*compare)(const void *key1, const void *key2),
+                    void (*destroy)(void *data));
+
+/**
+ * destroy the tree, no thread may use @fc anymore.
+ */
+void bistree_fc_destroy(BisTreeFc *fc);
+
+/**
+ * every thread registers its own @slot before its first operation.
+ * @return      return 0 on success otherwise return -1
+ */
+int bistree_fc_register(BisTreeFc *fc, struct bistree_fc_slot *slot);
+void bistree_fc_unregister(BisTreeFc *fc, struct bistree_fc_slot *slot);
+
+/**
+ * same results as bistree_insert(), bistree_remove() and bistree_lookup().
+ */
+int bistree_fc_insert(BisTreeFc *fc, struct bistree_fc_slot *slot, const void *data);
+int bistree_fc_remove(BisTreeFc *fc, struct bistree_fc_slot *slot, const void *data);
+int bistree_fc_lookup(BisTreeFc *fc, struct bistree_fc_slot *slot, void **data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,207 @@
+/* bistree_frozen.c --- Eytzinger snapshot of a binary search tree
+ *
+ * Filename: bistree_frozen.c
+ * Description: read-only BFS-ordered copy of a BisTree
+ * Author: Werther Zhang
+ * Maintainer: Werther Zhang (peng.zhang.dev@gmail.com)
+ * Version: 0
+ * Keywords: binary search tree, eytzinger
+ *
+ */
+
+/* Change Log:
+ *
+ *
+ */
+
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth
+ * Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* Code: */
+
+#include <stdlib.h>
+#include <string.h>
+#include "bistree_frozen.h"
+
+#define CACHE_LINE 64
+
+/*
+ * One cache line holds 8 slots, so slots 16k..16k+15 (the descendants of
+ * k four levels down) are two lines starting at 16k.
+ */
+#define PREFETCH_STRIDE 16
+
+static void *alloc_slots(size_t count, size_t size)
+{
+    void *slots;
+
+    if (posix_memalign(&slots, CACHE_LINE, count * size) != 0)
+        return NULL;
+
+    return slots;
+}
+
+static size_t count_live(BiTreeNode *node)
+{
+    size_t count = 0;
+
+    while (node != NULL) {
+        count += count_live(bitree_right(node));
+        if (!((AvlNode *)bitree_data(node))->hidden)
+            count++;
+        node = bitree_left(node);
+    }
+
+    return count;
+}
+
+/**
+ * slot which follows @k in sorted order.
+ */
+static size_t next_slot(size_t k, size_t size)
+{
+    if (2 * k + 1 <= size) {
+        k = 2 * k + 1;
+        while (2 * k <= size)
+            k = 2 * k;
+        return k;
+    }
+
+    // Climb while @k is a right child, then once more
+    return k >> (__builtin_ctzl(~k) + 1);
+}
+
+/**
+ * walk @tree in order and drop each live data in the next Eytzinger slot.
+ */
+static int fill(BisTree *tree, BisFrozen *frozen, uint64_t (*key)(const void *data))
+{
+    BiTreeNode *stack[BISTREE_MAX_HEIGHT], *node = bitree_root(tree);
+    AvlNode *avl_data;
+    size_t k = 1;
+    int top = 0;
+
+    if (frozen->size == 0)
+        return 0;
+
+    while (2 * k <= frozen->size)
+        k = 2 * k;
+
+    while (node != NULL || top > 0) {
+        while (node != NULL) {
+            if (top == BISTREE_MAX_HEIGHT)
+                return -1;
+            stack[top++] = node;
+            node = bitree_left(node);
+        }
+
+        node = stack[--top];
+        avl_data = (AvlNode *)bitree_data(node);
+        if (!avl_data->hidden) {
+            frozen->data[k] = avl_data->data;
+            if (key != NULL)
+                frozen->keys[k] = key(avl_data->data);
+            k = next_slot(k, frozen->size);
+        }
+        node = bitree_right(node);
+    }
+
+    return 0;
+}
+
+int bistree_freeze_u64(BisTree *tree, BisFrozen *frozen,
+                       uint64_t (*key)(const void *data))
+{
+    frozen->size = count_live(bitree_root(tree));
+    frozen->compare = tree->compare;
+    frozen->keys = NULL;
+
+    if ((frozen->data = (void **)alloc_slots(frozen->size + 1, sizeof(void *))) == NULL)
+        return -1;
+    frozen->data[0] = NULL;
+
+    if (key != NULL) {
+        if ((frozen->keys = (uint64_t *)alloc_slots(frozen->size + 1,
+                                                    sizeof(uint64_t))) == NULL) {
+            free(frozen->data);
+            return -1;
+        }
+        frozen->keys[0] = 0;
+    }
+
+    if (fill(tree, frozen, key) != 0) {
+        bistree_frozen_destroy(frozen);
+        return -1;
+    }
+
+    return 0;
+}
+
+int bistree_freeze(BisTree *tree, BisFrozen *frozen)
+{
+    return bistree_freeze_u64(tree, frozen, NULL);
+}
+
+int bistree_frozen_lookup(BisFrozen *frozen, void **data)
+{
+    void **slots = frozen->data;
+    size_t k = 1, size = frozen->size;
+
+    while (k <= size) {
+        __builtin_prefetch(slots + PREFETCH_STRIDE * k);
+        __builtin_prefetch(slots + PREFETCH_STRIDE * k + 8);
+        k = 2 * k + (frozen->compare(slots[k], *data) < 0);
+    }
+
+    // Undo the right turns taken after the last left one
+    k >>= __builtin_ffsl(~k);
+    if (k == 0 || frozen->compare(*data, slots[k]) != 0)
+        return -1;
+
+    // Pass back the data from tree
+    *data = slots[k];
+    return 0;
+}
+
+int bistree_frozen_lookup_u64(BisFrozen *frozen, uint64_t key, void **data)
+{
+    uint64_t *keys = frozen->keys;
+    size_t k = 1, size = frozen->size;
+
+    while (k <= size) {
+        __builtin_prefetch(keys + PREFETCH_STRIDE * k);
+        __builtin_prefetch(keys + PREFETCH_STRIDE * k + 8);
+        k = 2 * k + (keys[k] < key);
+    }
+
+    k >>= __builtin_ffsl(~k);
+    if (k == 0 || keys[k] != key)
+        return -1;
+
+    *data = frozen->data[k];
+    return 0;
+}
+
+void bistree_frozen_destroy(BisFrozen *frozen)
+{
+    free(frozen->data);
+    free(frozen->keys);
+    memset(frozen, 0, sizeof(BisFrozen));
+
+    return;
+}
+
+/* bistree_frozen.c ends here */
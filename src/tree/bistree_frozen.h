@@ -0,0 +1,66 @@
+#ifndef BISTREE_FROZEN_H
+#define BISTREE_FROZEN_H
+
+#include <stdint.h>
+#include "bistree.h"
+
+/**
+ * Read-only snapshot of the live data of a BisTree laid out in Eytzinger
+ * (BFS) order: the children of slot k are 2k and 2k + 1, slot 0 is
+ * unused. Searches walk the array without branches on the comparison
+ * and prefetch the slots four levels down.
+ *
+ * The snapshot stores the data pointers of the tree, which keeps owning
+ * them: destroy the snapshot before the tree.
+ */
+typedef struct bistree_frozen_ {
+    size_t size;
+    void **data;                // size + 1 slots, cache line aligned
+    uint64_t *keys;             // integer keys in the same order, or NULL
+    int (*compare)(const void *key1, const void *key2);
+} BisFrozen;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * copy the live (not hidden) data of @tree into @frozen.
+ * @return      return 0 on success otherwise return -1
+ */
+int bistree_freeze(BisTree *tree, BisFrozen *frozen);
+
+/**
+ * like bistree_freeze(), and also store @key(data) of every data for
+ * bistree_frozen_lookup_u64(). @key must preserve the order of
+ * tree->compare.
+ */
+int bistree_freeze_u64(BisTree *tree, BisFrozen *frozen,
+                       uint64_t (*key)(const void *data));
+
+/**
+ * same semantics as bistree_lookup().
+ */
+int bistree_frozen_lookup(BisFrozen *frozen, void **data);
+
+/**
+ * lookup by integer key, only for snapshots made by bistree_freeze_u64().
+ * @return      return 0 and set *@data on success otherwise return -1
+ */
+int bistree_frozen_lookup_u64(BisFrozen *frozen, uint64_t key, void **data);
+
+/**
+ * free the snapshot, the data is left to the tree.
+ */
+void bistree_frozen_destroy(BisFrozen *frozen);
+
+#ifdef __cplusplus
+}
+#endif
+
+static inline size_t bistree_frozen_size(BisFrozen *frozen)
+{
+    return frozen->size;
+}
+
+#endif
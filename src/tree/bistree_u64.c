@@ -0,0 +1,264 @@
+/* bistree_u64.c --- integer keyed binary search tree
+ *
+ * Filename: bistree_u64.c
+ * Description: AVL tree with inline 64-bit keys
+ * Author: Werther Zhang
+ * Maintainer: Werther Zhang (peng.zhang.dev@gmail.com)
+ * Version: 0
+ * Keywords: binary search tree, avl
+ *
+ */
+
+/* Change Log:
+ *
+ *
+ */
+
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth
+ * Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* Code: */
+
+#include <stdlib.h>
+#include "bistree.h"
+#include "bistree_u64.h"
+
+static inline int height(struct bistree_u64_node *node)
+{
+    return node == NULL ? 0 : node->height;
+}
+
+static inline void update(struct bistree_u64_node *node)
+{
+    int lh = height(node->left), rh = height(node->right);
+
+    node->height = (lh > rh ? lh : rh) + 1;
+}
+
+static struct bistree_u64_node *rotate_left(struct bistree_u64_node *node)
+{
+    struct bistree_u64_node *right = node->right;
+
+    node->right = right->left;
+    right->left = node;
+    update(node);
+    update(right);
+
+    return right;
+}
+
+static struct bistree_u64_node *rotate_right(struct bistree_u64_node *node)
+{
+    struct bistree_u64_node *left = node->left;
+
+    node->left = left->right;
+    left->right = node;
+    update(node);
+    update(left);
+
+    return left;
+}
+
+static struct bistree_u64_node *rebalance(struct bistree_u64_node *node)
+{
+    int factor = height(node->left) - height(node->right);
+
+    if (factor > 1) {
+        if (height(node->left->left) < height(node->left->right))
+            node->left = rotate_left(node->left);
+        return rotate_right(node);
+    }
+
+    if (factor < -1) {
+        if (height(node->right->right) < height(node->right->left))
+            node->right = rotate_right(node->right);
+        return rotate_left(node);
+    }
+
+    update(node);
+    return node;
+}
+
+/**
+ * fix heights and balance from the deepest recorded link back to the root.
+ */
+static void retrace(struct bistree_u64_node **path[], int depth)
+{
+    int old;
+
+    while (--depth >= 0) {
+        struct bistree_u64_node **link = path[depth];
+
+        old = (*link)->height;
+        *link = rebalance(*link);
+        if ((*link)->height == old)
+            break;
+    }
+}
+
+static void destroy_nodes(BisTreeU64 *tree, struct bistree_u64_node *node)
+{
+    struct bistree_u64_node *next;
+
+    // Flatten by rotating left children up, no recursion needed
+    while (node != NULL) {
+        if (node->left != NULL) {
+            next = node->left;
+            node->left = next->right;
+            next->right = node;
+        } else {
+            next = node->right;
+            if (tree->destroy != NULL)
+                tree->destroy(node->data);
+            free(node);
+        }
+        node = next;
+    }
+}
+
+void bistree_u64_init(BisTreeU64 *tree, void (*destroy)(void *data))
+{
+    tree->size = 0;
+    tree->root = NULL;
+    tree->destroy = destroy;
+}
+
+void bistree_u64_destroy(BisTreeU64 *tree)
+{
+    destroy_nodes(tree, tree->root);
+    tree->root = NULL;
+    tree->size = 0;
+
+    return;
+}
+
+int bistree_u64_insert(BisTreeU64 *tree, uint64_t key, const void *data)
+{
+    struct bistree_u64_node **path[BISTREE_MAX_HEIGHT];
+    struct bistree_u64_node **link = &tree->root;
+    struct bistree_u64_node *node;
+    int depth = 0;
+
+    while (*link != NULL) {
+        if (key == (*link)->key)
+            return 1;
+        path[depth++] = link;
+        link = key < (*link)->key ? &(*link)->left : &(*link)->right;
+    }
+
+    if ((node = (struct bistree_u64_node *)malloc(sizeof(struct bistree_u64_node))) == NULL)
+        return -1;
+
+    node->key = key;
+    node->data = (void *)data;
+    node->left = NULL;
+    node->right = NULL;
+    node->height = 1;
+    *link = node;
+    tree->size++;
+
+    retrace(path, depth);
+
+    return 0;
+}
+
+int bistree_u64_remove(BisTreeU64 *tree, uint64_t key)
+{
+    struct bistree_u64_node **path[BISTREE_MAX_HEIGHT];
+    struct bistree_u64_node **link = &tree->root;
+    struct bistree_u64_node *node, *successor;
+    int depth = 0, at;
+
+    while (*link != NULL && (*link)->key != key) {
+        path[depth++] = link;
+        link = key < (*link)->key ? &(*link)->left : &(*link)->right;
+    }
+
+    if ((node = *link) == NULL)
+        return -1;
+
+    if (node->left == NULL || node->right == NULL) {
+        *link = node->left != NULL ? node->left : node->right;
+    } else {
+        // Unlink the in-order successor and put it in place of node
+        at = depth;
+        path[depth++] = link;
+        link = &node->right;
+        while ((*link)->left != NULL) {
+            path[depth++] = link;
+            link = &(*link)->left;
+        }
+        successor = *link;
+        *link = successor->right;
+        successor->left = node->left;
+        successor->right = node->right;
+        successor->height = node->height;
+        *path[at] = successor;
+        // The recorded link into the old right subtree moved with it
+        if (at + 1 < depth)
+            path[at + 1] = &successor->right;
+    }
+
+    if (tree->destroy != NULL)
+        tree->destroy(node->data);
+    free(node);
+    tree->size--;
+
+    // Removal may need a rotation at every level, so no early stop here
+    while (--depth >= 0)
+        *path[depth] = rebalance(*path[depth]);
+
+    return 0;
+}
+
+int bistree_u64_lookup(BisTreeU64 *tree, uint64_t key, void **data)
+{
+    struct bistree_u64_node *node = tree->root;
+
+    while (node != NULL) {
+        if (key == node->key) {
+            *data = node->data;
+            return 0;
+        }
+        node = key < node->key ? node->left : node->right;
+    }
+
+    return -1;
+}
+
+int bistree_u64_foreach(BisTreeU64 *tree,
+                        int (*visit)(uint64_t key, void *data, void *ctx), void *ctx)
+{
+    struct bistree_u64_node *stack[BISTREE_MAX_HEIGHT];
+    struct bistree_u64_node *node = tree->root;
+    int top = 0, count = 0;
+
+    while (node != NULL || top > 0) {
+        while (node != NULL) {
+            stack[top++] = node;
+            node = node->left;
+        }
+        node = stack[--top];
+        count++;
+        if (visit(node->key, node->data, ctx) != 0)
+            break;
+        node = node->right;
+    }
+
+    return count;
+}
+
+/* bistree_u64.c ends here */
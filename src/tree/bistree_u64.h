@@ -0,0 +1,78 @@
+#ifndef BISTREE_U64_H
+#define BISTREE_U64_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * AVL tree keyed by a 64-bit integer. The key lives in the node and is
+ * compared directly, so a lookup touches one cache line per level and
+ * never calls through a compare pointer.
+ */
+
+struct bistree_u64_node {
+    uint64_t key;
+    void *data;
+    struct bistree_u64_node *left;
+    struct bistree_u64_node *right;
+    int height;
+};
+
+typedef struct bistree_u64_ {
+    size_t size;
+    struct bistree_u64_node *root;
+    void (*destroy)(void *data);
+} BisTreeU64;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * init integer keyed tree.
+ * @destroy     destroy private data in BisTreeU64, may be NULL.
+ */
+void bistree_u64_init(BisTreeU64 *tree, void (*destroy)(void *data));
+
+/**
+ * destroy tree, include all data.
+ */
+void bistree_u64_destroy(BisTreeU64 *tree);
+
+/**
+ * insert @data under @key.
+ * @return      return 0 on success, 1 if @key is already in the tree,
+ *              -1 on error.
+ */
+int bistree_u64_insert(BisTreeU64 *tree, uint64_t key, const void *data);
+
+/**
+ * remove @key, its data is passed to tree->destroy.
+ * @return      return 0 on success otherwise return -1
+ */
+int bistree_u64_remove(BisTreeU64 *tree, uint64_t key);
+
+/**
+ * lookup @key, on success *@data is set to its data.
+ * @return      return 0 on success otherwise return -1
+ */
+int bistree_u64_lookup(BisTreeU64 *tree, uint64_t key, void **data);
+
+/**
+ * visit all entries in ascending key order.
+ * @visit       return non-zero to stop.
+ * @return      number of visited entries.
+ */
+int bistree_u64_foreach(BisTreeU64 *tree,
+                        int (*visit)(uint64_t key, void *data, void *ctx), void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+static inline size_t bistree_u64_size(BisTreeU64 *tree)
+{
+    return tree->size;
+}
+
+#endif
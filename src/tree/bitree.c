@@ -39,27 +39,186 @@
 /* Code: */
 
 
+#include <errno.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 #include "bitree.h"
+#include "../thread/wspool.h"
 
 void bitree_init(struct bitree_tree *tree, void (*destroy)(void *data))
 {
     tree->size = 0;
     tree->destroy = destroy;
     tree->root = NULL;
+    tree->sized = 0;
+    tree->pool = NULL;
 
     return;
 }
 
+void bitree_init_sized(struct bitree_tree *tree, void (*destroy)(void *data))
+{
+    bitree_init(tree, destroy);
+    tree->sized = 1;
+
+    return;
+}
+
+/**
+ * add @delta to the counts of @node and all its ancestors.
+ */
+static void add_count(struct bitree_node *node, int delta)
+{
+    struct bitree_snode *snode;
+
+    for (snode = bitree_snode(node); snode != NULL; snode = snode->parent)
+        snode->count += delta;
+}
+
+/**
+ * hang @child below @parent in a sized tree.
+ */
+static void attach(struct bitree_node *parent, struct bitree_node *child)
+{
+    bitree_snode(child)->parent = bitree_snode(parent);
+    add_count(parent, bitree_count(child));
+}
+
+/*
+ * Node pools. A slab starts with its list link, nodes follow back to
+ * back; freed nodes are chained through their left pointer. Nodes are
+ * 24 or 40 bytes and only need the alignment of a pointer.
+ */
+#define BITREE_SLAB_SIZE (64 * 1024)
+#define BITREE_HUGE_SLAB_SIZE (2 * 1024 * 1024)
+
+struct bitree_slab {
+    struct bitree_slab *next;
+    size_t pad;                 // header size, the first node starts at 16
+};
+
+static struct bitree_node *pool_alloc(struct bitree_pool *pool)
+{
+    struct bitree_node *node;
+    struct bitree_slab *slab;
+    void *mem;
+
+    if ((node = pool->free) != NULL) {
+        pool->free = node->left;
+        return node;
+    }
+
+    if (pool->next + pool->object > pool->end) {
+        if (posix_memalign(&mem, pool->flags & BITREE_POOL_HUGEPAGE ?
+                           pool->slab_size : 64, pool->slab_size) != 0)
+            return NULL;
+#ifdef MADV_HUGEPAGE
+        if (pool->flags & BITREE_POOL_HUGEPAGE)
+            madvise(mem, pool->slab_size, MADV_HUGEPAGE);
+#endif
+        slab = (struct bitree_slab *)mem;
+        slab->next = pool->slabs;
+        pool->slabs = slab;
+        pool->next = (char *)mem + sizeof(struct bitree_slab);
+        pool->end = (char *)mem + pool->slab_size;
+    }
+
+    node = (struct bitree_node *)pool->next;
+    pool->next += pool->object;
+
+    return node;
+}
+
+static void pool_free(struct bitree_pool *pool, struct bitree_node *node)
+{
+    node->left = pool->free;
+    pool->free = node;
+}
+
+/**
+ * release all nodes of @tree, walking them only when needed.
+ */
+static void pool_teardown(struct bitree_tree *tree)
+{
+    struct bitree_pool *pool = tree->pool;
+    struct bitree_node *node = tree->root, *next;
+    struct bitree_slab *slab;
+    int last = --pool->refcount == 0;
+
+    if (tree->destroy != NULL || !last) {
+        // Rotate left children up so the tree unrolls to the right, no stack
+        while (node != NULL) {
+            if (node->left != NULL) {
+                next = node->left;
+                node->left = next->right;
+                next->right = node;
+            } else {
+                next = node->right;
+                if (tree->destroy != NULL)
+                    tree->destroy(node->data);
+                if (!last)
+                    pool_free(pool, node);
+            }
+            node = next;
+        }
+    }
+
+    if (last) {
+        while ((slab = pool->slabs) != NULL) {
+            pool->slabs = slab->next;
+            free(slab);
+        }
+        free(pool);
+    }
+}
+
+int bitree_use_pool(struct bitree_tree *tree, int flags)
+{
+    struct bitree_pool *pool;
+
+    if (tree->pool != NULL || bitree_size(tree) > 0)
+        return -1;
+
+    if ((pool = (struct bitree_pool *)malloc(sizeof(struct bitree_pool))) == NULL)
+        return -1;
+
+    pool->refcount = 1;
+    pool->flags = flags;
+    pool->object = tree->sized ? sizeof(struct bitree_snode) : sizeof(struct bitree_node);
+    pool->slab_size = flags & BITREE_POOL_HUGEPAGE ? BITREE_HUGE_SLAB_SIZE : BITREE_SLAB_SIZE;
+    pool->free = NULL;
+    pool->next = NULL;
+    pool->end = NULL;
+    pool->slabs = NULL;
+    tree->pool = pool;
+
+    return 0;
+}
+
 void bitree_destroy(struct bitree_tree *tree)
 {
-    bitree_rm_left(tree, NULL);
+    if (tree->pool != NULL)
+        pool_teardown(tree);
+    else
+        bitree_rm_left(tree, NULL);
     bzero(tree, sizeof(struct bitree_tree));
     return;
 }
 
+/**
+ * give @node back to where it came from.
+ */
+static void node_free(struct bitree_tree *tree, struct bitree_node *node)
+{
+    if (tree->pool != NULL)
+        pool_free(tree->pool, node);
+    else
+        free(node);
+}
+
 int bitree_node_init(struct bitree_node **node, const void *data)
 {
     (*node) = (struct bitree_node *)malloc(sizeof(struct bitree_node));
@@ -74,6 +233,47 @@ int bitree_node_init(struct bitree_node **node, const void *data)
     return 0;
 }
 
+int bitree_snode_init(struct bitree_node **node, const void *data)
+{
+    struct bitree_snode *snode;
+
+    snode = (struct bitree_snode *)malloc(sizeof(struct bitree_snode));
+    if (snode == NULL) {
+        return -1;
+    }
+
+    snode->node.data = (void *)data;
+    snode->node.left = NULL;
+    snode->node.right = NULL;
+    snode->parent = NULL;
+    snode->count = 1;
+    *node = &snode->node;
+
+    return 0;
+}
+
+int bitree_node_alloc(struct bitree_tree *tree, struct bitree_node **node,
+                      const void *data)
+{
+    if (tree->pool == NULL) {
+        return tree->sized ? bitree_snode_init(node, data)
+            : bitree_node_init(node, data);
+    }
+
+    if ((*node = pool_alloc(tree->pool)) == NULL)
+        return -1;
+
+    (*node)->data = (void *)data;
+    (*node)->left = NULL;
+    (*node)->right = NULL;
+    if (tree->sized) {
+        bitree_snode(*node)->parent = NULL;
+        bitree_snode(*node)->count = 1;
+    }
+
+    return 0;
+}
+
 int bitree_ins_left_data(struct bitree_tree *root,
                     struct bitree_node *parent, const void *data)
 {
@@ -91,10 +291,12 @@ int bitree_ins_left_data(struct bitree_tree *root,
         position = &parent->left;
     }
 
-    if (bitree_node_init(&new_node, data) == -1)
+    if (bitree_node_alloc(root, &new_node, data) == -1)
         return -1;
 
     *position = new_node;
+    if (root->sized)
+        attach(parent, new_node);
 
     root->size++;
 
@@ -118,10 +320,12 @@ int bitree_ins_right_data(struct bitree_tree *root,
         position = &parent->right;
     }
 
-    if (bitree_node_init(&new_node, data))
+    if (bitree_node_alloc(root, &new_node, data))
         return -1;
 
     *position = new_node;
+    if (root->sized)
+        attach(parent, new_node);
 
     root->size++;
 
@@ -146,6 +350,10 @@ int bitree_ins_left_node(struct bitree_tree *root,
     }
 
     *position = left;
+    if (root->sized && left != NULL) {
+        attach(parent, left);
+        root->size += bitree_count(left) - 1;
+    }
 
     root->size++;
 
@@ -170,6 +378,10 @@ int bitree_ins_right_node(struct bitree_tree *root,
     }
 
     *position = right;
+    if (root->sized && right != NULL) {
+        attach(parent, right);
+        root->size += bitree_count(right) - 1;
+    }
 
     root->size++;
 
@@ -179,7 +391,17 @@ int bitree_ins_right_node(struct bitree_tree *root,
 int bitree_merge(struct bitree_tree *merge, struct bitree_tree *left,
                  struct bitree_tree *right, const void *data)
 {
+    struct bitree_pool *pool = left->pool != NULL ? left->pool : right->pool;
+
+    // Pooled nodes can only be mixed with nodes of the same pool
+    if ((left->pool != pool && bitree_size(left) > 0)
+        || (right->pool != pool && bitree_size(right) > 0))
+        return -1;
+
     bitree_init(merge, left->destroy);
+    merge->sized = left->sized;
+    if ((merge->pool = pool) != NULL)
+        pool->refcount++;
 
     if (bitree_ins_left_data(merge, NULL, data) != 0) {
         bitree_destroy(merge);
@@ -189,6 +411,13 @@ int bitree_merge(struct bitree_tree *merge, struct bitree_tree *left,
     bitree_root(merge)->left = bitree_root(left);
     bitree_root(merge)->right = bitree_root(right);
 
+    if (merge->sized) {
+        if (bitree_root(left) != NULL)
+            attach(bitree_root(merge), bitree_root(left));
+        if (bitree_root(right) != NULL)
+            attach(bitree_root(merge), bitree_root(right));
+    }
+
     merge->size = merge->size + bitree_size(left) + bitree_size(right);
 
     left->root = NULL;
@@ -196,6 +425,14 @@ int bitree_merge(struct bitree_tree *merge, struct bitree_tree *left,
     right->root = NULL;
     right->size = 0;
 
+    // The emptied inputs no longer hold on to their pools
+    if (left->pool != NULL)
+        pool_teardown(left);
+    if (right->pool != NULL)
+        pool_teardown(right);
+    left->pool = NULL;
+    right->pool = NULL;
+
     return 0;
 }
 
@@ -208,11 +445,29 @@ int bitree_split(struct bitree_tree *tree, struct bitree_tree *left,
     left->root = bitree_root(tree)->left;
     right->root = bitree_root(tree)->right;
 
+    // Both halves keep using the nodes of the shared pool
+    if (tree->pool != NULL) {
+        left->pool = right->pool = tree->pool;
+        tree->pool->refcount += 2;
+    }
+
     // we will free it at root
     //bitree_root(tree)->left = NULL;
     //bitree_root(tree)->right = NULL;
     //tree->size = 0;
 
+    if (tree->sized) {
+        // Counts are maintained, only the new roots need detaching
+        left->sized = right->sized = 1;
+        if (bitree_root(left) != NULL)
+            bitree_snode(bitree_root(left))->parent = NULL;
+        if (bitree_root(right) != NULL)
+            bitree_snode(bitree_root(right))->parent = NULL;
+        left->size = bitree_count(bitree_root(left));
+        right->size = bitree_count(bitree_root(right));
+        return 0;
+    }
+
     left->size = bitree_node_count(bitree_root(left));
     right->size = bitree_node_count(bitree_root(right));
     return 0;
@@ -237,6 +492,14 @@ int bitree_node_count(struct bitree_node *node)
     return count;
 }
 
+int bitree_subtree_size(struct bitree_tree *tree, struct bitree_node *node)
+{
+    if (tree->sized)
+        return bitree_count(node);
+
+    return bitree_node_count(node);
+}
+
 void bitree_rm_left(struct bitree_tree *tree, struct bitree_node *node)
 {
     struct bitree_node **position;
@@ -253,6 +516,12 @@ void bitree_rm_left(struct bitree_tree *tree, struct bitree_node *node)
 
     // remove the node
     if (*position != NULL) {
+        if (tree->sized) {
+            // Fix the ancestors once, the recursion below stops at *position
+            add_count(node, -bitree_count(*position));
+            bitree_snode(*position)->parent = NULL;
+        }
+
         bitree_rm_left(tree, *position);
         bitree_rm_right(tree, *position);
 
@@ -260,7 +529,7 @@ void bitree_rm_left(struct bitree_tree *tree, struct bitree_node *node)
             tree->destroy((*position)->data);
         }
 
-        free(*position);
+        node_free(tree, *position);
         *position = NULL;
 
         tree->size--;
@@ -285,6 +554,11 @@ void bitree_rm_right(struct bitree_tree *tree, struct bitree_node *node)
 
     if (*position != NULL)
     {
+        if (tree->sized) {
+            add_count(node, -bitree_count(*position));
+            bitree_snode(*position)->parent = NULL;
+        }
+
         bitree_rm_left(tree, *position);
         bitree_rm_right(tree, *position);
 
@@ -292,7 +566,7 @@ void bitree_rm_right(struct bitree_tree *tree, struct bitree_node *node)
             tree->destroy((*position)->data);
         }
 
-        free(*position);
+        node_free(tree, *position);
         *position = NULL;
 
         tree->size--;
@@ -300,71 +574,758 @@ void bitree_rm_right(struct bitree_tree *tree, struct bitree_node *node)
     return;
 }
 
-void show_tree_preorder(struct bitree_tree *tree, struct bitree_node *node,
-                        void (*show_data)(void *data))
+#define BITREE_ITER_STACK 64
+
+static int iter_push(struct bitree_iter *iter, struct bitree_node *node)
 {
-    struct bitree_node *current;
-    if (tree != NULL) {
-        current = bitree_root(tree);
-    } else if (node != NULL) {
-        current = node;
-    } else {
+    struct bitree_node **stack;
+
+    if (iter->top == iter->capacity) {
+        stack = (struct bitree_node **)realloc(iter->stack, 2 * iter->capacity
+                                               * sizeof(struct bitree_node *));
+        if (stack == NULL) {
+            iter->error = -1;
+            return -1;
+        }
+        iter->stack = stack;
+        iter->capacity *= 2;
+    }
+
+    iter->stack[iter->top++] = node;
+
+    return 0;
+}
+
+/**
+ * push @node and its left spine.
+ */
+static int iter_push_left(struct bitree_iter *iter, struct bitree_node *node)
+{
+    for (; node != NULL; node = node->left) {
+        if (iter_push(iter, node) != 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+int bitree_iter_init(struct bitree_iter *iter, struct bitree_node *root, int order)
+{
+    iter->order = order;
+    iter->top = 0;
+    iter->error = 0;
+    iter->current = NULL;
+    iter->last = NULL;
+    iter->capacity = BITREE_ITER_STACK;
+    iter->stack = (struct bitree_node **)malloc(iter->capacity
+                                                * sizeof(struct bitree_node *));
+    if (iter->stack == NULL)
+        return -1;
+
+    if (order == BITREE_PREORDER) {
+        if (root != NULL)
+            iter->stack[iter->top++] = root;
+        return 0;
+    }
+
+    if (iter_push_left(iter, root) != 0) {
+        bitree_iter_destroy(iter);
+        return -1;
+    }
+
+    return 0;
+}
+
+struct bitree_node *bitree_iter_next(struct bitree_iter *iter)
+{
+    struct bitree_node *node;
+
+    if (iter->error != 0 || iter->top == 0)
+        return NULL;
+
+    switch (iter->order) {
+    case BITREE_PREORDER:
+        node = iter->stack[--iter->top];
+        if ((node->right != NULL && iter_push(iter, node->right) != 0)
+            || (node->left != NULL && iter_push(iter, node->left) != 0))
+            return NULL;
+        return node;
+
+    case BITREE_INORDER:
+        node = iter->stack[--iter->top];
+        if (iter_push_left(iter, node->right) != 0)
+            return NULL;
+        return node;
+
+    case BITREE_POSTORDER:
+        for (;;) {
+            node = iter->stack[iter->top - 1];
+            // Descend right once, the left side is already on the stack
+            if (node->right != NULL && node->right != iter->last) {
+                if (iter_push_left(iter, node->right) != 0)
+                    return NULL;
+                continue;
+            }
+            iter->top--;
+            iter->last = node;
+            return node;
+        }
+    }
+
+    return NULL;
+}
+
+void bitree_iter_destroy(struct bitree_iter *iter)
+{
+    free(iter->stack);
+    iter->stack = NULL;
+    iter->top = 0;
+}
+
+int bitree_walk(struct bitree_node *root, int order,
+                int (*visit)(void *data, void *ctx), void *ctx)
+{
+    struct bitree_iter iter;
+    struct bitree_node *node;
+    int retval = 0;
+
+    if (bitree_iter_init(&iter, root, order) != 0)
+        return -1;
+
+    while ((node = bitree_iter_next(&iter)) != NULL) {
+        if ((retval = visit(node->data, ctx)) != 0)
+            break;
+    }
+
+    if (iter.error != 0)
+        retval = -1;
+    bitree_iter_destroy(&iter);
+
+    return retval;
+}
+
+int bitree_walk_morris(struct bitree_node *root, int order,
+                       int (*visit)(void *data, void *ctx), void *ctx)
+{
+    struct bitree_node *current = root, *pre;
+    int retval = 0;
+
+    if (order != BITREE_PREORDER && order != BITREE_INORDER)
+        return -1;
+
+    while (current != NULL) {
+        if (current->left == NULL) {
+            if (retval == 0)
+                retval = visit(current->data, ctx);
+            current = current->right;
+            continue;
+        }
+
+        pre = current->left;
+        while (pre->right != NULL && pre->right != current)
+            pre = pre->right;
+
+        if (pre->right == NULL) {
+            // After a stop an untouched left subtree holds no thread
+            if (retval != 0) {
+                current = current->right;
+                continue;
+            }
+            if (order == BITREE_PREORDER)
+                retval = visit(current->data, ctx);
+            pre->right = current;
+            current = current->left;
+        } else {
+            // Back from the left subtree through the thread
+            pre->right = NULL;
+            if (order == BITREE_INORDER && retval == 0)
+                retval = visit(current->data, ctx);
+            current = current->right;
+        }
+    }
+
+    return retval;
+}
+
+/*
+ * Parallel reduce. A subtree task forks its right child with a fresh
+ * accumulator, folds its left child and itself into the accumulator it
+ * was given, then merges the right one behind it.
+ */
+#define BITREE_PAR_DEPTH 12
+#define BITREE_PAR_GRAIN 4096
+
+struct reduce {
+    struct wspool *pool;
+    int sized;
+    void (*map)(void *acc, void *data, void *ctx);
+    void (*combine)(void *acc, const void *other, void *ctx);
+    void (*fn)(void *data, void *ctx);      // for_each
+    const void *identity;
+    size_t size;
+    void *ctx;
+    int error;
+};
+
+struct reduce_task {
+    struct reduce *job;
+    struct bitree_node *node;
+    void *acc;
+    int depth;
+};
+
+static inline void reduce_apply(struct reduce *job, void *acc, void *data)
+{
+    if (job->fn != NULL)
+        job->fn(data, job->ctx);
+    else
+        job->map(acc, data, job->ctx);
+}
+
+static void reduce_walk(struct reduce *job, struct bitree_node *node, void *acc)
+{
+    struct bitree_iter iter;
+
+    if (bitree_iter_init(&iter, node, BITREE_INORDER) == 0) {
+        while ((node = bitree_iter_next(&iter)) != NULL)
+            reduce_apply(job, acc, node->data);
+    }
+
+    if (iter.stack == NULL || iter.error != 0)
+        __atomic_store_n(&job->error, -1, __ATOMIC_RELAXED);
+    bitree_iter_destroy(&iter);
+}
+
+static void reduce_node(struct reduce *job, struct bitree_node *node, void *acc,
+                        int depth);
+
+static void reduce_run(void *arg)
+{
+    struct reduce_task *task = (struct reduce_task *)arg;
+
+    reduce_node(task->job, task->node, task->acc, task->depth);
+}
+
+static void reduce_node(struct reduce *job, struct bitree_node *node, void *acc,
+                        int depth)
+{
+    struct wspool_task spawn;
+    struct reduce_task right;
+
+    for (; node != NULL; node = node->right, depth++) {
+        if (job->pool == NULL || depth >= BITREE_PAR_DEPTH
+            || (job->sized && bitree_count(node) <= BITREE_PAR_GRAIN)) {
+            reduce_walk(job, node, acc);
+            return;
+        }
+
+        right.acc = NULL;
+        if (node->right != NULL && job->size > 0
+            && (right.acc = malloc(job->size)) != NULL)
+            memcpy(right.acc, job->identity, job->size);
+
+        // Without a private accumulator the right side stays in this loop
+        if (node->right == NULL || (job->size > 0 && right.acc == NULL)) {
+            reduce_node(job, node->left, acc, depth + 1);
+            reduce_apply(job, acc, node->data);
+            continue;
+        }
+
+        right.job = job;
+        right.node = node->right;
+        right.depth = depth + 1;
+        wspool_task_init(&spawn, reduce_run, &right);
+        wspool_spawn(job->pool, &spawn);
+
+        reduce_node(job, node->left, acc, depth + 1);
+        reduce_apply(job, acc, node->data);
+
+        wspool_sync(job->pool, &spawn);
+        if (right.acc != NULL) {
+            job->combine(acc, right.acc, job->ctx);
+            free(right.acc);
+        }
         return;
     }
+}
+
+struct reduce_root {
+    struct reduce *job;
+    struct bitree_node *node;
+    void *acc;
+};
+
+static void reduce_root_run(void *arg)
+{
+    struct reduce_root *root = (struct reduce_root *)arg;
 
-    show_data(current->data);
-    show_tree_preorder(NULL, current->left, show_data);
-    show_tree_preorder(NULL, current->right, show_data);
+    reduce_node(root->job, root->node, root->acc, 0);
 }
-void show_tree_posorder(struct bitree_tree *tree, struct bitree_node *node,
-                        void (*show_data)(void *data))
+
+static int reduce(struct reduce *job, struct bitree_tree *tree, void *result)
 {
-    struct bitree_node *current;
-    if (tree != NULL) {
-        current = bitree_root(tree);
-    } else if (node != NULL) {
-        current = node;
+    struct reduce_root root;
+
+    job->sized = tree->sized;
+    job->error = 0;
+
+    if (job->pool == NULL) {
+        reduce_walk(job, bitree_root(tree), result);
     } else {
-        return;
+        root.job = job;
+        root.node = bitree_root(tree);
+        root.acc = result;
+        wspool_run(job->pool, reduce_root_run, &root);
     }
 
-    show_tree_posorder(NULL, current->left, show_data);
-    show_tree_posorder(NULL, current->right, show_data);
-    show_data(current->data);
+    return job->error;
 }
+
+int bitree_parallel_reduce(struct bitree_tree *tree,
+                           void (*map)(void *acc, void *data, void *ctx),
+                           void (*combine)(void *acc, const void *other, void *ctx),
+                           const void *identity, size_t size, void *result,
+                           void *ctx, struct wspool *pool)
+{
+    struct reduce job;
+
+    memset(&job, 0, sizeof(job));
+    job.pool = pool;
+    job.map = map;
+    job.combine = combine;
+    job.identity = identity;
+    job.size = size;
+    job.ctx = ctx;
+
+    memcpy(result, identity, size);
+
+    return reduce(&job, tree, result);
+}
+
+int bitree_parallel_for_each(struct bitree_tree *tree,
+                             void (*fn)(void *data, void *ctx),
+                             void *ctx, struct wspool *pool)
+{
+    struct reduce job;
+
+    memset(&job, 0, sizeof(job));
+    job.pool = pool;
+    job.fn = fn;
+    job.ctx = ctx;
+
+    return reduce(&job, tree, NULL);
+}
+
+/*
+ * The show_tree_* helpers predate bitree_walk() and are kept as thin
+ * wrappers around it.
+ */
+struct show {
+    void (*show_data)(void *data);
+};
+
+static int show_visit(void *data, void *ctx)
+{
+    ((struct show *)ctx)->show_data(data);
+    return 0;
+}
+
+static void show_tree(struct bitree_tree *tree, struct bitree_node *node,
+                      void (*show_data)(void *data), int order)
+{
+    struct show show;
+
+    show.show_data = show_data;
+    bitree_walk(tree != NULL ? bitree_root(tree) : node, order, show_visit, &show);
+}
+
+void show_tree_preorder(struct bitree_tree *tree, struct bitree_node *node,
+                        void (*show_data)(void *data))
+{
+    show_tree(tree, node, show_data, BITREE_PREORDER);
+}
+
+void show_tree_posorder(struct bitree_tree *tree, struct bitree_node *node,
+                        void (*show_data)(void *data))
+{
+    show_tree(tree, node, show_data, BITREE_POSTORDER);
+}
+
 void show_tree_inorder(struct bitree_tree *tree, struct bitree_node *node,
                        void (*show_data)(void *data))
 {
-    struct bitree_node *current;
-    if (tree != NULL) {
-        current = bitree_root(tree);
-    } else if (node != NULL) {
-        current = node;
-    } else {
-        return ;
+    show_tree(tree, node, show_data, BITREE_INORDER);
+}
+
+/*
+ * Builders. Tokens are consumed one at a time, so input of any size is
+ * read through a fixed window.
+ */
+#define BITREE_STREAM_CHUNK (64 * 1024)
+
+void bitree_stream_buffer(struct bitree_stream *in, const char *buf, size_t len)
+{
+    memset(in, 0, sizeof(struct bitree_stream));
+    in->fd = -1;
+    in->buf = buf;
+    in->len = len;
+}
+
+int bitree_stream_fd(struct bitree_stream *in, int fd)
+{
+    memset(in, 0, sizeof(struct bitree_stream));
+    if ((in->chunk = (char *)malloc(BITREE_STREAM_CHUNK)) == NULL)
+        return -1;
+
+    in->fd = fd;
+    in->capacity = BITREE_STREAM_CHUNK;
+    in->buf = in->chunk;
+
+    return 0;
+}
+
+void bitree_stream_close(struct bitree_stream *in)
+{
+    free(in->chunk);
+    memset(in, 0, sizeof(struct bitree_stream));
+    in->fd = -1;
+}
+
+static inline int is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+}
+
+/**
+ * refill the window of an fd stream, keeping the bytes from @keep on.
+ * @return      bytes read, 0 at end of file, -1 on error.
+ */
+static long stream_fill(struct bitree_stream *in, size_t keep)
+{
+    char *grown;
+    long n;
+
+    memmove(in->chunk, in->chunk + keep, in->len - keep);
+    in->len -= keep;
+    in->pos -= keep;
+
+    // A single token filling the whole window
+    if (in->len == in->capacity) {
+        if ((grown = (char *)realloc(in->chunk, 2 * in->capacity)) == NULL)
+            return -1;
+        in->chunk = grown;
+        in->capacity *= 2;
+    }
+
+    do {
+        n = read(in->fd, in->chunk + in->len, in->capacity - in->len);
+    } while (n < 0 && errno == EINTR);
+
+    if (n > 0)
+        in->len += n;
+    in->buf = in->chunk;
+
+    return n;
+}
+
+/**
+ * @return      return 1 with the next token, 0 at the end, -1 on error.
+ */
+static int next_token(struct bitree_stream *in, const char **token, size_t *len)
+{
+    size_t start;
+    long n;
+
+    for (;;) {
+        while (in->pos < in->len && is_space(in->buf[in->pos]))
+            in->pos++;
+        if (in->pos < in->len || in->fd < 0)
+            break;
+        if ((n = stream_fill(in, in->pos)) < 0)
+            return in->error = -1;
+        if (n == 0)
+            return 0;
+    }
+
+    if (in->pos == in->len)
+        return 0;
+
+    start = in->pos;
+    for (;;) {
+        while (in->pos < in->len && !is_space(in->buf[in->pos]))
+            in->pos++;
+        if (in->pos < in->len || in->fd < 0)
+            break;
+        // The token may go on in the next read
+        if ((n = stream_fill(in, start)) < 0)
+            return in->error = -1;
+        start = 0;
+        if (n == 0)
+            break;
+    }
+
+    *token = in->buf + start;
+    *len = in->pos - start;
+
+    return 1;
+}
+
+static int is_null_token(const char *token, size_t len)
+{
+    return len == sizeof(BITREE_NULL_TOKEN) - 1
+        && memcmp(token, BITREE_NULL_TOKEN, len) == 0;
+}
+
+/**
+ * set the subtree counts of a freshly built sized tree.
+ */
+static int count_nodes(struct bitree_tree *tree)
+{
+    struct bitree_iter iter;
+    struct bitree_node *node;
+    int retval;
+
+    if (bitree_iter_init(&iter, bitree_root(tree), BITREE_POSTORDER) != 0) {
+        bitree_iter_destroy(&iter);
+        return -1;
     }
 
-    show_tree_inorder(NULL, current->left, show_data);
-    show_data(current->data);
-    show_tree_inorder(NULL, current->right, show_data);
+    while ((node = bitree_iter_next(&iter)) != NULL)
+        bitree_snode(node)->count = 1 + bitree_count(node->left) + bitree_count(node->right);
+
+    retval = iter.error;
+    bitree_iter_destroy(&iter);
+
+    return retval;
+}
+
+typedef int (*fill_fn)(struct bitree_node *node, const char *token, size_t len,
+                       void *ctx);
+
+/*
+ * Nodes waiting for their right subtree are chained through their own
+ * ->right pointers, which are unused until then, so the only extra
+ * memory is a list head.
+ */
+static int build_preorder(struct bitree_tree *tree, struct bitree_stream *in,
+                          fill_fn fill, void *ctx)
+{
+    struct bitree_node **slot = &tree->root, *owner = NULL, *pending = NULL, *node;
+    const char *token;
+    size_t len;
+    int retval, done = 0;
+
+    if (bitree_size(tree) > 0)
+        return -1;
+
+    while ((retval = next_token(in, &token, &len)) > 0) {
+        if (done) {
+            retval = -1;        // tokens after a complete tree
+            break;
+        }
+
+        if (is_null_token(token, len)) {
+            *slot = NULL;
+            if (pending == NULL) {
+                done = 1;
+                continue;
+            }
+            // The left subtree of the latest pending node is complete
+            owner = pending;
+            pending = owner->right;
+            owner->right = NULL;
+            slot = &owner->right;
+            continue;
+        }
+
+        if (bitree_node_alloc(tree, &node, NULL) != 0) {
+            retval = -1;
+            break;
+        }
+        if (fill(node, token, len, ctx) != 0) {
+            node_free(tree, node);
+            retval = -1;
+            break;
+        }
+
+        if (tree->sized)
+            bitree_snode(node)->parent = bitree_snode(owner);
+        *slot = node;
+        tree->size++;
+
+        node->right = pending;
+        pending = node;
+        owner = node;
+        slot = &node->left;
+    }
+
+    // Unchain what is left, the partial tree stays valid
+    while (pending != NULL) {
+        node = pending;
+        pending = node->right;
+        node->right = NULL;
+    }
+
+    if (retval == 0 && !done && tree->root != NULL)
+        retval = -1;            // truncated input
+    if (retval == 0 && tree->sized)
+        retval = count_nodes(tree);
+
+    return retval;
+}
+
+struct parse_fill {
+    void *(*parse)(const char *token, size_t len, void *ctx);
+    void *ctx;
+};
+
+static int parse_fill(struct bitree_node *node, const char *token, size_t len,
+                      void *ctx)
+{
+    struct parse_fill *pf = (struct parse_fill *)ctx;
+
+    node->data = pf->parse(token, len, pf->ctx);
+
+    return 0;
+}
+
+int bitree_build_preorder(struct bitree_tree *tree, struct bitree_stream *in,
+                          void *(*parse)(const char *token, size_t len, void *ctx),
+                          void *ctx)
+{
+    struct parse_fill pf;
+
+    pf.parse = parse;
+    pf.ctx = ctx;
+
+    return build_preorder(tree, in, parse_fill, &pf);
+}
+
+/*
+ * Preorder + inorder: each new node is the left child of the stack top,
+ * unless the stack top is the next inorder token; then nodes are popped
+ * while they match and the new node is the right child of the last one.
+ * The stack is chained through ->right like in build_preorder().
+ */
+int bitree_build_pre_in(struct bitree_tree *tree, struct bitree_stream *preorder,
+                        struct bitree_stream *inorder,
+                        void *(*parse)(const char *token, size_t len, void *ctx),
+                        int (*match)(const void *data, const char *token, size_t len),
+                        void *ctx)
+{
+    struct bitree_node *stack = NULL, *node, *parent;
+    const char *token, *in_token = NULL;
+    size_t len, in_len = 0;
+    int retval, in_state;
+
+    if (bitree_size(tree) > 0)
+        return -1;
+
+    in_state = next_token(inorder, &in_token, &in_len);
+
+    while ((retval = next_token(preorder, &token, &len)) > 0) {
+        if (bitree_node_alloc(tree, &node, NULL) != 0) {
+            retval = -1;
+            break;
+        }
+        node->data = parse(token, len, ctx);
+
+        parent = NULL;
+        while (stack != NULL && in_state > 0 && match(stack->data, in_token, in_len)) {
+            parent = stack;
+            stack = parent->right;
+            parent->right = NULL;
+            in_state = next_token(inorder, &in_token, &in_len);
+        }
+
+        if (parent != NULL)
+            parent->right = node;
+        else if (stack != NULL)
+            (parent = stack)->left = node;
+        else if (tree->root == NULL)
+            tree->root = node;
+        else
+            retval = -1;        // a second root: the sequences disagree
+
+        if (retval < 0) {
+            if (tree->destroy != NULL)
+                tree->destroy(node->data);
+            node_free(tree, node);
+            break;
+        }
+
+        if (tree->sized)
+            bitree_snode(node)->parent = bitree_snode(parent);
+        tree->size++;
+        node->right = stack;
+        stack = node;
+    }
+
+    // Whatever is still stacked closes the inorder sequence
+    while (stack != NULL) {
+        node = stack;
+        stack = node->right;
+        node->right = NULL;
+        if (retval == 0 && (in_state <= 0 || !match(node->data, in_token, in_len)))
+            retval = -1;
+        if (retval == 0)
+            in_state = next_token(inorder, &in_token, &in_len);
+    }
+
+    if (retval == 0 && in_state != 0)
+        retval = -1;
+    if (retval == 0 && tree->sized)
+        retval = count_nodes(tree);
+
+    return retval;
+}
+
+struct value_fill {
+    void (*build_data)(struct bitree_node *node, char *value);
+    char *copy;
+    size_t capacity;
+};
+
+static int value_fill(struct bitree_node *node, const char *token, size_t len,
+                      void *ctx)
+{
+    struct value_fill *vf = (struct value_fill *)ctx;
+    char *grown;
+
+    // build_data wants a terminated string
+    if (len + 1 > vf->capacity) {
+        if ((grown = (char *)realloc(vf->copy, len + 1)) == NULL)
+            return -1;
+        vf->copy = grown;
+        vf->capacity = len + 1;
+    }
+    memcpy(vf->copy, token, len);
+    vf->copy[len] = '\0';
+
+    vf->build_data(node, vf->copy);
+
+    return 0;
 }
 
 void build_tree_data(struct bitree_tree *tree, struct bitree_node *node ,
                      void (*build_data)(struct bitree_node *node, char *value), char *value)
 {
-    struct bitree_node *current;
-    if (tree != NULL) {
-        current = bitree_root(tree);
-    } else if (node != NULL) {
-        current = node;
-    } else {
+    struct bitree_stream in;
+    struct value_fill vf;
+
+    if (tree == NULL) {
+        if (node != NULL)
+            build_data(node, value);
         return ;
     }
 
-    build_data(current, value);
-    //build_tree_data(NULL, current, build_data, data);
-    //build_data(current, value);
-    //build_tree_data(NULL, current, build_data, data);
+    vf.build_data = build_data;
+    vf.copy = NULL;
+    vf.capacity = 0;
+
+    bitree_stream_buffer(&in, value, strlen(value));
+    build_preorder(tree, &in, value_fill, &vf);
+    free(vf.copy);
 }
 
 /* bitree.c ends here */
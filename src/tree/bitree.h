@@ -1,17 +1,92 @@
 #ifndef BIT_TREE_H
 #define BIT_TREE_H
 
+#include <stddef.h>
+
+struct wspool;
+
 struct bitree_node {
     void *data;
     struct bitree_node *left;
     struct bitree_node *right;
 };
 
+/**
+ * Node of a sized tree, see bitree_init_sized(). @count is the number of
+ * nodes in the subtree rooted here, @parent is NULL at the root.
+ */
+struct bitree_snode {
+    struct bitree_node node;
+    struct bitree_snode *parent;
+    int count;
+};
+
+/**
+ * Node pool of a tree, see bitree_use_pool(). Nodes are carved from large
+ * slabs and recycled through a free list; trees produced by bitree_split
+ * share the pool of their source, hence the reference count.
+ */
+struct bitree_slab;
+
+struct bitree_pool {
+    int refcount;
+    int flags;
+    size_t object;              // node size
+    size_t slab_size;
+    struct bitree_node *free;   // recycled nodes, linked through ->left
+    char *next;                 // unused part of the newest slab
+    char *end;
+    struct bitree_slab *slabs;
+};
+
+enum bitree_pool_flags_ {
+    BITREE_POOL_HUGEPAGE = 1,   // 2MB slabs advised as transparent huge pages
+};
+
 struct bitree_tree {
     int size;
     struct bitree_node *root;
     int (*compare)(const void *key1, const void *key2);
     void (*destroy)(void *data); // destroy data;
+    int sized;                   // nodes are struct bitree_snode
+    struct bitree_pool *pool;    // NULL when nodes come from malloc
+};
+
+enum bitree_order_ {
+    BITREE_PREORDER = 0,
+    BITREE_INORDER,
+    BITREE_POSTORDER,
+};
+
+/**
+ * External traversal iterator, the pending nodes are kept on a heap
+ * allocated stack so degenerate trees do not use the call stack.
+ */
+struct bitree_iter {
+    int order;
+    int top;
+    int capacity;
+    int error;                  // -1 once the stack could not grow
+    struct bitree_node **stack;
+    struct bitree_node *current;
+    struct bitree_node *last;   // last node returned, for postorder
+};
+
+/**
+ * Token source of the tree builders: whitespace separated tokens read from
+ * a memory buffer or incrementally from a file descriptor. The token
+ * BITREE_NULL_TOKEN marks a missing child in preorder input.
+ */
+#define BITREE_NULL_TOKEN "#"
+
+struct bitree_stream {
+    int fd;                     // -1 for a memory buffer
+    int error;
+    const char *buf;
+    size_t len;
+    size_t pos;
+    char *chunk;                // read buffer of an fd stream
+    size_t capacity;
 };
 
 #ifdef __cplusplus
@@ -25,6 +100,26 @@ extern "C" {
      */
     void bitree_init(struct bitree_tree *tree, void (*destroy)(void *data));
 
+    /**
+     * init a sized bit tree. Its nodes are struct bitree_snode, and the
+     * subtree counts are kept up to date by bitree_ins_*, bitree_rm_*,
+     * bitree_merge and bitree_split, so split and size queries are O(1).
+     * Nodes handed to bitree_ins_*_node must come from bitree_snode_init(),
+     * and both trees given to bitree_merge must be sized.
+     */
+    void bitree_init_sized(struct bitree_tree *tree, void (*destroy)(void *data));
+
+    /**
+     * allocate the nodes of the empty @tree from a private pool, call right
+     * after bitree_init() or bitree_init_sized(). bitree_destroy then
+     * releases whole slabs and only visits nodes to call tree->destroy.
+     * Nodes handed to bitree_ins_*_node must come from bitree_node_alloc()
+     * on the same tree, and bitree_merge only joins trees sharing a pool.
+     * @flags       BITREE_POOL_HUGEPAGE or 0.
+     * @return      return 0 on success otherwise return -1
+     */
+    int bitree_use_pool(struct bitree_tree *tree, int flags);
+
     /**
      * destroy bitree, include all data.
      */
@@ -37,6 +132,17 @@ extern "C" {
 
     int bitree_node_init(struct bitree_node **node, const void *data);
 
+    /**
+     * init a node for a sized tree.
+     */
+    int bitree_snode_init(struct bitree_node **node, const void *data);
+
+    /**
+     * init a node suitable for @tree: from its pool, sized or plain.
+     */
+    int bitree_node_alloc(struct bitree_tree *tree, struct bitree_node **node,
+                          const void *data);
+
     /**
      * init bitree_node for @data and insert it as the left child of @parent.
      * If @parent is NULL, create @root.
@@ -73,6 +179,11 @@ extern "C" {
 
 
     int bitree_node_count(struct bitree_node *node);
+
+    /**
+     * number of nodes under @node, O(1) in a sized tree.
+     */
+    int bitree_subtree_size(struct bitree_tree *tree, struct bitree_node *node);
     /**
      * merge two tree into @merge, and the data of @merge is @data.
      */
@@ -82,6 +193,65 @@ extern "C" {
     void bitree_rm_left(struct bitree_tree *root, struct bitree_node *node);
     void bitree_rm_right(struct bitree_tree *root, struct bitree_node *node);
 
+    /**
+     * start iterating the subtree @root in @order (enum bitree_order_).
+     * @return      return 0 on success otherwise return -1, and @iter
+     *              needs no bitree_iter_destroy() then.
+     */
+    int bitree_iter_init(struct bitree_iter *iter, struct bitree_node *root, int order);
+
+    /**
+     * @return      the next node, NULL at the end or if iter->error is set.
+     */
+    struct bitree_node *bitree_iter_next(struct bitree_iter *iter);
+
+    void bitree_iter_destroy(struct bitree_iter *iter);
+
+    /**
+     * visit the subtree @root in @order with an explicit stack.
+     * @visit       return non-zero to stop the walk.
+     * @return      0 after a full walk, the non-zero value of @visit when
+     *              it stopped, -1 if out of memory.
+     */
+    int bitree_walk(struct bitree_node *root, int order,
+                    int (*visit)(void *data, void *ctx), void *ctx);
+
+    /**
+     * bitree_walk() in O(1) extra space with Morris threading. The tree is
+     * temporarily modified, so nothing else may access it during the walk;
+     * it is fully restored on return, also after an early stop.
+     * Only BITREE_PREORDER and BITREE_INORDER are supported.
+     * @return      as bitree_walk(), -1 for an unsupported @order.
+     */
+    int bitree_walk_morris(struct bitree_node *root, int order,
+                           int (*visit)(void *data, void *ctx), void *ctx);
+
+    /**
+     * fold all data of @tree in key (in-)order on @pool, like
+     *     result = identity; for each data: map(result, data)
+     * Subtrees are folded into private accumulators of @size bytes which
+     * start as a copy of @identity and are merged with @combine(acc, other)
+     * in order, so @combine has to be associative but need not commute.
+     * Work is split at subtrees down to a fixed depth, or down to a few
+     * thousand nodes in a sized tree, then walked sequentially.
+     * @pool        NULL to run in the calling thread.
+     * @return      return 0 on success otherwise return -1
+     */
+    int bitree_parallel_reduce(struct bitree_tree *tree,
+                               void (*map)(void *acc, void *data, void *ctx),
+                               void (*combine)(void *acc, const void *other, void *ctx),
+                               const void *identity, size_t size, void *result,
+                               void *ctx, struct wspool *pool);
+
+    /**
+     * call @fn on all data of @tree from the workers of @pool, in no
+     * particular order.
+     * @return      return 0 on success otherwise return -1
+     */
+    int bitree_parallel_for_each(struct bitree_tree *tree,
+                                 void (*fn)(void *data, void *ctx),
+                                 void *ctx, struct wspool *pool);
+
     void show_tree_preorder(struct bitree_tree *tree, struct bitree_node *node,
                             void (*show_data)(void *data));
     void show_tree_posorder(struct bitree_tree *tree, struct bitree_node *node,
@@ -89,6 +259,43 @@ extern "C" {
     void show_tree_inorder(struct bitree_tree *tree, struct bitree_node *node,
                            void (*show_data)(void *data));
 
+    /**
+     * token sources for the builders. bitree_stream_fd() only reads from
+     * @fd, bitree_stream_close() does not close it.
+     */
+    void bitree_stream_buffer(struct bitree_stream *in, const char *buf, size_t len);
+    int bitree_stream_fd(struct bitree_stream *in, int fd);
+    void bitree_stream_close(struct bitree_stream *in);
+
+    /**
+     * build the empty @tree from preorder tokens with null markers, e.g.
+     * "1 2 # # 3 # #", without recursion. Nodes come from the tree pool
+     * when bitree_use_pool() was called, so they are allocated in slabs.
+     * @parse       make the data of a node from a token, not terminated.
+     * @return      return 0 on success otherwise return -1. On error the
+     *              nodes built so far stay in @tree.
+     */
+    int bitree_build_preorder(struct bitree_tree *tree, struct bitree_stream *in,
+                              void *(*parse)(const char *token, size_t len, void *ctx),
+                              void *ctx);
+
+    /**
+     * build the empty @tree from its preorder and inorder tokens, which
+     * must be unique, in O(n) time without recursion.
+     * @match       return non-zero if @data was parsed from @token.
+     * @return      as bitree_build_preorder().
+     */
+    int bitree_build_pre_in(struct bitree_tree *tree, struct bitree_stream *preorder,
+                            struct bitree_stream *inorder,
+                            void *(*parse)(const char *token, size_t len, void *ctx),
+                            int (*match)(const void *data, const char *token, size_t len),
+                            void *ctx);
+
+    /**
+     * build @tree from the preorder string @value (see
+     * bitree_build_preorder), @build_data fills each new node from its
+     * token. With @tree NULL, @build_data is only applied to @node.
+     */
     void build_tree_data(struct bitree_tree *tree, struct bitree_node *node ,
                          void (*build_data)(struct bitree_node *node, char *value), char *value);
 #ifdef __cplusplus
@@ -102,6 +309,9 @@ extern "C" {
 #define bitree_left(node) ((node)->left)
 #define bitree_right(node) ((node)->right)
 #define bitree_is_eob(node) ((node) == NULL)
+#define bitree_snode(node) ((struct bitree_snode *)(node))
+#define bitree_parent(node) ((struct bitree_node *)bitree_snode(node)->parent)
+#define bitree_count(node) ((node) == NULL ? 0 : bitree_snode(node)->count)
 // #define data2node(data) \
 //     (struct bitree_node*)((char *)data - \
 //                           (unsigned long)(((struct bitree_node*)(0))->data))
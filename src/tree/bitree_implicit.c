@@ -0,0 +1,370 @@
+/* bitree_implicit.c --- implicit complete binary tree
+ *
+ * Filename: bitree_implicit.c
+ * Description: array backed complete binary tree
+ * Author: Werther Zhang
+ * Maintainer: Werther Zhang (peng.zhang.dev@gmail.com)
+ * Version: 0
+ * Keywords: binary tree, implicit, complete
+ *
+ */
+
+/* Change Log:
+ *
+ *
+ */
+
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth
+ * Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* Code: */
+
+#include <stdlib.h>
+#include <string.h>
+#include "bitree_implicit.h"
+
+#define BITREE_IMPLICIT_MIN 16
+
+static int reserve(struct bitree_implicit *tree, size_t capacity)
+{
+    void **data;
+
+    if (capacity < BITREE_IMPLICIT_MIN)
+        capacity = BITREE_IMPLICIT_MIN;
+
+    if (capacity <= tree->capacity)
+        return 0;
+
+    if ((data = (void **)realloc(tree->data, capacity * sizeof(void *))) == NULL)
+        return -1;
+
+    tree->data = data;
+    tree->capacity = capacity;
+
+    return 0;
+}
+
+/**
+ * forget all nodes without destroying their data.
+ */
+static void clear(struct bitree_implicit *tree)
+{
+    free(tree->data);
+    tree->data = NULL;
+    tree->size = 0;
+    tree->capacity = 0;
+}
+
+static int height(size_t size)
+{
+    int h = 0;
+
+    while (size > 0) {
+        h++;
+        size >>= 1;
+    }
+
+    return h;
+}
+
+static inline int is_perfect(size_t size)
+{
+    return ((size + 1) & size) == 0;
+}
+
+/**
+ * copy the subtree of @node in @src to @dst, level by level.
+ */
+static void copy_subtree(struct bitree_implicit *dst, const struct bitree_implicit *src,
+                         size_t node)
+{
+    size_t lo = node, hi = node, last;
+
+    while (lo < src->size) {
+        last = hi < src->size ? hi : src->size - 1;
+        memcpy(dst->data + dst->size, src->data + lo, (last - lo + 1) * sizeof(void *));
+        dst->size += last - lo + 1;
+        lo = 2 * lo + 1;
+        hi = 2 * hi + 2;
+    }
+}
+
+void bitree_implicit_init(struct bitree_implicit *tree, void (*destroy)(void *data))
+{
+    tree->size = 0;
+    tree->capacity = 0;
+    tree->data = NULL;
+    tree->destroy = destroy;
+}
+
+void bitree_implicit_destroy(struct bitree_implicit *tree)
+{
+    size_t i;
+
+    if (tree->destroy != NULL) {
+        for (i = 0; i < tree->size; i++)
+            tree->destroy(tree->data[i]);
+    }
+
+    clear(tree);
+
+    return;
+}
+
+int bitree_implicit_push(struct bitree_implicit *tree, const void *data)
+{
+    if (tree->size == tree->capacity && reserve(tree, 2 * tree->capacity) != 0)
+        return -1;
+
+    tree->data[tree->size++] = (void *)data;
+
+    return 0;
+}
+
+int bitree_implicit_pop(struct bitree_implicit *tree, void **data)
+{
+    if (tree->size == 0)
+        return -1;
+
+    *data = tree->data[--tree->size];
+
+    return 0;
+}
+
+/*
+ * A node is entered from its parent, then comes back from its left and
+ * from its right child; which one follows from the parity of the child.
+ */
+int bitree_implicit_walk(struct bitree_implicit *tree, long node, int order,
+                         int (*visit)(void *data, void *ctx), void *ctx)
+{
+    enum { DOWN, FROM_LEFT, FROM_RIGHT } from = DOWN;
+    long root = node, next;
+    int retval;
+
+    if (node < 0 || (size_t)node >= tree->size)
+        return 0;
+
+    while (node != BITREE_IMPLICIT_NONE) {
+        if (from == DOWN) {
+            if (order == BITREE_PREORDER
+                && (retval = visit(tree->data[node], ctx)) != 0)
+                return retval;
+            if ((next = bitree_implicit_left(tree, node)) != BITREE_IMPLICIT_NONE) {
+                node = next;
+                continue;
+            }
+            from = FROM_LEFT;
+        }
+
+        if (from == FROM_LEFT) {
+            if (order == BITREE_INORDER
+                && (retval = visit(tree->data[node], ctx)) != 0)
+                return retval;
+            if ((next = bitree_implicit_right(tree, node)) != BITREE_IMPLICIT_NONE) {
+                node = next;
+                from = DOWN;
+                continue;
+            }
+        }
+
+        if (order == BITREE_POSTORDER
+            && (retval = visit(tree->data[node], ctx)) != 0)
+            return retval;
+
+        if (node == root)
+            break;
+        from = node & 1 ? FROM_LEFT : FROM_RIGHT;
+        node = bitree_implicit_parent(tree, node);
+    }
+
+    return 0;
+}
+
+size_t bitree_implicit_subtree_size(struct bitree_implicit *tree, long node)
+{
+    size_t lo = node, hi = node, count = 0;
+
+    if (node < 0)
+        return 0;
+
+    while (lo < tree->size) {
+        count += (hi < tree->size ? hi : tree->size - 1) - lo + 1;
+        lo = 2 * lo + 1;
+        hi = 2 * hi + 2;
+    }
+
+    return count;
+}
+
+int bitree_implicit_split(struct bitree_implicit *tree, struct bitree_implicit *left,
+                          struct bitree_implicit *right)
+{
+    bitree_implicit_init(left, tree->destroy);
+    bitree_implicit_init(right, tree->destroy);
+
+    if (tree->size == 0)
+        return -1;
+
+    if (reserve(left, bitree_implicit_subtree_size(tree, 1)) != 0
+        || reserve(right, bitree_implicit_subtree_size(tree, 2)) != 0) {
+        clear(left);
+        clear(right);
+        return -1;
+    }
+
+    copy_subtree(left, tree, 1);
+    copy_subtree(right, tree, 2);
+    tree->size = 1;
+
+    return 0;
+}
+
+int bitree_implicit_merge(struct bitree_implicit *merge, struct bitree_implicit *left,
+                          struct bitree_implicit *right, const void *data)
+{
+    int hl = height(left->size), hr = height(right->size);
+    size_t level, lo, n;
+
+    if (!((is_perfect(left->size) && hl == hr)
+          || (is_perfect(right->size) && hl == hr + 1)))
+        return -1;
+
+    bitree_implicit_init(merge, left->destroy);
+    if (reserve(merge, 1 + left->size + right->size) != 0)
+        return -1;
+
+    merge->data[merge->size++] = (void *)data;
+
+    // Level d of the result is level d-1 of left followed by that of right
+    for (level = 1, lo = 0; lo < left->size; level <<= 1, lo = 2 * lo + 1) {
+        n = left->size - lo < level ? left->size - lo : level;
+        memcpy(merge->data + merge->size, left->data + lo, n * sizeof(void *));
+        merge->size += n;
+        if (lo < right->size) {
+            n = right->size - lo < level ? right->size - lo : level;
+            memcpy(merge->data + merge->size, right->data + lo, n * sizeof(void *));
+            merge->size += n;
+        }
+    }
+
+    clear(left);
+    clear(right);
+
+    return 0;
+}
+
+int bitree_implicit_from_bitree(struct bitree_implicit *implicit, struct bitree_tree *tree)
+{
+    struct bitree_node *node, *child[2];
+    void (*destroy)(void *data);
+    size_t head, tail = 0, capacity;
+    int gap = 0, i;
+
+    if (implicit->size > 0)
+        return -1;
+
+    capacity = implicit->capacity;
+    if (bitree_root(tree) != NULL) {
+        if (reserve(implicit, BITREE_IMPLICIT_MIN) != 0)
+            return -1;
+        implicit->data[tail++] = bitree_root(tree);
+    }
+
+    // Level order with the node pointers in the data array, no gap allowed
+    for (head = 0; head < tail; head++) {
+        node = (struct bitree_node *)implicit->data[head];
+        child[0] = node->left;
+        child[1] = node->right;
+        for (i = 0; i < 2; i++) {
+            if (child[i] == NULL) {
+                gap = 1;
+                continue;
+            }
+            if (gap || (tail == implicit->capacity
+                        && reserve(implicit, 2 * implicit->capacity) != 0)) {
+                if (capacity == 0)
+                    clear(implicit);
+                return -1;
+            }
+            implicit->data[tail++] = child[i];
+        }
+    }
+
+    for (head = 0; head < tail; head++)
+        implicit->data[head] = ((struct bitree_node *)implicit->data[head])->data;
+    implicit->size = tail;
+
+    // The data now belongs to @implicit
+    destroy = tree->destroy;
+    tree->destroy = NULL;
+    bitree_rm_left(tree, NULL);
+    tree->destroy = destroy;
+    tree->size = 0;
+
+    return 0;
+}
+
+int bitree_implicit_to_bitree(struct bitree_implicit *implicit, struct bitree_tree *tree)
+{
+    struct bitree_node **nodes, *parent;
+    void (*destroy)(void *data);
+    size_t i;
+
+    if (bitree_size(tree) > 0)
+        return -1;
+
+    if (implicit->size == 0)
+        return 0;
+
+    if ((nodes = (struct bitree_node **)malloc(implicit->size * sizeof(*nodes))) == NULL)
+        return -1;
+
+    for (i = 0; i < implicit->size; i++) {
+        if (bitree_node_alloc(tree, &nodes[i], implicit->data[i]) != 0) {
+            // Drop the nodes linked so far, the data stays in @implicit
+            destroy = tree->destroy;
+            tree->destroy = NULL;
+            bitree_rm_left(tree, NULL);
+            tree->destroy = destroy;
+            free(nodes);
+            return -1;
+        }
+
+        if (i == 0) {
+            tree->root = nodes[i];
+        } else {
+            parent = nodes[(i - 1) / 2];
+            if (i & 1)
+                parent->left = nodes[i];
+            else
+                parent->right = nodes[i];
+        }
+
+        if (tree->sized) {
+            bitree_snode(nodes[i])->parent = i == 0 ? NULL : bitree_snode(nodes[(i - 1) / 2]);
+            bitree_snode(nodes[i])->count = (int)bitree_implicit_subtree_size(implicit, i);
+        }
+        tree->size++;
+    }
+
+    free(nodes);
+    clear(implicit);
+
+    return 0;
+}
+
+/* bitree_implicit.c ends here */
@@ -0,0 +1,114 @@
+#ifndef BITREE_IMPLICIT_H
+#define BITREE_IMPLICIT_H
+
+#include <stddef.h>
+#include "bitree.h"
+
+/**
+ * Complete binary tree stored in level order in one array: the children
+ * of node i are 2i+1 and 2i+2, its parent is (i-1)/2. There are no child
+ * pointers, and nodes only ever get added or removed at the end, so the
+ * tree stays complete.
+ */
+struct bitree_implicit {
+    size_t size;
+    size_t capacity;
+    void **data;
+    void (*destroy)(void *data);
+};
+
+#define BITREE_IMPLICIT_NONE (-1L)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void bitree_implicit_init(struct bitree_implicit *tree, void (*destroy)(void *data));
+
+/**
+ * destroy the tree, include all data.
+ */
+void bitree_implicit_destroy(struct bitree_implicit *tree);
+
+/**
+ * add @data as the next node in level order.
+ * @return      return 0 on success otherwise return -1
+ */
+int bitree_implicit_push(struct bitree_implicit *tree, const void *data);
+
+/**
+ * remove the last node in level order, its data goes to *@data.
+ * @return      return 0 on success otherwise return -1
+ */
+int bitree_implicit_pop(struct bitree_implicit *tree, void **data);
+
+/**
+ * visit the subtree rooted at @node in @order (enum bitree_order_),
+ * walking by index arithmetic without any stack.
+ * @visit       return non-zero to stop the walk.
+ * @return      0 after a full walk, else the non-zero value of @visit.
+ */
+int bitree_implicit_walk(struct bitree_implicit *tree, long node, int order,
+                         int (*visit)(void *data, void *ctx), void *ctx);
+
+/**
+ * number of nodes under @node.
+ */
+size_t bitree_implicit_subtree_size(struct bitree_implicit *tree, long node);
+
+/**
+ * move the two subtrees of the root to @left and @right, which the
+ * function initializes. The root stays in @tree.
+ * @return      return 0 on success otherwise return -1
+ */
+int bitree_implicit_split(struct bitree_implicit *tree, struct bitree_implicit *left,
+                          struct bitree_implicit *right);
+
+/**
+ * make @merge the tree with root @data over @left and @right, which are
+ * left empty. Only shapes which give a complete tree are accepted:
+ * @left perfect and as high as @right, or @left complete and @right
+ * perfect and one level lower.
+ * @return      return 0 on success otherwise return -1
+ */
+int bitree_implicit_merge(struct bitree_implicit *merge, struct bitree_implicit *left,
+                          struct bitree_implicit *right, const void *data);
+
+/**
+ * move the data of a complete bitree into the empty @implicit; @tree is
+ * left empty without destroying the data.
+ * @return      return 0 on success, -1 if @tree is not complete or on
+ *              error, @tree is unchanged then.
+ */
+int bitree_implicit_from_bitree(struct bitree_implicit *implicit, struct bitree_tree *tree);
+
+/**
+ * move the data of @implicit into the empty bitree @tree.
+ * @return      return 0 on success otherwise return -1
+ */
+int bitree_implicit_to_bitree(struct bitree_implicit *implicit, struct bitree_tree *tree);
+
+#ifdef __cplusplus
+}
+#endif
+
+static inline long bitree_implicit_left(const struct bitree_implicit *tree, long node)
+{
+    return (size_t)(2 * node + 1) < tree->size ? 2 * node + 1 : BITREE_IMPLICIT_NONE;
+}
+
+static inline long bitree_implicit_right(const struct bitree_implicit *tree, long node)
+{
+    return (size_t)(2 * node + 2) < tree->size ? 2 * node + 2 : BITREE_IMPLICIT_NONE;
+}
+
+static inline long bitree_implicit_parent(const struct bitree_implicit *tree, long node)
+{
+    (void)tree;
+    return node > 0 ? (node - 1) / 2 : BITREE_IMPLICIT_NONE;
+}
+
+#define bitree_implicit_size(tree) ((tree)->size)
+#define bitree_implicit_data(tree, node) ((tree)->data[(node)])
+
+#endif
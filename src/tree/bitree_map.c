@@ -0,0 +1,328 @@
+/* bitree_map.c --- serialized binary tree
+ *
+ * Filename: bitree_map.c
+ * Description: succinct bitree file format and mmap navigation
+ * Author: Werther Zhang
+ * Maintainer: Werther Zhang (peng.zhang.dev@gmail.com)
+ * Version: 0
+ * Keywords: binary tree, succinct, mmap
+ *
+ */
+
+/* Change Log:
+ *
+ *
+ */
+
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth
+ * Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* Code: */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "bitree_map.h"
+
+#define BITREE_MAP_MAGIC "BITREE01"
+#define BITREE_MAP_BLOCK 8          // words per rank block
+
+/*
+ * File layout, every section starts on an 8 byte boundary:
+ *   header
+ *   bits      2 * size bits, bit 2i: node i has a left child, 2i+1: right
+ *   rank      one word per BITREE_MAP_BLOCK words of bits, plus the total
+ *   records   size * record_size bytes
+ */
+struct header {
+    char magic[8];
+    uint64_t size;
+    uint64_t record_size;
+    uint64_t bits;
+    uint64_t rank;
+    uint64_t records;
+};
+
+static inline uint64_t align8(uint64_t offset)
+{
+    return (offset + 7) & ~(uint64_t)7;
+}
+
+static inline int get_bit(const uint64_t *bits, uint64_t pos)
+{
+    return (bits[pos >> 6] >> (pos & 63)) & 1;
+}
+
+/**
+ * number of ones in bits [0, @pos).
+ */
+static uint64_t rank1(const BiTreeMap *map, uint64_t pos)
+{
+    uint64_t word = pos >> 6, i;
+    uint64_t count = map->rank[word / BITREE_MAP_BLOCK];
+
+    for (i = word - word % BITREE_MAP_BLOCK; i < word; i++)
+        count += __builtin_popcountll(map->bits[i]);
+    if (pos & 63)
+        count += __builtin_popcountll(map->bits[word] & ((1ULL << (pos & 63)) - 1));
+
+    return count;
+}
+
+/**
+ * position of the @nth one, counting from 1.
+ */
+static uint64_t select1(const BiTreeMap *map, uint64_t nth)
+{
+    uint64_t words = (2 * map->size + 63) >> 6;
+    uint64_t blocks = (words + BITREE_MAP_BLOCK - 1) / BITREE_MAP_BLOCK;
+    uint64_t lo = 0, hi = blocks, mid, word, bits;
+    int count;
+
+    // Last block with fewer than @nth ones before it
+    while (hi - lo > 1) {
+        mid = (lo + hi) / 2;
+        if (map->rank[mid] < nth)
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    nth -= map->rank[lo];
+    for (word = lo * BITREE_MAP_BLOCK; ; word++) {
+        count = __builtin_popcountll(map->bits[word]);
+        if ((uint64_t)count >= nth)
+            break;
+        nth -= count;
+    }
+
+    for (bits = map->bits[word]; --nth > 0; )
+        bits &= bits - 1;
+
+    return (word << 6) + __builtin_ctzll(bits);
+}
+
+/**
+ * collect the nodes of @tree in level order.
+ * @return      number of nodes, -1 if out of memory.
+ */
+static long level_order(struct bitree_tree *tree, struct bitree_node ***nodes)
+{
+    struct bitree_node **queue, **grown, *node;
+    long head, tail = 0, capacity = 1024;
+
+    if ((queue = (struct bitree_node **)malloc(capacity * sizeof(*queue))) == NULL)
+        return -1;
+
+    if (bitree_root(tree) != NULL)
+        queue[tail++] = bitree_root(tree);
+
+    for (head = 0; head < tail; head++) {
+        if (tail + 2 > capacity) {
+            grown = (struct bitree_node **)realloc(queue, 2 * capacity * sizeof(*queue));
+            if (grown == NULL) {
+                free(queue);
+                return -1;
+            }
+            queue = grown;
+            capacity *= 2;
+        }
+
+        node = queue[head];
+        if (node->left != NULL)
+            queue[tail++] = node->left;
+        if (node->right != NULL)
+            queue[tail++] = node->right;
+    }
+
+    *nodes = queue;
+
+    return tail;
+}
+
+static int write_tree(FILE *file, struct bitree_node **nodes, long size,
+                      const struct bitree_codec *codec, void *ctx)
+{
+    struct header header;
+    uint64_t words = (2 * (uint64_t)size + 63) >> 6;
+    uint64_t blocks = (words + BITREE_MAP_BLOCK - 1) / BITREE_MAP_BLOCK;
+    uint64_t *bits, *rank, ones = 0, i;
+    char *record, pad[8] = { 0 };
+    int retval = -1;
+    long n;
+
+    bits = (uint64_t *)calloc(words + 1, sizeof(uint64_t));
+    rank = (uint64_t *)calloc(blocks + 1, sizeof(uint64_t));
+    record = (char *)malloc(codec->record_size + 1);
+    if (bits == NULL || rank == NULL || record == NULL)
+        goto out;
+
+    for (n = 0; n < size; n++) {
+        if (nodes[n]->left != NULL)
+            bits[(2 * n) >> 6] |= 1ULL << ((2 * n) & 63);
+        if (nodes[n]->right != NULL)
+            bits[(2 * n + 1) >> 6] |= 1ULL << ((2 * n + 1) & 63);
+    }
+
+    for (i = 0; i < words; i++) {
+        if (i % BITREE_MAP_BLOCK == 0)
+            rank[i / BITREE_MAP_BLOCK] = ones;
+        ones += __builtin_popcountll(bits[i]);
+    }
+    rank[blocks] = ones;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BITREE_MAP_MAGIC, sizeof(header.magic));
+    header.size = size;
+    header.record_size = codec->record_size;
+    header.bits = align8(sizeof(header));
+    header.rank = header.bits + words * sizeof(uint64_t);
+    header.records = header.rank + (blocks + 1) * sizeof(uint64_t);
+
+    if (fwrite(&header, sizeof(header), 1, file) != 1
+        || fwrite(pad, 1, header.bits - sizeof(header), file) != header.bits - sizeof(header)
+        || fwrite(bits, sizeof(uint64_t), words, file) != words
+        || fwrite(rank, sizeof(uint64_t), blocks + 1, file) != blocks + 1)
+        goto out;
+
+    for (n = 0; n < size; n++) {
+        memset(record, 0, codec->record_size);
+        if (codec->encode(nodes[n]->data, record, ctx) != 0
+            || fwrite(record, 1, codec->record_size, file) != codec->record_size)
+            goto out;
+    }
+
+    retval = 0;
+
+out:
+    free(record);
+    free(rank);
+    free(bits);
+
+    return retval;
+}
+
+int bitree_serialize(struct bitree_tree *tree, const char *path,
+                     const struct bitree_codec *codec, void *ctx)
+{
+    struct bitree_node **nodes;
+    FILE *file;
+    long size;
+    int retval;
+
+    if ((size = level_order(tree, &nodes)) < 0)
+        return -1;
+
+    if ((file = fopen(path, "wb")) == NULL) {
+        free(nodes);
+        return -1;
+    }
+
+    retval = write_tree(file, nodes, size, codec, ctx);
+    if (fclose(file) != 0)
+        retval = -1;
+    free(nodes);
+
+    return retval;
+}
+
+int bitree_map(BiTreeMap *map, const char *path)
+{
+    const struct header *header;
+    struct stat st;
+    uint64_t words, blocks;
+    void *base;
+    int fd;
+
+    if ((fd = open(path, O_RDONLY)) < 0)
+        return -1;
+
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct header)) {
+        close(fd);
+        return -1;
+    }
+
+    base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return -1;
+
+    // Only the header is checked, the rest is trusted
+    header = (const struct header *)base;
+    words = (2 * header->size + 63) >> 6;
+    blocks = (words + BITREE_MAP_BLOCK - 1) / BITREE_MAP_BLOCK;
+    if (memcmp(header->magic, BITREE_MAP_MAGIC, sizeof(header->magic)) != 0
+        || header->rank != header->bits + words * sizeof(uint64_t)
+        || header->records != header->rank + (blocks + 1) * sizeof(uint64_t)
+        || header->records + header->size * header->record_size > (uint64_t)st.st_size) {
+        munmap(base, st.st_size);
+        return -1;
+    }
+
+    map->base = base;
+    map->length = st.st_size;
+    map->size = header->size;
+    map->record_size = header->record_size;
+    map->bits = (const uint64_t *)((const char *)base + header->bits);
+    map->rank = (const uint64_t *)((const char *)base + header->rank);
+    map->records = (const char *)base + header->records;
+
+    return 0;
+}
+
+void bitree_unmap(BiTreeMap *map)
+{
+    if (map->base != NULL)
+        munmap(map->base, map->length);
+    memset(map, 0, sizeof(BiTreeMap));
+}
+
+long bitree_map_root(const BiTreeMap *map)
+{
+    return map->size > 0 ? 0 : BITREE_MAP_NONE;
+}
+
+/*
+ * Every one bit stands for a child, in level order: the child behind
+ * bit p is node rank1(p + 1), as node 0 is the root.
+ */
+long bitree_map_left(const BiTreeMap *map, long node)
+{
+    uint64_t pos = 2 * (uint64_t)node;
+
+    return get_bit(map->bits, pos) ? (long)rank1(map, pos + 1) : BITREE_MAP_NONE;
+}
+
+long bitree_map_right(const BiTreeMap *map, long node)
+{
+    uint64_t pos = 2 * (uint64_t)node + 1;
+
+    return get_bit(map->bits, pos) ? (long)rank1(map, pos + 1) : BITREE_MAP_NONE;
+}
+
+long bitree_map_parent(const BiTreeMap *map, long node)
+{
+    if (node <= 0)
+        return BITREE_MAP_NONE;
+
+    return (long)(select1(map, node) / 2);
+}
+
+/* bitree_map.c ends here */
@@ -0,0 +1,78 @@
+#ifndef BITREE_MAP_H
+#define BITREE_MAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "bitree.h"
+
+/**
+ * On-disk bitree. Nodes are numbered in level order, the shape is two
+ * bits per node (has left, has right) with a rank directory on top, and
+ * the data is an array of fixed-size records written by a codec. Child
+ * and parent links are computed from ranks over the mapped file, so
+ * opening a tree costs the same for any size. Files use the byte order
+ * of the host which wrote them.
+ */
+
+struct bitree_codec {
+    size_t record_size;
+    /**
+     * write @data into the @record_size bytes at @record.
+     * @return      return 0 on success otherwise return -1
+     */
+    int (*encode)(const void *data, void *record, void *ctx);
+};
+
+typedef struct bitree_map_ {
+    void *base;
+    size_t length;
+    uint64_t size;              // number of nodes
+    uint64_t record_size;
+    const uint64_t *bits;
+    const uint64_t *rank;       // ones before each 512 bit block
+    const char *records;
+} BiTreeMap;
+
+#define BITREE_MAP_NONE (-1L)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * write @tree to the file @path.
+ * @return      return 0 on success otherwise return -1
+ */
+int bitree_serialize(struct bitree_tree *tree, const char *path,
+                     const struct bitree_codec *codec, void *ctx);
+
+/**
+ * map the file @path read-only.
+ * @return      return 0 on success otherwise return -1
+ */
+int bitree_map(BiTreeMap *map, const char *path);
+
+void bitree_unmap(BiTreeMap *map);
+
+/**
+ * navigation over a mapped tree, nodes are level order numbers.
+ * @return      the node or BITREE_MAP_NONE.
+ */
+long bitree_map_root(const BiTreeMap *map);
+long bitree_map_left(const BiTreeMap *map, long node);
+long bitree_map_right(const BiTreeMap *map, long node);
+long bitree_map_parent(const BiTreeMap *map, long node);
+
+/**
+ * the record of @node, valid until bitree_unmap().
+ */
+static inline const void *bitree_map_data(const BiTreeMap *map, long node)
+{
+    return map->records + (size_t)node * map->record_size;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,559 @@
+/* bptree.c --- B+tree
+ *
+ * Filename: bptree.c
+ * Description: cache-conscious B+tree with the bistree interface
+ * Author: Werther Zhang
+ * Maintainer: Werther Zhang (peng.zhang.dev@gmail.com)
+ * Version: 0
+ * Keywords: B+tree
+ *
+ */
+
+/* Change Log:
+ *
+ *
+ */
+
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth
+ * Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* Code: */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "bptree.h"
+
+/*
+ * Separators in inner nodes are pointers to the smallest data of the
+ * subtree on their right, so every separator is live data of the tree.
+ */
+
+#define BPTREE_MAX_HEIGHT 32
+
+#define inner(node) ((struct bptree_inner *)(node))
+#define leaf(node) ((struct bptree_leaf *)(node))
+
+struct bptree_path {
+    struct bptree_node *node;
+    int index;                  // child index taken in node
+};
+
+static struct bptree_node *node_alloc(int is_leaf)
+{
+    struct bptree_node *node;
+
+    if (is_leaf) {
+        node = (struct bptree_node *)malloc(sizeof(struct bptree_leaf));
+        if (node != NULL) {
+            leaf(node)->prev = NULL;
+            leaf(node)->next = NULL;
+        }
+    } else {
+        node = (struct bptree_node *)malloc(sizeof(struct bptree_inner));
+    }
+
+    if (node != NULL) {
+        node->leaf = is_leaf;
+        node->num = 0;
+    }
+
+    return node;
+}
+
+/**
+ * first index whose key is >= @key, @found is set on equality.
+ */
+static int lower_bound(BpTree *tree, struct bptree_node *node,
+                       const void *key, int *found)
+{
+    int lo = 0, hi = node->num, mid, cmpval;
+
+    *found = 0;
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        cmpval = tree->compare(node->keys[mid], key);
+        if (cmpval < 0) {
+            lo = mid + 1;
+        } else {
+            if (cmpval == 0)
+                *found = 1;
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+/**
+ * child of an inner node that covers @key.
+ */
+static int child_index(BpTree *tree, struct bptree_node *node, const void *key)
+{
+    int found, index;
+
+    index = lower_bound(tree, node, key, &found);
+    return found ? index + 1 : index;
+}
+
+static struct bptree_leaf *find_leaf(BpTree *tree, const void *key,
+                                     struct bptree_path *path, int *depth)
+{
+    struct bptree_node *node = tree->root;
+    int index, level = 0;
+
+    while (!node->leaf) {
+        index = child_index(tree, node, key);
+        if (path != NULL) {
+            path[level].node = node;
+            path[level].index = index;
+        }
+        level++;
+        node = inner(node)->children[index];
+    }
+
+    if (depth != NULL)
+        *depth = level;
+
+    return leaf(node);
+}
+
+static void insert_at(void **array, int num, int index, void *value)
+{
+    memmove(&array[index + 1], &array[index], (num - index) * sizeof(void *));
+    array[index] = value;
+}
+
+static void remove_at(void **array, int num, int index)
+{
+    memmove(&array[index], &array[index + 1], (num - index - 1) * sizeof(void *));
+}
+
+/**
+ * split a full leaf into the empty leaf @right, its new right sibling.
+ */
+static void split_leaf(struct bptree_leaf *left, struct bptree_leaf *right)
+{
+    int keep = BPTREE_ORDER / 2;
+
+    right->node.num = BPTREE_ORDER - keep;
+    memcpy(right->node.keys, &left->node.keys[keep], right->node.num * sizeof(void *));
+    left->node.num = keep;
+
+    right->next = left->next;
+    right->prev = left;
+    if (left->next != NULL)
+        left->next->prev = right;
+    left->next = right;
+}
+
+/**
+ * split a full inner node into the empty @right, the median key goes up
+ * through @up.
+ */
+static void split_inner(struct bptree_inner *left, struct bptree_inner *right, void **up)
+{
+    int keep = BPTREE_ORDER / 2;
+
+    *up = left->node.keys[keep];
+    right->node.num = BPTREE_ORDER - keep - 1;
+    memcpy(right->node.keys, &left->node.keys[keep + 1],
+           right->node.num * sizeof(void *));
+    memcpy(right->children, &left->children[keep + 1],
+           (right->node.num + 1) * sizeof(struct bptree_node *));
+    left->node.num = keep;
+}
+
+void bptree_init(BpTree *tree, int (*compare)(const void *key1, const void *key2),
+                 void (*destroy)(void *data))
+{
+    tree->size = 0;
+    tree->height = 0;
+    tree->root = NULL;
+    tree->head = NULL;
+    tree->compare = compare;
+    tree->destroy = destroy;
+
+    return;
+}
+
+static void destroy_node(BpTree *tree, struct bptree_node *node)
+{
+    int i;
+
+    if (node->leaf) {
+        if (tree->destroy != NULL) {
+            for (i = 0; i < node->num; i++)
+                tree->destroy(node->keys[i]);
+        }
+    } else {
+        for (i = 0; i <= node->num; i++)
+            destroy_node(tree, inner(node)->children[i]);
+    }
+
+    free(node);
+}
+
+void bptree_destroy(BpTree *tree)
+{
+    if (tree->root != NULL)
+        destroy_node(tree, tree->root);
+
+    // No operations are allowed
+    memset(tree, 0, sizeof(BpTree));
+    return;
+}
+
+int bptree_insert(BpTree *tree, const void *data)
+{
+    struct bptree_path path[BPTREE_MAX_HEIGHT];
+    struct bptree_node *spare[BPTREE_MAX_HEIGHT + 1];
+    struct bptree_leaf *node, *sibling;
+    struct bptree_node *child, *new_child, *root;
+    void *up;
+    int depth, index, found, level, splits, count, i;
+
+    if (tree->root == NULL) {
+        if ((tree->root = node_alloc(1)) == NULL)
+            return -1;
+        tree->head = leaf(tree->root);
+    }
+
+    node = find_leaf(tree, data, path, &depth);
+    index = lower_bound(tree, &node->node, data, &found);
+    if (found)
+        return 1;
+
+    if (node->node.num < BPTREE_ORDER) {
+        insert_at(node->node.keys, node->node.num, index, (void *)data);
+        node->node.num++;
+        tree->size++;
+        return 0;
+    }
+
+    // Allocate every node the split needs before touching the tree, so a
+    // failure leaves it unchanged: the leaf, each full parent above it and
+    // a new root if the split goes all the way up.
+    for (splits = 0; splits < depth; splits++) {
+        if (path[depth - 1 - splits].node->num < BPTREE_ORDER)
+            break;
+    }
+    count = 1 + splits + (splits == depth);
+
+    for (i = 0; i < count; i++) {
+        if ((spare[i] = node_alloc(i == 0)) == NULL) {
+            while (--i >= 0)
+                free(spare[i]);
+            return -1;
+        }
+    }
+
+    sibling = leaf(spare[0]);
+    split_leaf(node, sibling);
+
+    if (index <= node->node.num) {
+        insert_at(node->node.keys, node->node.num, index, (void *)data);
+        node->node.num++;
+    } else {
+        index -= node->node.num;
+        insert_at(sibling->node.keys, sibling->node.num, index, (void *)data);
+        sibling->node.num++;
+    }
+    tree->size++;
+
+    // Push the separators up along the path
+    up = sibling->node.keys[0];
+    child = &node->node;
+    new_child = &sibling->node;
+
+    for (level = depth - 1, i = 1; level >= 0; level--) {
+        struct bptree_inner *parent = inner(path[level].node);
+        struct bptree_inner *right;
+        void *next_up;
+
+        index = path[level].index;
+        if (parent->node.num < BPTREE_ORDER) {
+            insert_at(parent->node.keys, parent->node.num, index, up);
+            insert_at((void **)parent->children, parent->node.num + 1,
+                      index + 1, new_child);
+            parent->node.num++;
+            return 0;
+        }
+
+        right = inner(spare[i++]);
+        split_inner(parent, right, &next_up);
+
+        if (index <= parent->node.num) {
+            insert_at(parent->node.keys, parent->node.num, index, up);
+            insert_at((void **)parent->children, parent->node.num + 1,
+                      index + 1, new_child);
+            parent->node.num++;
+        } else {
+            index -= parent->node.num + 1;
+            insert_at(right->node.keys, right->node.num, index, up);
+            insert_at((void **)right->children, right->node.num + 1,
+                      index + 1, new_child);
+            right->node.num++;
+        }
+
+        up = next_up;
+        child = &parent->node;
+        new_child = &right->node;
+    }
+
+    // The root was split, grow the tree by one level
+    root = spare[i];
+    root->num = 1;
+    root->keys[0] = up;
+    inner(root)->children[0] = child;
+    inner(root)->children[1] = new_child;
+    tree->root = root;
+    tree->height++;
+
+    return 0;
+}
+
+/**
+ * fix the underflow of the leaf @node, which is child @index of @parent.
+ */
+static void rebalance_leaf(struct bptree_inner *parent, int index,
+                           struct bptree_leaf *node)
+{
+    struct bptree_leaf *left = NULL, *right = NULL;
+
+    if (index > 0)
+        left = leaf(parent->children[index - 1]);
+    if (index < parent->node.num)
+        right = leaf(parent->children[index + 1]);
+
+    if (left != NULL && left->node.num > BPTREE_MIN_KEYS) {
+        // Borrow the last key of the left sibling
+        insert_at(node->node.keys, node->node.num, 0,
+                  left->node.keys[left->node.num - 1]);
+        node->node.num++;
+        left->node.num--;
+        parent->node.keys[index - 1] = node->node.keys[0];
+    } else if (right != NULL && right->node.num > BPTREE_MIN_KEYS) {
+        // Borrow the first key of the right sibling
+        node->node.keys[node->node.num++] = right->node.keys[0];
+        remove_at(right->node.keys, right->node.num, 0);
+        right->node.num--;
+        parent->node.keys[index] = right->node.keys[0];
+    } else {
+        // Merge with a sibling and drop the separator between them
+        if (left != NULL) {
+            right = node;
+            index--;
+        } else {
+            left = node;
+        }
+
+        memcpy(&left->node.keys[left->node.num], right->node.keys,
+               right->node.num * sizeof(void *));
+        left->node.num += right->node.num;
+        left->next = right->next;
+        if (right->next != NULL)
+            right->next->prev = left;
+
+        remove_at(parent->node.keys, parent->node.num, index);
+        remove_at((void **)parent->children, parent->node.num + 1, index + 1);
+        parent->node.num--;
+        free(right);
+    }
+}
+
+/**
+ * fix the underflow of the inner node @node, which is child @index of @parent.
+ */
+static void rebalance_inner(struct bptree_inner *parent, int index,
+                            struct bptree_inner *node)
+{
+    struct bptree_inner *left = NULL, *right = NULL;
+    int num = node->node.num;
+
+    if (index > 0)
+        left = inner(parent->children[index - 1]);
+    if (index < parent->node.num)
+        right = inner(parent->children[index + 1]);
+
+    if (left != NULL && left->node.num > BPTREE_MIN_KEYS) {
+        // Rotate right through the parent
+        insert_at(node->node.keys, num, 0, parent->node.keys[index - 1]);
+        insert_at((void **)node->children, num + 1, 0,
+                  left->children[left->node.num]);
+        node->node.num++;
+        parent->node.keys[index - 1] = left->node.keys[left->node.num - 1];
+        left->node.num--;
+    } else if (right != NULL && right->node.num > BPTREE_MIN_KEYS) {
+        // Rotate left through the parent
+        node->node.keys[num] = parent->node.keys[index];
+        node->children[num + 1] = right->children[0];
+        node->node.num++;
+        parent->node.keys[index] = right->node.keys[0];
+        remove_at(right->node.keys, right->node.num, 0);
+        remove_at((void **)right->children, right->node.num + 1, 0);
+        right->node.num--;
+    } else {
+        // Merge, pulling the separator down
+        if (left != NULL) {
+            right = node;
+            index--;
+        } else {
+            left = node;
+        }
+
+        left->node.keys[left->node.num] = parent->node.keys[index];
+        memcpy(&left->node.keys[left->node.num + 1], right->node.keys,
+               right->node.num * sizeof(void *));
+        memcpy(&left->children[left->node.num + 1], right->children,
+               (right->node.num + 1) * sizeof(struct bptree_node *));
+        left->node.num += right->node.num + 1;
+
+        remove_at(parent->node.keys, parent->node.num, index);
+        remove_at((void **)parent->children, parent->node.num + 1, index + 1);
+        parent->node.num--;
+        free(right);
+    }
+}
+
+/**
+ * the removed @data may still be a separator in one inner node,
+ * replace it with the new smallest data of the subtree on its right.
+ */
+static void replace_separator(BpTree *tree, const void *data)
+{
+    struct bptree_node *node = tree->root, *min;
+    int index, found;
+
+    while (!node->leaf) {
+        index = lower_bound(tree, node, data, &found);
+        if (found) {
+            min = inner(node)->children[index + 1];
+            while (!min->leaf)
+                min = inner(min)->children[0];
+            node->keys[index] = min->keys[0];
+            return;
+        }
+        node = inner(node)->children[index];
+    }
+}
+
+int bptree_remove(BpTree *tree, const void *data)
+{
+    struct bptree_path path[BPTREE_MAX_HEIGHT];
+    struct bptree_leaf *node;
+    struct bptree_node *root;
+    void *old;
+    int depth, index, found, level;
+
+    if (tree->root == NULL)
+        return -1;
+
+    node = find_leaf(tree, data, path, &depth);
+    index = lower_bound(tree, &node->node, data, &found);
+    if (!found)
+        return -1;
+
+    old = node->node.keys[index];
+    remove_at(node->node.keys, node->node.num, index);
+    node->node.num--;
+    tree->size--;
+
+    if (depth > 0 && node->node.num < BPTREE_MIN_KEYS) {
+        rebalance_leaf(inner(path[depth - 1].node), path[depth - 1].index, node);
+
+        for (level = depth - 1; level > 0; level--) {
+            if (path[level].node->num >= BPTREE_MIN_KEYS)
+                break;
+            rebalance_inner(inner(path[level - 1].node), path[level - 1].index,
+                            inner(path[level].node));
+        }
+    }
+
+    // Shrink the tree when the root runs out of keys
+    root = tree->root;
+    if (!root->leaf && root->num == 0) {
+        tree->root = inner(root)->children[0];
+        tree->height--;
+        free(root);
+    } else if (root->leaf && root->num == 0) {
+        tree->root = NULL;
+        tree->head = NULL;
+        free(root);
+    }
+
+    if (index == 0 && tree->root != NULL)
+        replace_separator(tree, old);
+
+    if (tree->destroy != NULL)
+        tree->destroy(old);
+
+    return 0;
+}
+
+int bptree_lookup(BpTree *tree, void **data)
+{
+    struct bptree_leaf *node;
+    int index, found;
+
+    if (tree->root == NULL)
+        return -1;
+
+    node = find_leaf(tree, *data, NULL, NULL);
+    index = lower_bound(tree, &node->node, *data, &found);
+    if (!found)
+        return -1;
+
+    // Pass back the data from tree
+    *data = node->node.keys[index];
+    return 0;
+}
+
+int bptree_scan(BpTree *tree, const void *lo, const void *hi,
+                int (*visit)(void *data, void *ctx), void *ctx)
+{
+    struct bptree_leaf *node;
+    int index, found, count = 0;
+
+    if (tree->root == NULL)
+        return 0;
+
+    if (lo != NULL) {
+        node = find_leaf(tree, lo, NULL, NULL);
+        index = lower_bound(tree, &node->node, lo, &found);
+    } else {
+        node = tree->head;
+        index = 0;
+    }
+
+    for (; node != NULL; node = node->next, index = 0) {
+        if (node->next != NULL)
+            __builtin_prefetch(node->next);
+
+        for (; index < node->node.num; index++) {
+            if (hi != NULL && tree->compare(node->node.keys[index], hi) >= 0)
+                return count;
+
+            count++;
+            if (visit(node->node.keys[index], ctx) != 0)
+                return count;
+        }
+    }
+
+    return count;
+}
+
+/* bptree.c ends here */
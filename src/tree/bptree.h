@@ -0,0 +1,105 @@
+#ifndef BPTREE_H
+#define BPTREE_H
+
+#include <stdio.h>
+
+/**
+ * Maximum number of keys per node. Keys are stored as a contiguous array
+ * of pointers: with 16 keys the 128 bytes searched in a node span two or
+ * three 64-byte cache lines, a leaf is 152 bytes and an inner node, with
+ * its 17 child pointers, 272 bytes.
+ */
+#ifndef BPTREE_ORDER
+#define BPTREE_ORDER 16
+#endif
+
+#define BPTREE_MIN_KEYS (BPTREE_ORDER / 2)
+
+struct bptree_node {
+    int leaf;
+    int num;
+    void *keys[BPTREE_ORDER];
+};
+
+struct bptree_inner {
+    struct bptree_node node;
+    struct bptree_node *children[BPTREE_ORDER + 1];
+};
+
+struct bptree_leaf {
+    struct bptree_node node;
+    struct bptree_leaf *prev;
+    struct bptree_leaf *next;
+};
+
+typedef struct bptree_ {
+    int size;
+    int height;
+    struct bptree_node *root;
+    struct bptree_leaf *head;   // leftmost leaf, for ordered scans
+    int (*compare)(const void *key1, const void *key2);
+    void (*destroy)(void *data);
+} BpTree;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * init B+tree. Same contract as bistree_init().
+ * @tree        global BpTree struct
+ * @compare     compare key1 and key2.
+ *              return 1 on key1 > key2.
+ *              return 0 on key1 == key2.
+ *              return -1 on key1 < key2.
+ * @destroy     destroy private data in BpTree.
+ */
+void bptree_init(BpTree *tree, int (*compare)(const void *key1, const void *key2),
+                 void (*destroy)(void *data));
+
+/**
+ * destroy B+tree, include all data.
+ */
+void bptree_destroy(BpTree *tree);
+
+/**
+ * insert @data to @tree
+ * @return      return 0 on success, 1 if an equal key is already in
+ *              the tree, -1 on error.
+ */
+int bptree_insert(BpTree *tree, const void *data);
+
+/**
+ * remove the data equal to @data from @tree.
+ * Unlike bistree_remove() the entry is really removed, so its data is
+ * passed to tree->destroy right away.
+ * @return      return 0 on success otherwise return -1
+ */
+int bptree_remove(BpTree *tree, const void *data);
+
+/**
+ * lookup data. On success *@data is replaced by the data in the tree.
+ * @return      return 0 on success otherwise return -1
+ */
+int bptree_lookup(BpTree *tree, void **data);
+
+/**
+ * visit data in [@lo, @hi) in key order by following the leaf links.
+ * @lo          first key, NULL to start at the smallest key.
+ * @hi          end key (excluded), NULL to scan to the end.
+ * @visit       return non-zero to stop the scan.
+ * @return      number of visited data.
+ */
+int bptree_scan(BpTree *tree, const void *lo, const void *hi,
+                int (*visit)(void *data, void *ctx), void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+static inline size_t bptree_size(BpTree *tree)
+{
+    return tree->size;
+}
+
+#endif
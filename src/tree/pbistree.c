@@ -0,0 +1,453 @@
+/* pbistree.c --- persistent binary search tree
+ *
+ * Filename: pbistree.c
+ * Description: path copying AVL tree with shared, refcounted nodes
+ * Author: Werther Zhang
+ * Maintainer: Werther Zhang (peng.zhang.dev@gmail.com)
+ * Version: 0
+ * Keywords: binary search tree, persistent, snapshot
+ *
+ */
+
+/* Change Log:
+ *
+ *
+ */
+
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 3, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street, Fifth
+ * Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* Code: */
+
+#include <stdlib.h>
+#include "pbistree.h"
+#include "bistree.h"
+
+static inline void retain(int *refcount)
+{
+    __atomic_add_fetch(refcount, 1, __ATOMIC_RELAXED);
+}
+
+static inline int put(int *refcount)
+{
+    return __atomic_sub_fetch(refcount, 1, __ATOMIC_ACQ_REL) == 0;
+}
+
+static void release_entry(PBisTree *tree, struct pbistree_entry *entry)
+{
+    if (put(&entry->refcount)) {
+        if (tree->destroy != NULL)
+            tree->destroy(entry->data);
+        free(entry);
+    }
+}
+
+static void release(PBisTree *tree, struct pbistree_node *node)
+{
+    struct pbistree_node *right;
+
+    // Loop on the right child, recurse on the left one
+    while (node != NULL && put(&node->refcount)) {
+        release_entry(tree, node->entry);
+        release(tree, node->left);
+        right = node->right;
+        free(node);
+        node = right;
+    }
+}
+
+static inline int height(struct pbistree_node *node)
+{
+    return node == NULL ? 0 : node->height;
+}
+
+static inline void update(struct pbistree_node *node)
+{
+    int lh = height(node->left), rh = height(node->right);
+
+    node->height = (lh > rh ? lh : rh) + 1;
+}
+
+static inline int shared(struct pbistree_node *node)
+{
+    return __atomic_load_n(&node->refcount, __ATOMIC_ACQUIRE) != 1;
+}
+
+/**
+ * make sure @count nodes are in tree->spare.
+ * @return      return 0 on success otherwise return -1
+ */
+static int reserve(PBisTree *tree, int count)
+{
+    struct pbistree_node *node;
+
+    while (tree->spare_count < count) {
+        if ((node = (struct pbistree_node *)malloc(sizeof(struct pbistree_node))) == NULL)
+            return -1;
+        node->left = tree->spare;
+        tree->spare = node;
+        tree->spare_count++;
+    }
+
+    return 0;
+}
+
+/**
+ * make the node in *@link private to this version, copying it when
+ * other versions share it. The copy takes over the reference of @link.
+ * Reserved nodes are used first.
+ * @return      the private node or NULL if out of memory.
+ */
+static struct pbistree_node *own(PBisTree *tree, struct pbistree_node **link)
+{
+    struct pbistree_node *node = *link, *copy;
+
+    if (!shared(node))
+        return node;
+
+    if (tree->spare != NULL) {
+        copy = tree->spare;
+        tree->spare = copy->left;
+        tree->spare_count--;
+    } else if ((copy = (struct pbistree_node *)malloc(sizeof(struct pbistree_node))) == NULL) {
+        return NULL;
+    }
+
+    *copy = *node;
+    copy->refcount = 1;
+    retain(&copy->entry->refcount);
+    if (copy->left != NULL)
+        retain(&copy->left->refcount);
+    if (copy->right != NULL)
+        retain(&copy->right->refcount);
+
+    *link = copy;
+    release(tree, node);
+
+    return copy;
+}
+
+/*
+ * Rotations move references between owned nodes, only the child which
+ * is lifted has to be made private first.
+ */
+static int rotate_left(PBisTree *tree, struct pbistree_node **link)
+{
+    struct pbistree_node *node = *link, *right;
+
+    if ((right = own(tree, &node->right)) == NULL)
+        return -1;
+
+    node->right = right->left;
+    right->left = node;
+    update(node);
+    update(right);
+    *link = right;
+
+    return 0;
+}
+
+static int rotate_right(PBisTree *tree, struct pbistree_node **link)
+{
+    struct pbistree_node *node = *link, *left;
+
+    if ((left = own(tree, &node->left)) == NULL)
+        return -1;
+
+    node->left = left->right;
+    left->right = node;
+    update(node);
+    update(left);
+    *link = left;
+
+    return 0;
+}
+
+/**
+ * rebalance the owned node in *@link.
+ * @return      return 0 on success, -1 if out of memory before anything
+ *              changed. Callers reserve the copies so that it cannot fail.
+ */
+static int rebalance(PBisTree *tree, struct pbistree_node **link)
+{
+    struct pbistree_node *node = *link;
+    int factor = height(node->left) - height(node->right);
+
+    if (factor > 1) {
+        if (height(node->left->left) < height(node->left->right)) {
+            if (own(tree, &node->left) == NULL
+                || rotate_left(tree, &node->left) != 0)
+                return -1;
+        }
+        return rotate_right(tree, link);
+    }
+
+    if (factor < -1) {
+        if (height(node->right->right) < height(node->right->left)) {
+            if (own(tree, &node->right) == NULL
+                || rotate_right(tree, &node->right) != 0)
+                return -1;
+        }
+        return rotate_left(tree, link);
+    }
+
+    update(node);
+    return 0;
+}
+
+/**
+ * walk to @data making every node on the way private.
+ * @return      depth of the path, -1 if out of memory or too deep. The
+ *              tree still holds the same data then, some of it in
+ *              private copies.
+ */
+static int own_path(PBisTree *tree, const void *data,
+                    struct pbistree_node **path[], struct pbistree_node ***found)
+{
+    struct pbistree_node **link = &tree->root;
+    struct pbistree_node *node;
+    int depth = 0, cmpval;
+
+    while (*link != NULL) {
+        if ((node = own(tree, link)) == NULL)
+            return -1;
+        if ((cmpval = tree->compare(data, node->entry->data)) == 0)
+            break;
+        if (depth == BISTREE_MAX_HEIGHT - 1)
+            return -1;
+        path[depth++] = link;
+        link = cmpval < 0 ? &node->left : &node->right;
+    }
+    *found = link;
+
+    return depth;
+}
+
+/**
+ * number of copies the rebalancing after removing *@victim can need.
+ * The removal shortens the path side, so a rotation at path[i] lifts its
+ * other child, and the inner grandchild of that side too for a double
+ * rotation. Those subtrees do not change below, so which copies each
+ * level could take is known up front.
+ */
+static int remove_copies(struct pbistree_node **path[], int depth,
+                         struct pbistree_node **victim)
+{
+    struct pbistree_node *node, *sibling, *inner;
+    int i, count = 0, copy;
+
+    for (i = 0; i < depth; i++) {
+        node = *path[i];
+        if ((i + 1 < depth ? path[i + 1] : victim) == &node->left) {
+            sibling = node->right;
+            inner = sibling != NULL ? sibling->left : NULL;
+            if (sibling != NULL && height(sibling->right) >= height(sibling->left))
+                inner = NULL;           // single rotation
+        } else {
+            sibling = node->left;
+            inner = sibling != NULL ? sibling->right : NULL;
+            if (sibling != NULL && height(sibling->left) >= height(sibling->right))
+                inner = NULL;
+        }
+
+        if (sibling == NULL)
+            continue;
+        copy = shared(sibling);
+        count += copy;
+        // Copying the sibling shares its children with the old version
+        if (inner != NULL && (copy || shared(inner)))
+            count++;
+    }
+
+    return count;
+}
+
+static int search(const PBisTree *tree, const void *data, void **found)
+{
+    struct pbistree_node *node = tree->root;
+    int cmpval;
+
+    while (node != NULL) {
+        if ((cmpval = tree->compare(data, node->entry->data)) == 0) {
+            *found = node->entry->data;
+            return 0;
+        }
+        node = cmpval < 0 ? node->left : node->right;
+    }
+
+    return -1;
+}
+
+void pbistree_init(PBisTree *tree, int (*compare)(const void *key1, const void *key2),
+                   void (*destroy)(void *data))
+{
+    tree->size = 0;
+    tree->root = NULL;
+    tree->spare = NULL;
+    tree->spare_count = 0;
+    tree->compare = compare;
+    tree->destroy = destroy;
+}
+
+void pbistree_destroy(PBisTree *tree)
+{
+    struct pbistree_node *node;
+
+    release(tree, tree->root);
+    while ((node = tree->spare) != NULL) {
+        tree->spare = node->left;
+        free(node);
+    }
+    tree->root = NULL;
+    tree->size = 0;
+    tree->spare_count = 0;
+
+    return;
+}
+
+void pbistree_snapshot(PBisTree *snapshot, const PBisTree *tree)
+{
+    *snapshot = *tree;
+    snapshot->spare = NULL;
+    snapshot->spare_count = 0;
+    if (snapshot->root != NULL)
+        retain(&snapshot->root->refcount);
+}
+
+int pbistree_insert(PBisTree *tree, const void *data)
+{
+    struct pbistree_node **path[BISTREE_MAX_HEIGHT];
+    struct pbistree_node **link;
+    struct pbistree_node *node;
+    struct pbistree_entry *entry;
+    void *found;
+    int depth;
+
+    // Do not copy a path for nothing
+    if (search(tree, data, &found) == 0)
+        return 1;
+
+    if ((node = (struct pbistree_node *)malloc(sizeof(struct pbistree_node))) == NULL)
+        return -1;
+    if ((entry = (struct pbistree_entry *)malloc(sizeof(struct pbistree_entry))) == NULL) {
+        free(node);
+        return -1;
+    }
+
+    if ((depth = own_path(tree, data, path, &link)) < 0) {
+        free(entry);
+        free(node);
+        return -1;
+    }
+
+    entry->refcount = 1;
+    entry->data = (void *)data;
+    node->refcount = 1;
+    node->height = 1;
+    node->entry = entry;
+    node->left = NULL;
+    node->right = NULL;
+    *link = node;
+    tree->size++;
+
+    // An insert only rotates nodes of the path, which are private now
+    while (--depth >= 0)
+        rebalance(tree, path[depth]);
+
+    return 0;
+}
+
+int pbistree_remove(PBisTree *tree, const void *data)
+{
+    struct pbistree_node **path[BISTREE_MAX_HEIGHT];
+    struct pbistree_node **link, **victim;
+    struct pbistree_node *node, *child;
+    void *found;
+    int depth;
+
+    if (search(tree, data, &found) != 0)
+        return -1;
+
+    if ((depth = own_path(tree, data, path, &link)) < 0)
+        return -1;
+
+    node = *link;
+    victim = link;
+    if (node->left != NULL && node->right != NULL) {
+        // Take the entry of the in-order successor, then drop that node
+        path[depth++] = link;
+        victim = &node->right;
+        while (own(tree, victim) != NULL && (*victim)->left != NULL) {
+            if (depth == BISTREE_MAX_HEIGHT)
+                return -1;
+            path[depth++] = victim;
+            victim = &(*victim)->left;
+        }
+        if (shared(*victim))
+            return -1;
+    }
+
+    // Nothing may fail once the tree starts to change
+    if (reserve(tree, remove_copies(path, depth, victim)) != 0)
+        return -1;
+
+    if (victim != link) {
+        retain(&(*victim)->entry->refcount);
+        release_entry(tree, node->entry);
+        node->entry = (*victim)->entry;
+    }
+
+    node = *victim;
+    child = node->left != NULL ? node->left : node->right;
+    if (child != NULL)
+        retain(&child->refcount);
+    *victim = child;
+    release(tree, node);
+    tree->size--;
+
+    while (--depth >= 0)
+        rebalance(tree, path[depth]);
+
+    return 0;
+}
+
+int pbistree_lookup(const PBisTree *tree, void **data)
+{
+    return search(tree, *data, data);
+}
+
+int pbistree_foreach(const PBisTree *tree, int (*visit)(void *data, void *ctx), void *ctx)
+{
+    struct pbistree_node *stack[BISTREE_MAX_HEIGHT];
+    struct pbistree_node *node = tree->root;
+    int top = 0, count = 0;
+
+    while (node != NULL || top > 0) {
+        while (node != NULL) {
+            stack[top++] = node;
+            node = node->left;
+        }
+        node = stack[--top];
+        count++;
+        if (visit(node->entry->data, ctx) != 0)
+            break;
+        node = node->right;
+    }
+
+    return count;
+}
+
+/* pbistree.c ends here */
@@ -0,0 +1,99 @@
+#ifndef PBISTREE_H
+#define PBISTREE_H
+
+#include <stddef.h>
+
+/**
+ * Persistent AVL tree. A PBisTree is one version: insert and remove copy
+ * the nodes on the search path and leave every other node shared with
+ * older versions. Nodes are reference counted, so pbistree_snapshot() is
+ * O(1) and each version is released on its own with pbistree_destroy().
+ *
+ * Nodes which only the current version can reach are updated in place,
+ * so a version nobody snapshotted costs no more than a plain AVL tree.
+ *
+ * Taking a snapshot of a version must not race with updates of that same
+ * version. A snapshot, once taken, is immutable: it may be read and
+ * destroyed from any thread without locking.
+ */
+
+struct pbistree_entry {
+    int refcount;
+    void *data;
+};
+
+struct pbistree_node {
+    int refcount;
+    int height;
+    struct pbistree_entry *entry;
+    struct pbistree_node *left;
+    struct pbistree_node *right;
+};
+
+typedef struct pbistree_ {
+    size_t size;
+    struct pbistree_node *root;
+    struct pbistree_node *spare;    // free nodes linked by ->left, see pbistree_remove()
+    int spare_count;
+    int (*compare)(const void *key1, const void *key2);
+    void (*destroy)(void *data);
+} PBisTree;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * init an empty version. Same contract as bistree_init(), @destroy is
+ * called once the last version holding the data is released.
+ */
+void pbistree_init(PBisTree *tree, int (*compare)(const void *key1, const void *key2),
+                   void (*destroy)(void *data));
+
+/**
+ * release the version @tree, nodes still used by other versions stay.
+ */
+void pbistree_destroy(PBisTree *tree);
+
+/**
+ * make @snapshot a new version equal to @tree in O(1).
+ */
+void pbistree_snapshot(PBisTree *snapshot, const PBisTree *tree);
+
+/**
+ * insert @data into the version @tree, other versions are not changed.
+ * @return      return 0 on success, 1 if an equal key is already in
+ *              @tree, -1 on error, @tree is unchanged then.
+ */
+int pbistree_insert(PBisTree *tree, const void *data);
+
+/**
+ * remove the data equal to @data from the version @tree.
+ * @return      return 0 on success otherwise return -1, @tree is
+ *              unchanged then.
+ */
+int pbistree_remove(PBisTree *tree, const void *data);
+
+/**
+ * lookup data. On success *@data is replaced by the data in the tree.
+ * @return      return 0 on success otherwise return -1
+ */
+int pbistree_lookup(const PBisTree *tree, void **data);
+
+/**
+ * visit all data of @tree in key order.
+ * @visit       return non-zero to stop.
+ * @return      number of visited data.
+ */
+int pbistree_foreach(const PBisTree *tree, int (*visit)(void *data, void *ctx), void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+static inline size_t pbistree_size(const PBisTree *tree)
+{
+    return tree->size;
+}
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdio.h>
+
+/**
+ * Every test_*() returns 0 when it passes. TEST_CHECK() reports the first
+ * failed condition and makes the test return -1, so a test must not hold
+ * anything it has to release when a check can fail.
+ */
+#define TEST_CHECK(cond)                                                \
+    do {                                                                \
+        if (!(cond)) {                                                  \
+            fprintf(stderr, "%s:%d: check failed: %s\n",                \
+                    __FILE__, __LINE__, #cond);                         \
+            return -1;                                                  \
+        }                                                               \
+    } while (0)
+
+/**
+ * make the @n-th allocation from now on (0 is the next one) fail,
+ * -1 lets every allocation succeed again. Covers malloc, calloc, realloc
+ * and posix_memalign of the test and of libalg. Not thread safe.
+ */
+void test_fail_alloc(long n);
+
+/**
+ * @return      1 if the allocation armed by test_fail_alloc() has failed.
+ */
+int test_alloc_failed(void);
+
+/**
+ * deterministic pseudo random numbers, so failures can be replayed.
+ */
+void test_srand(unsigned long seed);
+unsigned long test_rand(void);
+
+int test_list(void);
+int test_lfqueue(void);
+int test_bistree_u64(void);
+int test_bistree_setops(void);
+int test_bistree_fc(void);
+int test_bptree(void);
+int test_htable(void);
+int test_hmap(void);
+int test_ulist(void);
+int test_lru(void);
+int test_skiplist(void);
+int test_epoch(void);
+int test_bistree_rcu(void);
+int test_pbistree(void);
+int test_sorted_batch(void);
+int test_frozen(void);
+int test_interval(void);
+int test_bitree_sized(void);
+int test_bitree_walk(void);
+int test_bitree_reduce(void);
+int test_bitree_pool(void);
+int test_bitree_map(void);
+int test_bitree_build(void);
+int test_bitree_implicit(void);
+int test_avl_tree(void);
+
+#endif
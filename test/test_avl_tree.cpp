@@ -0,0 +1,265 @@
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+extern "C" {
+#include "test.h"
+}
+#include "../src/tree/avl_tree.hpp"
+
+#define KEYS 5000
+
+namespace {
+
+long live;                      // counted values not yet destroyed
+long nodes;                     // nodes held by counting allocators
+
+/**
+ * a value which must never move: it remembers its own address and can
+ * neither be copied nor moved.
+ */
+struct pinned {
+    pinned *self;
+    long value;
+
+    explicit pinned(long v) : self(this), value(v) { live++; }
+    ~pinned() { live--; self = nullptr; }
+    pinned(const pinned &) = delete;
+    pinned &operator=(const pinned &) = delete;
+
+    bool intact(long v) const { return self == this && value == v; }
+};
+
+// throws for negative values, after nothing was constructed
+struct picky {
+    long value;
+
+    explicit picky(long v) : value(v)
+    {
+        if (v < 0)
+            throw v;
+        live++;
+    }
+    picky(picky &&other) noexcept : value(other.value) { live++; }
+    ~picky() { live--; }
+};
+
+template <class T>
+struct counting {
+    typedef T value_type;
+
+    int id;
+
+    explicit counting(int i) : id(i) {}
+    template <class U>
+    counting(const counting<U> &other) : id(other.id) {}
+
+    T *allocate(std::size_t n)
+    {
+        nodes += n;
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T *p, std::size_t n)
+    {
+        nodes -= n;
+        std::allocator<T>().deallocate(p, n);
+    }
+
+    template <class U>
+    bool operator==(const counting<U> &other) const { return id == other.id; }
+    template <class U>
+    bool operator!=(const counting<U> &other) const { return id != other.id; }
+};
+
+// orders std::string keys and looks them up by std::string_view
+struct by_view {
+    typedef void is_transparent;
+
+    bool operator()(std::string_view a, std::string_view b) const { return a < b; }
+};
+
+// random inserts and erases, compared with std::map after every step
+int test_against_map()
+{
+    alg::avl_tree<long, long> tree;
+    std::map<long, long> expect;
+    std::vector<long> keys, values;
+    long i, key;
+
+    test_srand(26);
+    for (i = 0; i < 20 * KEYS; i++) {
+        key = test_rand() % KEYS;
+        if (test_rand() % 3 != 0) {
+            auto got = tree.insert(key, i);
+            auto want = expect.emplace(key, i);
+            TEST_CHECK(got.second == want.second && *got.first == want.first->second);
+        } else {
+            TEST_CHECK(tree.erase(key) == (expect.erase(key) == 1));
+        }
+        TEST_CHECK(tree.size() == expect.size());
+        TEST_CHECK(tree.contains(key) == (expect.count(key) == 1));
+    }
+
+    // In key order, and stopping where asked
+    tree.for_each([&](const long &k, long &v) { keys.push_back(k); values.push_back(v); });
+    TEST_CHECK(keys.size() == expect.size());
+    i = 0;
+    for (auto &kv : expect) {
+        TEST_CHECK(keys[i] == kv.first && values[i] == kv.second);
+        i++;
+    }
+    key = keys[keys.size() / 2];
+    TEST_CHECK(tree.for_each_until([&](const long &k, long &) { return k == key; })
+               == keys.size() / 2 + 1);
+    TEST_CHECK(tree.for_each_until([](const long &, long &) { return false; }) == keys.size());
+
+    // Moving hands the nodes over
+    alg::avl_tree<long, long> moved(std::move(tree));
+    TEST_CHECK(tree.empty() && tree.find(key) == nullptr);
+    TEST_CHECK(moved.size() == expect.size() && *moved.find(key) == expect[key]);
+
+    return 0;
+}
+
+int test_move_only()
+{
+    alg::avl_tree<int, std::unique_ptr<long> > tree;
+    std::unique_ptr<long> value(new long(7));
+    int i;
+
+    for (i = 0; i < 100; i++)
+        TEST_CHECK(tree.emplace(i, new long(i)).second);
+    TEST_CHECK(tree.insert(100, std::move(value)).second && value == nullptr);
+
+    // A duplicate does not take the argument
+    value.reset(new long(8));
+    auto dup = tree.emplace(50, std::move(value));
+    TEST_CHECK(!dup.second && **dup.first == 50 && value != nullptr && *value == 8);
+
+    for (i = 0; i < 100; i += 2)
+        TEST_CHECK(tree.erase(i));
+    for (i = 0; i < 100; i++)
+        TEST_CHECK(i % 2 == 0 ? tree.find(i) == nullptr : **tree.find(i) == i);
+    TEST_CHECK(**tree.find(100) == 7);
+
+    return 0;
+}
+
+int test_strings()
+{
+    alg::avl_tree<std::string, long, by_view> tree;
+    alg::avl_tree<std::string, long> plain;
+    const std::string prefix(40, 'k');   // longer than the small string buffer
+    const alg::avl_tree<std::string, long, by_view> &view = tree;
+    long i;
+
+    for (i = 0; i < KEYS; i++) {
+        TEST_CHECK(tree.insert(prefix + std::to_string(i), i).second);
+        TEST_CHECK(plain.emplace(std::to_string(i), i).second);
+    }
+    TEST_CHECK(!tree.insert(prefix + "17", -1).second);
+
+    // Found by string_view and C strings, with and without converting to Key
+    for (i = 0; i < KEYS; i += 7) {
+        std::string key = prefix + std::to_string(i);
+        TEST_CHECK(*tree.find(std::string_view(key)) == i);
+        TEST_CHECK(*view.find(key.c_str()) == i);
+        TEST_CHECK(*plain.find(std::to_string(i).c_str()) == i);
+    }
+    TEST_CHECK(!tree.contains(std::string_view("k")) && !plain.contains("x"));
+
+    for (i = 0; i < KEYS; i += 3)
+        TEST_CHECK(tree.erase(std::string_view(prefix + std::to_string(i))));
+    TEST_CHECK(!tree.erase(prefix.c_str()));
+    TEST_CHECK(tree.size() == (size_t)(KEYS - (KEYS + 2) / 3));
+
+    std::string last;
+    bool ordered = true;
+    tree.for_each([&](const std::string &k, long &) {
+        ordered = ordered && last < k;
+        last = k;
+    });
+    TEST_CHECK(ordered);
+
+    return 0;
+}
+
+// erasing relinks nodes, so values found earlier stay where they are
+int test_relink()
+{
+    typedef counting<std::pair<const long, pinned> > alloc;
+    std::vector<pinned *> found(KEYS);
+    std::vector<bool> erased(KEYS);
+    long i, key;
+
+    live = nodes = 0;
+    {
+        alg::avl_tree<long, pinned, std::less<long>, alloc> tree(std::less<long>(), alloc(3));
+
+        for (i = 0; i < KEYS; i++)
+            TEST_CHECK((found[i] = tree.emplace(i, i).first) != nullptr);
+        TEST_CHECK(live == KEYS && nodes == KEYS);
+        TEST_CHECK(!tree.emplace(5, -5).second && live == KEYS && nodes == KEYS);
+
+        // Interior nodes with two children are erased as often as leaves
+        test_srand(126);
+        for (i = 0; i < KEYS / 2; i++) {
+            key = test_rand() % KEYS;
+            TEST_CHECK(tree.erase(key) == !erased[key]);
+            erased[key] = true;
+        }
+        TEST_CHECK(live == (long)tree.size() && nodes == (long)tree.size());
+        for (i = 0; i < KEYS; i++) {
+            if (erased[i])
+                TEST_CHECK(tree.find(i) == nullptr);
+            else
+                TEST_CHECK(tree.find(i) == found[i] && found[i]->intact(i));
+        }
+
+        tree.clear();
+        TEST_CHECK(live == 0 && nodes == 0 && tree.empty());
+        for (i = 0; i < KEYS; i++)
+            TEST_CHECK(tree.emplace(i, i).second);
+    }
+    TEST_CHECK(live == 0 && nodes == 0);
+
+    return 0;
+}
+
+// a throwing constructor leaves the tree as it was
+int test_throw()
+{
+    typedef counting<std::pair<const long, picky> > alloc;
+    alg::avl_tree<long, picky, std::less<long>, alloc> tree(std::less<long>(), alloc(1));
+    bool thrown = false;
+    long i;
+
+    live = nodes = 0;
+    for (i = 0; i < 100; i++)
+        TEST_CHECK(tree.emplace(i * 2, i).second);
+    try {
+        tree.emplace(51, -1);
+    } catch (long) {
+        thrown = true;
+    }
+    TEST_CHECK(thrown && tree.size() == 100 && live == 100 && nodes == 100);
+    TEST_CHECK(tree.find(51) == nullptr && tree.find(52)->value == 26);
+    // Moved in through insert()
+    TEST_CHECK(tree.insert(51, picky(3)).second && tree.find(51)->value == 3);
+    TEST_CHECK(live == 101 && nodes == 101);
+
+    return 0;
+}
+
+} // namespace
+
+extern "C" int test_avl_tree(void)
+{
+    if (test_against_map() != 0 || test_move_only() != 0 || test_strings() != 0
+        || test_relink() != 0 || test_throw() != 0)
+        return -1;
+
+    return 0;
+}
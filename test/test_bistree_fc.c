@@ -0,0 +1,196 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+#include "../src/tree/bistree_fc.h"
+
+#define KEYS 4000
+#define OWNED 2000              // keys below are only updated by key % THREADS
+#define THREADS 8
+
+static long destroyed;
+
+static int compare(const void *key1, const void *key2)
+{
+    long a = *(const long *)key1, b = *(const long *)key2;
+
+    return a < b ? -1 : a > b;
+}
+
+static void destroy(void *data)
+{
+    __atomic_add_fetch(&destroyed, 1, __ATOMIC_RELAXED);
+    free(data);
+}
+
+static long *new_key(long key)
+{
+    long *data = malloc(sizeof(*data));
+
+    *data = key;
+    return data;
+}
+
+struct worker {
+    BisTreeFc *fc;
+    int id;
+    long inserted;
+    long removed;
+    int errors;
+};
+
+static void *worker_run(void *arg)
+{
+    struct worker *worker = (struct worker *)arg;
+    struct bistree_fc_slot slot;
+    char present[OWNED];
+    unsigned long seed = worker->id + 1;
+    long key, *data;
+    void *found;
+    int i, ret, owned;
+
+    memset(present, 0, sizeof(present));
+    if (bistree_fc_register(worker->fc, &slot) != 0) {
+        worker->errors++;
+        return NULL;
+    }
+
+    for (i = 0; i < 100000; i++) {
+        seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+        key = (seed >> 33) % KEYS;
+        // The keys of this thread behave like a private map, the others
+        // see inserts and removes of the same key in one batch
+        if (key < OWNED)
+            key = key - key % THREADS + worker->id;
+        else
+            key = OWNED + key % 16;
+        owned = key < OWNED;
+
+        switch ((seed >> 20) % 3) {
+        case 0:
+            data = new_key(key);
+            ret = bistree_fc_insert(worker->fc, &slot, data);
+            if (ret == 1)
+                free(data);
+            worker->inserted += ret == 0;
+            worker->errors += ret == -1 || (owned && ret != present[key]);
+            if (owned)
+                present[key] = 1;
+            break;
+        case 1:
+            ret = bistree_fc_remove(worker->fc, &slot, &key);
+            worker->removed += ret == 0;
+            worker->errors += owned && ret != (present[key] ? 0 : -1);
+            if (owned)
+                present[key] = 0;
+            break;
+        default:
+            // Data of shared keys may be destroyed by now
+            found = &key;
+            ret = bistree_fc_lookup(worker->fc, &slot, &found);
+            worker->errors += ret == 0 && found == &key;
+            worker->errors += owned && ret != (present[key] ? 0 : -1);
+            worker->errors += owned && ret == 0 && *(long *)found != key;
+        }
+    }
+
+    bistree_fc_unregister(worker->fc, &slot);
+
+    return NULL;
+}
+
+static int test_threads(void)
+{
+    struct worker workers[THREADS];
+    pthread_t threads[THREADS];
+    BisTreeFc fc;
+    long key, live = 0, size = 0;
+    void *found;
+    int i;
+
+    destroyed = 0;
+    TEST_CHECK(bistree_fc_init(&fc, compare, destroy) == 0);
+    for (i = 0; i < THREADS; i++) {
+        workers[i].fc = &fc;
+        workers[i].id = i;
+        workers[i].inserted = workers[i].removed = 0;
+        workers[i].errors = 0;
+        pthread_create(&threads[i], NULL, worker_run, &workers[i]);
+    }
+    for (i = 0; i < THREADS; i++) {
+        pthread_join(threads[i], NULL);
+        TEST_CHECK(workers[i].errors == 0);
+        size += workers[i].inserted - workers[i].removed;
+    }
+
+    for (key = 0; key < KEYS; key++) {
+        found = &key;
+        if (bistree_lookup(&fc.tree, &found) == 0) {
+            TEST_CHECK(*(long *)found == key);
+            live++;
+        }
+    }
+    TEST_CHECK(live == size);
+
+    // Every inserted data is destroyed exactly once
+    bistree_fc_destroy(&fc);
+    for (i = 0; i < THREADS; i++)
+        size += workers[i].removed;
+    TEST_CHECK(destroyed == size);
+
+    return 0;
+}
+
+// A batch without memory for its trees falls back to single updates
+static int test_out_of_memory(void)
+{
+    struct bistree_fc_slot slot;
+    BisTreeFc fc;
+    long key, n, *data;
+    void *found;
+    int ret;
+
+    destroyed = 0;
+    TEST_CHECK(bistree_fc_init(&fc, compare, destroy) == 0);
+    TEST_CHECK(bistree_fc_register(&fc, &slot) == 0);
+    for (key = 0; key < 64; key++) {
+        data = new_key(key);
+        for (n = 0; n < 4; n++) {
+            test_fail_alloc(n);
+            ret = bistree_fc_insert(&fc, &slot, data);
+            test_fail_alloc(-1);
+            if (ret == 0)
+                break;
+            TEST_CHECK(ret == -1);
+        }
+        TEST_CHECK(ret == 0);
+        TEST_CHECK(bistree_fc_insert(&fc, &slot, &key) == 1);
+    }
+
+    for (key = 0; key < 64; key += 2) {
+        test_fail_alloc(0);
+        ret = bistree_fc_remove(&fc, &slot, &key);
+        test_fail_alloc(-1);
+        TEST_CHECK(ret == 0);
+    }
+    for (key = 0; key < 64; key++) {
+        found = &key;
+        TEST_CHECK(bistree_fc_lookup(&fc, &slot, &found) == (key % 2 ? 0 : -1));
+        TEST_CHECK(key % 2 == 0 || *(long *)found == key);
+    }
+
+    bistree_fc_unregister(&fc, &slot);
+    bistree_fc_destroy(&fc);
+    TEST_CHECK(destroyed == 64);
+
+    return 0;
+}
+
+int test_bistree_fc(void)
+{
+    test_srand(32);
+    if (test_out_of_memory() != 0 || test_threads() != 0)
+        return -1;
+
+    return 0;
+}
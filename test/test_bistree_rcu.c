@@ -0,0 +1,176 @@
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include "test.h"
+#include "../src/tree/bistree.h"
+
+#define KEYS 1000
+#define READERS 3
+#define UPDATES 50000
+#define LIVE 0x11fe
+#define DEAD 0xdead
+
+struct data {
+    long key;
+    long magic;
+};
+
+// Destroyed data is only marked, so a late reader sees DEAD
+static struct data pool[UPDATES];
+static long destroyed;
+
+static int compare(const void *key1, const void *key2)
+{
+    long a = *(const long *)key1, b = *(const long *)key2;
+
+    return a < b ? -1 : a > b;
+}
+
+static void destroy(void *data)
+{
+    ((struct data *)data)->magic = DEAD;
+    __atomic_add_fetch(&destroyed, 1, __ATOMIC_RELAXED);
+}
+
+struct walk {
+    long last;
+    int count;
+    int errors;
+};
+
+// runs inside the read section, so the data must still be live
+static int visit(void *data, void *ctx)
+{
+    struct walk *walk = (struct walk *)ctx;
+    struct data *d = (struct data *)data;
+
+    walk->errors += d->magic != LIVE || d->key <= walk->last;
+    walk->last = d->key;
+    walk->count++;
+    if (walk->count % 64 == 0)
+        sched_yield();
+    return 0;
+}
+
+struct reader {
+    BisTreeRcu *rcu;
+    int id;
+    int done;
+    int errors;
+};
+
+static void *reader_run(void *arg)
+{
+    struct reader *reader = (struct reader *)arg;
+    struct epoch_record record;
+    struct walk walk;
+    unsigned long seed = reader->id + 1;
+    long key, lo, hi;
+    void *found;
+
+    bistree_rcu_register(reader->rcu, &record);
+    while (!__atomic_load_n(&reader->done, __ATOMIC_ACQUIRE)) {
+        seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+        key = (seed >> 33) % KEYS;
+        if ((seed >> 20) % 2) {
+            // Only the pointer may be checked after the section
+            found = &key;
+            if (bistree_rcu_lookup(reader->rcu, &record, &found) == 0)
+                reader->errors += found < (void *)pool || found >= (void *)(pool + UPDATES);
+        } else {
+            lo = key;
+            hi = key + 100;
+            walk.last = lo - 1;
+            walk.count = walk.errors = 0;
+            bistree_rcu_scan(reader->rcu, &record, &lo, &hi, visit, &walk);
+            reader->errors += walk.errors != 0 || walk.last >= hi || walk.count > 100;
+        }
+    }
+    bistree_rcu_unregister(reader->rcu, &record);
+
+    return NULL;
+}
+
+struct check {
+    const char *present;
+    long last;
+    int count;
+    int errors;
+};
+
+static int check_visit(void *data, void *ctx)
+{
+    struct check *check = (struct check *)ctx;
+    long key = ((struct data *)data)->key;
+
+    check->errors += key <= check->last || !check->present[key];
+    check->last = key;
+    check->count++;
+    return 0;
+}
+
+// one writer against readers that only see live data in key order
+int test_bistree_rcu(void)
+{
+    static char present[KEYS];
+    struct reader readers[READERS];
+    pthread_t threads[READERS];
+    struct epoch_record record;
+    struct check check;
+    BisTreeRcu rcu;
+    long i, key, inserted = 0, size = 0;
+    int j, ret;
+
+    test_srand(31);
+    memset(present, 0, sizeof(present));
+    destroyed = 0;
+    bistree_rcu_init(&rcu, compare, destroy);
+    for (j = 0; j < READERS; j++) {
+        readers[j].rcu = &rcu;
+        readers[j].id = j;
+        readers[j].done = 0;
+        readers[j].errors = 0;
+        pthread_create(&threads[j], NULL, reader_run, &readers[j]);
+    }
+
+    for (i = 0; i < UPDATES; i++) {
+        key = test_rand() % KEYS;
+        if (test_rand() % 2) {
+            pool[i].key = key;
+            pool[i].magic = LIVE;
+            ret = bistree_rcu_insert(&rcu, &pool[i]);
+            TEST_CHECK(ret == present[key]);
+            if (ret == 1)
+                pool[i].magic = DEAD;
+            inserted += ret == 0;
+            size += !present[key];
+            present[key] = 1;
+        } else {
+            TEST_CHECK(bistree_rcu_remove(&rcu, &key) == (present[key] ? 0 : -1));
+            size -= present[key];
+            present[key] = 0;
+        }
+    }
+
+    for (j = 0; j < READERS; j++) {
+        __atomic_store_n(&readers[j].done, 1, __ATOMIC_RELEASE);
+        pthread_join(threads[j], NULL);
+        TEST_CHECK(readers[j].errors == 0);
+    }
+
+    bistree_rcu_register(&rcu, &record);
+    memset(&check, 0, sizeof(check));
+    check.present = present;
+    check.last = -1;
+    TEST_CHECK(bistree_rcu_scan(&rcu, &record, NULL, NULL, check_visit, &check) == size);
+    TEST_CHECK(check.errors == 0 && check.count == size);
+    bistree_rcu_unregister(&rcu, &record);
+
+    // Every inserted data is destroyed exactly once
+    bistree_rcu_destroy(&rcu);
+    TEST_CHECK(destroyed == inserted);
+    for (i = 0; i < UPDATES; i++)
+        TEST_CHECK(pool[i].magic != LIVE);
+
+    return 0;
+}
@@ -0,0 +1,221 @@
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+#include "../src/tree/bistree.h"
+#include "../src/thread/wspool.h"
+
+#define KEYS (1 << 16)
+
+enum { ABSENT, LIVE, HIDDEN };
+
+// state and data of every key in both inputs
+static char state1[KEYS], state2[KEYS];
+static long *data1[KEYS], *data2[KEYS];
+static int outstanding;         // data not destroyed yet
+
+static int compare(const void *key1, const void *key2)
+{
+    long a = *(const long *)key1, b = *(const long *)key2;
+
+    return a < b ? -1 : a > b;
+}
+
+static void destroy(void *data)
+{
+    outstanding--;
+    free(data);
+}
+
+/**
+ * fill @tree with about @percent % of the keys, a quarter of them hidden.
+ */
+static int fill(BisTree *tree, char *state, long **data, int percent)
+{
+    long key;
+
+    bistree_init(tree, compare, destroy);
+    for (key = 0; key < KEYS; key++) {
+        state[key] = ABSENT;
+        if ((int)(test_rand() % 100) >= percent)
+            continue;
+
+        data[key] = malloc(sizeof(long));
+        *data[key] = key;
+        outstanding++;
+        TEST_CHECK(bistree_insert(tree, data[key]) == 0);
+        state[key] = LIVE;
+    }
+
+    for (key = 0; key < KEYS; key++) {
+        if (state[key] == LIVE && test_rand() % 4 == 0) {
+            TEST_CHECK(bistree_remove(tree, &key) == 0);
+            state[key] = HIDDEN;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * check order and AVL balance below @node.
+ * @return      height of @node, -1 if it is broken.
+ */
+static int check_node(BiTreeNode *node, const long *lo, const long *hi, int *count)
+{
+    AvlNode *avl;
+    long key;
+    int hl, hr;
+
+    if (node == NULL)
+        return 0;
+
+    avl = (AvlNode *)bitree_data(node);
+    key = *(long *)avl->data;
+    if ((lo != NULL && key <= *lo) || (hi != NULL && key >= *hi))
+        return -1;
+
+    hl = check_node(bitree_left(node), lo, &key, count);
+    hr = check_node(bitree_right(node), &key, hi, count);
+    if (hl < 0 || hr < 0 || hl - hr != avl->factor)
+        return -1;
+
+    (*count)++;
+    return 1 + (hl > hr ? hl : hr);
+}
+
+/**
+ * compare @tree with the expected live keys and their data.
+ * @expect      0 if @key is not live in the result, 1 for data1, 2 for data2.
+ */
+static int check_result(BisTree *tree, int (*expect)(long key))
+{
+    long key;
+    void *data;
+    int count = 0, want;
+
+    TEST_CHECK(check_node(bitree_root(tree), NULL, NULL, &count) >= 0);
+    TEST_CHECK(count == bitree_size(tree));
+
+    for (key = 0; key < KEYS; key++) {
+        data = &key;
+        want = expect(key);
+        if (want == 0) {
+            TEST_CHECK(bistree_lookup(tree, &data) == -1);
+            continue;
+        }
+        TEST_CHECK(bistree_lookup(tree, &data) == 0);
+        TEST_CHECK(data == (want == 1 ? data1[key] : data2[key]));
+    }
+
+    return 0;
+}
+
+static int expect_union(long key)
+{
+    return state1[key] == LIVE ? 1 : state2[key] == LIVE ? 2 : 0;
+}
+
+static int expect_intersection(long key)
+{
+    return state1[key] == LIVE && state2[key] == LIVE ? 1 : 0;
+}
+
+static int expect_difference(long key)
+{
+    return state1[key] == LIVE && state2[key] != LIVE ? 1 : 0;
+}
+
+static const struct {
+    int (*run)(BisTree *tree, BisTree *t1, BisTree *t2);
+    int (*parallel)(BisTree *tree, BisTree *t1, BisTree *t2, struct wspool *pool);
+    int (*expect)(long key);
+} setops[] = {
+    { bistree_union, bistree_parallel_union, expect_union },
+    { bistree_intersection, bistree_parallel_intersection, expect_intersection },
+    { bistree_difference, bistree_parallel_difference, expect_difference },
+};
+
+// input densities in %, including empty and very uneven inputs
+static const int densities[][2] = {
+    { 50, 50 }, { 90, 1 }, { 1, 90 }, { 0, 30 }, { 30, 0 }, { 100, 100 },
+};
+
+static int run_setops(struct wspool *pool)
+{
+    BisTree t1, t2, result, *tree;
+    int i, j, ret;
+
+    for (i = 0; i < (int)(sizeof(setops) / sizeof(setops[0])); i++) {
+        for (j = 0; j < (int)(sizeof(densities) / sizeof(densities[0])); j++) {
+            TEST_CHECK(fill(&t1, state1, data1, densities[j][0]) == 0);
+            TEST_CHECK(fill(&t2, state2, data2, densities[j][1]) == 0);
+
+            // Every other run writes the result over @t1
+            tree = j % 2 == 0 ? &result : &t1;
+            if (pool == NULL)
+                ret = setops[i].run(tree, &t1, &t2);
+            else
+                ret = setops[i].parallel(tree, &t1, &t2, pool);
+            TEST_CHECK(ret == 0);
+            TEST_CHECK(tree == &t1 || (bitree_size(&t1) == 0 && bitree_root(&t1) == NULL));
+            TEST_CHECK(bitree_size(&t2) == 0 && bitree_root(&t2) == NULL);
+
+            TEST_CHECK(check_result(tree, setops[i].expect) == 0);
+            bistree_destroy(tree);
+            TEST_CHECK(outstanding == 0);
+        }
+    }
+
+    return 0;
+}
+
+static int expect_built(long key)
+{
+    return key % 3 == 0 ? 1 : 0;
+}
+
+static int run_build(struct wspool *pool)
+{
+    static void *sorted[KEYS];
+    BisTree tree;
+    long key;
+    int size = 0;
+
+    for (key = 0; key < KEYS; key++) {
+        state1[key] = ABSENT;
+        if (!expect_built(key))
+            continue;
+        data1[key] = malloc(sizeof(long));
+        *data1[key] = key;
+        sorted[size++] = data1[key];
+        outstanding++;
+    }
+
+    bistree_init(&tree, compare, destroy);
+    if (pool == NULL)
+        TEST_CHECK(bistree_build_sorted(&tree, sorted, size) == 0);
+    else
+        TEST_CHECK(bistree_parallel_build_sorted(&tree, sorted, size, pool) == 0);
+    TEST_CHECK(bitree_size(&tree) == size);
+    TEST_CHECK(check_result(&tree, expect_built) == 0);
+    bistree_destroy(&tree);
+    TEST_CHECK(outstanding == 0);
+
+    return 0;
+}
+
+int test_bistree_setops(void)
+{
+    struct wspool *pool;
+    int ret;
+
+    test_srand(28);
+    if (run_setops(NULL) != 0 || run_build(NULL) != 0)
+        return -1;
+
+    TEST_CHECK((pool = wspool_create(4)) != NULL);
+    ret = run_setops(pool) == 0 && run_build(pool) == 0 ? 0 : -1;
+    wspool_destroy(pool);
+
+    return ret;
+}
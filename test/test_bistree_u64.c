@@ -0,0 +1,108 @@
+#include <string.h>
+#include "test.h"
+#include "../src/tree/bistree_u64.h"
+
+#define KEYS 2048
+
+static int destroyed;
+
+static void destroy(void *data)
+{
+    (void)data;
+    destroyed++;
+}
+
+struct walk {
+    uint64_t last;
+    int count;
+    int unordered;
+    int stop;
+};
+
+static int visit(uint64_t key, void *data, void *ctx)
+{
+    struct walk *walk = (struct walk *)ctx;
+
+    walk->unordered += walk->count > 0 && key <= walk->last;
+    walk->unordered += data != (void *)(uintptr_t)(key + 1);
+    walk->last = key;
+    return ++walk->count == walk->stop;
+}
+
+int test_bistree_u64(void)
+{
+    static char present[KEYS];
+    struct walk walk;
+    BisTreeU64 tree;
+    uint64_t key;
+    void *data;
+    int i, ret, size = 0;
+
+    memset(present, 0, sizeof(present));
+    bistree_u64_init(&tree, destroy);
+    test_srand(26);
+
+    // The empty tree has nothing allocated yet
+    TEST_CHECK(bistree_u64_lookup(&tree, 1, &data) == -1);
+    TEST_CHECK(bistree_u64_remove(&tree, 1) == -1);
+    memset(&walk, 0, sizeof(walk));
+    TEST_CHECK(bistree_u64_foreach(&tree, visit, &walk) == 0);
+
+    for (i = 0; i < 100000; i++) {
+        key = test_rand() % KEYS;
+        if (test_rand() % 3 != 0) {
+            ret = bistree_u64_insert(&tree, key, (void *)(uintptr_t)(key + 1));
+            TEST_CHECK(ret == (present[key] ? 1 : 0));
+            size += !present[key];
+            present[key] = 1;
+        } else {
+            destroyed = 0;
+            ret = bistree_u64_remove(&tree, key);
+            TEST_CHECK(ret == (present[key] ? 0 : -1) && destroyed == !ret);
+            size -= present[key];
+            present[key] = 0;
+        }
+        TEST_CHECK((int)bistree_u64_size(&tree) == size);
+    }
+
+    for (key = 0; key < KEYS; key++) {
+        ret = bistree_u64_lookup(&tree, key, &data);
+        TEST_CHECK(ret == (present[key] ? 0 : -1));
+        TEST_CHECK(ret != 0 || data == (void *)(uintptr_t)(key + 1));
+    }
+
+    memset(&walk, 0, sizeof(walk));
+    TEST_CHECK(bistree_u64_foreach(&tree, visit, &walk) == size);
+    TEST_CHECK(walk.unordered == 0);
+    memset(&walk, 0, sizeof(walk));
+    walk.stop = 10;
+    TEST_CHECK(bistree_u64_foreach(&tree, visit, &walk) == 10);
+
+    // Failed allocations leave the tree as it was
+    key = KEYS;
+    for (i = 0; ; i++) {
+        test_fail_alloc(i);
+        ret = bistree_u64_insert(&tree, key, (void *)(uintptr_t)(key + 1));
+        test_fail_alloc(-1);
+        if (ret == 0)
+            break;
+        TEST_CHECK(ret == -1 && test_alloc_failed());
+        TEST_CHECK((int)bistree_u64_size(&tree) == size);
+        TEST_CHECK(bistree_u64_lookup(&tree, key, &data) == -1);
+    }
+    TEST_CHECK(i > 0 && (int)bistree_u64_size(&tree) == ++size);
+
+    destroyed = 0;
+    bistree_u64_destroy(&tree);
+    TEST_CHECK(destroyed == size && bistree_u64_size(&tree) == 0);
+
+    // Also when the very first insert cannot allocate the tree
+    test_fail_alloc(0);
+    ret = bistree_u64_insert(&tree, 1, NULL);
+    test_fail_alloc(-1);
+    TEST_CHECK(ret == -1 && bistree_u64_size(&tree) == 0);
+    TEST_CHECK(bistree_u64_insert(&tree, 1, NULL) == 0);
+    bistree_u64_destroy(&tree);
+
+    return 0;
+}
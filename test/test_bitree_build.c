@@ -0,0 +1,303 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "test.h"
+#include "../src/tree/bitree.h"
+
+#define NODES 20000             // the text is a few 64K windows long
+#define LONG_TOKEN (150 * 1024) // longer than the window
+
+static long ids[NODES];
+static struct bitree_node *nodes[NODES];
+
+struct text {
+    char *buf;
+    size_t len;
+    size_t capacity;
+};
+
+static int append(struct text *text, const char *token, size_t len)
+{
+    char *grown;
+
+    if (text->len + len + 2 > text->capacity) {
+        if ((grown = realloc(text->buf, 2 * (text->len + len + 2))) == NULL)
+            return -1;
+        text->buf = grown;
+        text->capacity = 2 * (text->len + len + 2);
+    }
+    memcpy(text->buf + text->len, token, len);
+    text->len += len;
+    // Vary the separators
+    text->buf[text->len] = text->len % 7 == 0 ? '\n' : ' ';
+    text->buf[++text->len] = '\0';
+
+    return 0;
+}
+
+static int append_id(struct text *text, struct bitree_node *node)
+{
+    char token[32];
+
+    return append(text, token, snprintf(token, sizeof(token), "%ld", *(long *)bitree_data(node)));
+}
+
+static int write_preorder(struct text *text, struct bitree_node *node, int markers)
+{
+    if (node == NULL)
+        return markers ? append(text, BITREE_NULL_TOKEN, 1) : 0;
+
+    if (append_id(text, node) != 0
+        || write_preorder(text, bitree_left(node), markers) != 0
+        || write_preorder(text, bitree_right(node), markers) != 0)
+        return -1;
+
+    return 0;
+}
+
+static int write_inorder(struct text *text, struct bitree_node *node)
+{
+    if (node == NULL)
+        return 0;
+
+    if (write_inorder(text, bitree_left(node)) != 0
+        || append_id(text, node) != 0
+        || write_inorder(text, bitree_right(node)) != 0)
+        return -1;
+
+    return 0;
+}
+
+static void *parse(const char *token, size_t len, void *ctx)
+{
+    long value = 0;
+    size_t i;
+
+    (void)ctx;
+    for (i = 0; i < len; i++)
+        value = value * 10 + token[i] - '0';
+
+    return value < NODES ? &ids[value] : NULL;
+}
+
+static int match(const void *data, const char *token, size_t len)
+{
+    return parse(token, len, NULL) == data;
+}
+
+/**
+ * same shape and data, and counts and parents in a sized tree.
+ */
+static long same(struct bitree_tree *built, struct bitree_node *a, struct bitree_node *b,
+                 struct bitree_node *parent)
+{
+    long left, right;
+
+    if (a == NULL || b == NULL)
+        return a == b ? 0 : -1;
+    if (bitree_data(a) != bitree_data(b))
+        return -1;
+    if (built->sized && bitree_parent(b) != parent)
+        return -1;
+
+    left = same(built, bitree_left(a), bitree_left(b), b);
+    right = same(built, bitree_right(a), bitree_right(b), b);
+    if (left < 0 || right < 0)
+        return -1;
+    if (built->sized && bitree_count(b) != left + right + 1)
+        return -1;
+
+    return left + right + 1;
+}
+
+static int build(struct bitree_tree *tree, int size, int chain)
+{
+    struct bitree_node *parent;
+    int i;
+
+    bitree_init(tree, NULL);
+    TEST_CHECK(bitree_ins_left_data(tree, NULL, &ids[0]) == 0);
+    nodes[0] = bitree_root(tree);
+    for (i = 1; i < size; i++) {
+        parent = nodes[chain ? i - 1 : (int)(test_rand() % i)];
+        if (bitree_left(parent) == NULL && (chain || test_rand() % 2)) {
+            TEST_CHECK(bitree_ins_left_data(tree, parent, &ids[i]) == 0);
+            nodes[i] = bitree_left(parent);
+        } else if (bitree_right(parent) == NULL) {
+            TEST_CHECK(bitree_ins_right_data(tree, parent, &ids[i]) == 0);
+            nodes[i] = bitree_right(parent);
+        } else {
+            i--;
+        }
+    }
+
+    return 0;
+}
+
+static void init_tree(struct bitree_tree *tree, int kind)
+{
+    if (kind == 1)
+        bitree_init_sized(tree, NULL);
+    else
+        bitree_init(tree, NULL);
+    if (kind == 2)
+        bitree_use_pool(tree, 0);
+}
+
+/**
+ * rebuild @tree from its text in every way and compare.
+ */
+static int rebuild(struct bitree_tree *tree, const char *path)
+{
+    struct text pre = { NULL, 0, 0 }, in = { NULL, 0, 0 }, plain = { NULL, 0, 0 };
+    struct bitree_stream stream, stream2;
+    struct bitree_tree built;
+    int kind, fd;
+
+    TEST_CHECK(write_preorder(&pre, bitree_root(tree), 1) == 0);
+    TEST_CHECK(write_preorder(&plain, bitree_root(tree), 0) == 0);
+    TEST_CHECK(write_inorder(&in, bitree_root(tree)) == 0);
+
+    for (kind = 0; kind < 3; kind++) {
+        // Plain, sized and pooled trees
+        init_tree(&built, kind);
+        bitree_stream_buffer(&stream, pre.buf, pre.len);
+        TEST_CHECK(bitree_build_preorder(&built, &stream, parse, NULL) == 0);
+        TEST_CHECK(same(&built, bitree_root(tree), bitree_root(&built), NULL) == bitree_size(tree));
+        TEST_CHECK(bitree_size(&built) == bitree_size(tree));
+        bitree_destroy(&built);
+
+        init_tree(&built, kind);
+        bitree_stream_buffer(&stream, plain.buf, plain.len);
+        bitree_stream_buffer(&stream2, in.buf, in.len);
+        TEST_CHECK(bitree_build_pre_in(&built, &stream, &stream2, parse, match, NULL) == 0);
+        TEST_CHECK(same(&built, bitree_root(tree), bitree_root(&built), NULL) == bitree_size(tree));
+        TEST_CHECK(bitree_size(&built) == bitree_size(tree));
+        bitree_destroy(&built);
+    }
+
+    // Read through the window of an fd stream
+    TEST_CHECK((fd = open(path, O_WRONLY | O_TRUNC)) >= 0);
+    TEST_CHECK(write(fd, pre.buf, pre.len) == (ssize_t)pre.len);
+    close(fd);
+    TEST_CHECK((fd = open(path, O_RDONLY)) >= 0);
+    TEST_CHECK(bitree_stream_fd(&stream, fd) == 0);
+    bitree_init(&built, NULL);
+    TEST_CHECK(bitree_build_preorder(&built, &stream, parse, NULL) == 0);
+    bitree_stream_close(&stream);
+    close(fd);
+    TEST_CHECK(same(&built, bitree_root(tree), bitree_root(&built), NULL) == bitree_size(tree));
+    bitree_destroy(&built);
+
+    free(pre.buf);
+    free(in.buf);
+    free(plain.buf);
+
+    return 0;
+}
+
+// input which is not one complete tree
+static int test_errors(const char *path)
+{
+    static const char *preorder[] = { "1 2 #", "1 # # 2", "#", "", "1 # # #" };
+    static const int expect[] = { -1, -1, 0, 0, -1 };
+    struct bitree_stream stream, stream2;
+    struct bitree_tree tree;
+    char *token;
+    int i, fd;
+
+    for (i = 0; i < (int)(sizeof(preorder) / sizeof(preorder[0])); i++) {
+        bitree_init(&tree, NULL);
+        bitree_stream_buffer(&stream, preorder[i], strlen(preorder[i]));
+        TEST_CHECK(bitree_build_preorder(&tree, &stream, parse, NULL) == expect[i]);
+        bitree_destroy(&tree);
+    }
+
+    // The sequences must describe the same tree
+    bitree_init(&tree, NULL);
+    bitree_stream_buffer(&stream, "1 2 3", 5);
+    bitree_stream_buffer(&stream2, "2 3 1 4", 7);
+    TEST_CHECK(bitree_build_pre_in(&tree, &stream, &stream2, parse, match, NULL) == -1);
+    bitree_destroy(&tree);
+    bitree_init(&tree, NULL);
+    bitree_stream_buffer(&stream, "1 2 3", 5);
+    bitree_stream_buffer(&stream2, "3 1 2", 5);
+    TEST_CHECK(bitree_build_pre_in(&tree, &stream, &stream2, parse, match, NULL) == -1);
+    bitree_destroy(&tree);
+
+    // Only empty trees are built into
+    bitree_init(&tree, NULL);
+    bitree_stream_buffer(&stream, "1 # #", 5);
+    TEST_CHECK(bitree_build_preorder(&tree, &stream, parse, NULL) == 0);
+    bitree_stream_buffer(&stream, "1 # #", 5);
+    TEST_CHECK(bitree_build_preorder(&tree, &stream, parse, NULL) == -1);
+    bitree_destroy(&tree);
+
+    // A token longer than the window grows it
+    TEST_CHECK((token = malloc(LONG_TOKEN)) != NULL);
+    memset(token, '0', LONG_TOKEN);
+    memcpy(token + LONG_TOKEN - 8, "42 # #\n", 7);
+    TEST_CHECK((fd = open(path, O_WRONLY | O_TRUNC)) >= 0);
+    TEST_CHECK(write(fd, token, LONG_TOKEN - 1) == LONG_TOKEN - 1);
+    close(fd);
+    free(token);
+    TEST_CHECK((fd = open(path, O_RDONLY)) >= 0);
+    TEST_CHECK(bitree_stream_fd(&stream, fd) == 0);
+    bitree_init(&tree, NULL);
+    TEST_CHECK(bitree_build_preorder(&tree, &stream, parse, NULL) == 0);
+    TEST_CHECK(bitree_size(&tree) == 1 && bitree_data(bitree_root(&tree)) == &ids[42]);
+    bitree_stream_close(&stream);
+    close(fd);
+    bitree_destroy(&tree);
+
+    return 0;
+}
+
+static void set_data(struct bitree_node *node, char *value)
+{
+    node->data = parse(value, strlen(value), NULL);
+}
+
+int test_bitree_build(void)
+{
+    char path[] = "/tmp/test_bitree_build.XXXXXX";
+    struct bitree_tree tree, built;
+    int fd, size, ret = 0;
+    long i;
+
+    test_srand(42);
+    for (i = 0; i < NODES; i++)
+        ids[i] = i;
+    TEST_CHECK((fd = mkstemp(path)) >= 0);
+    close(fd);
+
+    for (size = 1; size <= NODES && ret == 0; size = size * 5 + 1) {
+        ret = build(&tree, size, 0) != 0 || rebuild(&tree, path) != 0;
+        bitree_destroy(&tree);
+    }
+    // Deep enough that a recursive builder would need a large stack
+    if (ret == 0) {
+        ret = build(&tree, NODES, 1) != 0 || rebuild(&tree, path) != 0;
+        bitree_destroy(&tree);
+    }
+    if (ret == 0)
+        ret = test_errors(path);
+    unlink(path);
+    TEST_CHECK(ret == 0);
+
+    // The old entry point builds through the same parser
+    bitree_init(&tree, NULL);
+    build_tree_data(&tree, NULL, set_data, "5 3 # # 8 # 9 # #");
+    bitree_init(&built, NULL);
+    TEST_CHECK(bitree_ins_left_data(&built, NULL, &ids[5]) == 0);
+    TEST_CHECK(bitree_ins_left_data(&built, bitree_root(&built), &ids[3]) == 0);
+    TEST_CHECK(bitree_ins_right_data(&built, bitree_root(&built), &ids[8]) == 0);
+    TEST_CHECK(bitree_ins_right_data(&built, bitree_right(bitree_root(&built)), &ids[9]) == 0);
+    TEST_CHECK(same(&tree, bitree_root(&built), bitree_root(&tree), NULL) == 4);
+    bitree_destroy(&tree);
+    bitree_destroy(&built);
+
+    return 0;
+}
@@ -0,0 +1,274 @@
+#include <string.h>
+#include "test.h"
+#include "../src/tree/bitree_implicit.h"
+
+#define NODES 300
+
+static long ids[NODES];
+static long destroyed;
+
+static void destroy(void *data)
+{
+    (void)data;
+    destroyed++;
+}
+
+struct visit {
+    long seen[NODES];
+    int count;
+    int stop;                   // stop after this many, 0 never
+};
+
+static int visit(void *data, void *ctx)
+{
+    struct visit *walk = (struct visit *)ctx;
+
+    walk->seen[walk->count++] = *(long *)data;
+    return walk->count == walk->stop ? 5 : 0;
+}
+
+/**
+ * the walk by recursion over the index arithmetic.
+ */
+static void reference(struct bitree_implicit *tree, long node, int order,
+                      long *expect, int *count)
+{
+    if (node == BITREE_IMPLICIT_NONE)
+        return;
+    if (order == BITREE_PREORDER)
+        expect[(*count)++] = *(long *)bitree_implicit_data(tree, node);
+    reference(tree, bitree_implicit_left(tree, node), order, expect, count);
+    if (order == BITREE_INORDER)
+        expect[(*count)++] = *(long *)bitree_implicit_data(tree, node);
+    reference(tree, bitree_implicit_right(tree, node), order, expect, count);
+    if (order == BITREE_POSTORDER)
+        expect[(*count)++] = *(long *)bitree_implicit_data(tree, node);
+}
+
+static int fill(struct bitree_implicit *tree, long size)
+{
+    long i;
+
+    bitree_implicit_init(tree, destroy);
+    for (i = 0; i < size; i++)
+        TEST_CHECK(bitree_implicit_push(tree, &ids[i]) == 0);
+    TEST_CHECK(bitree_implicit_size(tree) == (size_t)size);
+
+    return 0;
+}
+
+// every order from every subtree root, with and without a stop
+static int check_walks(struct bitree_implicit *tree)
+{
+    static long expect[NODES];
+    static struct visit walk;
+    long node;
+    int order, count;
+
+    for (node = 0; node < (long)tree->size; node += 1 + node / 4) {
+        for (order = BITREE_PREORDER; order <= BITREE_POSTORDER; order++) {
+            count = 0;
+            reference(tree, node, order, expect, &count);
+            TEST_CHECK(bitree_implicit_subtree_size(tree, node) == (size_t)count);
+
+            walk.count = walk.stop = 0;
+            TEST_CHECK(bitree_implicit_walk(tree, node, order, visit, &walk) == 0);
+            TEST_CHECK(walk.count == count);
+            TEST_CHECK(memcmp(walk.seen, expect, count * sizeof(long)) == 0);
+
+            walk.count = 0;
+            walk.stop = 1 + count / 2;
+            TEST_CHECK(bitree_implicit_walk(tree, node, order, visit, &walk) == 5);
+            TEST_CHECK(walk.count == walk.stop);
+            TEST_CHECK(memcmp(walk.seen, expect, walk.count * sizeof(long)) == 0);
+        }
+    }
+
+    return 0;
+}
+
+// splitting at the root and merging back gives the same array
+static int check_split_merge(struct bitree_implicit *tree)
+{
+    struct bitree_implicit left, right, merged;
+    size_t size = tree->size;
+    void *root;
+
+    TEST_CHECK(bitree_implicit_split(tree, &left, &right) == 0);
+    TEST_CHECK(tree->size == 1 && left.size + right.size == size - 1);
+    TEST_CHECK(left.destroy == destroy && right.destroy == destroy);
+    TEST_CHECK(bitree_implicit_pop(tree, &root) == 0 && root == &ids[0]);
+
+    TEST_CHECK(bitree_implicit_merge(&merged, &left, &right, root) == 0);
+    TEST_CHECK(left.size == 0 && right.size == 0 && left.data == NULL);
+    TEST_CHECK(merged.size == size && merged.destroy == destroy);
+    for (size = 0; size < merged.size; size++)
+        TEST_CHECK(bitree_implicit_data(&merged, size) == &ids[size]);
+
+    bitree_implicit_destroy(tree);
+    *tree = merged;
+
+    return 0;
+}
+
+// only shapes which give a complete tree are merged
+static int test_merge_shapes(void)
+{
+    static const int shapes[][3] = {
+        // left, right, accepted
+        { 0, 0, 1 }, { 1, 0, 1 }, { 1, 1, 1 }, { 2, 1, 1 }, { 3, 3, 1 },
+        { 3, 1, 1 }, { 6, 3, 1 }, { 7, 4, 1 }, { 0, 1, 0 }, { 1, 2, 0 },
+        { 4, 3, 1 }, { 2, 2, 0 }, { 3, 0, 0 }, { 4, 1, 0 }, { 3, 7, 0 },
+        { 7, 1, 0 },
+    };
+    struct bitree_implicit left, right, merged;
+    int i;
+
+    for (i = 0; i < (int)(sizeof(shapes) / sizeof(shapes[0])); i++) {
+        if (fill(&left, shapes[i][0]) != 0 || fill(&right, shapes[i][1]) != 0)
+            return -1;
+        TEST_CHECK(bitree_implicit_merge(&merged, &left, &right, &ids[0])
+                   == (shapes[i][2] ? 0 : -1));
+        if (shapes[i][2]) {
+            TEST_CHECK(merged.size == (size_t)(1 + shapes[i][0] + shapes[i][1]));
+            bitree_implicit_destroy(&merged);
+        } else {
+            // Refused inputs are left alone
+            TEST_CHECK(left.size == (size_t)shapes[i][0] && right.size == (size_t)shapes[i][1]);
+        }
+        bitree_implicit_destroy(&left);
+        bitree_implicit_destroy(&right);
+    }
+
+    return 0;
+}
+
+static int check_counts(struct bitree_node *node, struct bitree_node *parent)
+{
+    int left, right;
+
+    if (node == NULL)
+        return 0;
+    if (bitree_parent(node) != parent)
+        return -1;
+    if ((left = check_counts(bitree_left(node), node)) < 0
+        || (right = check_counts(bitree_right(node), node)) < 0
+        || bitree_count(node) != left + right + 1)
+        return -1;
+
+    return left + right + 1;
+}
+
+// to a sized bitree and back, and incomplete trees are refused
+static int test_bitree(void)
+{
+    struct bitree_implicit implicit;
+    struct bitree_tree tree;
+    struct bitree_node *root;
+    long size, i;
+
+    for (size = 0; size < NODES; size += 1 + size / 8) {
+        if (fill(&implicit, size) != 0)
+            return -1;
+        bitree_init_sized(&tree, destroy);
+        TEST_CHECK(bitree_implicit_to_bitree(&implicit, &tree) == 0);
+        TEST_CHECK(implicit.size == 0 && bitree_size(&tree) == size);
+        TEST_CHECK(check_counts(bitree_root(&tree), NULL) == size);
+
+        destroyed = 0;
+        TEST_CHECK(bitree_implicit_from_bitree(&implicit, &tree) == 0);
+        TEST_CHECK(destroyed == 0 && bitree_size(&tree) == 0 && bitree_root(&tree) == NULL);
+        TEST_CHECK(implicit.size == (size_t)size);
+        for (i = 0; i < size; i++)
+            TEST_CHECK(bitree_implicit_data(&implicit, i) == &ids[i]);
+        bitree_destroy(&tree);
+        bitree_implicit_destroy(&implicit);
+        TEST_CHECK(destroyed == size);
+    }
+
+    // A gap in the last level is not complete
+    if (fill(&implicit, 6) != 0)
+        return -1;
+    bitree_init(&tree, NULL);
+    TEST_CHECK(bitree_implicit_to_bitree(&implicit, &tree) == 0);
+    root = bitree_root(&tree);
+    bitree_rm_left(&tree, bitree_left(root));
+    TEST_CHECK(bitree_implicit_from_bitree(&implicit, &tree) == -1);
+    TEST_CHECK(implicit.size == 0 && implicit.data == NULL);
+    TEST_CHECK(bitree_size(&tree) == 5 && bitree_root(&tree) == root);
+    bitree_destroy(&tree);
+
+    return 0;
+}
+
+// failed allocations leave everything as it was
+static int test_alloc(void)
+{
+    struct bitree_implicit implicit, left, right;
+    struct bitree_tree tree;
+    long i;
+
+    if (fill(&implicit, 16) != 0)
+        return -1;
+    test_fail_alloc(0);
+    TEST_CHECK(bitree_implicit_push(&implicit, &ids[16]) == -1);
+    test_fail_alloc(-1);
+    TEST_CHECK(implicit.size == 16);
+
+    test_fail_alloc(1);
+    TEST_CHECK(bitree_implicit_split(&implicit, &left, &right) == -1);
+    test_fail_alloc(-1);
+    TEST_CHECK(implicit.size == 16 && left.data == NULL && right.data == NULL);
+
+    bitree_init(&tree, NULL);
+    test_fail_alloc(5);
+    TEST_CHECK(bitree_implicit_to_bitree(&implicit, &tree) == -1);
+    test_fail_alloc(-1);
+    TEST_CHECK(bitree_size(&tree) == 0 && bitree_root(&tree) == NULL);
+    TEST_CHECK(implicit.size == 16);
+    for (i = 0; i < 16; i++)
+        TEST_CHECK(bitree_implicit_data(&implicit, i) == &ids[i]);
+
+    destroyed = 0;
+    bitree_implicit_destroy(&implicit);
+    TEST_CHECK(destroyed == 16);
+
+    return 0;
+}
+
+int test_bitree_implicit(void)
+{
+    struct bitree_implicit tree;
+    void *data;
+    long size, i;
+
+    for (i = 0; i < NODES; i++)
+        ids[i] = i;
+
+    for (size = 0; size < NODES; size += 1 + size / 4) {
+        if (fill(&tree, size) != 0 || check_walks(&tree) != 0)
+            return -1;
+        for (i = 0; i < size; i++) {
+            TEST_CHECK(bitree_implicit_parent(&tree, i) == (i > 0 ? (i - 1) / 2 : BITREE_IMPLICIT_NONE));
+            TEST_CHECK(bitree_implicit_left(&tree, i) == (2 * i + 1 < size ? 2 * i + 1 : BITREE_IMPLICIT_NONE));
+            TEST_CHECK(bitree_implicit_right(&tree, i) == (2 * i + 2 < size ? 2 * i + 2 : BITREE_IMPLICIT_NONE));
+        }
+        if (size > 0 && check_split_merge(&tree) != 0)
+            return -1;
+        if (check_walks(&tree) != 0)
+            return -1;
+
+        // Popping gives back the last node, and nothing once empty
+        for (i = size - 1; i >= 0; i--)
+            TEST_CHECK(bitree_implicit_pop(&tree, &data) == 0 && data == &ids[i]);
+        TEST_CHECK(bitree_implicit_pop(&tree, &data) == -1);
+        destroyed = 0;
+        bitree_implicit_destroy(&tree);
+        TEST_CHECK(destroyed == 0);
+    }
+
+    if (test_merge_shapes() != 0 || test_bitree() != 0 || test_alloc() != 0)
+        return -1;
+
+    return 0;
+}
@@ -0,0 +1,191 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "test.h"
+#include "../src/tree/bitree_map.h"
+
+#define NODES 5000
+#define RECORD 12               // not a multiple of 8 on purpose
+
+static long ids[NODES];
+static struct bitree_node *nodes[NODES];
+
+// The id and its complement, so a shifted record shows up
+static int encode(const void *data, void *record, void *ctx)
+{
+    uint64_t id = *(const long *)data;
+    uint32_t check = ~(uint32_t)id;
+
+    if (ctx != NULL && id == *(long *)ctx)
+        return -1;
+    memcpy(record, &id, sizeof(id));
+    memcpy((char *)record + sizeof(id), &check, sizeof(check));
+    return 0;
+}
+
+static const struct bitree_codec codec = { RECORD, encode };
+
+static long record_id(const BiTreeMap *map, long node)
+{
+    const char *record = (const char *)bitree_map_data(map, node);
+    uint64_t id;
+    uint32_t check;
+
+    memcpy(&id, record, sizeof(id));
+    memcpy(&check, record + sizeof(id), sizeof(check));
+    return check == ~(uint32_t)id ? (long)id : -1;
+}
+
+/**
+ * a tree of @size nodes, random or, with @chain, every node the right
+ * child of the one before.
+ */
+static int build(struct bitree_tree *tree, int size, int chain)
+{
+    struct bitree_node *parent;
+    int i;
+
+    bitree_init(tree, NULL);
+    if (size == 0)
+        return 0;
+    TEST_CHECK(bitree_ins_left_data(tree, NULL, &ids[0]) == 0);
+    nodes[0] = bitree_root(tree);
+    for (i = 1; i < size; i++) {
+        parent = nodes[chain ? i - 1 : (int)(test_rand() % i)];
+        if (!chain && bitree_left(parent) == NULL && test_rand() % 2) {
+            TEST_CHECK(bitree_ins_left_data(tree, parent, &ids[i]) == 0);
+            nodes[i] = bitree_left(parent);
+        } else if (bitree_right(parent) == NULL) {
+            TEST_CHECK(bitree_ins_right_data(tree, parent, &ids[i]) == 0);
+            nodes[i] = bitree_right(parent);
+        } else {
+            i--;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * walk the pointer tree and the mapped one side by side.
+ * @return      number of nodes, -1 on a mismatch.
+ */
+static long compare_node(const BiTreeMap *map, struct bitree_node *node, long mapped,
+                         long parent)
+{
+    long left, right;
+
+    if (node == NULL)
+        return mapped == BITREE_MAP_NONE ? 0 : -1;
+    if (mapped == BITREE_MAP_NONE || mapped >= (long)map->size)
+        return -1;
+    if (record_id(map, mapped) != *(long *)bitree_data(node)
+        || bitree_map_parent(map, mapped) != parent)
+        return -1;
+
+    left = compare_node(map, bitree_left(node), bitree_map_left(map, mapped), mapped);
+    right = compare_node(map, bitree_right(node), bitree_map_right(map, mapped), mapped);
+    if (left < 0 || right < 0)
+        return -1;
+
+    return left + right + 1;
+}
+
+static int round_trip(struct bitree_tree *tree, const char *path)
+{
+    BiTreeMap map;
+    long node;
+
+    TEST_CHECK(bitree_serialize(tree, path, &codec, NULL) == 0);
+    TEST_CHECK(bitree_map(&map, path) == 0);
+    TEST_CHECK(map.size == (uint64_t)bitree_size(tree) && map.record_size == RECORD);
+    TEST_CHECK(compare_node(&map, bitree_root(tree), bitree_map_root(&map),
+                            BITREE_MAP_NONE) == bitree_size(tree));
+
+    // Level order numbers the nodes consecutively
+    for (node = 1; node < (long)map.size; node++)
+        TEST_CHECK(bitree_map_parent(&map, node) < node);
+    bitree_unmap(&map);
+
+    return 0;
+}
+
+// files that are not a tree, or not all of one, are refused
+static int test_errors(const char *path)
+{
+    struct bitree_tree tree;
+    BiTreeMap map;
+    FILE *file;
+    long size, stop = 7;
+
+    TEST_CHECK(bitree_map(&map, "/nonexistent/bitree") == -1);
+
+    if (build(&tree, 100, 0) != 0)
+        return -1;
+    TEST_CHECK(bitree_serialize(&tree, "/nonexistent/bitree", &codec, NULL) == -1);
+    // A failing codec fails the whole file
+    TEST_CHECK(bitree_serialize(&tree, path, &codec, &stop) == -1);
+
+    test_fail_alloc(0);
+    TEST_CHECK(bitree_serialize(&tree, path, &codec, NULL) == -1);
+    test_fail_alloc(-1);
+
+    TEST_CHECK(bitree_serialize(&tree, path, &codec, NULL) == 0);
+    bitree_destroy(&tree);
+
+    // Cut the records short
+    TEST_CHECK((file = fopen(path, "r+b")) != NULL);
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    fclose(file);
+    TEST_CHECK(truncate(path, size - 1) == 0);
+    TEST_CHECK(bitree_map(&map, path) == -1);
+    TEST_CHECK(truncate(path, 8) == 0);
+    TEST_CHECK(bitree_map(&map, path) == -1);
+
+    // Wrong magic
+    TEST_CHECK(truncate(path, 0) == 0);
+    TEST_CHECK((file = fopen(path, "wb")) != NULL);
+    for (size = 0; size < 64; size++)
+        fputc('x', file);
+    fclose(file);
+    TEST_CHECK(bitree_map(&map, path) == -1);
+
+    return 0;
+}
+
+int test_bitree_map(void)
+{
+    char path[] = "/tmp/test_bitree_map.XXXXXX";
+    struct bitree_tree tree;
+    int fd, size, ret = 0;
+    long i;
+
+    test_srand(41);
+    for (i = 0; i < NODES; i++)
+        ids[i] = i;
+    TEST_CHECK((fd = mkstemp(path)) >= 0);
+    close(fd);
+
+    // Sizes around the rank blocks of 256 nodes
+    for (size = 0; size <= NODES && ret == 0; size = size < 4 ? size + 1 : size * 2 + 1) {
+        ret = build(&tree, size, 0) != 0 || round_trip(&tree, path) != 0;
+        bitree_destroy(&tree);
+        if (ret == 0) {
+            ret = build(&tree, size, 1) != 0 || round_trip(&tree, path) != 0;
+            bitree_destroy(&tree);
+        }
+    }
+    for (size = 255; size <= 257 && ret == 0; size++) {
+        ret = build(&tree, size, 0) != 0 || round_trip(&tree, path) != 0;
+        bitree_destroy(&tree);
+    }
+
+    if (ret == 0)
+        ret = test_errors(path);
+    unlink(path);
+
+    return ret == 0 ? 0 : -1;
+}
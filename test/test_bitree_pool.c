@@ -0,0 +1,187 @@
+#include <stdint.h>
+#include "test.h"
+#include "../src/tree/bitree.h"
+
+#define NODES 20000             // several slabs of either node size
+
+static long destroyed;
+
+static void destroy(void *data)
+{
+    (void)data;
+    destroyed++;
+}
+
+static struct bitree_node *heap[NODES + 1];
+
+/**
+ * fill the empty @tree with @count nodes in heap order, heap[1] is the
+ * root and the children of heap[k] are heap[2k] and heap[2k + 1].
+ */
+static int grow(struct bitree_tree *tree, int count)
+{
+    struct bitree_node *parent;
+    int k;
+
+    if (bitree_ins_left_data(tree, NULL, NULL) != 0)
+        return -1;
+    heap[1] = bitree_root(tree);
+
+    for (k = 2; k <= count; k++) {
+        parent = heap[k / 2];
+        if (k % 2 == 0) {
+            if (bitree_ins_left_data(tree, parent, NULL) != 0)
+                return -1;
+            heap[k] = bitree_left(parent);
+        } else {
+            if (bitree_ins_right_data(tree, parent, NULL) != 0)
+                return -1;
+            heap[k] = bitree_right(parent);
+        }
+    }
+
+    return 0;
+}
+
+static int check_counts(struct bitree_node *node)
+{
+    int left, right;
+
+    if (node == NULL)
+        return 0;
+    if ((left = check_counts(bitree_left(node))) < 0
+        || (right = check_counts(bitree_right(node))) < 0
+        || bitree_count(node) != left + right + 1)
+        return -1;
+
+    return left + right + 1;
+}
+
+// removed nodes are reused before the slab grows
+static int test_recycle(int sized)
+{
+    struct bitree_tree tree;
+    struct bitree_node *node, *freed;
+    struct bitree_slab *slabs;
+
+    if (sized)
+        bitree_init_sized(&tree, destroy);
+    else
+        bitree_init(&tree, destroy);
+    TEST_CHECK(bitree_use_pool(&tree, 0) == 0);
+    TEST_CHECK(bitree_use_pool(&tree, 0) == -1);
+    TEST_CHECK(grow(&tree, NODES) == 0);
+    TEST_CHECK(bitree_size(&tree) == NODES);
+    TEST_CHECK(!sized || check_counts(bitree_root(&tree)) == NODES);
+
+    // The last node freed is the first one handed out again
+    node = heap[NODES / 2];
+    freed = heap[NODES];
+    destroyed = 0;
+    bitree_rm_left(&tree, node);
+    TEST_CHECK(destroyed == 1);
+    TEST_CHECK(bitree_ins_left_data(&tree, node, NULL) == 0);
+    TEST_CHECK(bitree_left(node) == freed);
+    TEST_CHECK(!sized || check_counts(bitree_root(&tree)) == NODES);
+
+    // A regrown tree comes from the free list, no new slab
+    destroyed = 0;
+    slabs = tree.pool->slabs;
+    bitree_rm_left(&tree, NULL);
+    TEST_CHECK(bitree_size(&tree) == 0 && destroyed == NODES);
+    TEST_CHECK(grow(&tree, NODES) == 0);
+    TEST_CHECK(tree.pool->slabs == slabs);
+
+    destroyed = 0;
+    bitree_destroy(&tree);
+    TEST_CHECK(destroyed == NODES && tree.pool == NULL);
+
+    // Without destroy the teardown only frees the slabs
+    bitree_init(&tree, NULL);
+    TEST_CHECK(bitree_use_pool(&tree, BITREE_POOL_HUGEPAGE) == 0);
+    TEST_CHECK(grow(&tree, NODES) == 0);
+    // Nodes start right after the slab header
+    TEST_CHECK((uintptr_t)bitree_root(&tree) % (2 * 1024 * 1024) == 16);
+    bitree_destroy(&tree);
+
+    return 0;
+}
+
+// halves of a split share the pool until the last one is destroyed
+static int test_shared(void)
+{
+    struct bitree_tree tree, left, right, merged, other;
+    struct bitree_node *root;
+    int size;
+
+    bitree_init_sized(&tree, destroy);
+    TEST_CHECK(bitree_use_pool(&tree, 0) == 0);
+    TEST_CHECK(grow(&tree, NODES) == 0);
+    size = NODES;
+
+    TEST_CHECK(bitree_split(&tree, &left, &right) == 0);
+    TEST_CHECK(left.pool == tree.pool && right.pool == tree.pool);
+    TEST_CHECK(tree.pool->refcount == 3);
+    TEST_CHECK(bitree_size(&left) + bitree_size(&right) == size - 1);
+
+    // Only the old root stays with the source tree
+    root = bitree_root(&tree);
+    root->left = root->right = NULL;
+    destroyed = 0;
+    bitree_destroy(&tree);
+    TEST_CHECK(destroyed == 1 && left.pool->refcount == 2);
+
+    // Trees with different pools cannot be merged
+    bitree_init_sized(&other, destroy);
+    TEST_CHECK(bitree_use_pool(&other, 0) == 0);
+    TEST_CHECK(bitree_ins_left_data(&other, NULL, NULL) == 0);
+    TEST_CHECK(bitree_merge(&merged, &left, &other, NULL) == -1);
+    TEST_CHECK(bitree_size(&left) > 0 && left.pool->refcount == 2);
+    bitree_destroy(&other);
+
+    // Merging the halves drops their references, the new tree keeps one
+    TEST_CHECK(bitree_merge(&merged, &left, &right, NULL) == 0);
+    TEST_CHECK(left.pool == NULL && right.pool == NULL);
+    TEST_CHECK(merged.pool->refcount == 1);
+    TEST_CHECK(bitree_size(&merged) == size);
+    TEST_CHECK(check_counts(bitree_root(&merged)) == size);
+
+    destroyed = 0;
+    bitree_destroy(&merged);
+    TEST_CHECK(destroyed == size);
+
+    return 0;
+}
+
+// a pool or slab that cannot be allocated leaves the tree as it was
+static int test_alloc(void)
+{
+    struct bitree_tree tree;
+
+    bitree_init(&tree, destroy);
+    test_fail_alloc(0);
+    TEST_CHECK(bitree_use_pool(&tree, 0) == -1 && tree.pool == NULL);
+    test_fail_alloc(-1);
+
+    TEST_CHECK(bitree_use_pool(&tree, 0) == 0);
+    test_fail_alloc(0);
+    TEST_CHECK(bitree_ins_left_data(&tree, NULL, NULL) == -1);
+    test_fail_alloc(-1);
+    TEST_CHECK(bitree_size(&tree) == 0 && bitree_root(&tree) == NULL);
+
+    TEST_CHECK(bitree_ins_left_data(&tree, NULL, NULL) == 0);
+    destroyed = 0;
+    bitree_destroy(&tree);
+    TEST_CHECK(destroyed == 1);
+
+    return 0;
+}
+
+int test_bitree_pool(void)
+{
+    if (test_recycle(0) != 0 || test_recycle(1) != 0 || test_shared() != 0
+        || test_alloc() != 0)
+        return -1;
+
+    return 0;
+}
@@ -0,0 +1,166 @@
+#include <string.h>
+#include "test.h"
+#include "../src/tree/bitree.h"
+#include "../src/thread/wspool.h"
+
+#define NODES 100000
+#define CHAIN 1000
+
+static long values[NODES];
+static int seen[NODES];
+
+/**
+ * a run of consecutive values, so a combine out of order shows up.
+ */
+struct run {
+    long first;
+    long last;
+    long count;
+    long sum;
+    int ordered;
+};
+
+static const struct run empty = { 0, 0, 0, 0, 1 };
+
+static void map(void *acc, void *data, void *ctx)
+{
+    struct run *run = (struct run *)acc;
+    long value = *(long *)data;
+
+    (void)ctx;
+    if (run->count == 0)
+        run->first = value;
+    else if (value != run->last + 1)
+        run->ordered = 0;
+    run->last = value;
+    run->count++;
+    run->sum += value;
+}
+
+// associative but not commutative
+static void combine(void *acc, const void *other, void *ctx)
+{
+    struct run *run = (struct run *)acc;
+    const struct run *next = (const struct run *)other;
+
+    (void)ctx;
+    if (next->count == 0)
+        return;
+    if (run->count == 0) {
+        *run = *next;
+        return;
+    }
+    run->ordered = run->ordered && next->ordered && next->first == run->last + 1;
+    run->last = next->last;
+    run->count += next->count;
+    run->sum += next->sum;
+}
+
+static void mark(void *data, void *ctx)
+{
+    (void)ctx;
+    __atomic_add_fetch(&seen[*(long *)data], 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * hang the values [@lo, @hi) below @parent, in order and balanced.
+ */
+static int build(struct bitree_tree *tree, struct bitree_node *parent, int left,
+                 long lo, long hi)
+{
+    struct bitree_node *node;
+    long mid = lo + (hi - lo) / 2;
+
+    if (lo >= hi)
+        return 0;
+
+    if (left) {
+        TEST_CHECK(bitree_ins_left_data(tree, parent, &values[mid]) == 0);
+        node = parent == NULL ? bitree_root(tree) : bitree_left(parent);
+    } else {
+        TEST_CHECK(bitree_ins_right_data(tree, parent, &values[mid]) == 0);
+        node = bitree_right(parent);
+    }
+
+    if (build(tree, node, 1, lo, mid) != 0 || build(tree, node, 0, mid + 1, hi) != 0)
+        return -1;
+
+    return 0;
+}
+
+static int check(struct bitree_tree *tree, long size, struct wspool *pool)
+{
+    struct run run;
+    long i;
+
+    memset(&run, 0xff, sizeof(run));
+    TEST_CHECK(bitree_parallel_reduce(tree, map, combine, &empty, sizeof(run),
+                                      &run, NULL, pool) == 0);
+    TEST_CHECK(run.count == size && run.ordered);
+    TEST_CHECK(size == 0 || (run.first == 0 && run.last == size - 1));
+    TEST_CHECK(run.sum == size * (size - 1) / 2);
+
+    memset(seen, 0, sizeof(seen));
+    TEST_CHECK(bitree_parallel_for_each(tree, mark, NULL, pool) == 0);
+    for (i = 0; i < size; i++)
+        TEST_CHECK(seen[i] == 1);
+
+    return 0;
+}
+
+// the same fold with and without the pool, on every kind of tree
+int test_bitree_reduce(void)
+{
+    struct bitree_tree tree;
+    struct bitree_node *node;
+    struct wspool *pool;
+    struct run run;
+    long i;
+
+    for (i = 0; i < NODES; i++)
+        values[i] = i;
+    TEST_CHECK((pool = wspool_create(4)) != NULL);
+
+    bitree_init(&tree, NULL);
+    if (check(&tree, 0, pool) != 0 || check(&tree, 0, NULL) != 0)
+        return -1;
+    if (build(&tree, NULL, 1, 0, NODES) != 0)
+        return -1;
+    if (check(&tree, NODES, pool) != 0 || check(&tree, NODES, NULL) != 0)
+        return -1;
+    bitree_destroy(&tree);
+
+    // Sized trees stop forking at small subtrees
+    bitree_init_sized(&tree, NULL);
+    if (build(&tree, NULL, 1, 0, NODES) != 0)
+        return -1;
+    if (check(&tree, NODES, pool) != 0 || check(&tree, NODES, NULL) != 0)
+        return -1;
+    bitree_destroy(&tree);
+
+    // A right chain forks at every node down to the depth limit
+    bitree_init(&tree, NULL);
+    TEST_CHECK(bitree_ins_right_data(&tree, NULL, &values[0]) == 0);
+    for (i = 1, node = bitree_root(&tree); i < CHAIN; i++, node = bitree_right(node))
+        TEST_CHECK(bitree_ins_right_data(&tree, node, &values[i]) == 0);
+    if (check(&tree, CHAIN, pool) != 0)
+        return -1;
+    bitree_destroy(&tree);
+
+    // A left chain needs a deep walk stack, which may fail
+    bitree_init(&tree, NULL);
+    TEST_CHECK(bitree_ins_left_data(&tree, NULL, &values[CHAIN - 1]) == 0);
+    for (i = CHAIN - 2, node = bitree_root(&tree); i >= 0; i--, node = bitree_left(node))
+        TEST_CHECK(bitree_ins_left_data(&tree, node, &values[i]) == 0);
+    if (check(&tree, CHAIN, pool) != 0)
+        return -1;
+    test_fail_alloc(1);
+    TEST_CHECK(bitree_parallel_reduce(&tree, map, combine, &empty, sizeof(run),
+                                      &run, NULL, NULL) == -1);
+    test_fail_alloc(-1);
+    bitree_destroy(&tree);
+
+    wspool_destroy(pool);
+
+    return 0;
+}
@@ -0,0 +1,184 @@
+#include <stdlib.h>
+#include "test.h"
+#include "../src/tree/bitree.h"
+
+#define NODES 2000
+#define ROUNDS 50
+
+static long destroyed;
+
+static void destroy(void *data)
+{
+    (void)data;
+    destroyed++;
+}
+
+/**
+ * check the count and parent of every node below @node.
+ * @return      number of nodes, -1 if a count or parent is wrong.
+ */
+static int check_node(struct bitree_node *node, struct bitree_node *parent)
+{
+    int left, right;
+
+    if (node == NULL)
+        return 0;
+
+    if (bitree_parent(node) != parent)
+        return -1;
+    if ((left = check_node(bitree_left(node), node)) < 0
+        || (right = check_node(bitree_right(node), node)) < 0)
+        return -1;
+    if (bitree_count(node) != left + right + 1)
+        return -1;
+
+    return left + right + 1;
+}
+
+static int check_tree(struct bitree_tree *tree)
+{
+    TEST_CHECK(check_node(bitree_root(tree), NULL) == bitree_size(tree));
+    TEST_CHECK(bitree_subtree_size(tree, bitree_root(tree)) == bitree_size(tree));
+
+    return 0;
+}
+
+static void collect(struct bitree_node *node, struct bitree_node **nodes, int *count)
+{
+    if (node == NULL)
+        return;
+    nodes[(*count)++] = node;
+    collect(bitree_left(node), nodes, count);
+    collect(bitree_right(node), nodes, count);
+}
+
+/**
+ * add @count nodes at random free places of @tree.
+ */
+static int grow(struct bitree_tree *tree, int count)
+{
+    static struct bitree_node *nodes[4 * NODES];
+    struct bitree_node *parent;
+    int size = 0, i;
+
+    collect(bitree_root(tree), nodes, &size);
+    if (size == 0) {
+        TEST_CHECK(bitree_ins_left_data(tree, NULL, NULL) == 0);
+        nodes[size++] = bitree_root(tree);
+        count--;
+    }
+
+    for (i = 0; i < count; i++) {
+        parent = nodes[test_rand() % size];
+        if (bitree_left(parent) == NULL) {
+            TEST_CHECK(bitree_ins_left_data(tree, parent, NULL) == 0);
+            nodes[size++] = bitree_left(parent);
+        } else if (bitree_right(parent) == NULL) {
+            TEST_CHECK(bitree_ins_right_data(tree, parent, NULL) == 0);
+            nodes[size++] = bitree_right(parent);
+        } else {
+            // Both taken, try another one
+            TEST_CHECK(bitree_ins_left_data(tree, parent, NULL) == -1);
+            i--;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * pick a random node of @tree, NULL if it is empty.
+ */
+static struct bitree_node *pick(struct bitree_tree *tree)
+{
+    static struct bitree_node *nodes[4 * NODES];
+    int size = 0;
+
+    collect(bitree_root(tree), nodes, &size);
+    return size == 0 ? NULL : nodes[test_rand() % size];
+}
+
+int test_bitree_sized(void)
+{
+    struct bitree_tree tree, sub, merged, left, right;
+    struct bitree_node *node, *root;
+    int round, count, size;
+
+    test_srand(37);
+    bitree_init_sized(&tree, destroy);
+    for (round = 0; round < ROUNDS; round++) {
+        if (grow(&tree, NODES / ROUNDS * 2) != 0 || check_tree(&tree) != 0)
+            return -1;
+
+        // Removing a subtree fixes the counts of all its ancestors
+        node = pick(&tree);
+        count = bitree_count(bitree_left(node));
+        size = bitree_size(&tree);
+        destroyed = 0;
+        bitree_rm_left(&tree, node);
+        TEST_CHECK(destroyed == count && bitree_size(&tree) == size - count);
+        if (check_tree(&tree) != 0)
+            return -1;
+
+        node = pick(&tree);
+        count = bitree_count(bitree_right(node));
+        size = bitree_size(&tree);
+        destroyed = 0;
+        bitree_rm_right(&tree, node);
+        TEST_CHECK(destroyed == count && bitree_size(&tree) == size - count);
+        if (check_tree(&tree) != 0)
+            return -1;
+
+        // A whole sized subtree hangs in at once
+        bitree_init_sized(&sub, destroy);
+        if (grow(&sub, 1 + test_rand() % 20) != 0)
+            return -1;
+        count = bitree_size(&sub);
+        size = bitree_size(&tree);
+        while ((node = pick(&tree)) != NULL && bitree_right(node) != NULL)
+            ;
+        TEST_CHECK(node != NULL);
+        TEST_CHECK(bitree_ins_right_node(&tree, node, bitree_root(&sub)) == 0);
+        TEST_CHECK(bitree_size(&tree) == size + count);
+        sub.root = NULL;
+        sub.size = 0;
+        bitree_destroy(&sub);
+        if (check_tree(&tree) != 0)
+            return -1;
+    }
+
+    // Merge counts both sides plus the new root, split takes them back
+    bitree_init_sized(&sub, destroy);
+    if (grow(&sub, NODES / 3) != 0)
+        return -1;
+    size = bitree_size(&tree);
+    count = bitree_size(&sub);
+    TEST_CHECK(bitree_merge(&merged, &tree, &sub, NULL) == 0);
+    TEST_CHECK(bitree_size(&tree) == 0 && bitree_size(&sub) == 0);
+    TEST_CHECK(bitree_size(&merged) == size + count + 1);
+    if (check_tree(&merged) != 0)
+        return -1;
+
+    TEST_CHECK(bitree_split(&merged, &left, &right) == 0);
+    TEST_CHECK(bitree_size(&left) == size && bitree_size(&right) == count);
+    if (check_tree(&left) != 0 || check_tree(&right) != 0)
+        return -1;
+
+    // Only the old root is left to free, the halves own the rest
+    root = bitree_root(&merged);
+    root->left = root->right = NULL;
+    destroyed = 0;
+    bitree_destroy(&merged);
+    bitree_destroy(&left);
+    bitree_destroy(&right);
+    TEST_CHECK(destroyed == 1 + size + count);
+
+    // Plain trees count by walking
+    bitree_init(&tree, NULL);
+    if (grow(&tree, 100) != 0)
+        return -1;
+    TEST_CHECK(bitree_subtree_size(&tree, bitree_root(&tree)) == 100);
+    bitree_destroy(&tree);
+
+    return 0;
+}
@@ -0,0 +1,179 @@
+#include <string.h>
+#include "test.h"
+#include "../src/tree/bitree.h"
+
+#define NODES 500
+
+static long ids[NODES];
+static struct bitree_node *nodes[NODES];
+static struct bitree_node *shape[NODES][2];     // left and right of every node
+
+// The reference order, by recursion
+static long expect[NODES];
+static int expected;
+
+struct visit {
+    long seen[NODES];
+    int count;
+    int stop;                   // stop after this many, 0 never
+};
+
+static int visit(void *data, void *ctx)
+{
+    struct visit *walk = (struct visit *)ctx;
+
+    walk->seen[walk->count++] = *(long *)data;
+    return walk->count == walk->stop ? 7 : 0;
+}
+
+static void reference(struct bitree_node *node, int order)
+{
+    if (node == NULL)
+        return;
+    if (order == BITREE_PREORDER)
+        expect[expected++] = *(long *)bitree_data(node);
+    reference(bitree_left(node), order);
+    if (order == BITREE_INORDER)
+        expect[expected++] = *(long *)bitree_data(node);
+    reference(bitree_right(node), order);
+    if (order == BITREE_POSTORDER)
+        expect[expected++] = *(long *)bitree_data(node);
+}
+
+/**
+ * a random tree of @size nodes, @chain makes every node a left child
+ * so the iterator stack has to grow.
+ */
+static int build(struct bitree_tree *tree, int size, int chain)
+{
+    struct bitree_node *parent;
+    int i;
+
+    bitree_init(tree, NULL);
+    TEST_CHECK(bitree_ins_left_data(tree, NULL, &ids[0]) == 0);
+    nodes[0] = bitree_root(tree);
+    for (i = 1; i < size; i++) {
+        parent = nodes[chain ? i - 1 : (int)(test_rand() % i)];
+        if (bitree_left(parent) == NULL && (chain || test_rand() % 2)) {
+            TEST_CHECK(bitree_ins_left_data(tree, parent, &ids[i]) == 0);
+            nodes[i] = bitree_left(parent);
+        } else if (bitree_right(parent) == NULL) {
+            TEST_CHECK(bitree_ins_right_data(tree, parent, &ids[i]) == 0);
+            nodes[i] = bitree_right(parent);
+        } else {
+            i--;
+        }
+    }
+
+    for (i = 0; i < size; i++) {
+        shape[i][0] = bitree_left(nodes[i]);
+        shape[i][1] = bitree_right(nodes[i]);
+    }
+
+    return 0;
+}
+
+static int check_shape(int size)
+{
+    int i;
+
+    for (i = 0; i < size; i++)
+        TEST_CHECK(bitree_left(nodes[i]) == shape[i][0] && bitree_right(nodes[i]) == shape[i][1]);
+
+    return 0;
+}
+
+static int check_orders(struct bitree_tree *tree, int size)
+{
+    static struct visit walk;
+    struct bitree_iter iter;
+    struct bitree_node *node;
+    int order, stop;
+
+    for (order = BITREE_PREORDER; order <= BITREE_POSTORDER; order++) {
+        expected = 0;
+        reference(bitree_root(tree), order);
+        TEST_CHECK(expected == size);
+
+        TEST_CHECK(bitree_iter_init(&iter, bitree_root(tree), order) == 0);
+        for (walk.count = 0; (node = bitree_iter_next(&iter)) != NULL; walk.count++)
+            TEST_CHECK(walk.count < size && *(long *)bitree_data(node) == expect[walk.count]);
+        TEST_CHECK(walk.count == size && iter.error == 0);
+        bitree_iter_destroy(&iter);
+
+        // Stopping after a spread of nodes, 0 never stops
+        for (stop = 0; stop <= size; stop += 1 + size / 16) {
+            walk.count = 0;
+            walk.stop = stop;
+            TEST_CHECK(bitree_walk(bitree_root(tree), order, visit, &walk) == (stop ? 7 : 0));
+            TEST_CHECK(walk.count == (stop ? stop : size));
+            TEST_CHECK(memcmp(walk.seen, expect, walk.count * sizeof(long)) == 0);
+
+            // Morris threads are all undone, also after a stop
+            if (order == BITREE_POSTORDER) {
+                TEST_CHECK(bitree_walk_morris(bitree_root(tree), order, visit, &walk) == -1);
+                continue;
+            }
+            walk.count = 0;
+            TEST_CHECK(bitree_walk_morris(bitree_root(tree), order, visit, &walk) == (stop ? 7 : 0));
+            TEST_CHECK(walk.count == (stop ? stop : size));
+            TEST_CHECK(memcmp(walk.seen, expect, walk.count * sizeof(long)) == 0);
+            if (check_shape(size) != 0)
+                return -1;
+        }
+    }
+
+    return 0;
+}
+
+// a stack that cannot grow ends the walk with an error
+static int test_alloc(void)
+{
+    static struct visit walk;
+    struct bitree_tree tree;
+    struct bitree_iter iter;
+    int order;
+
+    if (build(&tree, NODES, 1) != 0)
+        return -1;
+
+    test_fail_alloc(0);
+    TEST_CHECK(bitree_iter_init(&iter, bitree_root(&tree), BITREE_INORDER) == -1);
+    test_fail_alloc(-1);
+
+    for (order = BITREE_PREORDER; order <= BITREE_POSTORDER; order++) {
+        walk.count = walk.stop = 0;
+        test_fail_alloc(1);
+        TEST_CHECK(bitree_walk(bitree_root(&tree), order, visit, &walk) == (order == BITREE_PREORDER ? 0 : -1));
+        test_fail_alloc(-1);
+    }
+    bitree_destroy(&tree);
+
+    return 0;
+}
+
+int test_bitree_walk(void)
+{
+    struct bitree_tree tree;
+    int size, i;
+
+    test_srand(38);
+    for (i = 0; i < NODES; i++)
+        ids[i] = i;
+
+    for (size = 1; size <= NODES; size = size * 3 + 1) {
+        if (build(&tree, size, 0) != 0 || check_orders(&tree, size) != 0)
+            return -1;
+        bitree_destroy(&tree);
+
+        if (build(&tree, size, 1) != 0 || check_orders(&tree, size) != 0)
+            return -1;
+        bitree_destroy(&tree);
+    }
+
+    // The empty tree
+    TEST_CHECK(bitree_walk(NULL, BITREE_INORDER, visit, NULL) == 0);
+    TEST_CHECK(bitree_walk_morris(NULL, BITREE_INORDER, visit, NULL) == 0);
+
+    return test_alloc();
+}
@@ -0,0 +1,183 @@
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+#include "../src/tree/bptree.h"
+
+#define KEYS 4096
+
+static int compare(const void *key1, const void *key2)
+{
+    long a = *(const long *)key1, b = *(const long *)key2;
+
+    return a < b ? -1 : a > b;
+}
+
+static int destroyed;
+
+static void destroy(void *data)
+{
+    destroyed++;
+    free(data);
+}
+
+struct walk {
+    long last;
+    int count;
+    int unordered;
+    unsigned long sum;
+};
+
+static int visit(void *data, void *ctx)
+{
+    struct walk *walk = (struct walk *)ctx;
+    long key = *(long *)data;
+
+    walk->unordered += walk->count > 0 && key <= walk->last;
+    walk->last = key;
+    walk->count++;
+    walk->sum = walk->sum * 31 + key;
+    return 0;
+}
+
+static int stop_at_ten(void *data, void *ctx)
+{
+    (void)data;
+    return ++*(int *)ctx == 10;
+}
+
+static long *new_key(long key)
+{
+    long *data = malloc(sizeof(*data));
+
+    *data = key;
+    return data;
+}
+
+// random inserts and removes checked against a bitmap of present keys
+static int test_random(void)
+{
+    static char present[KEYS];
+    struct walk walk;
+    BpTree tree;
+    long key, lo, hi, *data;
+    void *found;
+    int i, ret, size = 0, expect, stop = 0;
+
+    memset(present, 0, sizeof(present));
+    destroyed = 0;
+    bptree_init(&tree, compare, destroy);
+    test_srand(27);
+
+    for (i = 0; i < 200000; i++) {
+        key = test_rand() % KEYS;
+        data = new_key(key);
+        if (test_rand() % 3 != 0) {
+            ret = bptree_insert(&tree, data);
+            TEST_CHECK(ret == (present[key] ? 1 : 0));
+            if (ret == 1)
+                free(data);
+            else
+                size += present[key] = 1;
+        } else {
+            ret = bptree_remove(&tree, data);
+            TEST_CHECK(ret == (present[key] ? 0 : -1));
+            if (ret == 0)
+                size -= present[key]--;
+            free(data);
+        }
+        TEST_CHECK((int)bptree_size(&tree) == size);
+    }
+
+    for (key = 0; key < KEYS; key++) {
+        found = &key;
+        ret = bptree_lookup(&tree, &found);
+        TEST_CHECK(ret == (present[key] ? 0 : -1));
+        TEST_CHECK(ret != 0 || (found != &key && *(long *)found == key));
+    }
+
+    memset(&walk, 0, sizeof(walk));
+    TEST_CHECK(bptree_scan(&tree, NULL, NULL, visit, &walk) == size);
+    TEST_CHECK(walk.count == size && walk.unordered == 0);
+
+    // [lo, hi) with bounds that are present or not
+    lo = 1000;
+    hi = 1777;
+    for (expect = 0, key = lo; key < hi; key++)
+        expect += present[key];
+    memset(&walk, 0, sizeof(walk));
+    TEST_CHECK(bptree_scan(&tree, &lo, &hi, visit, &walk) == expect);
+    TEST_CHECK(walk.unordered == 0 && (expect == 0 || walk.last < hi));
+    TEST_CHECK(bptree_scan(&tree, &hi, &lo, visit, &walk) == 0);
+    TEST_CHECK(bptree_scan(&tree, NULL, NULL, stop_at_ten, &stop) == 10);
+
+    // Remove everything, each removal destroys its data
+    destroyed = 0;
+    for (key = 0; key < KEYS; key++)
+        TEST_CHECK(bptree_remove(&tree, &key) == (present[key] ? 0 : -1));
+    TEST_CHECK(destroyed == size && bptree_size(&tree) == 0);
+    memset(&walk, 0, sizeof(walk));
+    TEST_CHECK(bptree_scan(&tree, NULL, NULL, visit, &walk) == 0);
+
+    // The tree is usable again and destroy releases what is left
+    for (key = 0; key < 100; key++)
+        TEST_CHECK(bptree_insert(&tree, new_key(key)) == 0);
+    destroyed = 0;
+    bptree_destroy(&tree);
+    TEST_CHECK(destroyed == 100);
+
+    return 0;
+}
+
+// every allocation of every insert fails once, the tree must not change
+static int test_out_of_memory(void)
+{
+    static long keys[KEYS];
+    struct walk before, after;
+    BpTree tree;
+    long n, *key;
+    void *found;
+    int i, ret, height;
+
+    bptree_init(&tree, compare, NULL);
+
+    // Even keys ascending, then the odd ones in between
+    for (i = 0; i < KEYS; i++) {
+        key = &keys[i];
+        *key = i < KEYS / 2 ? 2 * i : 2 * (i - KEYS / 2) + 1;
+        memset(&before, 0, sizeof(before));
+        bptree_scan(&tree, NULL, NULL, visit, &before);
+        height = tree.height;
+
+        for (n = 0; ; n++) {
+            test_fail_alloc(n);
+            ret = bptree_insert(&tree, key);
+            test_fail_alloc(-1);
+            if (ret == 0)
+                break;
+
+            TEST_CHECK(ret == -1 && test_alloc_failed());
+            TEST_CHECK((int)bptree_size(&tree) == i && tree.height == height);
+            memset(&after, 0, sizeof(after));
+            bptree_scan(&tree, NULL, NULL, visit, &after);
+            TEST_CHECK(after.count == before.count && after.sum == before.sum);
+            found = key;
+            TEST_CHECK(bptree_lookup(&tree, &found) == -1);
+        }
+    }
+
+    TEST_CHECK(bptree_size(&tree) == KEYS && tree.height > 2);
+    memset(&after, 0, sizeof(after));
+    TEST_CHECK(bptree_scan(&tree, NULL, NULL, visit, &after) == KEYS);
+    TEST_CHECK(after.unordered == 0 && after.last == KEYS - 1);
+    bptree_destroy(&tree);
+
+    return 0;
+}
+
+int test_bptree(void)
+{
+    if (test_random() != 0 || test_out_of_memory() != 0)
+        return -1;
+
+    return 0;
+}
@@ -0,0 +1,171 @@
+#include <pthread.h>
+#include <sched.h>
+#include "test.h"
+#include "../src/thread/epoch.h"
+
+#define READERS 4
+#define UPDATES 200000
+#define LIVE 0x11fe
+#define DEAD 0xdead
+
+struct object {
+    long magic;
+    long value;
+};
+
+static struct object objects[UPDATES + 1];
+static long freed;
+
+// Marks instead of freeing, so a late reader sees DEAD and not garbage
+static void mark_dead(void *ptr)
+{
+    ((struct object *)ptr)->magic = DEAD;
+    __atomic_add_fetch(&freed, 1, __ATOMIC_RELAXED);
+}
+
+// nothing retired while a reader is inside its section is freed
+static int test_sections(void)
+{
+    struct epoch_domain domain;
+    struct epoch_record writer, reader;
+    unsigned long epoch;
+    int i;
+
+    freed = 0;
+    epoch_init(&domain);
+    epoch_register(&domain, &writer);
+    epoch_register(&domain, &reader);
+
+    // Idle records do not hold the epoch back
+    epoch = domain.epoch;
+    epoch_reclaim(&writer);
+    TEST_CHECK(domain.epoch == epoch + 1);
+
+    epoch_enter(&reader);
+    epoch = domain.epoch;
+    for (i = 0; i < 1000; i++) {
+        objects[i].magic = LIVE;
+        TEST_CHECK(epoch_retire(&writer, &objects[i], mark_dead) == 0);
+        epoch_reclaim(&writer);
+    }
+    // The epoch moves once past the reader and then waits for it
+    TEST_CHECK(domain.epoch == epoch + 1);
+    TEST_CHECK(freed == 0);
+    epoch_exit(&reader);
+
+    // Two epochs later everything is safe
+    epoch_reclaim(&writer);
+    epoch_reclaim(&writer);
+    epoch_reclaim(&writer);
+    TEST_CHECK(freed == 1000);
+    for (i = 0; i < 1000; i++)
+        TEST_CHECK(objects[i].magic == DEAD);
+
+    // What is still retired goes with epoch_unregister() or epoch_destroy()
+    objects[0].magic = objects[1].magic = LIVE;
+    TEST_CHECK(epoch_retire(&writer, &objects[0], mark_dead) == 0);
+    TEST_CHECK(epoch_retire(&reader, &objects[1], mark_dead) == 0);
+    epoch_unregister(&reader);
+    TEST_CHECK(freed == 1001 && objects[1].magic == DEAD);
+    epoch_destroy(&domain);
+    TEST_CHECK(freed == 1002 && objects[0].magic == DEAD);
+
+    return 0;
+}
+
+struct shared {
+    struct epoch_domain domain;
+    struct object *current;
+    int done;
+};
+
+struct reader {
+    struct shared *shared;
+    long reads;
+    int errors;
+};
+
+static void *reader_run(void *arg)
+{
+    struct reader *reader = (struct reader *)arg;
+    struct shared *shared = reader->shared;
+    struct epoch_record record;
+    struct object *object;
+    long last = -1;
+
+    epoch_register(&shared->domain, &record);
+    while (!__atomic_load_n(&shared->done, __ATOMIC_ACQUIRE)) {
+        epoch_enter(&record);
+        object = __atomic_load_n(&shared->current, __ATOMIC_ACQUIRE);
+        // The object stays LIVE for the whole section
+        reader->errors += object->magic != LIVE;
+        reader->errors += object->value < last;
+        last = object->value;
+        sched_yield();
+        reader->errors += object->magic != LIVE;
+        epoch_exit(&record);
+        reader->reads++;
+    }
+    epoch_unregister(&record);
+
+    return NULL;
+}
+
+// one writer replaces the object readers look at and retires the old one
+static int test_threads(void)
+{
+    struct reader readers[READERS];
+    pthread_t threads[READERS];
+    struct epoch_record writer;
+    struct shared shared;
+    struct object *old;
+    long i;
+
+    freed = 0;
+    epoch_init(&shared.domain);
+    epoch_register(&shared.domain, &writer);
+    objects[0].magic = LIVE;
+    objects[0].value = 0;
+    shared.current = &objects[0];
+    shared.done = 0;
+    for (i = 0; i < READERS; i++) {
+        readers[i].shared = &shared;
+        readers[i].reads = 0;
+        readers[i].errors = 0;
+        pthread_create(&threads[i], NULL, reader_run, &readers[i]);
+    }
+
+    for (i = 1; i <= UPDATES; i++) {
+        objects[i].magic = LIVE;
+        objects[i].value = i;
+        old = __atomic_exchange_n(&shared.current, &objects[i], __ATOMIC_ACQ_REL);
+        if (epoch_retire(&writer, old, mark_dead) != 0) {
+            epoch_synchronize(&shared.domain);
+            mark_dead(old);
+        }
+    }
+
+    __atomic_store_n(&shared.done, 1, __ATOMIC_RELEASE);
+    for (i = 0; i < READERS; i++) {
+        pthread_join(threads[i], NULL);
+        TEST_CHECK(readers[i].errors == 0);
+    }
+
+    // Every retired object is freed once, the current one never
+    epoch_unregister(&writer);
+    epoch_destroy(&shared.domain);
+    TEST_CHECK(freed == UPDATES);
+    TEST_CHECK(shared.current->magic == LIVE);
+    for (i = 0; i < UPDATES; i++)
+        TEST_CHECK(objects[i].magic == DEAD);
+
+    return 0;
+}
+
+int test_epoch(void)
+{
+    if (test_sections() != 0 || test_threads() != 0)
+        return -1;
+
+    return 0;
+}
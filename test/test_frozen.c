@@ -0,0 +1,126 @@
+#include <stdint.h>
+#include "test.h"
+#include "../src/tree/bistree_frozen.h"
+
+#define KEYS 4096
+
+// Only odd values are inserted, so every gap has a key to miss
+static long values[KEYS];
+
+static int compare(const void *key1, const void *key2)
+{
+    long a = *(const long *)key1, b = *(const long *)key2;
+
+    return a < b ? -1 : a > b;
+}
+
+static uint64_t key_u64(const void *data)
+{
+    return *(const long *)data;
+}
+
+/**
+ * every odd value below 2 * @size is found with the pointer of the tree
+ * unless it was removed, every even one is missed.
+ */
+static int check(BisFrozen *frozen, const char *removed, long size)
+{
+    void *data;
+    long value, i;
+
+    for (value = -1; value <= 2 * size + 1; value++) {
+        i = value / 2;
+        data = &value;
+        if (value % 2 == 0 || value < 0 || i >= size || removed[i]) {
+            TEST_CHECK(bistree_frozen_lookup(frozen, &data) == -1);
+            if (value >= 0)
+                TEST_CHECK(bistree_frozen_lookup_u64(frozen, value, &data) == -1);
+            continue;
+        }
+
+        TEST_CHECK(bistree_frozen_lookup(frozen, &data) == 0 && data == &values[i]);
+        data = NULL;
+        TEST_CHECK(bistree_frozen_lookup_u64(frozen, value, &data) == 0);
+        TEST_CHECK(data == &values[i]);
+    }
+
+    return 0;
+}
+
+// all sizes up to some full levels and past them, with hidden nodes
+static int test_sizes(void)
+{
+    static char removed[KEYS];
+    BisFrozen frozen;
+    BisTree tree;
+    long size, i, live;
+
+    for (i = 0; i < KEYS; i++)
+        values[i] = 2 * i + 1;
+
+    for (size = 0; size <= KEYS; size = size < 300 ? size + 1 : size * 2 - 1) {
+        bistree_init(&tree, compare, NULL);
+        for (i = 0; i < size; i++)
+            TEST_CHECK(bistree_insert(&tree, &values[i]) == 0);
+
+        // Hidden data must not be copied
+        live = size;
+        for (i = 0; i < size; i++) {
+            removed[i] = test_rand() % 5 == 0;
+            if (removed[i]) {
+                TEST_CHECK(bistree_remove(&tree, &values[i]) == 0);
+                live--;
+            }
+        }
+
+        TEST_CHECK(bistree_freeze_u64(&tree, &frozen, key_u64) == 0);
+        TEST_CHECK(bistree_frozen_size(&frozen) == (size_t)live);
+        // Slot 0 is unused and the slots are cache line aligned
+        TEST_CHECK(frozen.data[0] == NULL && (uintptr_t)frozen.data % 64 == 0);
+        if (check(&frozen, removed, size) != 0)
+            return -1;
+        bistree_frozen_destroy(&frozen);
+        bistree_destroy(&tree);
+    }
+
+    return 0;
+}
+
+// a failed freeze leaves nothing allocated and the tree usable
+static int test_alloc(void)
+{
+    BisFrozen frozen;
+    BisTree tree;
+    void *data;
+    long i, fail;
+
+    bistree_init(&tree, compare, NULL);
+    for (i = 0; i < 100; i++)
+        TEST_CHECK(bistree_insert(&tree, &values[i]) == 0);
+
+    for (fail = 0; fail < 2; fail++) {
+        test_fail_alloc(fail);
+        TEST_CHECK(bistree_freeze_u64(&tree, &frozen, key_u64) == -1);
+        test_fail_alloc(-1);
+        TEST_CHECK(test_alloc_failed());
+    }
+
+    // Without integer keys, the u64 lookup is not available
+    TEST_CHECK(bistree_freeze(&tree, &frozen) == 0);
+    TEST_CHECK(frozen.keys == NULL && bistree_frozen_size(&frozen) == 100);
+    data = &values[99];
+    TEST_CHECK(bistree_frozen_lookup(&frozen, &data) == 0 && data == &values[99]);
+    bistree_frozen_destroy(&frozen);
+    bistree_destroy(&tree);
+
+    return 0;
+}
+
+int test_frozen(void)
+{
+    test_srand(30);
+    if (test_sizes() != 0 || test_alloc() != 0)
+        return -1;
+
+    return 0;
+}
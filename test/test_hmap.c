@@ -0,0 +1,160 @@
+#include <string.h>
+#include "test.h"
+#include "../src/data_structure/hmap.h"
+
+#define KEYS 30000
+
+// an odd value size, its copies must not write past it
+struct value {
+    uint32_t key;
+    uint32_t round;
+    char tag[5];
+};
+
+static char present[KEYS];
+static uint32_t rounds[KEYS];
+static int weak;
+
+static uint64_t weak_hash(const void *key, size_t size)
+{
+    (void)size;
+    // Few distinct hashes: long probe sequences and many tombstones
+    return *(const uint32_t *)key % 97 * 0x9e3779b97f4a7c15ULL;
+}
+
+static int visit(const void *key, void *value, void *ctx)
+{
+    uint32_t k = *(const uint32_t *)key;
+    HMap *map = (HMap *)ctx;
+
+    // A set has no value, @value points past the key then
+    if (present[k] != 1 || (map->value_size != 0 && ((struct value *)value)->key != k))
+        return 1;
+    present[k] = 2;
+
+    // Remove every other key on the way
+    if (k % 2 == 0 && hmap_remove(map, key) == 0)
+        present[k] = 0;
+    return 0;
+}
+
+static int check_all(HMap *map, size_t size)
+{
+    struct value *value;
+    uint32_t key;
+
+    TEST_CHECK(hmap_size(map) == size);
+    for (key = 0; key < KEYS; key++) {
+        value = NULL;
+        TEST_CHECK(hmap_lookup(map, &key, (void **)&value) == (present[key] ? 0 : -1));
+        if (present[key] && map->value_size != 0)
+            TEST_CHECK(value->key == key && value->round == rounds[key]
+                       && memcmp(value->tag, "tag!", 5) == 0);
+    }
+
+    return 0;
+}
+
+static int run(size_t value_size)
+{
+    struct value value;
+    HMap map;
+    uint32_t key;
+    size_t size = 0, n;
+    int i, ret, failed = 0;
+
+    memset(present, 0, sizeof(present));
+    hmap_init(&map, sizeof(uint32_t), value_size, weak ? weak_hash : NULL, NULL);
+    TEST_CHECK(hmap_lookup(&map, &size, NULL) == -1);
+    TEST_CHECK(hmap_remove(&map, &size) == -1);
+
+    for (i = 0; i < 400000; i++) {
+        key = test_rand() % KEYS;
+        if (test_rand() % 2 == 0) {
+            value.key = key;
+            value.round = i;
+            memcpy(value.tag, "tag!", 5);
+            ret = hmap_insert(&map, &key, &value);
+            TEST_CHECK(ret == present[key]);
+            if (ret == 0)
+                rounds[key] = i;
+            size += !present[key];
+            present[key] = 1;
+        } else {
+            TEST_CHECK(hmap_remove(&map, &key) == (present[key] ? 0 : -1));
+            size -= present[key];
+            present[key] = 0;
+        }
+        TEST_CHECK(hmap_size(&map) == size);
+
+        if (i % 100000 == 0 && check_all(&map, size) != 0)
+            return -1;
+    }
+    TEST_CHECK(check_all(&map, size) == 0);
+
+    // Every entry is visited once, even with removals on the way
+    TEST_CHECK(hmap_foreach(&map, visit, &map) == size);
+    for (n = 0, key = 0; key < KEYS; key++) {
+        TEST_CHECK(present[key] != 1);
+        if (present[key] == 2) {
+            present[key] = 1;
+            n++;
+        }
+    }
+    size = n;
+    TEST_CHECK(check_all(&map, size) == 0);
+
+    // A NULL value is zeroes
+    key = KEYS;
+    TEST_CHECK(hmap_insert(&map, &key, NULL) == 0);
+    if (value_size != 0) {
+        struct value *found, zero;
+
+        memset(&zero, 0, sizeof(zero));
+        TEST_CHECK(hmap_lookup(&map, &key, (void **)&found) == 0);
+        TEST_CHECK(memcmp(found, &zero, value_size) == 0);
+    }
+    TEST_CHECK(hmap_remove(&map, &key) == 0);
+
+    // Growing fails: the insert fails and nothing changes
+    for (key = 0; key < KEYS; key++) {
+        if (present[key])
+            continue;
+        value.key = key;
+        value.round = rounds[key] = 1;
+        test_fail_alloc(0);
+        ret = hmap_insert(&map, &key, &value);
+        test_fail_alloc(-1);
+        if (ret == -1) {
+            TEST_CHECK(test_alloc_failed() && hmap_size(&map) == size);
+            TEST_CHECK(hmap_lookup(&map, &key, NULL) == -1);
+            TEST_CHECK(hmap_insert(&map, &key, &value) == 0);
+            failed++;
+        }
+        TEST_CHECK(ret != 0 || !test_alloc_failed());
+        present[key] = 1;
+        size++;
+    }
+    TEST_CHECK(failed > 0 && check_all(&map, size) == 0);
+
+    test_fail_alloc(0);
+    ret = hmap_reserve(&map, 4 * KEYS);
+    test_fail_alloc(-1);
+    TEST_CHECK(ret == -1 && check_all(&map, size) == 0);
+    TEST_CHECK(hmap_reserve(&map, 4 * KEYS) == 0 && check_all(&map, size) == 0);
+
+    hmap_destroy(&map);
+
+    return 0;
+}
+
+int test_hmap(void)
+{
+    test_srand(46);
+    for (weak = 0; weak < 2; weak++) {
+        if (run(sizeof(struct value)) != 0 || run(0) != 0)
+            return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,163 @@
+#include <string.h>
+#include "test.h"
+#include "../src/data_structure/htable.h"
+
+#define KEYS 20000
+
+struct entry {
+    struct hlist_node node;
+    uint64_t key;
+    int present;
+    int visited;
+};
+
+static struct entry entries[KEYS];
+static int weak;                // hash into a few long chains
+
+static uint64_t key_hash(uint64_t key)
+{
+    return weak ? key % 61 : htable_hash_u64(key);
+}
+
+static uint64_t hash(const struct hlist_node *node)
+{
+    return key_hash(list_entry(node, struct entry, node)->key);
+}
+
+static int match(const struct hlist_node *node, const void *key)
+{
+    return list_entry(node, struct entry, node)->key == *(const uint64_t *)key;
+}
+
+static struct entry *lookup(const struct htable *table, uint64_t key)
+{
+    struct hlist_node *node = htable_lookup(table, key_hash(key), match, &key);
+
+    return node == NULL ? NULL : list_entry(node, struct entry, node);
+}
+
+static int visit(struct hlist_node *node, void *ctx)
+{
+    struct entry *entry = list_entry(node, struct entry, node);
+
+    entry->visited++;
+    // Drop every third entry on the way
+    if (ctx != NULL && entry->key % 3 == 0) {
+        htable_remove((struct htable *)ctx, node);
+        entry->present = 0;
+    }
+    return 0;
+}
+
+static int stop(struct hlist_node *node, void *ctx)
+{
+    (void)node;
+    return ++*(int *)ctx == 5;
+}
+
+static int released;
+
+static void release(struct hlist_node *node)
+{
+    list_entry(node, struct entry, node)->present = 0;
+    released++;
+}
+
+static int check_all(struct htable *table, size_t size)
+{
+    struct htable before = *table;
+    int i;
+
+    TEST_CHECK(htable_size(table) == size);
+    for (i = 0; i < KEYS; i++) {
+        TEST_CHECK(lookup(table, entries[i].key) == (entries[i].present ? &entries[i] : NULL));
+        entries[i].visited = 0;
+    }
+    // Lookups do not move buckets, even in the middle of a rehash
+    TEST_CHECK(memcmp(&before, table, sizeof(before)) == 0);
+
+    TEST_CHECK(htable_foreach(table, visit, NULL) == size);
+    for (i = 0; i < KEYS; i++)
+        TEST_CHECK(entries[i].visited == entries[i].present);
+
+    return 0;
+}
+
+static int run(void)
+{
+    struct htable table;
+    struct entry *entry;
+    size_t size = 0;
+    int i, count = 0;
+
+    memset(entries, 0, sizeof(entries));
+    for (i = 0; i < KEYS; i++)
+        entries[i].key = (uint64_t)i * 0x9e3779b97f4a7c15ULL;
+
+    TEST_CHECK(htable_init(&table, hash) == 0);
+    for (i = 0; i < 300000; i++) {
+        entry = &entries[test_rand() % KEYS];
+        if (test_rand() % 3 != 0) {
+            TEST_CHECK(lookup(&table, entry->key) == (entry->present ? entry : NULL));
+            if (!entry->present) {
+                TEST_CHECK(htable_insert(&table, &entry->node) == 0);
+                entry->present = 1;
+                size++;
+            }
+        } else if (entry->present) {
+            htable_remove(&table, &entry->node);
+            entry->present = 0;
+            size--;
+        }
+        TEST_CHECK(htable_size(&table) == size);
+
+        // Also check in the middle of rehashes
+        if (i % 50000 == 0 && check_all(&table, size) != 0)
+            return -1;
+    }
+    TEST_CHECK(check_all(&table, size) == 0);
+
+    // Removing from inside foreach
+    for (i = 0; i < KEYS; i++)
+        entries[i].visited = 0;
+    TEST_CHECK(htable_foreach(&table, visit, &table) == size);
+    for (i = 0; i < KEYS; i++)
+        size -= entries[i].visited && entries[i].key % 3 == 0;
+    TEST_CHECK(check_all(&table, size) == 0);
+    TEST_CHECK(htable_foreach(&table, stop, &count) == (size < 5 ? size : 5));
+
+    // A failed grow keeps the table working with a higher load
+    for (i = 0; i < KEYS; i++) {
+        if (entries[i].present)
+            continue;
+        test_fail_alloc(0);
+        TEST_CHECK(htable_insert(&table, &entries[i].node) == 0);
+        test_fail_alloc(-1);
+        entries[i].present = 1;
+        size++;
+    }
+    TEST_CHECK(check_all(&table, size) == 0);
+
+    released = 0;
+    htable_destroy(&table, release);
+    TEST_CHECK(released == (int)size);
+
+    // init cannot allocate the buckets
+    test_fail_alloc(0);
+    i = htable_init(&table, hash);
+    test_fail_alloc(-1);
+    TEST_CHECK(i == -1);
+
+    return 0;
+}
+
+int test_htable(void)
+{
+    test_srand(45);
+    weak = 0;
+    if (run() != 0)
+        return -1;
+
+    weak = 1;
+    return run();
+}
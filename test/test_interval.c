@@ -0,0 +1,167 @@
+#include <stdint.h>
+#include "test.h"
+#include "../src/tree/bistree.h"
+
+#define INTERVALS 4096
+#define RANGE 100000
+#define QUERIES 2000
+#define AVL_HEIGHT 20           // of INTERVALS nodes, with room to spare
+
+struct interval {
+    int64_t low;
+    int64_t high;
+    long id;                    // ties on low
+};
+
+// A revived interval takes the place of the removed one with a new high
+static struct interval intervals[INTERVALS], revived[INTERVALS];
+static struct interval *live[INTERVALS];
+static long low_calls;
+
+static int compare(const void *key1, const void *key2)
+{
+    const struct interval *a = (const struct interval *)key1;
+    const struct interval *b = (const struct interval *)key2;
+
+    if (a->low != b->low)
+        return a->low < b->low ? -1 : 1;
+    return a->id < b->id ? -1 : a->id > b->id;
+}
+
+static int64_t low(const void *data)
+{
+    low_calls++;
+    return ((const struct interval *)data)->low;
+}
+
+static int64_t high(const void *data)
+{
+    return ((const struct interval *)data)->high;
+}
+
+struct query {
+    int64_t lo;
+    int64_t hi;
+    const struct interval *last;
+    int count;
+    int limit;
+    int errors;
+};
+
+// every reported interval overlaps, in key order, and is live
+static int visit(void *data, void *ctx)
+{
+    struct query *query = (struct query *)ctx;
+    struct interval *interval = (struct interval *)data;
+
+    query->errors += interval->low >= query->hi || interval->high <= query->lo;
+    query->errors += query->last != NULL && compare(query->last, interval) >= 0;
+    query->errors += live[interval->id] != interval;
+    query->last = interval;
+    return ++query->count == query->limit;
+}
+
+static long expected(int64_t lo, int64_t hi)
+{
+    long i, count = 0;
+
+    for (i = 0; i < INTERVALS; i++)
+        count += live[i] != NULL && live[i]->low < hi && live[i]->high > lo;
+
+    return count;
+}
+
+/**
+ * random queries against a linear scan; subtrees ending before the
+ * query are skipped, so only a few nodes are read past the hits.
+ */
+static int check_queries(BisTreeInterval *itree)
+{
+    struct query query;
+    long count;
+    int i;
+
+    for (i = 0; i < QUERIES; i++) {
+        query.lo = (int64_t)(test_rand() % (RANGE + 200)) - 100;
+        query.hi = query.lo + 1 + test_rand() % (i % 10 == 0 ? 5000 : 50);
+        query.last = NULL;
+        query.count = query.errors = 0;
+        query.limit = -1;
+        low_calls = 0;
+        count = expected(query.lo, query.hi);
+        TEST_CHECK(bistree_overlap(itree, query.lo, query.hi, visit, &query) == count);
+        TEST_CHECK(query.count == count && query.errors == 0);
+        TEST_CHECK(low_calls <= (count + 1) * 2 * AVL_HEIGHT);
+
+        // Stopping early reports the first hits only
+        if (count > 1) {
+            query.last = NULL;
+            query.count = query.errors = 0;
+            query.limit = 1;
+            TEST_CHECK(bistree_overlap(itree, query.lo, query.hi, visit, &query) == 1);
+            TEST_CHECK(query.errors == 0);
+        }
+    }
+
+    return 0;
+}
+
+int test_interval(void)
+{
+    BisTreeInterval itree;
+    void *data;
+    long i;
+
+    test_srand(35);
+    bistree_interval_init(&itree, compare, NULL, low, high);
+    for (i = 0; i < INTERVALS; i++) {
+        // Mostly short, a few long ones the maxima must carry up
+        intervals[i].low = test_rand() % RANGE;
+        intervals[i].high = intervals[i].low + 1 +
+            test_rand() % (i % 64 == 0 ? RANGE / 5 : 64);
+        intervals[i].id = i;
+        // Some low endpoints are shared
+        if (i % 16 == 1)
+            intervals[i].low = intervals[i - 1].low;
+        if (intervals[i].high <= intervals[i].low)
+            intervals[i].high = intervals[i].low + 1;
+        revived[i] = intervals[i];
+        revived[i].high = intervals[i].low + 1 + test_rand() % 2000;
+
+        TEST_CHECK(bistree_interval_insert(&itree, &intervals[i]) == 0);
+        TEST_CHECK(bistree_interval_insert(&itree, &intervals[i]) == 1);
+        live[i] = &intervals[i];
+    }
+    TEST_CHECK(bistree_size(&itree.tree) == INTERVALS);
+    if (check_queries(&itree) != 0)
+        return -1;
+
+    // Hidden intervals, the long ones included, no longer overlap
+    for (i = 0; i < INTERVALS; i++) {
+        if (i % 64 == 0 || test_rand() % 3 == 0) {
+            TEST_CHECK(bistree_interval_remove(&itree, &intervals[i]) == 0);
+            live[i] = NULL;
+        }
+    }
+    if (check_queries(&itree) != 0)
+        return -1;
+
+    // Reviving replaces the data, so the maxima follow the new high
+    for (i = 0; i < INTERVALS; i++) {
+        if (live[i] == NULL && test_rand() % 2 == 0) {
+            TEST_CHECK(bistree_interval_insert(&itree, &revived[i]) == 0);
+            live[i] = &revived[i];
+        }
+    }
+    if (check_queries(&itree) != 0)
+        return -1;
+
+    // Exact lookups go through the plain tree
+    data = &revived[1];
+    TEST_CHECK(bistree_lookup(&itree.tree, &data) == (live[1] != NULL ? 0 : -1));
+    TEST_CHECK(live[1] == NULL || data == live[1]);
+
+    bistree_interval_destroy(&itree);
+
+    return 0;
+}
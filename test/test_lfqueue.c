@@ -0,0 +1,227 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+#include "../src/data_structure/lfqueue.h"
+
+#define PRODUCERS 4
+#define CONSUMERS 4
+#define ITEMS 100000            // per producer
+
+struct item {
+    struct mpsc_node node;
+    int producer;
+    long seq;
+};
+
+static struct item items[PRODUCERS][ITEMS];
+static char seen[PRODUCERS][ITEMS];
+
+struct producer {
+    struct mpsc_queue *queue;
+    struct mpmc_ring *ring;
+    int id;
+};
+
+static void *mpsc_produce(void *arg)
+{
+    struct producer *producer = (struct producer *)arg;
+    long i;
+
+    for (i = 0; i < ITEMS; i++) {
+        items[producer->id][i].producer = producer->id;
+        items[producer->id][i].seq = i;
+        mpsc_enqueue(producer->queue, &items[producer->id][i].node);
+    }
+
+    return NULL;
+}
+
+// no loss, no duplicate and the order of every producer is kept
+static int test_mpsc(void)
+{
+    struct producer producers[PRODUCERS];
+    pthread_t threads[PRODUCERS];
+    long next[PRODUCERS], received = 0;
+    struct mpsc_queue queue;
+    struct mpsc_node *node;
+    struct item *item;
+    int i;
+
+    mpsc_init(&queue);
+    TEST_CHECK(mpsc_is_empty(&queue) && mpsc_dequeue(&queue) == NULL);
+
+    memset(next, 0, sizeof(next));
+    for (i = 0; i < PRODUCERS; i++) {
+        producers[i].queue = &queue;
+        producers[i].id = i;
+        pthread_create(&threads[i], NULL, mpsc_produce, &producers[i]);
+    }
+
+    while (received < PRODUCERS * ITEMS) {
+        // NULL may also mean a producer is half way, so just retry
+        if ((node = mpsc_dequeue(&queue)) == NULL) {
+            sched_yield();
+            continue;
+        }
+        item = mpsc_entry(node, struct item, node);
+        TEST_CHECK(item->seq == next[item->producer]);
+        next[item->producer]++;
+        received++;
+    }
+
+    for (i = 0; i < PRODUCERS; i++)
+        pthread_join(threads[i], NULL);
+    TEST_CHECK(mpsc_dequeue(&queue) == NULL && mpsc_is_empty(&queue));
+
+    // The queue keeps working once drained through the stub
+    mpsc_enqueue(&queue, &items[0][0].node);
+    mpsc_enqueue(&queue, &items[0][1].node);
+    TEST_CHECK(!mpsc_is_empty(&queue));
+    TEST_CHECK(mpsc_dequeue(&queue) == &items[0][0].node);
+    TEST_CHECK(mpsc_dequeue(&queue) == &items[0][1].node);
+    TEST_CHECK(mpsc_dequeue(&queue) == NULL && mpsc_is_empty(&queue));
+
+    return 0;
+}
+
+// full and empty edges, and wrapping the positions around the cells
+static int test_ring_edges(void)
+{
+    struct mpmc_ring ring;
+    void *data;
+    uintptr_t i, round;
+
+    TEST_CHECK(mpmc_ring_init(&ring, 0) == -1);
+    TEST_CHECK(mpmc_ring_init(&ring, 1) == -1);
+    TEST_CHECK(mpmc_ring_init(&ring, 6) == -1);
+    TEST_CHECK(mpmc_ring_init(&ring, 8) == 0);
+
+    TEST_CHECK(mpmc_ring_dequeue(&ring, &data) == -1);
+    for (round = 0; round < 100; round++) {
+        // Nine items per round move the wrap point every time
+        for (i = 0; i < 8; i++)
+            TEST_CHECK(mpmc_ring_enqueue(&ring, (void *)(round * 8 + i)) == 0);
+        TEST_CHECK(mpmc_ring_enqueue(&ring, &data) == -1);
+
+        for (i = 0; i < 8; i++) {
+            TEST_CHECK(mpmc_ring_dequeue(&ring, &data) == 0);
+            TEST_CHECK(data == (void *)(round * 8 + i));
+            // A freed cell takes one more
+            if (i == 0) {
+                TEST_CHECK(mpmc_ring_enqueue(&ring, &ring) == 0);
+                TEST_CHECK(mpmc_ring_enqueue(&ring, &ring) == -1);
+            }
+        }
+        TEST_CHECK(mpmc_ring_dequeue(&ring, &data) == 0 && data == &ring);
+        TEST_CHECK(mpmc_ring_dequeue(&ring, &data) == -1);
+    }
+    mpmc_ring_destroy(&ring);
+
+    return 0;
+}
+
+static void *ring_produce(void *arg)
+{
+    struct producer *producer = (struct producer *)arg;
+    uintptr_t i;
+
+    for (i = 0; i < ITEMS; i++) {
+        // Values are 1 + producer * ITEMS + seq, so never NULL
+        while (mpmc_ring_enqueue(producer->ring,
+                                 (void *)(1 + producer->id * (uintptr_t)ITEMS + i)) != 0)
+            sched_yield();
+    }
+
+    return NULL;
+}
+
+struct consumer {
+    struct mpmc_ring *ring;
+    long *remaining;
+    int errors;
+};
+
+static void *ring_consume(void *arg)
+{
+    struct consumer *consumer = (struct consumer *)arg;
+    long last[PRODUCERS];
+    uintptr_t value;
+    void *data;
+    int i, producer;
+
+    for (i = 0; i < PRODUCERS; i++)
+        last[i] = -1;
+
+    while (__atomic_load_n(consumer->remaining, __ATOMIC_RELAXED) > 0) {
+        if (mpmc_ring_dequeue(consumer->ring, &data) != 0) {
+            sched_yield();
+            continue;
+        }
+        __atomic_sub_fetch(consumer->remaining, 1, __ATOMIC_RELAXED);
+
+        value = (uintptr_t)data - 1;
+        producer = value / ITEMS;
+        if (producer >= PRODUCERS) {
+            consumer->errors++;
+            continue;
+        }
+        // One consumer sees the items of one producer in order
+        consumer->errors += (long)(value % ITEMS) <= last[producer];
+        last[producer] = value % ITEMS;
+        __atomic_add_fetch(&seen[producer][value % ITEMS], 1, __ATOMIC_RELAXED);
+    }
+
+    return NULL;
+}
+
+static int test_ring_threads(void)
+{
+    struct producer producers[PRODUCERS];
+    struct consumer consumers[CONSUMERS];
+    pthread_t threads[PRODUCERS + CONSUMERS];
+    struct mpmc_ring ring;
+    long remaining = PRODUCERS * ITEMS, i;
+    void *data;
+    int j;
+
+    memset(seen, 0, sizeof(seen));
+    // Small, so producers keep hitting the full edge
+    TEST_CHECK(mpmc_ring_init(&ring, 64) == 0);
+    for (j = 0; j < CONSUMERS; j++) {
+        consumers[j].ring = &ring;
+        consumers[j].remaining = &remaining;
+        consumers[j].errors = 0;
+        pthread_create(&threads[PRODUCERS + j], NULL, ring_consume, &consumers[j]);
+    }
+    for (j = 0; j < PRODUCERS; j++) {
+        producers[j].ring = &ring;
+        producers[j].id = j;
+        pthread_create(&threads[j], NULL, ring_produce, &producers[j]);
+    }
+
+    for (j = 0; j < PRODUCERS + CONSUMERS; j++)
+        pthread_join(threads[j], NULL);
+    for (j = 0; j < CONSUMERS; j++)
+        TEST_CHECK(consumers[j].errors == 0);
+
+    // Every item exactly once
+    for (j = 0; j < PRODUCERS; j++) {
+        for (i = 0; i < ITEMS; i++)
+            TEST_CHECK(seen[j][i] == 1);
+    }
+    TEST_CHECK(mpmc_ring_dequeue(&ring, &data) == -1);
+    mpmc_ring_destroy(&ring);
+
+    return 0;
+}
+
+int test_lfqueue(void)
+{
+    if (test_mpsc() != 0 || test_ring_edges() != 0 || test_ring_threads() != 0)
+        return -1;
+
+    return 0;
+}
@@ -1,7 +1,174 @@
-#include <stdio.h>
+#include "test.h"
+#include "../src/data_structure/list.h"
 
-int main(int argc, const char *argv[])
+struct item {
+    struct list_node node;
+    int key;
+};
+
+// both directions link up and hold @n nodes
+static int list_consistent(struct list_node *head, int n)
+{
+    struct list_node *pos;
+    int count = 0;
+
+    for (pos = head->next; pos != head && count <= n; pos = pos->next, count++)
+        TEST_CHECK(pos->next->prev == pos && pos->prev->next == pos);
+    TEST_CHECK(count == n && head->prev->next == head);
+
+    return 0;
+}
+
+struct hitem {
+    struct hlist_node node;
+    int key;
+};
+
+static int test_hlist(void)
 {
-    
+    struct hitem items[6];
+    struct hlist_head head;
+    struct hlist_node *pos, *pnext;
+    int i, count;
+
+    M_INIT_HLIST_HEAD(&head);
+    TEST_CHECK(hlist_is_empty(&head));
+
+    for (i = 0; i < 6; i++) {
+        items[i].key = i;
+        hlist_add_head(&items[i].node, &head);
+    }
+
+    // Newest first, and pprev points at the link to the node
+    for (i = 5, pos = head.first; pos != NULL; pos = pos->next, i--) {
+        TEST_CHECK(list_entry(pos, struct hitem, node)->key == i);
+        TEST_CHECK(*pos->pprev == pos);
+    }
+    TEST_CHECK(i == -1);
+
+    // Delete the first, a middle and the last node while iterating
+    hlist_for_each_safely(pos, pnext, &head) {
+        i = list_entry(pos, struct hitem, node)->key;
+        if (i == 5 || i == 2 || i == 0)
+            hlist_delete(pos);
+    }
+
+    count = 0;
+    for (pos = head.first; pos != NULL; pos = pos->next, count++) {
+        i = list_entry(pos, struct hitem, node)->key;
+        TEST_CHECK(i == 4 || i == 3 || i == 1);
+        TEST_CHECK(*pos->pprev == pos);
+    }
+    TEST_CHECK(count == 3);
+
+    hlist_for_each_safely(pos, pnext, &head)
+        hlist_delete(pos);
+    TEST_CHECK(hlist_is_empty(&head));
+
     return 0;
 }
+
+struct sitem {
+    struct list_node node;
+    int key;
+    int seq;                    // insertion order, to check stability
+};
+
+static int compare(void *ctx, const struct list_node *a, const struct list_node *b)
+{
+    (*(long *)ctx)++;
+    return list_entry(a, struct sitem, node)->key - list_entry(b, struct sitem, node)->key;
+}
+
+static int test_sort(void)
+{
+    // sizes around the powers of two the merge runs are built of
+    static const int sizes[] = { 0, 1, 2, 3, 7, 8, 9, 64, 1000, 4097 };
+    static struct sitem items[4097];
+    struct list_node head, *pos;
+    struct sitem *entry, *prev;
+    long compares;
+    int i, j, n, range;
+
+    for (i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])); i++) {
+        n = sizes[i];
+        // Many duplicates, distinct keys, then already sorted input
+        for (range = 1; range <= 3; range++) {
+            M_INIT_LIST_HEAD(&head);
+            for (j = 0; j < n; j++) {
+                items[j].key = range == 1 ? (int)(test_rand() % 10)
+                    : range == 2 ? (int)(test_rand() % 1000000) : j;
+                items[j].seq = j;
+                mlist_enqueue(&head, &items[j].node);
+            }
+
+            compares = 0;
+            mlist_sort(&head, compare, &compares);
+            TEST_CHECK(list_consistent(&head, n) == 0);
+
+            prev = NULL;
+            for (pos = head.next; pos != &head; pos = pos->next) {
+                entry = list_entry(pos, struct sitem, node);
+                TEST_CHECK(prev == NULL || prev->key < entry->key
+                           || (prev->key == entry->key && prev->seq < entry->seq));
+                prev = entry;
+            }
+
+            // O(n log n) compares, at most n - 1 per level
+            for (j = 0; (1 << j) < n; j++)
+                ;
+            TEST_CHECK(compares <= (long)n * j);
+        }
+    }
+
+    return 0;
+}
+
+int test_list(void)
+{
+    struct item items[8], *entry, *next;
+    struct list_node head, *pos, *pnext;
+    static const int expect[] = { 1, 2, 3, 4, 6 };
+    int i;
+
+    M_INIT_LIST_HEAD(&head);
+    TEST_CHECK(mlist_is_empty(&head));
+
+    for (i = 0; i < 8; i++) {
+        items[i].key = i;
+        mlist_enqueue(&head, &items[i].node);
+    }
+    TEST_CHECK(!mlist_is_empty(&head) && list_consistent(&head, 8) == 0);
+    TEST_CHECK(mlist_is_tail(&head, &items[7].node));
+    TEST_CHECK(list_head(&head, struct item, node)->key == 0);
+    TEST_CHECK(list_tail(&head, struct item, node)->key == 7);
+
+    // Dequeue takes from the front, in insertion order
+    mlist_dequeue(&head);
+    TEST_CHECK(list_head(&head, struct item, node)->key == 1);
+
+    // Drop the odd keys while iterating
+    list_for_entry_safely(entry, next, &head, struct item, node) {
+        if (entry->key % 2 != 0)
+            mlist_delete(&entry->node);
+    }
+    TEST_CHECK(list_consistent(&head, 3) == 0);
+
+    i = 2;
+    list_for_each_safely(pos, pnext, &head) {
+        TEST_CHECK(list_entry(pos, struct item, node)->key == i);
+        i += 2;
+    }
+
+    // add_ahead links before the given node, add_tail after it
+    mlist_add_ahead(&items[1].node, &items[2].node);
+    mlist_add_tail(&items[3].node, &items[2].node);
+    TEST_CHECK(list_consistent(&head, 5) == 0);
+    for (i = 0, pos = head.next; pos != &head; pos = pos->next)
+        TEST_CHECK(list_entry(pos, struct item, node)->key == expect[i++]);
+
+    if (test_hlist() != 0)
+        return -1;
+
+    return test_sort();
+}
@@ -0,0 +1,301 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+#include "../src/data_structure/lru.h"
+
+#define KEYS 64
+#define CAPACITY 40
+
+struct value {
+    int key;
+    int charge;
+};
+
+static long freed;              // values passed to the evict callback
+
+static void evict(const void *key, size_t key_len, void *value)
+{
+    if (key_len != sizeof(int) || *(const int *)key != ((struct value *)value)->key)
+        abort();
+    __atomic_add_fetch(&freed, 1, __ATOMIC_RELAXED);
+    free(value);
+}
+
+static struct value *new_value(int key, int charge)
+{
+    struct value *value = malloc(sizeof(*value));
+
+    value->key = key;
+    value->charge = charge;
+    return value;
+}
+
+/*
+ * Model of one strict LRU shard: keys from least to most recent.
+ */
+static int order[KEYS], charges[KEYS], length;
+static size_t usage;
+static long dropped;            // entries the model has let go
+
+static int model_find(int key)
+{
+    int i;
+
+    for (i = 0; i < length && order[i] != key; i++)
+        ;
+    return i < length ? i : -1;
+}
+
+static void model_drop(int i)
+{
+    usage -= charges[order[i]];
+    memmove(order + i, order + i + 1, (length - i - 1) * sizeof(int));
+    length--;
+    dropped++;
+}
+
+static void model_touch(int key)
+{
+    int i = model_find(key);
+
+    memmove(order + i, order + i + 1, (length - i - 1) * sizeof(int));
+    order[length - 1] = key;
+}
+
+static void model_put(int key, int charge)
+{
+    int i = model_find(key);
+
+    if (i >= 0)
+        model_drop(i);
+    order[length++] = key;
+    charges[key] = charge;
+    usage += charge;
+    while (usage > CAPACITY)
+        model_drop(0);
+}
+
+// one shard without pins behaves exactly like the model
+static int test_strict(void)
+{
+    struct lru_cache *cache;
+    struct lru_handle *handle;
+    int i, key, charge, ret;
+
+    TEST_CHECK((cache = lru_create(CAPACITY, 1, 0, evict)) != NULL);
+    freed = dropped = 0;
+    length = 0;
+    usage = 0;
+
+    for (i = 0; i < 100000; i++) {
+        key = test_rand() % KEYS;
+        switch (test_rand() % 4) {
+        case 0: case 1:
+            handle = lru_get(cache, &key, sizeof(key));
+            TEST_CHECK((handle != NULL) == (model_find(key) >= 0));
+            if (handle != NULL) {
+                TEST_CHECK(((struct value *)lru_value(handle))->key == key);
+                lru_release(cache, handle);
+                model_touch(key);
+            }
+            break;
+        case 2:
+            charge = 1 + test_rand() % 5;
+            TEST_CHECK(lru_put(cache, &key, sizeof(key), new_value(key, charge), charge, NULL) == 0);
+            model_put(key, charge);
+            break;
+        default:
+            ret = lru_erase(cache, &key, sizeof(key));
+            TEST_CHECK(ret == (model_find(key) >= 0 ? 0 : -1));
+            if (ret == 0)
+                model_drop(model_find(key));
+        }
+        TEST_CHECK(lru_usage(cache) == usage && freed == dropped);
+    }
+
+    lru_destroy(cache);
+    TEST_CHECK(freed == dropped + length);
+
+    return 0;
+}
+
+// handles pin entries against eviction, erase and replacement
+static int test_pinned(int flags)
+{
+    struct lru_cache *cache;
+    struct lru_handle *pinned, *handle, *again;
+    int key, zero = 0;
+
+    TEST_CHECK((cache = lru_create(4, 1, flags, evict)) != NULL);
+    freed = 0;
+
+    TEST_CHECK(lru_put(cache, &zero, sizeof(zero), new_value(0, 1), 1, &pinned) == 0);
+    for (key = 1; key < 100; key++)
+        TEST_CHECK(lru_put(cache, &key, sizeof(key), new_value(key, 1), 1, NULL) == 0);
+    TEST_CHECK((handle = lru_get(cache, &zero, sizeof(zero))) == pinned);
+    lru_release(cache, handle);
+    TEST_CHECK(lru_usage(cache) == 4 && freed == 96);
+
+    // Replaced while pinned: the old value stays valid until released
+    TEST_CHECK(lru_put(cache, &zero, sizeof(zero), new_value(0, 2), 2, NULL) == 0);
+    TEST_CHECK(((struct value *)lru_value(pinned))->charge == 1 && freed == 97);
+    TEST_CHECK((handle = lru_get(cache, &zero, sizeof(zero))) != NULL);
+    TEST_CHECK(((struct value *)lru_value(handle))->charge == 2);
+    lru_release(cache, pinned);
+    TEST_CHECK(freed == 98);
+
+    // Erased while pinned: gone from the cache, freed at the release
+    TEST_CHECK((again = lru_get(cache, &zero, sizeof(zero))) == handle);
+    TEST_CHECK(lru_erase(cache, &zero, sizeof(zero)) == 0);
+    TEST_CHECK(lru_get(cache, &zero, sizeof(zero)) == NULL);
+    TEST_CHECK(lru_erase(cache, &zero, sizeof(zero)) == -1);
+    lru_release(cache, handle);
+    TEST_CHECK(freed == 98);
+    lru_release(cache, again);
+    TEST_CHECK(freed == 99);
+
+    lru_destroy(cache);
+    TEST_CHECK(freed == 101);
+
+    return 0;
+}
+
+// CLOCK keeps a referenced entry over one that was not used again
+static int test_clock(void)
+{
+    struct lru_cache *cache;
+    int key;
+
+    TEST_CHECK((cache = lru_create(3, 1, LRU_CLOCK, evict)) != NULL);
+    for (key = 0; key < 3; key++)
+        TEST_CHECK(lru_put(cache, &key, sizeof(key), new_value(key, 1), 1, NULL) == 0);
+    key = 0;
+    lru_release(cache, lru_get(cache, &key, sizeof(key)));
+
+    key = 3;
+    TEST_CHECK(lru_put(cache, &key, sizeof(key), new_value(key, 1), 1, NULL) == 0);
+    key = 1;
+    TEST_CHECK(lru_get(cache, &key, sizeof(key)) == NULL);
+    for (key = 0; key < 4; key += key == 0 ? 2 : 1)
+        lru_release(cache, lru_get(cache, &key, sizeof(key)));
+    TEST_CHECK(lru_usage(cache) == 3);
+    lru_destroy(cache);
+
+    return 0;
+}
+
+static int test_out_of_memory(void)
+{
+    struct lru_cache *cache;
+    struct lru_handle *handle;
+    struct value *value;
+    int n, key = 1;
+
+    // Every allocation of create fails once
+    for (n = 0; ; n++) {
+        test_fail_alloc(n);
+        cache = lru_create(CAPACITY, 4, 0, evict);
+        test_fail_alloc(-1);
+        if (cache != NULL)
+            break;
+        TEST_CHECK(test_alloc_failed());
+    }
+    TEST_CHECK(n > 0);
+
+    // A failed put keeps the entry it would have replaced
+    freed = 0;
+    TEST_CHECK(lru_put(cache, &key, sizeof(key), new_value(key, 1), 1, NULL) == 0);
+    value = new_value(key, 2);
+    test_fail_alloc(0);
+    TEST_CHECK(lru_put(cache, &key, sizeof(key), value, 2, NULL) == -1);
+    test_fail_alloc(-1);
+    free(value);
+    TEST_CHECK((handle = lru_get(cache, &key, sizeof(key))) != NULL);
+    TEST_CHECK(((struct value *)lru_value(handle))->charge == 1);
+    TEST_CHECK(lru_usage(cache) == 1 && freed == 0);
+    lru_release(cache, handle);
+    lru_destroy(cache);
+    TEST_CHECK(freed == 1);
+
+    return 0;
+}
+
+struct worker {
+    struct lru_cache *cache;
+    unsigned long seed;
+    long puts;
+    int errors;
+};
+
+static void *worker_run(void *arg)
+{
+    struct worker *worker = (struct worker *)arg;
+    struct lru_handle *handle;
+    unsigned long seed = worker->seed;
+    int i, key;
+
+    for (i = 0; i < 50000; i++) {
+        seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+        // A hot set and a long tail
+        key = (seed >> 33) % ((seed >> 20) % 2 ? 50 : 2000);
+
+        if ((handle = lru_get(worker->cache, &key, sizeof(key))) == NULL) {
+            if (lru_put(worker->cache, &key, sizeof(key), new_value(key, 1 + key % 3),
+                        1 + key % 3, &handle) != 0) {
+                worker->errors++;
+                continue;
+            }
+            worker->puts++;
+        }
+        worker->errors += ((struct value *)lru_value(handle))->key != key;
+        lru_release(worker->cache, handle);
+
+        if (i % 97 == 0)
+            lru_erase(worker->cache, &key, sizeof(key));
+    }
+
+    return NULL;
+}
+
+static int test_threads(int flags)
+{
+    struct lru_cache *cache;
+    struct worker workers[8];
+    pthread_t threads[8];
+    long puts = 0;
+    int i;
+
+    freed = 0;
+    TEST_CHECK((cache = lru_create(500, 8, flags, evict)) != NULL);
+    for (i = 0; i < 8; i++) {
+        workers[i].cache = cache;
+        workers[i].seed = i + 1;
+        workers[i].puts = 0;
+        workers[i].errors = 0;
+        pthread_create(&threads[i], NULL, worker_run, &workers[i]);
+    }
+    for (i = 0; i < 8; i++) {
+        pthread_join(threads[i], NULL);
+        TEST_CHECK(workers[i].errors == 0);
+        puts += workers[i].puts;
+    }
+
+    // Without pins no shard is over its share of 500, rounded up
+    TEST_CHECK(lru_usage(cache) <= (500 + 7) / 8 * 8);
+    lru_destroy(cache);
+    TEST_CHECK(freed == puts);
+
+    return 0;
+}
+
+int test_lru(void)
+{
+    test_srand(49);
+    if (test_strict() != 0 || test_pinned(0) != 0 || test_pinned(LRU_CLOCK) != 0)
+        return -1;
+    if (test_clock() != 0 || test_out_of_memory() != 0)
+        return -1;
+
+    return test_threads(0) == 0 && test_threads(LRU_CLOCK) == 0 ? 0 : -1;
+}
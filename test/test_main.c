@@ -0,0 +1,55 @@
+#include <string.h>
+#include "test.h"
+
+static const struct {
+    const char *name;
+    int (*run)(void);
+} tests[] = {
+    { "list", test_list },
+    { "lfqueue", test_lfqueue },
+    { "epoch", test_epoch },
+    { "bistree_u64", test_bistree_u64 },
+    { "bistree_setops", test_bistree_setops },
+    { "bistree_fc", test_bistree_fc },
+    { "bistree_rcu", test_bistree_rcu },
+    { "bptree", test_bptree },
+    { "pbistree", test_pbistree },
+    { "sorted_batch", test_sorted_batch },
+    { "frozen", test_frozen },
+    { "interval", test_interval },
+    { "bitree_sized", test_bitree_sized },
+    { "bitree_walk", test_bitree_walk },
+    { "bitree_reduce", test_bitree_reduce },
+    { "bitree_pool", test_bitree_pool },
+    { "bitree_map", test_bitree_map },
+    { "bitree_build", test_bitree_build },
+    { "bitree_implicit", test_bitree_implicit },
+    { "avl_tree", test_avl_tree },
+    { "htable", test_htable },
+    { "hmap", test_hmap },
+    { "ulist", test_ulist },
+    { "lru", test_lru },
+    { "skiplist", test_skiplist },
+};
+
+int main(int argc, const char *argv[])
+{
+    int i, j, failures = 0;
+
+    for (i = 0; i < (int)(sizeof(tests) / sizeof(tests[0])); i++) {
+        // Only the tests named on the command line, all by default
+        for (j = 1; j < argc && strcmp(argv[j], tests[i].name) != 0; j++)
+            ;
+        if (argc > 1 && j == argc)
+            continue;
+
+        if (tests[i].run() == 0) {
+            printf("%-16s ok\n", tests[i].name);
+        } else {
+            printf("%-16s FAILED\n", tests[i].name);
+            failures++;
+        }
+    }
+
+    return failures == 0 ? 0 : 1;
+}
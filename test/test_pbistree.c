@@ -0,0 +1,221 @@
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+#include "../src/tree/pbistree.h"
+
+#define KEYS 2048
+#define VERSIONS 8
+
+static char present[VERSIONS][KEYS];
+static PBisTree versions[VERSIONS];
+static int outstanding;         // data not destroyed yet
+
+static int compare(const void *key1, const void *key2)
+{
+    long a = *(const long *)key1, b = *(const long *)key2;
+
+    return a < b ? -1 : a > b;
+}
+
+static void destroy(void *data)
+{
+    outstanding--;
+    free(data);
+}
+
+static long *new_key(long key)
+{
+    long *data = malloc(sizeof(*data));
+
+    *data = key;
+    outstanding++;
+    return data;
+}
+
+/**
+ * check order, and the AVL heights too when @balanced.
+ * @return      height of @node, -1 if it is broken.
+ */
+static int check_node(struct pbistree_node *node, const long *lo, const long *hi,
+                      int balanced)
+{
+    long key;
+    int hl, hr;
+
+    if (node == NULL)
+        return 0;
+
+    key = *(long *)node->entry->data;
+    if ((lo != NULL && key <= *lo) || (hi != NULL && key >= *hi))
+        return -1;
+    if (node->refcount < 1 || node->entry->refcount < 1)
+        return -1;
+
+    hl = check_node(node->left, lo, &key, balanced);
+    hr = check_node(node->right, &key, hi, balanced);
+    if (hl < 0 || hr < 0)
+        return -1;
+    if (balanced && (hl - hr > 1 || hr - hl > 1 || node->height != 1 + (hl > hr ? hl : hr)))
+        return -1;
+
+    return 1 + (hl > hr ? hl : hr);
+}
+
+struct walk {
+    const char *present;
+    long last;
+    int count;
+    int wrong;
+};
+
+static int visit(void *data, void *ctx)
+{
+    struct walk *walk = (struct walk *)ctx;
+    long key = *(long *)data;
+
+    walk->wrong += (walk->count > 0 && key <= walk->last) || !walk->present[key];
+    walk->last = key;
+    walk->count++;
+    return 0;
+}
+
+// @tree holds exactly the keys in @present
+static int check_version(PBisTree *tree, const char *present, int balanced)
+{
+    struct walk walk;
+    int key, size = 0;
+
+    for (key = 0; key < KEYS; key++)
+        size += present[key];
+
+    memset(&walk, 0, sizeof(walk));
+    walk.present = present;
+    TEST_CHECK(check_node(tree->root, NULL, NULL, balanced) >= 0);
+    TEST_CHECK(pbistree_foreach(tree, visit, &walk) == size);
+    TEST_CHECK(walk.wrong == 0 && (int)pbistree_size(tree) == size);
+
+    return 0;
+}
+
+// random updates of random versions, with versions replaced by snapshots
+static int test_versions(void)
+{
+    int i, v, w, ret;
+    long key, *data;
+    void *found;
+
+    memset(present, 0, sizeof(present));
+    pbistree_init(&versions[0], compare, destroy);
+    for (v = 1; v < VERSIONS; v++)
+        pbistree_snapshot(&versions[v], &versions[0]);
+
+    for (i = 0; i < 200000; i++) {
+        v = test_rand() % VERSIONS;
+        key = test_rand() % KEYS;
+        switch (test_rand() % 10) {
+        case 0: case 1: case 2: case 3:
+            data = new_key(key);
+            ret = pbistree_insert(&versions[v], data);
+            TEST_CHECK(ret == present[v][key]);
+            if (ret == 1)
+                destroy(data);
+            present[v][key] = 1;
+            break;
+        case 4: case 5: case 6: case 7:
+            TEST_CHECK(pbistree_remove(&versions[v], &key) == (present[v][key] ? 0 : -1));
+            present[v][key] = 0;
+            break;
+        case 8:
+            w = test_rand() % VERSIONS;
+            if (w == v)
+                break;
+            pbistree_destroy(&versions[w]);
+            pbistree_snapshot(&versions[w], &versions[v]);
+            memcpy(present[w], present[v], KEYS);
+            break;
+        default:
+            found = &key;
+            ret = pbistree_lookup(&versions[v], &found);
+            TEST_CHECK(ret == (present[v][key] ? 0 : -1));
+            TEST_CHECK(ret != 0 || *(long *)found == key);
+        }
+
+        if (i % 10000 == 0) {
+            for (w = 0; w < VERSIONS; w++)
+                TEST_CHECK(check_version(&versions[w], present[w], 1) == 0);
+        }
+    }
+
+    // Data lives until the last version holding it goes away
+    for (v = 0; v < VERSIONS; v++) {
+        TEST_CHECK(check_version(&versions[v], present[v], 1) == 0);
+        pbistree_destroy(&versions[v]);
+    }
+    TEST_CHECK(outstanding == 0);
+
+    return 0;
+}
+
+/*
+ * Every allocation of updates on a shared version fails once. A failed
+ * update leaves both versions with the same data and both stay balanced,
+ * a done update never skips its rotations.
+ */
+static int test_out_of_memory(void)
+{
+    PBisTree *tree = &versions[0], *snapshot = &versions[1];
+    long key, n, *data;
+    int ret;
+
+    memset(present, 0, sizeof(present));
+    pbistree_init(tree, compare, destroy);
+    for (key = 0; key < KEYS; key += 2) {
+        TEST_CHECK(pbistree_insert(tree, new_key(key)) == 0);
+        present[0][key] = present[1][key] = 1;
+    }
+
+    for (key = 0; key < 256; key++) {
+        pbistree_snapshot(snapshot, tree);
+        // Scattered odd inserts, a run of even removes which rotates often
+        data = new_key(key % 2 == 0 ? (key * 7 + 1) % KEYS : key - 1);
+        for (n = 0; ; n++) {
+            test_fail_alloc(n);
+            ret = key % 2 == 0 ? pbistree_insert(tree, data) : pbistree_remove(tree, data);
+            test_fail_alloc(-1);
+            if (ret != -1 || !test_alloc_failed())
+                break;
+            TEST_CHECK(check_version(tree, present[0], 1) == 0);
+            TEST_CHECK(check_version(snapshot, present[1], 1) == 0);
+        }
+
+        if (key % 2 == 0) {
+            TEST_CHECK(ret == present[0][*data]);
+            present[0][*data] = 1;
+            if (ret == 1)
+                destroy(data);
+        } else {
+            TEST_CHECK(ret == (present[0][*data] ? 0 : -1));
+            present[0][*data] = 0;
+            destroy(data);
+        }
+        TEST_CHECK(check_version(tree, present[0], 1) == 0);
+        TEST_CHECK(check_version(snapshot, present[1], 1) == 0);
+
+        pbistree_destroy(snapshot);
+        memcpy(present[1], present[0], KEYS);
+    }
+
+    pbistree_destroy(tree);
+    TEST_CHECK(outstanding == 0);
+
+    return 0;
+}
+
+int test_pbistree(void)
+{
+    test_srand(34);
+    if (test_versions() != 0 || test_out_of_memory() != 0)
+        return -1;
+
+    return 0;
+}
@@ -0,0 +1,265 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+#include "../src/data_structure/skiplist.h"
+
+#define KEYS 4000
+#define OWNED 2000              // keys below are only updated by key % THREADS
+#define THREADS 8
+
+static long destroyed;
+
+static int compare(const void *key1, const void *key2)
+{
+    long a = *(const long *)key1, b = *(const long *)key2;
+
+    return a < b ? -1 : a > b;
+}
+
+static void destroy(void *data)
+{
+    __atomic_add_fetch(&destroyed, 1, __ATOMIC_RELAXED);
+    free(data);
+}
+
+static long *new_key(long key)
+{
+    long *data = malloc(sizeof(*data));
+
+    *data = key;
+    return data;
+}
+
+struct walk {
+    long last;
+    int count;
+    int unordered;
+};
+
+static int visit(void *data, void *ctx)
+{
+    struct walk *walk = (struct walk *)ctx;
+    long key = *(long *)data;
+
+    walk->unordered += key <= walk->last;
+    walk->last = key;
+    walk->count++;
+    return 0;
+}
+
+static int test_single(void)
+{
+    static char present[KEYS];
+    struct epoch_record record;
+    struct walk walk;
+    SkipList list;
+    long key, lo, hi, n, *data;
+    void *found;
+    int i, ret, size = 0, expect, inserted = 0;
+
+    memset(present, 0, sizeof(present));
+    destroyed = 0;
+    TEST_CHECK(skiplist_init(&list, compare, destroy) == 0);
+    skiplist_register(&list, &record);
+
+    for (i = 0; i < 200000; i++) {
+        key = test_rand() % KEYS;
+        switch (test_rand() % 3) {
+        case 0:
+            data = new_key(key);
+            ret = skiplist_insert(&list, &record, data);
+            TEST_CHECK(ret == present[key]);
+            if (ret == 1)
+                free(data);
+            inserted += ret == 0;
+            size += !present[key];
+            present[key] = 1;
+            break;
+        case 1:
+            TEST_CHECK(skiplist_remove(&list, &record, &key) == (present[key] ? 0 : -1));
+            size -= present[key];
+            present[key] = 0;
+            break;
+        default:
+            found = &key;
+            ret = skiplist_lookup(&list, &record, &found);
+            TEST_CHECK(ret == (present[key] ? 0 : -1));
+            TEST_CHECK(ret != 0 || (found != &key && *(long *)found == key));
+        }
+        TEST_CHECK((int)skiplist_size(&list) == size);
+    }
+
+    walk.last = -1;
+    walk.count = walk.unordered = 0;
+    TEST_CHECK(skiplist_scan(&list, &record, NULL, NULL, visit, &walk) == size);
+    TEST_CHECK(walk.unordered == 0);
+
+    lo = 100;
+    hi = 333;
+    for (expect = 0, key = lo; key < hi; key++)
+        expect += present[key];
+    walk.last = lo - 1;
+    walk.count = walk.unordered = 0;
+    TEST_CHECK(skiplist_scan(&list, &record, &lo, &hi, visit, &walk) == expect);
+    TEST_CHECK(walk.unordered == 0 && (expect == 0 || walk.last < hi));
+
+    // A failed node allocation changes nothing
+    for (key = 0; key < KEYS; key++) {
+        if (present[key])
+            continue;
+        data = new_key(key);
+        for (n = 0; ; n++) {
+            test_fail_alloc(n);
+            ret = skiplist_insert(&list, &record, data);
+            test_fail_alloc(-1);
+            if (ret != -1)
+                break;
+            TEST_CHECK(test_alloc_failed() && (int)skiplist_size(&list) == size);
+            found = &key;
+            TEST_CHECK(skiplist_lookup(&list, &record, &found) == -1);
+        }
+        TEST_CHECK(ret == 0 && n > 0);
+        inserted++;
+        present[key] = 1;
+        size++;
+    }
+    walk.last = -1;
+    walk.count = walk.unordered = 0;
+    TEST_CHECK(skiplist_scan(&list, &record, NULL, NULL, visit, &walk) == KEYS);
+    TEST_CHECK(walk.unordered == 0);
+
+    // Every inserted data is destroyed exactly once
+    skiplist_unregister(&list, &record);
+    skiplist_destroy(&list);
+    TEST_CHECK(destroyed == inserted);
+
+    return 0;
+}
+
+struct worker {
+    SkipList *list;
+    int id;
+    long inserted;
+    long removed;
+    int errors;
+};
+
+static void *worker_run(void *arg)
+{
+    struct worker *worker = (struct worker *)arg;
+    struct epoch_record record;
+    struct walk walk;
+    char present[OWNED];
+    unsigned long seed = worker->id + 1;
+    long key, lo, hi, *data;
+    void *found;
+    int i, ret, owned;
+
+    memset(present, 0, sizeof(present));
+    skiplist_register(worker->list, &record);
+
+    for (i = 0; i < 100000; i++) {
+        seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+        key = (seed >> 33) % KEYS;
+        // The keys of this thread behave like a private map
+        if (key < OWNED)
+            key = key - key % THREADS + worker->id;
+        owned = key < OWNED;
+
+        switch ((seed >> 20) % 8) {
+        case 0: case 1: case 2:
+            data = new_key(key);
+            ret = skiplist_insert(worker->list, &record, data);
+            if (ret == 1)
+                free(data);
+            worker->inserted += ret == 0;
+            worker->errors += ret == -1 || (owned && ret != present[key]);
+            if (owned)
+                present[key] = 1;
+            break;
+        case 3: case 4:
+            ret = skiplist_remove(worker->list, &record, &key);
+            worker->removed += ret == 0;
+            worker->errors += owned && ret != (present[key] ? 0 : -1);
+            if (owned)
+                present[key] = 0;
+            break;
+        case 5: case 6:
+            found = &key;
+            ret = skiplist_lookup(worker->list, &record, &found);
+            worker->errors += ret == 0 && (found == &key || *(long *)found != key);
+            worker->errors += owned && ret != (present[key] ? 0 : -1);
+            break;
+        default:
+            lo = key;
+            hi = key + 50;
+            walk.last = lo - 1;
+            walk.count = walk.unordered = 0;
+            skiplist_scan(worker->list, &record, &lo, &hi, visit, &walk);
+            worker->errors += walk.unordered != 0 || walk.count > 50;
+        }
+    }
+
+    skiplist_unregister(worker->list, &record);
+
+    return NULL;
+}
+
+static int test_threads(void)
+{
+    struct worker workers[THREADS];
+    pthread_t threads[THREADS];
+    struct epoch_record record;
+    struct walk walk;
+    SkipList list;
+    long size = 0;
+    int i;
+
+    destroyed = 0;
+    TEST_CHECK(skiplist_init(&list, compare, destroy) == 0);
+    for (i = 0; i < THREADS; i++) {
+        workers[i].list = &list;
+        workers[i].id = i;
+        workers[i].inserted = workers[i].removed = 0;
+        workers[i].errors = 0;
+        pthread_create(&threads[i], NULL, worker_run, &workers[i]);
+    }
+    for (i = 0; i < THREADS; i++) {
+        pthread_join(threads[i], NULL);
+        TEST_CHECK(workers[i].errors == 0);
+        size += workers[i].inserted - workers[i].removed;
+    }
+
+    skiplist_register(&list, &record);
+    walk.last = -1;
+    walk.count = walk.unordered = 0;
+    TEST_CHECK(skiplist_scan(&list, &record, NULL, NULL, visit, &walk) == size);
+    TEST_CHECK(walk.unordered == 0 && (long)skiplist_size(&list) == size);
+    skiplist_unregister(&list, &record);
+
+    // Every inserted data is destroyed exactly once
+    skiplist_destroy(&list);
+    for (i = 0; i < THREADS; i++)
+        size += workers[i].removed;
+    TEST_CHECK(destroyed == size);
+
+    return 0;
+}
+
+int test_skiplist(void)
+{
+    SkipList list;
+    int ret;
+
+    test_srand(50);
+    test_fail_alloc(0);
+    ret = skiplist_init(&list, compare, destroy);
+    test_fail_alloc(-1);
+    TEST_CHECK(ret == -1);
+
+    if (test_single() != 0 || test_threads() != 0)
+        return -1;
+
+    return 0;
+}
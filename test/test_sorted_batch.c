@@ -0,0 +1,112 @@
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+#include "../src/tree/bistree.h"
+
+#define KEYS 20000
+#define BATCH 512
+
+static long values[KEYS];       // odd keys are in the tree
+static char hidden[KEYS];
+static long compares;
+
+static int compare(const void *key1, const void *key2)
+{
+    long a = *(const long *)key1, b = *(const long *)key2;
+
+    compares++;
+    return a < b ? -1 : a > b;
+}
+
+static int cmp_ptr(const void *a, const void *b)
+{
+    long x = **(long *const *)a, y = **(long *const *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+// every out[i] agrees with a plain lookup of keys[i]
+static int check_batch(BisTree *tree, void **keys, size_t n)
+{
+    void *out[BATCH];
+    size_t i;
+    int found = 0;
+    long key;
+
+    TEST_CHECK(n <= BATCH);
+    for (i = 0; i < n; i++) {
+        key = *(long *)keys[i];
+        found += key % 2 == 1 && !hidden[key];
+    }
+
+    TEST_CHECK(bistree_lookup_sorted_batch(tree, keys, n, out) == found);
+    for (i = 0; i < n; i++) {
+        key = *(long *)keys[i];
+        if (key % 2 == 1 && !hidden[key])
+            TEST_CHECK(out[i] == &values[key]);
+        else
+            TEST_CHECK(out[i] == NULL);
+    }
+
+    return 0;
+}
+
+int test_sorted_batch(void)
+{
+    BisTree tree;
+    void *keys[BATCH], *out[BATCH];
+    long key, start;
+    size_t i, n;
+    int round;
+
+    test_srand(36);
+    memset(hidden, 0, sizeof(hidden));
+    bistree_init(&tree, compare, NULL);
+    for (key = 0; key < KEYS; key++)
+        values[key] = key;
+    for (key = 1; key < KEYS; key += 2)
+        TEST_CHECK(bistree_insert(&tree, &values[key]) == 0);
+    for (key = 1; key < KEYS; key += 2) {
+        if (test_rand() % 5 == 0) {
+            TEST_CHECK(bistree_remove(&tree, &values[key]) == 0);
+            hidden[key] = 1;
+        }
+    }
+
+    // Empty batch
+    TEST_CHECK(bistree_lookup_sorted_batch(&tree, keys, 0, out) == 0);
+
+    for (round = 0; round < 400; round++) {
+        // Sorted keys from a random window, with repeats and missing keys
+        n = 1 + test_rand() % BATCH;
+        start = test_rand() % KEYS;
+        for (i = 0; i < n; i++)
+            keys[i] = &values[(start + test_rand() % (round % 2 ? 64 : KEYS)) % KEYS];
+        qsort(keys, n, sizeof(keys[0]), cmp_ptr);
+        if (check_batch(&tree, keys, n) != 0)
+            return -1;
+
+        // Unsorted keys fall back to searches from the root
+        for (i = 0; i < n; i++)
+            keys[i] = &values[test_rand() % KEYS];
+        if (check_batch(&tree, keys, n) != 0)
+            return -1;
+    }
+
+    // A dense sorted batch costs a few compares per key, not a full descent
+    for (i = 0; i < BATCH; i++)
+        keys[i] = &values[1000 + i];
+    compares = 0;
+    if (check_batch(&tree, keys, BATCH) != 0)
+        return -1;
+    TEST_CHECK(compares <= 5 * BATCH);
+
+    bistree_destroy(&tree);
+    bistree_init(&tree, compare, NULL);
+    TEST_CHECK(bistree_lookup_sorted_batch(&tree, keys, BATCH, out) == 0);
+    for (i = 0; i < BATCH; i++)
+        TEST_CHECK(out[i] == NULL);
+    bistree_destroy(&tree);
+
+    return 0;
+}
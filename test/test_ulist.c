@@ -0,0 +1,207 @@
+#include <stdint.h>
+#include <string.h>
+#include "test.h"
+#include "../src/data_structure/ulist.h"
+
+#define MAX_ITEMS 6000
+
+// the expected content, in order
+static long model[MAX_ITEMS];
+static int count;
+static int destroyed;
+
+static void destroy(void *data)
+{
+    (void)data;
+    destroyed++;
+}
+
+static void model_insert(int pos, long value)
+{
+    memmove(model + pos + 1, model + pos, (count - pos) * sizeof(long));
+    model[pos] = value;
+    count++;
+}
+
+static void model_remove(int pos)
+{
+    memmove(model + pos, model + pos + 1, (count - pos - 1) * sizeof(long));
+    count--;
+}
+
+static int check_list(UList *list)
+{
+    struct ulist_iter iter;
+    struct list_node *pos;
+    struct ulist_chunk *chunk;
+    int i = 0, ret;
+
+    TEST_CHECK((int)ulist_size(list) == count);
+    for (ret = ulist_first(list, &iter); ret == 0; ret = ulist_next(list, &iter))
+        TEST_CHECK(i < count && (long)ulist_get(&iter) == model[i++]);
+    TEST_CHECK(i == count && iter.chunk == NULL);
+
+    // No empty chunk is kept, chunks stay cache line aligned
+    for (pos = list->chunks.next; pos != &list->chunks; pos = pos->next) {
+        chunk = list_entry(pos, struct ulist_chunk, node);
+        TEST_CHECK(((uintptr_t)chunk & 63) == 0);
+        TEST_CHECK(chunk->begin >= 0 && chunk->begin < chunk->end
+                   && chunk->end <= (int)ULIST_CHUNK_ITEMS);
+    }
+
+    return 0;
+}
+
+static void seek(UList *list, struct ulist_iter *iter, int pos)
+{
+    ulist_first(list, iter);
+    while (pos-- > 0)
+        ulist_next(list, iter);
+}
+
+static int stop_at_ten(void *data, void *ctx)
+{
+    (void)data;
+    return ++*(int *)ctx == 10;
+}
+
+static int test_random(void)
+{
+    struct ulist_iter iter;
+    UList list;
+    long value = 1;
+    void *data;
+    int i, pos, ret, visited = 0;
+
+    count = 0;
+    ulist_init(&list, destroy);
+    TEST_CHECK(ulist_first(&list, &iter) == -1 && iter.chunk == NULL);
+    TEST_CHECK(ulist_pop_front(&list, &data) == -1 && ulist_pop_back(&list, &data) == -1);
+
+    // Grow for a while, then shrink slowly
+    for (i = 0; i < 60000; i++) {
+        switch (test_rand() % (i < 40000 ? 10 : 7)) {
+        case 0:
+            if (count == MAX_ITEMS)
+                break;
+            TEST_CHECK(ulist_push_front(&list, (void *)value) == 0);
+            model_insert(0, value++);
+            break;
+        case 1:
+            if (count == MAX_ITEMS)
+                break;
+            TEST_CHECK(ulist_push_back(&list, (void *)value) == 0);
+            model_insert(count, value++);
+            break;
+        case 2:
+            ret = ulist_pop_front(&list, &data);
+            TEST_CHECK(ret == (count > 0 ? 0 : -1));
+            if (ret == 0) {
+                TEST_CHECK((long)data == model[0]);
+                model_remove(0);
+            }
+            break;
+        case 3:
+            ret = ulist_pop_back(&list, &data);
+            TEST_CHECK(ret == (count > 0 ? 0 : -1));
+            if (ret == 0) {
+                TEST_CHECK((long)data == model[count - 1]);
+                model_remove(count - 1);
+            }
+            break;
+        case 4: case 5: case 7: case 8: case 9:
+            if (count == MAX_ITEMS)
+                break;
+            pos = test_rand() % (count + 1);
+            seek(&list, &iter, pos);
+            TEST_CHECK(ulist_insert(&list, &iter, (void *)value) == 0);
+            TEST_CHECK((long)ulist_get(&iter) == value);
+            model_insert(pos, value++);
+            // The iterator is still good for walking on
+            if (pos + 1 < count)
+                TEST_CHECK(ulist_next(&list, &iter) == 0 && (long)ulist_get(&iter) == model[pos + 1]);
+            break;
+        case 6:
+            if (count == 0)
+                break;
+            // Remove a run of data through the same iterator
+            pos = test_rand() % count;
+            seek(&list, &iter, pos);
+            for (ret = test_rand() % 4; ret >= 0 && iter.chunk != NULL; ret--) {
+                ulist_remove(&list, &iter, &data);
+                TEST_CHECK((long)data == model[pos]);
+                model_remove(pos);
+                TEST_CHECK(pos < count ? (long)ulist_get(&iter) == model[pos] : iter.chunk == NULL);
+            }
+        }
+
+        if (i % 500 == 0 && check_list(&list) != 0)
+            return -1;
+    }
+    TEST_CHECK(check_list(&list) == 0);
+
+    TEST_CHECK(ulist_foreach(&list, stop_at_ten, &visited) == (count < 10 ? (size_t)count : 10));
+    destroyed = 0;
+    ulist_destroy(&list);
+    TEST_CHECK(destroyed == count && ulist_size(&list) == 0);
+
+    return 0;
+}
+
+// a chunk that cannot be allocated leaves the list as it was
+static int test_out_of_memory(void)
+{
+    struct ulist_iter iter;
+    UList list;
+    long value;
+    int pos, ret, failed = 0;
+
+    count = 0;
+    ulist_init(&list, NULL);
+    for (value = 1; value <= 2000; value++) {
+        pos = value % 3 == 0 ? 0 : value % 3 == 1 ? count : (int)(test_rand() % (count + 1));
+        test_fail_alloc(0);
+        if (value % 3 == 0)
+            ret = ulist_push_front(&list, (void *)value);
+        else if (value % 3 == 1)
+            ret = ulist_push_back(&list, (void *)value);
+        else {
+            seek(&list, &iter, pos);
+            ret = ulist_insert(&list, &iter, (void *)value);
+        }
+        test_fail_alloc(-1);
+
+        if (ret == -1) {
+            TEST_CHECK(test_alloc_failed() && check_list(&list) == 0);
+            failed++;
+            continue;
+        }
+        TEST_CHECK(ret == 0 && !test_alloc_failed());
+        model_insert(pos, value);
+    }
+    TEST_CHECK(failed > 0 && check_list(&list) == 0);
+
+    // Removal never allocates
+    test_fail_alloc(0);
+    for (pos = 0; count > 0; pos = (pos + 7) % count) {
+        seek(&list, &iter, pos);
+        ulist_remove(&list, &iter, NULL);
+        model_remove(pos);
+        if (count == 0)
+            break;
+    }
+    test_fail_alloc(-1);
+    TEST_CHECK(!test_alloc_failed() && check_list(&list) == 0);
+    ulist_destroy(&list);
+
+    return 0;
+}
+
+int test_ulist(void)
+{
+    test_srand(48);
+    if (test_random() != 0 || test_out_of_memory() != 0)
+        return -1;
+
+    return 0;
+}
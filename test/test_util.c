@@ -0,0 +1,75 @@
+#include <errno.h>
+#include <stddef.h>
+#include "test.h"
+
+// glibc entry points behind the interposed allocators below
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+
+static long fail_countdown = -1;
+static int failed;
+static unsigned long rand_state = 1;
+
+void test_fail_alloc(long n)
+{
+    // Disarming keeps the result for test_alloc_failed()
+    if (n >= 0)
+        failed = 0;
+    fail_countdown = n;
+}
+
+int test_alloc_failed(void)
+{
+    return failed;
+}
+
+static int fail_now(void)
+{
+    if (fail_countdown < 0 || fail_countdown-- > 0)
+        return 0;
+
+    failed = 1;
+    return 1;
+}
+
+void *malloc(size_t size)
+{
+    return fail_now() ? NULL : __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    return fail_now() ? NULL : __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    return fail_now() ? NULL : __libc_realloc(ptr, size);
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+    void *mem;
+
+    if (fail_now() || (mem = __libc_memalign(alignment, size)) == NULL)
+        return ENOMEM;
+
+    *memptr = mem;
+    return 0;
+}
+
+void test_srand(unsigned long seed)
+{
+    rand_state = seed != 0 ? seed : 1;
+}
+
+unsigned long test_rand(void)
+{
+    // xorshift64*
+    rand_state ^= rand_state >> 12;
+    rand_state ^= rand_state << 25;
+    rand_state ^= rand_state >> 27;
+    return (rand_state * 2685821657736338717UL) >> 16;
+}